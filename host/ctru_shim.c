@@ -0,0 +1,792 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "ctru_shim.h"
+
+#include <3ds.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "histogram.h"
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+#define VBLANK_PERIOD_NS (1000000000ULL / 60ULL)
+
+//---------------------------------------------------------------------------
+// Emulated HID shared memory: the pad and touch rings that the HID module
+// fills every HID_SAMPLE_PERIOD_NS, in the layout read by libctru (see
+// input_capture.c).
+#define HID_SAMPLE_PERIOD_NS (4000000ULL)
+#define HID_SHARED_MEM_WORDS (0x100)
+#define HID_RING_DEPTH (8)
+#define HID_PAD_SECTION (0)
+#define HID_PAD_ENTRIES (10)
+#define HID_TOUCH_SECTION (42)
+#define HID_TOUCH_ENTRIES (HID_TOUCH_SECTION + 8)
+
+// Kernel objects returned by HIDUSER_GetHandles().  The pad, accel and gyro
+// events are signalled after each sample; the others never are.
+#define HID_EVENT_COUNT (5)
+#define HID_EVENT_HANDLE_BASE (0x100)
+#define HID_MEM_HANDLE (0x200)
+#define HID_EVENT_PAD0 (0)
+#define HID_EVENT_ACCEL (2)
+#define HID_EVENT_GYRO (3)
+
+// svcWaitSynchronization() result on timeout
+#define SHIM_RESULT_TIMEOUT ((Result)0x09401BFE)
+
+//---------------------------------------------------------------------------
+// Input state, as seen by the HID "hardware" (live), as published by the
+// most recent HID sample (sampled), and as latched by the most recent call to
+// hidScanInput() (scanned).
+typedef struct {
+    uint32_t       keys;
+    circlePosition circle;
+    circlePosition cstick;
+    touchPosition  touch;
+    accelVector    accel;
+    angularRate    gyro;
+} shim_input_t;
+
+//---------------------------------------------------------------------------
+static pthread_mutex_t       inputLock = PTHREAD_MUTEX_INITIALIZER;
+static shim_input_t          liveInput;
+static shim_input_t          sampledInput;
+static shim_input_t          scannedInput;
+static uint32_t              previousKeys;
+static u32                   sampledKeys;
+static volatile sig_atomic_t exitRequested;
+static PrintConsole          defaultConsole = { 50, 30 };
+static PrintConsole*         currentConsole = &defaultConsole;
+
+//---------------------------------------------------------------------------
+// Activity counters, reported on exit.  These make the cost of the client's
+// main loop (and savings from idle mode) measurable on the host.
+typedef struct {
+    uint64_t    startNs;          //!< Time the client started
+    uint64_t    scans;            //!< Calls to hidScanInput()
+    uint64_t    vblankWaits;      //!< Calls to gspWaitForVBlank()
+    uint64_t    swaps;            //!< Calls to gfxSwapBuffers()
+    uint64_t    sleeps;           //!< Calls to svcSleepThread()
+    uint64_t    backlightOffNs;   //!< Total time with the backlights off
+    uint64_t    backlightOffedAt; //!< Time the backlights were last turned off (0 == on)
+    uint64_t    pendingInputNs;      //!< Time of the oldest input change not yet sampled (0 == none)
+    uint64_t    sampledInputNs;      //!< Time of the oldest sampled input change not yet scanned (0 == none)
+    histogram_t inputLatencyUs;      //!< Time from an input change to the scan that observed it
+    uint64_t    keyChanges;          //!< Changes to the live key state
+    uint64_t    hidSamples;          //!< Entries written to the shared-memory rings
+    uint64_t    pendingKeysNs;       //!< Time of the oldest key change not yet sampled (0 == none)
+    uint64_t    sampledKeysNs;       //!< Time of the oldest sampled key change not yet sent (0 == none)
+    uint64_t    keysSampledAtNs;     //!< Time of the sample that published it
+    histogram_t keySendLatencyUs;    //!< Time from a key change to the next send() on any socket
+    histogram_t sampleSendLatencyUs; //!< Time from the sample publishing a key change to that send()
+} shim_stats_t;
+
+static shim_stats_t shimStats;
+static pthread_t    scriptThread;
+static pthread_t    samplerThread;
+static u32          sharedMem[HID_SHARED_MEM_WORDS];
+static LightEvent   hidEvents[HID_EVENT_COUNT];
+
+vu32* hidSharedMem = sharedMem;
+
+//---------------------------------------------------------------------------
+static uint64_t shim_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+//---------------------------------------------------------------------------
+static void shim_sigint_handler(int signal_)
+{
+    (void)signal_;
+    exitRequested = 1;
+}
+
+//---------------------------------------------------------------------------
+// Called with inputLock held whenever the live input changes
+static void shim_input_changed(void)
+{
+    if (!shimStats.pendingInputNs) {
+        shimStats.pendingInputNs = shim_now_ns();
+    }
+}
+
+//---------------------------------------------------------------------------
+void ctru_shim_set_keys(uint32_t keys_)
+{
+    pthread_mutex_lock(&inputLock);
+    if (liveInput.keys != keys_) {
+        shimStats.keyChanges++;
+        if (!shimStats.pendingKeysNs) {
+            shimStats.pendingKeysNs = shim_now_ns();
+        }
+    }
+    liveInput.keys = keys_;
+    shim_input_changed();
+    pthread_mutex_unlock(&inputLock);
+}
+
+//---------------------------------------------------------------------------
+void ctru_shim_set_circle(int16_t dx_, int16_t dy_)
+{
+    pthread_mutex_lock(&inputLock);
+    liveInput.circle.dx = dx_;
+    liveInput.circle.dy = dy_;
+    shim_input_changed();
+    pthread_mutex_unlock(&inputLock);
+}
+
+//---------------------------------------------------------------------------
+void ctru_shim_set_cstick(int16_t dx_, int16_t dy_)
+{
+    pthread_mutex_lock(&inputLock);
+    liveInput.cstick.dx = dx_;
+    liveInput.cstick.dy = dy_;
+    shim_input_changed();
+    pthread_mutex_unlock(&inputLock);
+}
+
+//---------------------------------------------------------------------------
+void ctru_shim_set_touch(uint16_t px_, uint16_t py_)
+{
+    pthread_mutex_lock(&inputLock);
+    liveInput.touch.px = px_;
+    liveInput.touch.py = py_;
+    shim_input_changed();
+    pthread_mutex_unlock(&inputLock);
+}
+
+//---------------------------------------------------------------------------
+void ctru_shim_set_accel(int16_t x_, int16_t y_, int16_t z_)
+{
+    pthread_mutex_lock(&inputLock);
+    liveInput.accel.x = x_;
+    liveInput.accel.y = y_;
+    liveInput.accel.z = z_;
+    shim_input_changed();
+    pthread_mutex_unlock(&inputLock);
+}
+
+//---------------------------------------------------------------------------
+void ctru_shim_set_gyro(int16_t x_, int16_t y_, int16_t z_)
+{
+    pthread_mutex_lock(&inputLock);
+    liveInput.gyro.x = x_;
+    liveInput.gyro.y = y_;
+    liveInput.gyro.z = z_;
+    shim_input_changed();
+    pthread_mutex_unlock(&inputLock);
+}
+
+//---------------------------------------------------------------------------
+void ctru_shim_request_exit(void)
+{
+    exitRequested = 1;
+}
+
+//---------------------------------------------------------------------------
+// Replays an input script, one "<time ms> <input> <values...>" command per
+// line, with times relative to client start.  See ctru_shim.h.
+static void* shim_script_thread(void* arg_)
+{
+    FILE* script = (FILE*)arg_;
+    char  line[128];
+
+    while (fgets(line, sizeof(line), script)) {
+        unsigned long timeMs;
+        char          input[16];
+        long          v[3] = { 0, 0, 0 };
+
+        if ((line[0] == '#')
+            || (sscanf(line, "%lu %15s %li %li %li", &timeMs, input, &v[0], &v[1], &v[2]) < 2)) {
+            continue;
+        }
+
+        uint64_t when = shimStats.startNs + ((uint64_t)timeMs * 1000000ULL);
+
+        struct timespec ts = { (time_t)(when / 1000000000ULL), (long)(when % 1000000000ULL) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        if (!strcmp(input, "keys")) {
+            ctru_shim_set_keys((uint32_t)v[0]);
+        } else if (!strcmp(input, "circle")) {
+            ctru_shim_set_circle((int16_t)v[0], (int16_t)v[1]);
+        } else if (!strcmp(input, "cstick")) {
+            ctru_shim_set_cstick((int16_t)v[0], (int16_t)v[1]);
+        } else if (!strcmp(input, "touch")) {
+            ctru_shim_set_touch((uint16_t)v[0], (uint16_t)v[1]);
+        } else if (!strcmp(input, "accel")) {
+            ctru_shim_set_accel((int16_t)v[0], (int16_t)v[1], (int16_t)v[2]);
+        } else if (!strcmp(input, "gyro")) {
+            ctru_shim_set_gyro((int16_t)v[0], (int16_t)v[1], (int16_t)v[2]);
+        } else if (!strcmp(input, "exit")) {
+            ctru_shim_request_exit();
+        } else {
+            fprintf(stderr, "ctru_shim: unknown script input '%s'\n", input);
+        }
+    }
+
+    fclose(script);
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+// Writes one entry to a shared-memory ring: entry data first, then the
+// section's timestamps, then the index -- so a reader that sees the new index
+// also sees the new timestamp.
+static void shim_hid_write_entry(size_t section_, size_t entries_, size_t entryWords_, const u32* entry_, u64 tick_)
+{
+    u32 index = (hidSharedMem[section_ + 4] + 1) % HID_RING_DEPTH;
+
+    for (size_t i = 0; i < entryWords_; i++) { hidSharedMem[entries_ + (index * entryWords_) + i] = entry_[i]; }
+
+    hidSharedMem[section_ + 2] = hidSharedMem[section_ + 0];
+    hidSharedMem[section_ + 3] = hidSharedMem[section_ + 1];
+    hidSharedMem[section_ + 0] = (u32)tick_;
+    hidSharedMem[section_ + 1] = (u32)(tick_ >> 32);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    hidSharedMem[section_ + 4] = index;
+}
+
+//---------------------------------------------------------------------------
+// Samples the live input into the pad and touch rings, as the HID module
+// does.  On the hardware, the rings are stamped with the system tick, which is
+// what time_util_ticks() returns there.
+static void shim_hid_sample(void)
+{
+    // The sample is published (to the rings and to hidScanInput()) under the
+    // lock, so a scan never sees input that the rings don't hold yet.
+    pthread_mutex_lock(&inputLock);
+    shim_input_t input = liveInput;
+    uint64_t     now   = shim_now_ns();
+
+    u64 tick     = time_util_ticks();
+    u32 keys     = input.keys & ~KEY_TOUCH;
+    u32 circle   = (u32)(u16)input.circle.dx | ((u32)(u16)input.circle.dy << 16);
+    u32 pad[4]   = { keys, keys & ~sampledKeys, sampledKeys & ~keys, circle };
+    u32 touch[2] = { (u32)input.touch.px | ((u32)input.touch.py << 16), (input.keys & KEY_TOUCH) ? 1u : 0u };
+    sampledKeys  = keys;
+
+    shim_hid_write_entry(HID_PAD_SECTION, HID_PAD_ENTRIES, 4, pad, tick);
+    shim_hid_write_entry(HID_TOUCH_SECTION, HID_TOUCH_ENTRIES, 2, touch, tick);
+    shimStats.hidSamples++;
+
+    sampledInput = input;
+    if (shimStats.pendingInputNs && !shimStats.sampledInputNs) {
+        shimStats.sampledInputNs = shimStats.pendingInputNs;
+    }
+    if (shimStats.pendingKeysNs && !shimStats.sampledKeysNs) {
+        shimStats.sampledKeysNs   = shimStats.pendingKeysNs;
+        shimStats.keysSampledAtNs = now;
+    }
+    shimStats.pendingInputNs = 0;
+    shimStats.pendingKeysNs  = 0;
+    pthread_mutex_unlock(&inputLock);
+
+    LightEvent_Signal(&hidEvents[HID_EVENT_PAD0]);
+    LightEvent_Signal(&hidEvents[HID_EVENT_ACCEL]);
+    LightEvent_Signal(&hidEvents[HID_EVENT_GYRO]);
+}
+
+//---------------------------------------------------------------------------
+// Stands in for the HID module's sampling timer
+static void* shim_hid_sampler_thread(void* arg_)
+{
+    (void)arg_;
+
+    uint64_t next = shim_now_ns();
+    while (!exitRequested) {
+        next += HID_SAMPLE_PERIOD_NS;
+        struct timespec ts = { (time_t)(next / 1000000000ULL), (long)(next % 1000000000ULL) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        shim_hid_sample();
+    }
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+void ctru_shim_sample_now(void)
+{
+    shim_hid_sample();
+}
+
+//---------------------------------------------------------------------------
+void gfxInitDefault(void)
+{
+    signal(SIGINT, shim_sigint_handler);
+
+    shimStats.startNs = shim_now_ns();
+    histogram_init(&shimStats.inputLatencyUs);
+    histogram_init(&shimStats.keySendLatencyUs);
+    histogram_init(&shimStats.sampleSendLatencyUs);
+
+    for (size_t i = 0; i < HID_EVENT_COUNT; i++) { LightEvent_Init(&hidEvents[i], RESET_STICKY); }
+    if (pthread_create(&samplerThread, NULL, shim_hid_sampler_thread, NULL) == 0) {
+        pthread_detach(samplerThread);
+    }
+
+    const char* scriptPath = getenv("CTRU_SHIM_SCRIPT");
+    if (scriptPath) {
+        FILE* script = fopen(scriptPath, "r");
+        if (!script) {
+            fprintf(stderr, "ctru_shim: couldn't open input script %s\n", scriptPath);
+        } else if (pthread_create(&scriptThread, NULL, shim_script_thread, script) == 0) {
+            pthread_detach(scriptThread);
+        } else {
+            fclose(script);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+void gfxExit(void)
+{
+    uint64_t now = shim_now_ns();
+    if (shimStats.backlightOffedAt) {
+        shimStats.backlightOffNs += now - shimStats.backlightOffedAt;
+    }
+
+    double elapsedSec = (double)(now - shimStats.startNs) / 1e9;
+
+    fprintf(stderr,
+            "ctru_shim: %.1fs elapsed, %llu scans (%.1f/s), %llu vblank waits, %llu swaps, %llu sleeps, "
+            "backlight off %.1fs, %llu key changes, %llu hid samples\n",
+            elapsedSec,
+            (unsigned long long)shimStats.scans,
+            (double)shimStats.scans / elapsedSec,
+            (unsigned long long)shimStats.vblankWaits,
+            (unsigned long long)shimStats.swaps,
+            (unsigned long long)shimStats.sleeps,
+            (double)shimStats.backlightOffNs / 1e9,
+            (unsigned long long)shimStats.keyChanges,
+            (unsigned long long)shimStats.hidSamples);
+
+    if (shimStats.inputLatencyUs.total) {
+        fprintf(stderr,
+                "ctru_shim: input->scan latency (us) n=%llu p50=%lu p99=%lu max=%lu\n",
+                (unsigned long long)shimStats.inputLatencyUs.total,
+                (unsigned long)histogram_percentile(&shimStats.inputLatencyUs, 0.50),
+                (unsigned long)histogram_percentile(&shimStats.inputLatencyUs, 0.99),
+                (unsigned long)shimStats.inputLatencyUs.max);
+    }
+    if (shimStats.keySendLatencyUs.total) {
+        fprintf(stderr,
+                "ctru_shim: key->send latency (us) n=%llu p50=%lu p90=%lu p99=%lu max=%lu; "
+                "sample->send p50=%lu p90=%lu p99=%lu max=%lu\n",
+                (unsigned long long)shimStats.keySendLatencyUs.total,
+                (unsigned long)histogram_percentile(&shimStats.keySendLatencyUs, 0.50),
+                (unsigned long)histogram_percentile(&shimStats.keySendLatencyUs, 0.90),
+                (unsigned long)histogram_percentile(&shimStats.keySendLatencyUs, 0.99),
+                (unsigned long)shimStats.keySendLatencyUs.max,
+                (unsigned long)histogram_percentile(&shimStats.sampleSendLatencyUs, 0.50),
+                (unsigned long)histogram_percentile(&shimStats.sampleSendLatencyUs, 0.90),
+                (unsigned long)histogram_percentile(&shimStats.sampleSendLatencyUs, 0.99),
+                (unsigned long)shimStats.sampleSendLatencyUs.max);
+    }
+}
+
+//---------------------------------------------------------------------------
+void gfxFlushBuffers(void) {}
+
+//---------------------------------------------------------------------------
+void gfxSwapBuffers(void)
+{
+    shimStats.swaps++;
+}
+
+//---------------------------------------------------------------------------
+PrintConsole* consoleInit(gfxScreen_t screen, PrintConsole* console)
+{
+    (void)screen;
+    if (!console) {
+        console = &defaultConsole;
+    }
+    console->consoleWidth  = (screen == GFX_TOP) ? 50 : 40;
+    console->consoleHeight = 30;
+    currentConsole         = console;
+    return console;
+}
+
+//---------------------------------------------------------------------------
+PrintConsole* consoleSelect(PrintConsole* console)
+{
+    PrintConsole* previous = currentConsole;
+    currentConsole         = console;
+    return previous;
+}
+
+//---------------------------------------------------------------------------
+void consoleClear(void)
+{
+    fflush(stdout);
+}
+
+//---------------------------------------------------------------------------
+void gspWaitForVBlank(void)
+{
+    shimStats.vblankWaits++;
+
+    // Sleep until the next 60Hz boundary of the monotonic clock
+    uint64_t now  = shim_now_ns();
+    uint64_t next = ((now / VBLANK_PERIOD_NS) + 1) * VBLANK_PERIOD_NS;
+
+    struct timespec ts = { (time_t)(next / 1000000000ULL), (long)(next % 1000000000ULL) };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+//---------------------------------------------------------------------------
+Result gspLcdInit(void)
+{
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+void gspLcdExit(void) {}
+
+//---------------------------------------------------------------------------
+Result GSPLCD_PowerOnBacklight(u32 screen)
+{
+    (void)screen;
+    if (shimStats.backlightOffedAt) {
+        shimStats.backlightOffNs += shim_now_ns() - shimStats.backlightOffedAt;
+        shimStats.backlightOffedAt = 0;
+    }
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+Result GSPLCD_PowerOffBacklight(u32 screen)
+{
+    (void)screen;
+    if (!shimStats.backlightOffedAt) {
+        shimStats.backlightOffedAt = shim_now_ns();
+    }
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+bool aptMainLoop(void)
+{
+    return !exitRequested;
+}
+
+//---------------------------------------------------------------------------
+void hidScanInput(void)
+{
+    pthread_mutex_lock(&inputLock);
+    previousKeys = scannedInput.keys;
+    scannedInput = sampledInput;
+    if (shimStats.sampledInputNs) {
+        histogram_record(&shimStats.inputLatencyUs, (uint32_t)((shim_now_ns() - shimStats.sampledInputNs) / 1000ULL));
+        shimStats.sampledInputNs = 0;
+    }
+    shimStats.scans++;
+    pthread_mutex_unlock(&inputLock);
+}
+
+//---------------------------------------------------------------------------
+u32 hidKeysHeld(void)
+{
+    return scannedInput.keys;
+}
+
+//---------------------------------------------------------------------------
+u32 hidKeysDown(void)
+{
+    return scannedInput.keys & ~previousKeys;
+}
+
+//---------------------------------------------------------------------------
+u32 hidKeysUp(void)
+{
+    return previousKeys & ~scannedInput.keys;
+}
+
+//---------------------------------------------------------------------------
+void hidCircleRead(circlePosition* pos)
+{
+    *pos = scannedInput.circle;
+}
+
+//---------------------------------------------------------------------------
+void hidCstickRead(circlePosition* pos)
+{
+    *pos = scannedInput.cstick;
+}
+
+//---------------------------------------------------------------------------
+void hidTouchRead(touchPosition* pos)
+{
+    *pos = scannedInput.touch;
+}
+
+//---------------------------------------------------------------------------
+void hidAccelRead(accelVector* vector)
+{
+    *vector = scannedInput.accel;
+}
+
+//---------------------------------------------------------------------------
+void hidGyroRead(angularRate* rate)
+{
+    *rate = scannedInput.gyro;
+}
+
+//---------------------------------------------------------------------------
+Result HIDUSER_EnableAccelerometer(void)
+{
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+Result HIDUSER_DisableAccelerometer(void)
+{
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+Result HIDUSER_EnableGyroscope(void)
+{
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+Result HIDUSER_DisableGyroscope(void)
+{
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+Result HIDUSER_GetHandles(Handle* outMemHandle,
+                          Handle* eventpad0,
+                          Handle* eventpad1,
+                          Handle* eventaccel,
+                          Handle* eventgyro,
+                          Handle* eventdebugpad)
+{
+    Handle* events[HID_EVENT_COUNT] = { eventpad0, eventpad1, eventaccel, eventgyro, eventdebugpad };
+
+    *outMemHandle = HID_MEM_HANDLE;
+    for (size_t i = 0; i < HID_EVENT_COUNT; i++) { *events[i] = HID_EVENT_HANDLE_BASE + (Handle)i; }
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+void svcSleepThread(s64 ns)
+{
+    shimStats.sleeps++;
+
+    struct timespec ts = { (time_t)(ns / 1000000000LL), (long)(ns % 1000000000LL) };
+    nanosleep(&ts, NULL);
+}
+
+//---------------------------------------------------------------------------
+u64 svcGetSystemTick(void)
+{
+    return (u64)(((unsigned __int128)shim_now_ns() * SYSCLOCK_ARM11) / 1000000000ULL);
+}
+
+//---------------------------------------------------------------------------
+// Only the HID events are waitable
+static LightEvent* shim_event_from_handle(Handle handle_)
+{
+    if ((handle_ < HID_EVENT_HANDLE_BASE) || (handle_ >= (HID_EVENT_HANDLE_BASE + HID_EVENT_COUNT))) {
+        return NULL;
+    }
+    return &hidEvents[handle_ - HID_EVENT_HANDLE_BASE];
+}
+
+//---------------------------------------------------------------------------
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds)
+{
+    LightEvent* event = shim_event_from_handle(handle);
+    if (!event) {
+        return -1;
+    }
+    return (LightEvent_WaitTimeout(event, nanoseconds) == 0) ? 0 : SHIM_RESULT_TIMEOUT;
+}
+
+//---------------------------------------------------------------------------
+Result svcClearEvent(Handle handle)
+{
+    LightEvent* event = shim_event_from_handle(handle);
+    if (!event) {
+        return -1;
+    }
+    pthread_mutex_lock(&event->lock);
+    event->signalled = false;
+    pthread_mutex_unlock(&event->lock);
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+Result svcCloseHandle(Handle handle)
+{
+    (void)handle;
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+Result svcGetThreadPriority(s32* out, Handle handle)
+{
+    (void)handle;
+    *out = 0x30;
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+Result APT_CheckNew3DS(bool* out)
+{
+    *out = true;
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+// Threads map directly onto pthreads; priority and core hints are ignored.
+struct Thread_tag {
+    pthread_t  handle;
+    ThreadFunc entrypoint;
+    void*      arg;
+};
+
+//---------------------------------------------------------------------------
+static void* shim_thread_entry(void* arg_)
+{
+    Thread thread = (Thread)arg_;
+    thread->entrypoint(thread->arg);
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+Thread threadCreate(ThreadFunc entrypoint, void* arg, size_t stack_size, int prio, int core_id, bool detached)
+{
+    (void)stack_size;
+    (void)prio;
+    (void)core_id;
+
+    Thread thread = (Thread)calloc(1, sizeof(*thread));
+    if (!thread) {
+        return NULL;
+    }
+    thread->entrypoint = entrypoint;
+    thread->arg        = arg;
+
+    if (pthread_create(&thread->handle, NULL, shim_thread_entry, thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+    if (detached) {
+        pthread_detach(thread->handle);
+    }
+    return thread;
+}
+
+//---------------------------------------------------------------------------
+Result threadJoin(Thread thread, u64 timeout_ns)
+{
+    (void)timeout_ns;
+    return (pthread_join(thread->handle, NULL) == 0) ? 0 : -1;
+}
+
+//---------------------------------------------------------------------------
+void threadFree(Thread thread)
+{
+    free(thread);
+}
+
+//---------------------------------------------------------------------------
+void LightEvent_Init(LightEvent* event, ResetType reset_type)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+    pthread_mutex_init(&event->lock, NULL);
+    pthread_cond_init(&event->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    event->signalled = false;
+    event->resetType = reset_type;
+}
+
+//---------------------------------------------------------------------------
+void LightEvent_Signal(LightEvent* event)
+{
+    pthread_mutex_lock(&event->lock);
+    event->signalled = true;
+    pthread_cond_signal(&event->cond);
+    pthread_mutex_unlock(&event->lock);
+}
+
+//---------------------------------------------------------------------------
+int LightEvent_WaitTimeout(LightEvent* event, s64 timeout_ns)
+{
+    uint64_t deadline = shim_now_ns() + (uint64_t)timeout_ns;
+
+    struct timespec ts = { (time_t)(deadline / 1000000000ULL), (long)(deadline % 1000000000ULL) };
+
+    pthread_mutex_lock(&event->lock);
+    while (!event->signalled) {
+        if (pthread_cond_timedwait(&event->cond, &event->lock, &ts) != 0) {
+            break;
+        }
+    }
+    int rc = event->signalled ? 0 : 1;
+    if (event->signalled && (event->resetType == RESET_ONESHOT)) {
+        event->signalled = false;
+    }
+    pthread_mutex_unlock(&event->lock);
+    return rc;
+}
+
+//---------------------------------------------------------------------------
+Result socInit(u32* context_addr, u32 context_size)
+{
+    (void)context_addr;
+    (void)context_size;
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+Result socExit(void)
+{
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+// The client's send() calls are routed here (the host build links with
+// --wrap=send), to time each key change -- and the sample that published it --
+// to the first send that follows.  The gamepad report is always the first one
+// sent after a poll that observes a key change, so this is the press-to-send
+// latency.
+ssize_t __real_send(int sockfd, const void* buf, size_t len, int flags);
+
+ssize_t __wrap_send(int sockfd, const void* buf, size_t len, int flags)
+{
+    ssize_t rc = __real_send(sockfd, buf, len, flags);
+    if (rc > 0) {
+        pthread_mutex_lock(&inputLock);
+        if (shimStats.sampledKeysNs) {
+            uint64_t now = shim_now_ns();
+            histogram_record(&shimStats.keySendLatencyUs, (uint32_t)((now - shimStats.sampledKeysNs) / 1000ULL));
+            histogram_record(&shimStats.sampleSendLatencyUs, (uint32_t)((now - shimStats.keysSampledAtNs) / 1000ULL));
+            shimStats.sampledKeysNs = 0;
+        }
+        pthread_mutex_unlock(&inputLock);
+    }
+    return rc;
+}
@@ -0,0 +1,64 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Input-injection API for the host libctru stand-in.  Values set here become
+// visible to the client on its next call to hidScanInput().  All functions
+// are safe to call from a thread other than the one running the client.
+//
+// A background thread stands in for the HID module, sampling the current
+// input into the pad and touch rings of hidSharedMem every 4ms and then
+// signalling the pad/accel/gyro events returned by HIDUSER_GetHandles().
+// hidScanInput() latches the most recent sample, not the live input.
+//
+// Input can also be replayed from a script named by the CTRU_SHIM_SCRIPT
+// environment variable, with one command per line (times in milliseconds,
+// relative to client start; '#' starts a comment):
+//
+//   <time> keys <mask>        <time> circle <dx> <dy>   <time> cstick <dx> <dy>
+//   <time> touch <px> <py>    <time> accel <x> <y> <z>  <time> gyro <x> <y> <z>
+//   <time> exit
+//
+// On exit (gfxExit()), the shim prints the number of input scans, vblank
+// waits, buffer swaps and sleeps, input changes and HID samples, the time
+// spent with the backlights off, the distribution of latency from each
+// input change to the scan that observed it, and the distribution of latency
+// from each key change (and the sample that published it) to the next send().
+//---------------------------------------------------------------------------
+
+void ctru_shim_set_keys(uint32_t keys_);
+void ctru_shim_set_circle(int16_t dx_, int16_t dy_);
+void ctru_shim_set_cstick(int16_t dx_, int16_t dy_);
+void ctru_shim_set_touch(uint16_t px_, uint16_t py_);
+void ctru_shim_set_accel(int16_t x_, int16_t y_, int16_t z_);
+void ctru_shim_set_gyro(int16_t x_, int16_t y_, int16_t z_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief ctru_shim_sample_now Take a HID sample of the current input
+ * immediately, as the sampler thread does every 4ms.  Lets benchmarks that
+ * don't start the sampler (by not calling gfxInitDefault()) control exactly
+ * when input becomes visible to hidScanInput().
+ */
+void ctru_shim_sample_now(void);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief ctru_shim_request_exit Cause the next call to aptMainLoop() to
+ * return false, ending the client's main loop.  Also triggered by SIGINT.
+ */
+void ctru_shim_request_exit(void);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,310 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+//---------------------------------------------------------------------------
+// framing-bench: compares the encode/decode cost and wire size of each framing
+// codec, for TLVC messages shaped like the ones netstick actually sends, and
+// for adversarial payloads that hit each codec's worst case.  Then compares
+// the cost of validating a receive buffer of back-to-back TLVC messages with a
+// byte-wise checksum loop, one tlvc_decode_data() call per message, and a
+// single tlvc_decode_batch() call over the frames' boundaries -- and checks
+// that a corrupt payload or length field costs only its own frame.
+//---------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "framing.h"
+#include "joystick.h"
+#include "time_util.h"
+#include "tlvc.h"
+
+//---------------------------------------------------------------------------
+#define BENCH_DEFAULT_ITERATIONS (200000)
+#define BENCH_MAX_MESSAGE (sizeof(js_config_t) + 16)
+#define BENCH_BATCH_FRAMES (1024)
+
+//---------------------------------------------------------------------------
+typedef enum {
+    BenchPayloadZero = 0, //!< All 0x00 -- bytes COBS must encode
+    BenchPayloadSlipEnd,  //!< All 0xC0 -- SLIP's worst case (every byte escaped)
+    BenchPayloadRandom,   //!< Uniformly random bytes
+    BenchPayloadReport,   //!< Realistic gamepad report (small axis values, mostly-zero buttons)
+} bench_payload_t;
+
+typedef struct {
+    const char*     name;
+    size_t          size;
+    bench_payload_t payload;
+} bench_case_t;
+
+//---------------------------------------------------------------------------
+static const bench_case_t benchCases[] = {
+    { "accel report", 12, BenchPayloadReport },
+    { "gamepad report", 38, BenchPayloadReport },
+    { "config", sizeof(js_config_t), BenchPayloadReport },
+    { "random 256", 256, BenchPayloadRandom },
+    { "zeros 256", 256, BenchPayloadZero },
+    { "0xC0 256", 256, BenchPayloadSlipEnd },
+};
+
+//---------------------------------------------------------------------------
+static void bench_fill(uint8_t* data_, size_t size_, bench_payload_t payload_)
+{
+    for (size_t i = 0; i < size_; i++) {
+        switch (payload_) {
+            case BenchPayloadZero: data_[i] = 0x00; break;
+            case BenchPayloadSlipEnd: data_[i] = SLIP_END; break;
+            case BenchPayloadRandom: data_[i] = (uint8_t)rand(); break;
+            case BenchPayloadReport: {
+                // int32 axes with small +/- values, then 0/1 buttons
+                data_[i] = ((i % 4) == 0) ? (uint8_t)(rand() % 3) : (((rand() % 2) != 0) ? 0xFF : 0x00);
+            } break;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+static size_t bench_encode(framing_type_t type_, const tlvc_data_t* tlvc_, uint8_t* out_, size_t outSize_)
+{
+    framing_encoder_t encoder;
+    framing_encode_begin(&encoder, type_, out_, outSize_);
+    framing_encode_data(&encoder, &tlvc_->header, sizeof(tlvc_->header));
+    framing_encode_data(&encoder, tlvc_->data, tlvc_->dataLen);
+    framing_encode_data(&encoder, &tlvc_->footer, sizeof(tlvc_->footer));
+    return framing_encode_finish(&encoder);
+}
+
+//---------------------------------------------------------------------------
+static size_t bench_decode(framing_decoder_t* decoder_, const uint8_t* frame_, size_t frameSize_)
+{
+    size_t frames = 0;
+    size_t offset = 0;
+    while (offset < frameSize_) {
+        size_t consumed = 0;
+        if (framing_decode_data(decoder_, &frame_[offset], frameSize_ - offset, &consumed) == FramingDecodeEndOfFrame) {
+            frames++;
+        }
+        offset += consumed;
+    }
+    return frames;
+}
+
+//---------------------------------------------------------------------------
+static bool bench_run(const bench_case_t* case_, framing_type_t type_, uint32_t iterations_)
+{
+    static uint8_t payload[BENCH_MAX_MESSAGE];
+    static uint8_t frame[(BENCH_MAX_MESSAGE * 2) + 16];
+
+    bench_fill(payload, case_->size, case_->payload);
+
+    tlvc_data_t tlvc = {};
+    tlvc_encode_data(&tlvc, 1, case_->size, payload);
+
+    framing_decoder_t* decoder = framing_decoder_create(type_, BENCH_MAX_MESSAGE);
+    size_t             rawSize = sizeof(tlvc.header) + case_->size + sizeof(tlvc.footer);
+    size_t             wire    = 0;
+
+    // Encode
+    uint64_t start = time_util_ticks();
+    for (uint32_t i = 0; i < iterations_; i++) { wire = bench_encode(type_, &tlvc, frame, sizeof(frame)); }
+    uint64_t encodeTicks = time_util_ticks() - start;
+
+    // Decode (as a stream receiver would), verifying the round trip
+    size_t frames = 0;
+    start         = time_util_ticks();
+    for (uint32_t i = 0; i < iterations_; i++) { frames += bench_decode(decoder, frame, wire); }
+    uint64_t decodeTicks = time_util_ticks() - start;
+
+    bool ok = (wire != 0) && (frames >= iterations_) && (decoder->index == rawSize)
+              && (0 == memcmp(decoder->raw + sizeof(tlvc.header), payload, case_->size));
+
+    printf("%-15s %-7s %7zu %7zu %6.1f%% %9.1f %9.1f %s\n",
+           case_->name,
+           framing_type_name(type_),
+           rawSize,
+           wire,
+           (100.0 * (double)(wire - rawSize)) / (double)rawSize,
+           (double)time_util_ticks_to_us(encodeTicks) * 1000.0 / (double)iterations_,
+           (double)time_util_ticks_to_us(decodeTicks) * 1000.0 / (double)iterations_,
+           ok ? "" : "ROUND-TRIP FAILED");
+
+    framing_decoder_destroy(decoder);
+    return ok;
+}
+
+//---------------------------------------------------------------------------
+// Reference validator: the byte-at-a-time checksum loop receivers used before
+// tlvc_decode_batch().  Returns the number of valid messages in the buffer.
+static size_t bench_validate_scalar(const uint8_t* buffer_, size_t bufferLen_)
+{
+    size_t valid  = 0;
+    size_t offset = 0;
+    while ((bufferLen_ - offset) >= (sizeof(tlvc_header_t) + sizeof(tlvc_footer_t))) {
+        tlvc_header_t header;
+        tlvc_footer_t footer;
+        memcpy(&header, buffer_ + offset, sizeof(header));
+
+        size_t   payloadEnd = offset + sizeof(header) + header.length;
+        uint16_t checksum   = 0;
+        for (size_t i = offset; i < payloadEnd; i++) { checksum += buffer_[i]; }
+        memcpy(&footer, buffer_ + payloadEnd, sizeof(footer));
+
+        valid += (footer.checksum == checksum) ? 1 : 0;
+        offset = payloadEnd + sizeof(footer);
+    }
+    return valid;
+}
+
+//---------------------------------------------------------------------------
+// Validate with one tlvc_decode_data() call per message
+static size_t bench_validate_each(uint8_t* buffer_, size_t bufferLen_)
+{
+    size_t valid  = 0;
+    size_t offset = 0;
+    while ((bufferLen_ - offset) >= (sizeof(tlvc_header_t) + sizeof(tlvc_footer_t))) {
+        tlvc_header_t header;
+        memcpy(&header, buffer_ + offset, sizeof(header));
+
+        size_t      size = sizeof(tlvc_header_t) + header.length + sizeof(tlvc_footer_t);
+        tlvc_data_t tlvc;
+        valid += tlvc_decode_data(&tlvc, buffer_ + offset, size) ? 1 : 0;
+        offset += size;
+    }
+    return valid;
+}
+
+//---------------------------------------------------------------------------
+static bool bench_batch(const bench_case_t* case_, uint32_t iterations_)
+{
+    static uint8_t      payload[BENCH_MAX_MESSAGE];
+    static tlvc_frame_t bounds[BENCH_BATCH_FRAMES];
+    static tlvc_view_t  views[BENCH_BATCH_FRAMES];
+
+    // Lay out the messages back to back, as a receiver appending decoded
+    // frames would -- most of them end up unaligned.
+    size_t   messageSize = sizeof(tlvc_header_t) + case_->size + sizeof(tlvc_footer_t);
+    size_t   bufferLen   = messageSize * BENCH_BATCH_FRAMES;
+    uint8_t* buffer      = (uint8_t*)malloc(bufferLen);
+    if (!buffer) {
+        return false;
+    }
+
+    for (size_t i = 0; i < BENCH_BATCH_FRAMES; i++) {
+        bench_fill(payload, case_->size, case_->payload);
+
+        tlvc_data_t tlvc = {};
+        tlvc_encode_data(&tlvc, 1, case_->size, payload);
+
+        uint8_t* message = buffer + (i * messageSize);
+        memcpy(message, &tlvc.header, sizeof(tlvc.header));
+        memcpy(message + sizeof(tlvc.header), payload, case_->size);
+        memcpy(message + sizeof(tlvc.header) + case_->size, &tlvc.footer, sizeof(tlvc.footer));
+
+        // The receiver knows where each frame ends from the framing codec
+        bounds[i].offset = i * messageSize;
+        bounds[i].length = messageSize;
+    }
+
+    size_t   valid  = 0;
+    uint32_t errors = 0;
+
+    uint64_t start = time_util_ticks();
+    for (uint32_t i = 0; i < iterations_; i++) { valid += bench_validate_scalar(buffer, bufferLen); }
+    uint64_t scalarTicks = time_util_ticks() - start;
+    bool     ok          = (valid == ((size_t)iterations_ * BENCH_BATCH_FRAMES));
+
+    valid = 0;
+    start = time_util_ticks();
+    for (uint32_t i = 0; i < iterations_; i++) { valid += bench_validate_each(buffer, bufferLen); }
+    uint64_t eachTicks = time_util_ticks() - start;
+    ok                 = ok && (valid == ((size_t)iterations_ * BENCH_BATCH_FRAMES));
+
+    valid = 0;
+    start = time_util_ticks();
+    for (uint32_t i = 0; i < iterations_; i++) {
+        valid += tlvc_decode_batch(buffer, bounds, BENCH_BATCH_FRAMES, views, &errors);
+    }
+    uint64_t batchTicks = time_util_ticks() - start;
+    ok = ok && (valid == ((size_t)iterations_ * BENCH_BATCH_FRAMES)) && (errors == 0)
+         && (views[BENCH_BATCH_FRAMES - 1].length == case_->size);
+
+    // A corrupt payload is skipped, and the rest still validate
+    buffer[messageSize + sizeof(tlvc_header_t)] ^= 0x01;
+    valid = tlvc_decode_batch(buffer, bounds, BENCH_BATCH_FRAMES, views, &errors);
+    ok    = ok && (valid == (BENCH_BATCH_FRAMES - 1)) && (errors == 1);
+
+    // So is a corrupt length field -- whether it claims more or less than its
+    // frame holds, the frames after it still validate
+    tlvc_header_t header;
+    memcpy(&header, buffer + (2 * messageSize), sizeof(header));
+    header.length = (uint16_t)(header.length + 3);
+    memcpy(buffer + (2 * messageSize), &header, sizeof(header));
+    header.length = (uint16_t)(header.length - 5);
+    memcpy(buffer + (3 * messageSize), &header, sizeof(header));
+
+    valid = tlvc_decode_batch(buffer, bounds, BENCH_BATCH_FRAMES, views, &errors);
+    ok    = ok && (valid == (BENCH_BATCH_FRAMES - 3)) && (errors == 3)
+         && (views[BENCH_BATCH_FRAMES - 4].data == (buffer + (bufferLen - messageSize) + sizeof(tlvc_header_t)));
+
+    double frames = (double)iterations_ * BENCH_BATCH_FRAMES;
+    printf("%-15s %7zu %9.1f %9.1f %9.1f %11.0f %s\n",
+           case_->name,
+           messageSize,
+           (double)time_util_ticks_to_us(scalarTicks) * 1000.0 / frames,
+           (double)time_util_ticks_to_us(eachTicks) * 1000.0 / frames,
+           (double)time_util_ticks_to_us(batchTicks) * 1000.0 / frames,
+           (batchTicks > 0) ? (frames * 1000.0 / (double)time_util_ticks_to_us(batchTicks)) : 0.0,
+           ok ? "" : "VALIDATION FAILED");
+
+    free(buffer);
+    return ok;
+}
+
+//---------------------------------------------------------------------------
+int main(int argc_, char** argv_)
+{
+    uint32_t iterations = BENCH_DEFAULT_ITERATIONS;
+
+    int opt;
+    while ((opt = getopt(argc_, argv_, "n:h")) != -1) {
+        switch (opt) {
+            case 'n': iterations = (uint32_t)strtoul(optarg, NULL, 0); break;
+            default: {
+                printf("usage: %s [-n iterations]\n", argv_[0]);
+                return 1;
+            }
+        }
+    }
+
+    srand(1);
+
+    printf("%-15s %-7s %7s %7s %7s %9s %9s\n", "message", "framing", "raw", "wire", "over", "enc(ns)", "dec(ns)");
+
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(benchCases) / sizeof(benchCases[0]); i++) {
+        // The config message is large; scale its iterations down to match
+        uint32_t caseIterations = iterations;
+        if (benchCases[i].size > 256) {
+            caseIterations = (uint32_t)((iterations * 64ULL) / benchCases[i].size) + 1;
+        }
+        for (int type = 0; type < FramingCount; type++) {
+            ok = bench_run(&benchCases[i], (framing_type_t)type, caseIterations) && ok;
+        }
+    }
+
+    printf("\n%-15s %7s %9s %9s %9s %11s\n", "message", "size", "byte(ns)", "each(ns)", "batch(ns)", "batch(f/ms)");
+
+    // Each pass validates a whole batch of frames
+    for (size_t i = 0; i < sizeof(benchCases) / sizeof(benchCases[0]); i++) {
+        uint64_t bytes           = (uint64_t)iterations * 64ULL;
+        uint64_t batchIterations = bytes / ((uint64_t)BENCH_BATCH_FRAMES * (benchCases[i].size + 6)) + 1;
+        ok                       = bench_batch(&benchCases[i], (uint32_t)batchIterations) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,604 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+//---------------------------------------------------------------------------
+// hint-eval: offline evaluation of motion hints (see NetstickTagHintedReport
+// in PROTOCOL.txt).  Replays an input trace (in the ctru_shim script format,
+// or a seeded synthetic one) through a model of the client -- polls at a
+// fixed rate, each recording its snapshot into the client's own velocity
+// estimator (motion_hint.c) and sending a report when an axis changes or its
+// velocity goes stale -- over a link with a fixed one-way delay plus jitter,
+// to a receiver that renders frames at a fixed rate.  At every receiver frame,
+// the value the receiver would use is compared against the true input at that
+// moment, both for plain last-value hold and for extrapolation from the
+// report's sample time using its velocities.
+//
+// The receiver learns the offset between its clock and the client's from the
+// smallest (arrival - sample time) it has seen, less the base one-way delay
+// (which a real receiver would take from half the round-trip time).
+//---------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "motion_hint.h"
+
+//---------------------------------------------------------------------------
+#define HE_MAX_TRACE (1u << 20)
+#define HE_MAX_DELAYS (8)
+#define HE_AXES (10) // Circle pad x/y, c-stick x/y, accelerometer x/y/z, gyroscope x/y/z
+
+#define HE_DEFAULT_DURATION_MS (30000)
+#define HE_DEFAULT_SAMPLE_US (4000)
+#define HE_DEFAULT_POLL_US (5556)
+#define HE_DEFAULT_FRAME_HZ (60)
+#define HE_DEFAULT_JITTER_MS (4)
+#define HE_DEFAULT_HORIZON_MS (100)
+#define HE_DEFAULT_DELAYS "10,30,60"
+
+// Extrapolation horizon over which a change in velocity makes the last one
+// sent stale (as HID_DEVICE_HINT_HORIZON_US in hid_device.c)
+#define HE_STALE_HORIZON_US (50000)
+
+//---------------------------------------------------------------------------
+// Inputs evaluated, each sent as its own device
+typedef enum {
+    HeGroupSticks = 0,
+    HeGroupAccel,
+    HeGroupGyro,
+    //--
+    HeGroupCount
+} he_group_t;
+
+typedef struct {
+    const char* name;
+    size_t      first; //!< Index of the group's first axis in he_input_t
+    size_t      count; //!< Number of axes in the group
+    int32_t     limit; //!< Largest magnitude an axis reports (extrapolation is clamped to it)
+} he_group_info_t;
+
+static const he_group_info_t groups[HeGroupCount] = {
+    [HeGroupSticks] = { "sticks", 0, 4, 156 },
+    [HeGroupAccel]  = { "accel", 4, 3, 32767 },
+    [HeGroupGyro]   = { "gyro", 7, 3, 32767 },
+};
+
+//---------------------------------------------------------------------------
+// One input change from the trace
+typedef struct {
+    uint64_t timeUs;  //!< Time of the change, relative to the start of the run
+    size_t   first;   //!< Index of the first axis changed
+    size_t   count;   //!< Number of axes changed
+    int32_t  v[3];    //!< New value(s)
+} he_trace_entry_t;
+
+//---------------------------------------------------------------------------
+// Report as sent by the client model
+typedef struct {
+    uint64_t arrivalUs;                      //!< Time the report reaches the receiver
+    uint64_t sampleUs;                       //!< Sample time carried by the report
+    int32_t  values[MOTION_HINT_MAX_AXES];   //!< Axis values
+    int32_t  velocity[MOTION_HINT_MAX_AXES]; //!< Velocities (Q24.8 units per second)
+} he_report_t;
+
+//---------------------------------------------------------------------------
+// Error of one prediction method, over every axis of a group at every frame
+typedef struct {
+    double  sumAbs;
+    double  sumSquares;
+    float*  errors; //!< Absolute error of each prediction, for percentiles
+    size_t  count;
+} he_error_t;
+
+//---------------------------------------------------------------------------
+typedef struct {
+    const char* tracePath;             //!< Input trace (NULL == synthetic)
+    uint64_t    durationUs;            //!< Evaluated time (0 == end of the trace)
+    uint64_t    sampleUs;              //!< HID sample period
+    uint64_t    pollUs;                //!< Client poll period
+    uint64_t    intervalUs;            //!< Shortest time between reports sent for axis changes (analog_interval_ms)
+    uint32_t    frameHz;               //!< Receiver frame rate
+    uint64_t    jitterUs;              //!< Largest extra delay added to a report
+    uint64_t    horizonUs;             //!< Longest time a value is extrapolated over
+    uint64_t    delaysUs[HE_MAX_DELAYS]; //!< One-way delays evaluated
+    size_t      delayCount;
+    uint64_t    seed;                  //!< Seed for the synthetic trace and jitter
+} he_options_t;
+
+static he_options_t heOptions = {
+    .sampleUs  = HE_DEFAULT_SAMPLE_US,
+    .pollUs    = HE_DEFAULT_POLL_US,
+    .frameHz   = HE_DEFAULT_FRAME_HZ,
+    .jitterUs  = HE_DEFAULT_JITTER_MS * 1000ULL,
+    .horizonUs = HE_DEFAULT_HORIZON_MS * 1000ULL,
+    .seed      = 1,
+};
+
+static he_trace_entry_t* trace;
+static size_t            traceCount;
+static bool              groupActive[HeGroupCount]; //!< The trace moves at least one of the group's axes
+
+//---------------------------------------------------------------------------
+// xorshift64* -- small, fast and deterministic across platforms
+static uint64_t he_random(uint64_t* state_)
+{
+    uint64_t x = *state_;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state_ = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+//---------------------------------------------------------------------------
+static double he_random_unit(uint64_t* state_)
+{
+    return (double)(he_random(state_) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//---------------------------------------------------------------------------
+static bool he_trace_add(uint64_t timeUs_, size_t first_, size_t count_, int32_t v0_, int32_t v1_, int32_t v2_)
+{
+    if (traceCount >= HE_MAX_TRACE) {
+        return false;
+    }
+    he_trace_entry_t* entry = &trace[traceCount++];
+    entry->timeUs           = timeUs_;
+    entry->first            = first_;
+    entry->count            = count_;
+    entry->v[0]             = v0_;
+    entry->v[1]             = v1_;
+    entry->v[2]             = v2_;
+
+    for (size_t i = 0; i < HeGroupCount; i++) {
+        if ((first_ >= groups[i].first) && (first_ < (groups[i].first + groups[i].count))) {
+            groupActive[i] = groupActive[i] || (v0_ != 0) || (v1_ != 0) || (v2_ != 0);
+        }
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static int he_trace_compare(const void* a_, const void* b_)
+{
+    const he_trace_entry_t* a = (const he_trace_entry_t*)a_;
+    const he_trace_entry_t* b = (const he_trace_entry_t*)b_;
+    return (a->timeUs < b->timeUs) ? -1 : ((a->timeUs > b->timeUs) ? 1 : 0);
+}
+
+//---------------------------------------------------------------------------
+// Load a ctru_shim input script.  Keys and touch are ignored; an "exit"
+// command sets the duration (unless one was given on the command line).
+static bool he_trace_load(const char* path_)
+{
+    FILE* file = fopen(path_, "r");
+    if (!file) {
+        fprintf(stderr, "error opening %s\n", path_);
+        return false;
+    }
+
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long timeMs;
+        char          input[16];
+        long          v[3] = { 0, 0, 0 };
+
+        if ((line[0] == '#')
+            || (sscanf(line, "%lu %15s %li %li %li", &timeMs, input, &v[0], &v[1], &v[2]) < 2)) {
+            continue;
+        }
+
+        uint64_t when = (uint64_t)timeMs * 1000ULL;
+        bool     ok   = true;
+        if (!strcmp(input, "circle")) {
+            ok = he_trace_add(when, 0, 2, (int32_t)v[0], (int32_t)v[1], 0);
+        } else if (!strcmp(input, "cstick")) {
+            ok = he_trace_add(when, 2, 2, (int32_t)v[0], (int32_t)v[1], 0);
+        } else if (!strcmp(input, "accel")) {
+            ok = he_trace_add(when, 4, 3, (int32_t)v[0], (int32_t)v[1], (int32_t)v[2]);
+        } else if (!strcmp(input, "gyro")) {
+            ok = he_trace_add(when, 7, 3, (int32_t)v[0], (int32_t)v[1], (int32_t)v[2]);
+        } else if (!strcmp(input, "exit") && !heOptions.durationUs) {
+            heOptions.durationUs = when;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "trace too long (max %u entries)\n", HE_MAX_TRACE);
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+
+    qsort(trace, traceCount, sizeof(*trace), he_trace_compare);
+    if (!heOptions.durationUs) {
+        heOptions.durationUs = (traceCount != 0) ? trace[traceCount - 1].timeUs : 0;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Synthetic trace, updated every 4ms: the circle pad flicks between random
+// positions along minimum-jerk paths and holds each for a while, with a
+// little hand tremor; the c-stick does the same, less often; the device tilts
+// slowly (accelerometer) and the gyroscope reports the rate of that tilt.
+static void he_trace_generate(void)
+{
+    uint64_t rng = heOptions.seed | 1;
+    double   from[4] = { 0 }, to[4] = { 0 };
+    uint64_t moveStart[2] = { 0, 0 }, moveEnd[2] = { 0, 0 }, holdEnd[2] = { 0, 0 };
+
+    for (uint64_t t = 0; t < heOptions.durationUs; t += 4000ULL) {
+        int32_t sticks[4];
+        for (size_t s = 0; s < 2; s++) {
+            if (t >= holdEnd[s]) {
+                // Start the next flick: to a random position, or back to center
+                bool center = (he_random(&rng) % 3) == 0;
+                for (size_t a = 0; a < 2; a++) {
+                    from[(s * 2) + a] = to[(s * 2) + a];
+                    to[(s * 2) + a]   = center ? 0.0 : (he_random_unit(&rng) * 300.0) - 150.0;
+                }
+                moveStart[s] = t;
+                moveEnd[s]   = t + 80000ULL + (he_random(&rng) % 220000ULL);
+                holdEnd[s]   = moveEnd[s] + ((s == 0) ? 100000ULL : 400000ULL) + (he_random(&rng) % 600000ULL);
+            }
+
+            double p = 1.0;
+            if (t < moveEnd[s]) {
+                double u = (double)(t - moveStart[s]) / (double)(moveEnd[s] - moveStart[s]);
+                p        = u * u * u * (10.0 - (15.0 * u) + (6.0 * u * u));
+            }
+            for (size_t a = 0; a < 2; a++) {
+                size_t i   = (s * 2) + a;
+                double pos = from[i] + ((to[i] - from[i]) * p) + ((he_random_unit(&rng) - 0.5) * 2.0);
+                sticks[i]  = (int32_t)lround(pos);
+            }
+        }
+        he_trace_add(t, 0, 2, sticks[0], sticks[1], 0);
+        he_trace_add(t, 2, 2, sticks[2], sticks[3], 0);
+
+        double seconds = (double)t / 1e6;
+        double tiltX   = sin(seconds * 1.3) + (0.5 * sin(seconds * 3.1));
+        double tiltY   = cos(seconds * 0.9);
+        double rateX   = (1.3 * cos(seconds * 1.3)) + (1.55 * cos(seconds * 3.1));
+        double rateY   = -0.9 * sin(seconds * 0.9);
+        he_trace_add(t,
+                     4,
+                     3,
+                     (int32_t)lround((tiltX * 200.0) + ((he_random_unit(&rng) - 0.5) * 6.0)),
+                     (int32_t)lround((tiltY * 200.0) + ((he_random_unit(&rng) - 0.5) * 6.0)),
+                     512);
+        he_trace_add(t,
+                     7,
+                     3,
+                     (int32_t)lround((rateX * 2000.0) + ((he_random_unit(&rng) - 0.5) * 20.0)),
+                     (int32_t)lround((rateY * 2000.0) + ((he_random_unit(&rng) - 0.5) * 20.0)),
+                     0);
+    }
+
+    qsort(trace, traceCount, sizeof(*trace), he_trace_compare);
+}
+
+//---------------------------------------------------------------------------
+// Apply the trace up to (and including) timeUs_ to an input state
+static void he_trace_advance(size_t* cursor_, int32_t* input_, uint64_t timeUs_)
+{
+    while ((*cursor_ < traceCount) && (trace[*cursor_].timeUs <= timeUs_)) {
+        const he_trace_entry_t* entry = &trace[(*cursor_)++];
+        for (size_t i = 0; i < entry->count; i++) { input_[entry->first + i] = entry->v[i]; }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Client model: poll at a fixed rate, taking the input as of the latest HID
+// sample; send a report when a value changed or the velocity last sent is
+// stale.  Reports arrive after the one-way delay plus jitter, in order.
+static size_t he_run_client(he_group_t group_, uint64_t delayUs_, uint64_t* rng_, he_report_t* reports_)
+{
+    const he_group_info_t* info   = &groups[group_];
+    int32_t                input[HE_AXES] = { 0 };
+    size_t                 cursor = 0;
+    size_t                 count  = 0;
+    motion_hint_t          hint;
+    he_report_t            sent        = {};
+    uint64_t               sentUs      = 0;
+    uint64_t               lastArrival = 0;
+
+    motion_hint_init(&hint, info->count);
+
+    for (uint64_t poll = 0; poll < heOptions.durationUs; poll += heOptions.pollUs) {
+        he_trace_advance(&cursor, input, (poll / heOptions.sampleUs) * heOptions.sampleUs);
+        motion_hint_record(&hint, poll, &input[info->first]);
+
+        bool changed = (count == 0);
+        for (size_t i = 0; i < info->count; i++) {
+            int32_t  velocity = motion_hint_velocity(&hint, i);
+            uint32_t drift    = motion_hint_drift(velocity, sent.velocity[i], HE_STALE_HORIZON_US);
+            changed = changed || (input[info->first + i] != sent.values[i]) || (drift != 0);
+        }
+        if (!changed || ((count != 0) && ((poll - sentUs) < heOptions.intervalUs))) {
+            continue;
+        }
+
+        he_report_t* report = &reports_[count++];
+        report->sampleUs    = poll;
+        for (size_t i = 0; i < info->count; i++) {
+            report->values[i]   = input[info->first + i];
+            report->velocity[i] = motion_hint_velocity(&hint, i);
+        }
+
+        uint64_t jitter   = heOptions.jitterUs ? (he_random(rng_) % (heOptions.jitterUs + 1)) : 0;
+        uint64_t arrival  = poll + delayUs_ + jitter;
+        report->arrivalUs = (arrival > lastArrival) ? arrival : lastArrival;
+        lastArrival       = report->arrivalUs;
+
+        sent   = *report;
+        sentUs = poll;
+    }
+    return count;
+}
+
+//---------------------------------------------------------------------------
+static void he_error_record(he_error_t* error_, double error_value_)
+{
+    double magnitude = fabs(error_value_);
+    error_->sumAbs += magnitude;
+    error_->sumSquares += magnitude * magnitude;
+    error_->errors[error_->count++] = (float)magnitude;
+}
+
+//---------------------------------------------------------------------------
+static int he_float_compare(const void* a_, const void* b_)
+{
+    float a = *(const float*)a_;
+    float b = *(const float*)b_;
+    return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+//---------------------------------------------------------------------------
+// Receiver model: at each frame, use the newest report that has arrived --
+// either as-is (hold), or extrapolated to the frame time (hinted)
+static void he_run_receiver(he_group_t         group_,
+                            uint64_t           delayUs_,
+                            const he_report_t* reports_,
+                            size_t             reportCount_,
+                            he_error_t*        hold_,
+                            he_error_t*        hinted_)
+{
+    const he_group_info_t* info           = &groups[group_];
+    int32_t                input[HE_AXES] = { 0 };
+    size_t                 cursor         = 0;
+    size_t                 next           = 0;
+    const he_report_t*     current        = NULL;
+    uint64_t               minOffset      = UINT64_MAX;
+    uint64_t               framePeriod    = 1000000ULL / heOptions.frameHz;
+
+    for (uint64_t frame = framePeriod; frame < heOptions.durationUs; frame += framePeriod) {
+        he_trace_advance(&cursor, input, frame);
+
+        while ((next < reportCount_) && (reports_[next].arrivalUs <= frame)) {
+            current         = &reports_[next++];
+            uint64_t offset = current->arrivalUs - current->sampleUs;
+            minOffset       = (offset < minOffset) ? offset : minOffset;
+        }
+        if (!current) {
+            continue;
+        }
+
+        // Estimated sample time, on the receiver's clock
+        uint64_t sampled = current->sampleUs + (minOffset - delayUs_);
+        uint64_t age     = (frame > sampled) ? (frame - sampled) : 0;
+        age              = (age > heOptions.horizonUs) ? heOptions.horizonUs : age;
+
+        for (size_t i = 0; i < info->count; i++) {
+            int32_t truth     = input[info->first + i];
+            int32_t predicted = motion_hint_extrapolate(current->values[i], current->velocity[i], (uint32_t)age);
+            predicted         = (predicted > info->limit) ? info->limit : predicted;
+            predicted         = (predicted < -info->limit) ? -info->limit : predicted;
+
+            he_error_record(hold_, (double)current->values[i] - (double)truth);
+            he_error_record(hinted_, (double)predicted - (double)truth);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+static void he_print_error(const he_error_t* error_, char* out_, size_t outLen_)
+{
+    double count = (error_->count != 0) ? (double)error_->count : 1.0;
+    float  p99   = 0.0f;
+    float  max   = 0.0f;
+
+    if (error_->count != 0) {
+        qsort(error_->errors, error_->count, sizeof(float), he_float_compare);
+        p99 = error_->errors[(size_t)((double)(error_->count - 1) * 0.99)];
+        max = error_->errors[error_->count - 1];
+    }
+    snprintf(out_,
+             outLen_,
+             "%7.2f %7.2f %7.1f %7.1f",
+             error_->sumAbs / count,
+             sqrt(error_->sumSquares / count),
+             (double)p99,
+             (double)max);
+}
+
+//---------------------------------------------------------------------------
+static void he_usage(const char* argv0_)
+{
+    printf("usage: %s [-t trace] [-d duration_ms] [-D delay_ms,...] [-j jitter_ms] [-s sample_us] [-p poll_us]\n"
+           "          [-i interval_ms] [-f frame_hz] [-H horizon_ms] [-x seed]\n"
+           "  -t trace      input script in the ctru_shim format (default: synthetic stick flicks and tilting)\n"
+           "  -d ms         evaluated time (default: the trace's exit command or last entry, or %d)\n"
+           "  -D ms,...     one-way delays to evaluate (default %s)\n"
+           "  -j ms         largest jitter added to the delay, uniformly distributed (default %d)\n"
+           "  -s us         HID sample period (default %d)\n"
+           "  -p us         client poll period (default %d)\n"
+           "  -i ms         shortest time between reports, as analog_interval_ms (default 0)\n"
+           "  -f hz         receiver frame rate (default %d)\n"
+           "  -H ms         longest time a value is extrapolated over (default %d)\n"
+           "  -x seed       seed for the synthetic trace and jitter (default 1)\n",
+           argv0_,
+           HE_DEFAULT_DURATION_MS,
+           HE_DEFAULT_DELAYS,
+           HE_DEFAULT_JITTER_MS,
+           HE_DEFAULT_SAMPLE_US,
+           HE_DEFAULT_POLL_US,
+           HE_DEFAULT_FRAME_HZ,
+           HE_DEFAULT_HORIZON_MS);
+}
+
+//---------------------------------------------------------------------------
+static bool he_parse_delays(const char* arg_)
+{
+    heOptions.delayCount = 0;
+    while (*arg_) {
+        char*         end;
+        unsigned long ms = strtoul(arg_, &end, 10);
+        if ((end == arg_) || (heOptions.delayCount >= HE_MAX_DELAYS)) {
+            fprintf(stderr, "delays must be given as up to %d comma-separated values (ms)\n", HE_MAX_DELAYS);
+            return false;
+        }
+        heOptions.delaysUs[heOptions.delayCount++] = (uint64_t)ms * 1000ULL;
+        arg_                                       = (*end == ',') ? (end + 1) : end;
+    }
+    return heOptions.delayCount != 0;
+}
+
+//---------------------------------------------------------------------------
+static bool he_parse_args(int argc_, char** argv_)
+{
+    if (!he_parse_delays(HE_DEFAULT_DELAYS)) {
+        return false;
+    }
+
+    int opt;
+    while ((opt = getopt(argc_, argv_, "t:d:D:j:s:p:i:f:H:x:h")) != -1) {
+        switch (opt) {
+            case 't': heOptions.tracePath = optarg; break;
+            case 'd': heOptions.durationUs = strtoull(optarg, NULL, 10) * 1000ULL; break;
+            case 'D': {
+                if (!he_parse_delays(optarg)) {
+                    return false;
+                }
+            } break;
+            case 'j': heOptions.jitterUs = strtoull(optarg, NULL, 10) * 1000ULL; break;
+            case 's': heOptions.sampleUs = strtoull(optarg, NULL, 10); break;
+            case 'p': heOptions.pollUs = strtoull(optarg, NULL, 10); break;
+            case 'i': heOptions.intervalUs = strtoull(optarg, NULL, 10) * 1000ULL; break;
+            case 'f': heOptions.frameHz = (uint32_t)atoi(optarg); break;
+            case 'H': heOptions.horizonUs = strtoull(optarg, NULL, 10) * 1000ULL; break;
+            case 'x': heOptions.seed = strtoull(optarg, NULL, 10); break;
+            default: he_usage(argv_[0]); return false;
+        }
+    }
+
+    if ((optind != argc_) || (heOptions.sampleUs == 0) || (heOptions.pollUs == 0) || (heOptions.frameHz == 0)) {
+        he_usage(argv_[0]);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (!he_parse_args(argc, argv)) {
+        return 1;
+    }
+
+    trace = (he_trace_entry_t*)calloc(HE_MAX_TRACE, sizeof(*trace));
+    if (!trace) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    if (heOptions.tracePath) {
+        if (!he_trace_load(heOptions.tracePath)) {
+            free(trace);
+            return 1;
+        }
+    } else {
+        if (!heOptions.durationUs) {
+            heOptions.durationUs = HE_DEFAULT_DURATION_MS * 1000ULL;
+        }
+        he_trace_generate();
+    }
+    if (!heOptions.durationUs) {
+        fprintf(stderr, "nothing to evaluate\n");
+        free(trace);
+        return 1;
+    }
+
+    size_t       maxReports = (size_t)(heOptions.durationUs / heOptions.pollUs) + 1;
+    size_t       maxFrames  = (size_t)((heOptions.durationUs * heOptions.frameHz) / 1000000ULL) + 1;
+    size_t       maxErrors  = maxFrames * MOTION_HINT_MAX_AXES;
+    he_report_t* reports    = (he_report_t*)calloc(maxReports, sizeof(*reports));
+    he_error_t   hold       = { .errors = (float*)calloc(maxErrors, sizeof(float)) };
+    he_error_t   hinted     = { .errors = (float*)calloc(maxErrors, sizeof(float)) };
+    if (!reports || !hold.errors || !hinted.errors) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("hint-eval: %.2fs, %zu trace entries, sample %lluus, poll %lluus, interval %llums, receiver %uHz, "
+           "jitter 0-%llums, horizon %llums\n\n",
+           (double)heOptions.durationUs / 1e6,
+           traceCount,
+           (unsigned long long)heOptions.sampleUs,
+           (unsigned long long)heOptions.pollUs,
+           (unsigned long long)(heOptions.intervalUs / 1000ULL),
+           heOptions.frameHz,
+           (unsigned long long)(heOptions.jitterUs / 1000ULL),
+           (unsigned long long)(heOptions.horizonUs / 1000ULL));
+    printf("%-6s %-7s %8s  %-31s  %-31s  %s\n",
+           "delay",
+           "input",
+           "reports",
+           "hold: mae/rms/p99/max",
+           "hinted: mae/rms/p99/max",
+           "rms change");
+
+    for (size_t d = 0; d < heOptions.delayCount; d++) {
+        for (int g = 0; g < HeGroupCount; g++) {
+            if (!groupActive[g]) {
+                continue;
+            }
+
+            uint64_t rng         = heOptions.seed | 1;
+            size_t   reportCount = he_run_client((he_group_t)g, heOptions.delaysUs[d], &rng, reports);
+
+            hold.sumAbs = hold.sumSquares = 0.0;
+            hinted.sumAbs = hinted.sumSquares = 0.0;
+            hold.count = hinted.count = 0;
+            he_run_receiver((he_group_t)g, heOptions.delaysUs[d], reports, reportCount, &hold, &hinted);
+
+            double holdRms   = sqrt(hold.sumSquares / (hold.count ? (double)hold.count : 1.0));
+            double hintedRms = sqrt(hinted.sumSquares / (hinted.count ? (double)hinted.count : 1.0));
+            char   holdText[48];
+            char   hintedText[48];
+            he_print_error(&hold, holdText, sizeof(holdText));
+            he_print_error(&hinted, hintedText, sizeof(hintedText));
+
+            printf("%4llums %-7s %8zu  %-31s  %-31s  %+.1f%%\n",
+                   (unsigned long long)(heOptions.delaysUs[d] / 1000ULL),
+                   groups[g].name,
+                   reportCount,
+                   holdText,
+                   hintedText,
+                   (holdRms > 0.0) ? ((hintedRms - holdRms) * 100.0) / holdRms : 0.0);
+        }
+    }
+
+    free(hinted.errors);
+    free(hold.errors);
+    free(reports);
+    free(trace);
+    return 0;
+}
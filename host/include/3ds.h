@@ -0,0 +1,192 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+//---------------------------------------------------------------------------
+// Host stand-in for the subset of libctru used by netstick.  This allows the
+// client to be built and exercised on a Linux machine, with input injected
+// through the API in ctru_shim.h.  Only the types/functions netstick actually
+// uses are provided.
+//---------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+
+typedef volatile u32 vu32;
+
+typedef s32 Result;
+typedef u32 Handle;
+
+#define BIT(n) (1U << (n))
+
+#define R_SUCCEEDED(res) ((res) >= 0)
+#define R_FAILED(res) ((res) < 0)
+#define R_DESCRIPTION(res) ((res)&0x3FF)
+#define RD_TIMEOUT (1022)
+
+//---------------------------------------------------------------------------
+#define SYSCLOCK_ARM11 (268111856ULL)
+
+//---------------------------------------------------------------------------
+enum {
+    KEY_A            = BIT(0),
+    KEY_B            = BIT(1),
+    KEY_SELECT       = BIT(2),
+    KEY_START        = BIT(3),
+    KEY_DRIGHT       = BIT(4),
+    KEY_DLEFT        = BIT(5),
+    KEY_DUP          = BIT(6),
+    KEY_DDOWN        = BIT(7),
+    KEY_R            = BIT(8),
+    KEY_L            = BIT(9),
+    KEY_X            = BIT(10),
+    KEY_Y            = BIT(11),
+    KEY_ZL           = BIT(14),
+    KEY_ZR           = BIT(15),
+    KEY_TOUCH        = BIT(20),
+    KEY_CSTICK_RIGHT = BIT(24),
+    KEY_CSTICK_LEFT  = BIT(25),
+    KEY_CSTICK_UP    = BIT(26),
+    KEY_CSTICK_DOWN  = BIT(27),
+    KEY_CPAD_RIGHT   = BIT(28),
+    KEY_CPAD_LEFT    = BIT(29),
+    KEY_CPAD_UP      = BIT(30),
+    KEY_CPAD_DOWN    = BIT(31),
+};
+
+//---------------------------------------------------------------------------
+typedef struct {
+    s16 dx;
+    s16 dy;
+} circlePosition;
+
+typedef struct {
+    u16 px;
+    u16 py;
+} touchPosition;
+
+typedef struct {
+    s16 x;
+    s16 y;
+    s16 z;
+} accelVector;
+
+typedef struct {
+    s16 x;
+    s16 z;
+    s16 y;
+} angularRate;
+
+//---------------------------------------------------------------------------
+typedef enum { GFX_TOP = 0, GFX_BOTTOM = 1 } gfxScreen_t;
+
+#define GSPLCD_SCREEN_TOP BIT(0)
+#define GSPLCD_SCREEN_BOTTOM BIT(1)
+#define GSPLCD_SCREEN_BOTH (GSPLCD_SCREEN_TOP | GSPLCD_SCREEN_BOTTOM)
+
+typedef struct {
+    int consoleWidth;
+    int consoleHeight;
+} PrintConsole;
+
+//---------------------------------------------------------------------------
+// gfx / console
+void          gfxInitDefault(void);
+void          gfxExit(void);
+void          gfxFlushBuffers(void);
+void          gfxSwapBuffers(void);
+PrintConsole* consoleInit(gfxScreen_t screen, PrintConsole* console);
+PrintConsole* consoleSelect(PrintConsole* console);
+void          consoleClear(void);
+
+//---------------------------------------------------------------------------
+// gsp / apt
+void   gspWaitForVBlank(void);
+bool   aptMainLoop(void);
+Result gspLcdInit(void);
+void   gspLcdExit(void);
+Result GSPLCD_PowerOnBacklight(u32 screen);
+Result GSPLCD_PowerOffBacklight(u32 screen);
+
+//---------------------------------------------------------------------------
+// hid
+extern vu32* hidSharedMem;
+
+void   hidScanInput(void);
+u32    hidKeysHeld(void);
+u32    hidKeysDown(void);
+u32    hidKeysUp(void);
+void   hidCircleRead(circlePosition* pos);
+void   hidCstickRead(circlePosition* pos);
+void   hidTouchRead(touchPosition* pos);
+void   hidAccelRead(accelVector* vector);
+void   hidGyroRead(angularRate* rate);
+Result HIDUSER_EnableAccelerometer(void);
+Result HIDUSER_DisableAccelerometer(void);
+Result HIDUSER_EnableGyroscope(void);
+Result HIDUSER_DisableGyroscope(void);
+Result HIDUSER_GetHandles(Handle* outMemHandle,
+                          Handle* eventpad0,
+                          Handle* eventpad1,
+                          Handle* eventaccel,
+                          Handle* eventgyro,
+                          Handle* eventdebugpad);
+
+//---------------------------------------------------------------------------
+// svc
+#define CUR_THREAD_HANDLE (0xFFFF8000)
+
+void   svcSleepThread(s64 ns);
+u64    svcGetSystemTick(void);
+Result svcGetThreadPriority(s32* out, Handle handle);
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds);
+Result svcClearEvent(Handle handle);
+Result svcCloseHandle(Handle handle);
+Result APT_CheckNew3DS(bool* out);
+
+//---------------------------------------------------------------------------
+// threads + synchronization (implemented with pthreads)
+typedef void (*ThreadFunc)(void* arg);
+typedef struct Thread_tag* Thread;
+
+typedef enum { RESET_ONESHOT = 0, RESET_STICKY = 1, RESET_PULSE = 2 } ResetType;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    bool            signalled;
+    ResetType       resetType;
+} LightEvent;
+
+Thread threadCreate(ThreadFunc entrypoint, void* arg, size_t stack_size, int prio, int core_id, bool detached);
+Result threadJoin(Thread thread, u64 timeout_ns);
+void   threadFree(Thread thread);
+void   LightEvent_Init(LightEvent* event, ResetType reset_type);
+void   LightEvent_Signal(LightEvent* event);
+int    LightEvent_WaitTimeout(LightEvent* event, s64 timeout_ns);
+
+//---------------------------------------------------------------------------
+// soc
+Result socInit(u32* context_addr, u32 context_size);
+Result socExit(void);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,502 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+//---------------------------------------------------------------------------
+// latency-bench: end-to-end latency benchmark for the client's send path, on
+// one machine.  Button presses are injected through the libctru stand-in,
+// sampled and scanned as on the hardware, turned into reports by the real
+// gamepad device (hid_gamepad's event handler + handle_hid_events()), encoded
+// and sent by net_util_encode_and_transmit() over a TCP loopback connection,
+// and decoded (framing + TLVC) by a receiver thread.  Every injection is
+// timestamped at each stage:
+//
+//   inject -> scan    ctru_shim_set_keys() to input_state_sample() returning
+//   scan   -> send    handle_hid_events() (report build, encode, send())
+//   send   -> recv    loopback transfer and receiver wakeup
+//   recv   -> decode  framing + TLVC decode of the message
+//
+// A paced phase (-r, -n) measures latency at a steady input rate; an unpaced
+// phase (-m, -w) then injects as fast as the receiver keeps up with, with a
+// bounded number of messages in flight, to find the maximum sustainable rate.
+// With -L and/or -R, the exit status reports whether the p99 latency and rate
+// meet the given limits, so the benchmark can be used as a regression gate.
+//---------------------------------------------------------------------------
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <3ds.h>
+
+#include "ctru_shim.h"
+#include "framing.h"
+#include "hid_device.h"
+#include "hid_gamepad.h"
+#include "histogram.h"
+#include "input_state.h"
+#include "logger.h"
+#include "options.h"
+#include "protocol.h"
+#include "tlvc.h"
+
+//---------------------------------------------------------------------------
+#define LB_FRAME_MAX (sizeof(js_config_t) + 64)
+#define LB_DEFAULT_COUNT (10000)
+#define LB_DEFAULT_RATE_HZ (1000)
+#define LB_DEFAULT_MAX_COUNT (100000)
+#define LB_DEFAULT_WINDOW (32)
+#define LB_WAIT_TIMEOUT_NS (2000000000ULL) // Longest wait for the receiver to catch up
+
+//---------------------------------------------------------------------------
+typedef enum {
+    LbStageScan = 0, //!< inject -> scan
+    LbStageSend,     //!< scan -> send
+    LbStageRecv,     //!< send -> recv
+    LbStageDecode,   //!< recv -> decode
+    LbStageTotal,    //!< inject -> decode
+    //--
+    LbStageCount
+} lb_stage_t;
+
+static const char* const stageNames[LbStageCount] = {
+    [LbStageScan]   = "inject->scan",
+    [LbStageSend]   = "scan->send",
+    [LbStageRecv]   = "send->recv",
+    [LbStageDecode] = "recv->decode",
+    [LbStageTotal]  = "inject->decode",
+};
+
+//---------------------------------------------------------------------------
+// Timestamps (CLOCK_MONOTONIC, ns) of one injection at each stage
+typedef struct {
+    uint64_t injectNs; //!< Written by the injecting thread
+    uint64_t scanNs;
+    uint64_t sendNs;
+    uint64_t recvNs; //!< Written by the receiver thread
+    uint64_t decodeNs;
+} lb_stamp_t;
+
+//---------------------------------------------------------------------------
+typedef struct {
+    uint32_t count;        //!< Injections in the paced phase
+    uint32_t rateHz;       //!< Injection rate of the paced phase (0 == one at a time, closed loop)
+    uint32_t maxCount;     //!< Injections in the unpaced phase (0 == skip)
+    uint32_t window;       //!< Messages in flight during the unpaced phase
+    int      framing;      //!< framing_type_t
+    bool     buttonFrames; //!< Send button changes as NetstickTagButtons messages
+    uint32_t limitP99Us;   //!< Fail if the paced phase's inject->decode p99 exceeds this (0 == no limit)
+    uint32_t limitRate;    //!< Fail if the sustained rate is below this (0 == no limit)
+} lb_options_t;
+
+//---------------------------------------------------------------------------
+// State shared with the receiver thread
+typedef struct {
+    int                listenFd;
+    framing_decoder_t* decoder;
+    lb_stamp_t*        stamps;
+    size_t             stampCount;
+    size_t             messages; //!< Report/button messages decoded (atomic)
+    uint32_t           errors;   //!< Framing/TLVC failures
+} lb_receiver_t;
+
+//---------------------------------------------------------------------------
+static lb_options_t lbOptions = {
+    .count    = LB_DEFAULT_COUNT,
+    .rateHz   = LB_DEFAULT_RATE_HZ,
+    .maxCount = LB_DEFAULT_MAX_COUNT,
+    .window   = LB_DEFAULT_WINDOW,
+    .framing  = FramingSlip,
+};
+
+//---------------------------------------------------------------------------
+static uint64_t lb_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+//---------------------------------------------------------------------------
+static void lb_sleep_until(uint64_t ns_)
+{
+    struct timespec ts = { (time_t)(ns_ / 1000000000ULL), (long)(ns_ % 1000000000ULL) };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+//---------------------------------------------------------------------------
+static size_t lb_messages(const lb_receiver_t* receiver_)
+{
+    return __atomic_load_n(&receiver_->messages, __ATOMIC_ACQUIRE);
+}
+
+//---------------------------------------------------------------------------
+// Wait until the receiver has decoded at least count_ messages.  Returns false
+// if it stalls (a message was lost to a send error).
+static bool lb_wait_messages(const lb_receiver_t* receiver_, size_t count_)
+{
+    uint64_t deadline = lb_now_ns() + LB_WAIT_TIMEOUT_NS;
+    while (lb_messages(receiver_) < count_) {
+        if (lb_now_ns() >= deadline) {
+            fprintf(stderr, "receiver stalled at %zu of %zu messages\n", lb_messages(receiver_), count_);
+            return false;
+        }
+        sched_yield();
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Decoded frame: report and button messages complete the next injection, in
+// order.  The first of them is the report forced by the connection, which
+// precedes any injection.
+static void lb_on_frame(lb_receiver_t* receiver_, uint64_t recvNs_)
+{
+    tlvc_data_t tlvc = {};
+    if (receiver_->decoder->index == 0) {
+        return; // Empty SLIP frame (leading delimiter)
+    }
+    if (!tlvc_decode_data(&tlvc, receiver_->decoder->raw, receiver_->decoder->index)) {
+        receiver_->errors++;
+        return;
+    }
+
+    switch (tlvc.header.tag) {
+        case NetstickTagFraming: {
+            netstick_framing_t framing;
+            if ((tlvc.dataLen == sizeof(framing)) && (((const uint8_t*)tlvc.data)[0] < FramingCount)) {
+                memcpy(&framing, tlvc.data, sizeof(framing));
+                framing_decoder_reset(receiver_->decoder, (framing_type_t)framing.framing);
+            }
+        } break;
+        case NetstickTagReport:
+        case NetstickTagButtons: {
+            uint64_t decodeNs = lb_now_ns();
+            size_t   message  = receiver_->messages;
+            if ((message != 0) && (message <= receiver_->stampCount)) {
+                receiver_->stamps[message - 1].recvNs   = recvNs_;
+                receiver_->stamps[message - 1].decodeNs = decodeNs;
+            }
+            __atomic_store_n(&receiver_->messages, message + 1, __ATOMIC_RELEASE);
+        } break;
+        default: break;
+    }
+}
+
+//---------------------------------------------------------------------------
+static void* lb_receiver_thread(void* arg_)
+{
+    lb_receiver_t* receiver = (lb_receiver_t*)arg_;
+
+    int fd = accept(receiver->listenFd, NULL, NULL);
+    if (fd < 0) {
+        fprintf(stderr, "accept failed: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    uint8_t buffer[4096];
+    while (true) {
+        ssize_t nRead = recv(fd, buffer, sizeof(buffer), 0);
+        if (nRead <= 0) {
+            break;
+        }
+        uint64_t recvNs = lb_now_ns();
+
+        size_t offset = 0;
+        while (offset < (size_t)nRead) {
+            size_t                  consumed = 0;
+            framing_decode_return_t rc
+                = framing_decode_data(receiver->decoder, &buffer[offset], (size_t)nRead - offset, &consumed);
+            offset += consumed;
+
+            if (rc == FramingDecodeEndOfFrame) {
+                lb_on_frame(receiver, recvNs);
+            } else if (rc != FramingDecodeOk) {
+                receiver->errors++;
+            }
+        }
+    }
+
+    close(fd);
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+// Inject one button change, and run it through the client's poll path
+static void lb_inject(hid_device_t* device_, const program_options_t* options_, lb_stamp_t* stamp_, size_t index_)
+{
+    input_state_t input;
+
+    stamp_->injectNs = lb_now_ns();
+    ctru_shim_set_keys((index_ & 1) ? 0 : KEY_A);
+    ctru_shim_sample_now();
+    hidScanInput();
+    input_state_sample(&input);
+    input.allDevices = true;
+    stamp_->scanNs   = lb_now_ns();
+
+    handle_hid_events(device_, options_, &input);
+    stamp_->sendNs = lb_now_ns();
+}
+
+//---------------------------------------------------------------------------
+static void lb_record(histogram_t* hist_, uint64_t fromNs_, uint64_t toNs_)
+{
+    uint64_t us = (toNs_ > fromNs_) ? ((toNs_ - fromNs_) / 1000ULL) : 0;
+    histogram_record(hist_, (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us);
+}
+
+//---------------------------------------------------------------------------
+// Summarize the stage latencies of a range of injections.  Returns the
+// inject->decode p99, in microseconds.
+static uint32_t lb_report(const char* title_, const lb_stamp_t* stamps_, size_t count_)
+{
+    static histogram_t hist[LbStageCount];
+    size_t             lost = 0;
+
+    for (int i = 0; i < LbStageCount; i++) { histogram_init(&hist[i]); }
+    for (size_t i = 0; i < count_; i++) {
+        const lb_stamp_t* stamp = &stamps_[i];
+        if (!stamp->decodeNs) {
+            lost++;
+            continue;
+        }
+        lb_record(&hist[LbStageScan], stamp->injectNs, stamp->scanNs);
+        lb_record(&hist[LbStageSend], stamp->scanNs, stamp->sendNs);
+        lb_record(&hist[LbStageRecv], stamp->sendNs, stamp->recvNs);
+        lb_record(&hist[LbStageDecode], stamp->recvNs, stamp->decodeNs);
+        lb_record(&hist[LbStageTotal], stamp->injectNs, stamp->decodeNs);
+    }
+
+    printf("%s (%zu injections, %zu not received)\n", title_, count_, lost);
+    printf("  %-16s %8s %8s %8s %8s %8s\n", "stage (us)", "mean", "p50", "p99", "p99.9", "max");
+    for (int i = 0; i < LbStageCount; i++) {
+        printf("  %-16s %8lu %8lu %8lu %8lu %8lu\n",
+               stageNames[i],
+               (unsigned long)histogram_mean(&hist[i]),
+               (unsigned long)histogram_percentile(&hist[i], 0.50),
+               (unsigned long)histogram_percentile(&hist[i], 0.99),
+               (unsigned long)histogram_percentile(&hist[i], 0.999),
+               (unsigned long)hist[i].max);
+    }
+    return histogram_percentile(&hist[LbStageTotal], 0.99);
+}
+
+//---------------------------------------------------------------------------
+static void lb_usage(const char* argv0_)
+{
+    printf("usage: %s [-n count] [-r rate_hz] [-m count] [-w window] [-f framing] [-b] [-L p99_us] [-R rate]\n"
+           "  -n count    injections in the paced phase (default %d)\n"
+           "  -r hz       injection rate of the paced phase; 0 waits for each message to be decoded (default %d)\n"
+           "  -m count    injections in the unpaced (maximum rate) phase; 0 skips it (default %d)\n"
+           "  -w window   messages in flight during the unpaced phase (default %d)\n"
+           "  -f framing  slip, length or cobs (default slip)\n"
+           "  -b          send button changes as button messages instead of full reports\n"
+           "  -L us       fail if the paced phase's inject->decode p99 exceeds this\n"
+           "  -R rate     fail if the sustained rate (messages/s) is below this\n",
+           argv0_,
+           LB_DEFAULT_COUNT,
+           LB_DEFAULT_RATE_HZ,
+           LB_DEFAULT_MAX_COUNT,
+           LB_DEFAULT_WINDOW);
+}
+
+//---------------------------------------------------------------------------
+static bool lb_parse_args(int argc_, char** argv_)
+{
+    int opt;
+    while ((opt = getopt(argc_, argv_, "n:r:m:w:f:bL:R:h")) != -1) {
+        switch (opt) {
+            case 'n': lbOptions.count = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'r': lbOptions.rateHz = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'm': lbOptions.maxCount = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'w': lbOptions.window = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'f': {
+                framing_type_t framing;
+                if (!framing_type_from_name(optarg, &framing)) {
+                    fprintf(stderr, "unknown framing '%s'\n", optarg);
+                    return false;
+                }
+                lbOptions.framing = (int)framing;
+            } break;
+            case 'b': lbOptions.buttonFrames = true; break;
+            case 'L': lbOptions.limitP99Us = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'R': lbOptions.limitRate = (uint32_t)strtoul(optarg, NULL, 10); break;
+            default: lb_usage(argv_[0]); return false;
+        }
+    }
+
+    if ((optind != argc_) || (lbOptions.window == 0) || (lbOptions.count + lbOptions.maxCount == 0)) {
+        lb_usage(argv_[0]);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Listen on an ephemeral loopback port, returning the socket and port
+static int lb_listen(uint16_t* port_)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in addr = {};
+    socklen_t          len  = sizeof(addr);
+    addr.sin_family         = AF_INET;
+    addr.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+
+    if ((bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (listen(fd, 1) != 0)
+        || (getsockname(fd, (struct sockaddr*)&addr, &len) != 0)) {
+        close(fd);
+        return -1;
+    }
+    *port_ = ntohs(addr.sin_port);
+    return fd;
+}
+
+//---------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (!lb_parse_args(argc, argv)) {
+        return 1;
+    }
+
+    logger_init(LoggerLevelWarning, NULL);
+
+    static lb_receiver_t receiver;
+    uint16_t             port;
+    receiver.listenFd = lb_listen(&port);
+    if (receiver.listenFd < 0) {
+        fprintf(stderr, "couldn't listen on loopback: %s\n", strerror(errno));
+        return 1;
+    }
+
+    receiver.stampCount = (size_t)lbOptions.count + lbOptions.maxCount;
+    receiver.stamps     = (lb_stamp_t*)calloc(receiver.stampCount, sizeof(lb_stamp_t));
+    receiver.decoder    = framing_decoder_create(FramingSlip, LB_FRAME_MAX);
+    if (!receiver.stamps || !receiver.decoder) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, lb_receiver_thread, &receiver) != 0) {
+        fprintf(stderr, "couldn't start receiver thread\n");
+        return 1;
+    }
+
+    // A gamepad device as the client would configure it, minus report refreshes
+    // (which would add messages that don't correspond to an injection)
+    program_options_t options;
+    program_options_init(&options);
+    snprintf(options.host, sizeof(options.host), "127.0.0.1");
+    options.port            = port;
+    options.framing         = lbOptions.framing;
+    options.buttonFrames    = lbOptions.buttonFrames;
+    options.reportRefreshMs = 0;
+
+    static hid_device_t device;
+    input_state_t       input;
+    if (!hid_gamepad_init(&device, &options)) {
+        fprintf(stderr, "couldn't initialize gamepad device\n");
+        return 1;
+    }
+
+    // Connect, and wait for the report forced by the connection
+    ctru_shim_sample_now();
+    hidScanInput();
+    input_state_sample(&input);
+    input.allDevices = true;
+    if (!handle_hid_events(&device, &options, &input)) {
+        fprintf(stderr, "couldn't connect to the receiver\n");
+        return 1;
+    }
+    if (!lb_wait_messages(&receiver, 1)) {
+        return 1;
+    }
+
+    printf("latency-bench: TCP loopback, %s framing, %s\n\n",
+           framing_type_name((framing_type_t)lbOptions.framing),
+           lbOptions.buttonFrames ? "button messages" : "full reports");
+
+    // Paced phase: steady injection rate (or closed loop)
+    bool     pass    = true;
+    uint64_t period  = lbOptions.rateHz ? (1000000000ULL / lbOptions.rateHz) : 0;
+    uint64_t next    = lb_now_ns();
+    size_t   injects = 0;
+    for (; injects < lbOptions.count; injects++) {
+        if (period) {
+            next += period;
+            lb_sleep_until(next);
+        } else if (!lb_wait_messages(&receiver, injects + 1)) {
+            break;
+        }
+        lb_inject(&device, &options, &receiver.stamps[injects], injects);
+    }
+
+    if (lbOptions.count) {
+        char title[64];
+        if (period) {
+            snprintf(title, sizeof(title), "paced phase, %u/s", lbOptions.rateHz);
+        } else {
+            snprintf(title, sizeof(title), "paced phase, closed loop");
+        }
+        pass = lb_wait_messages(&receiver, injects + 1);
+
+        uint32_t p99 = lb_report(title, receiver.stamps, lbOptions.count);
+        if (lbOptions.limitP99Us && (p99 > lbOptions.limitP99Us)) {
+            printf("FAIL: inject->decode p99 %luus exceeds %luus\n",
+                   (unsigned long)p99,
+                   (unsigned long)lbOptions.limitP99Us);
+            pass = false;
+        }
+    }
+
+    // Unpaced phase: inject whenever fewer than `window` messages are in flight
+    if (lbOptions.maxCount) {
+        uint64_t startNs = lb_now_ns();
+        for (; injects < receiver.stampCount; injects++) {
+            size_t decoded = injects + 1; // Including the connection's report
+            if ((decoded > lbOptions.window) && !lb_wait_messages(&receiver, (decoded + 1) - lbOptions.window)) {
+                break;
+            }
+            lb_inject(&device, &options, &receiver.stamps[injects], injects);
+        }
+        pass = lb_wait_messages(&receiver, injects + 1) && pass;
+        double seconds = (double)(lb_now_ns() - startNs) / 1e9;
+        double rate    = (double)lbOptions.maxCount / seconds;
+
+        printf("\n");
+        lb_report("unpaced phase", &receiver.stamps[lbOptions.count], lbOptions.maxCount);
+        printf("sustained rate: %.0f messages/s (%u in flight)\n", rate, lbOptions.window);
+        if (lbOptions.limitRate && (rate < (double)lbOptions.limitRate)) {
+            printf("FAIL: sustained rate below %lu messages/s\n", (unsigned long)lbOptions.limitRate);
+            pass = false;
+        }
+    }
+
+    printf("\nsend errors: %lu, EAGAIN: %lu, decode errors: %lu\n",
+           (unsigned long)device.stats.sendErrors,
+           (unsigned long)device.stats.sendBackpressure,
+           (unsigned long)receiver.errors);
+
+    hid_device_disconnect(&device);
+    pthread_join(thread, NULL);
+    close(receiver.listenFd);
+    framing_decoder_destroy(receiver.decoder);
+    free(receiver.stamps);
+    logger_exit();
+    return pass ? 0 : 2;
+}
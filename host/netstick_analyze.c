@@ -0,0 +1,915 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+//---------------------------------------------------------------------------
+// netstick-analyze: offline analyzer for captured netstick traffic.  Decodes
+// client-to-server streams from a pcap capture (or a raw dump of a single
+// stream's bytes) using the client's own framing/tlvc code, and reports per-tag
+// frame counts, payload and framing overhead, decode failures, duplicate
+// reports, and -- for pcap captures, which carry timestamps -- report
+// inter-arrival jitter and burst statistics.  Output is either a human-readable
+// summary or JSON.
+//---------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+
+#include "framing.h"
+#include "histogram.h"
+#include "joystick.h"
+#include "protocol.h"
+#include "tlvc.h"
+
+//---------------------------------------------------------------------------
+#define NA_MAX_STREAMS (64)
+#define NA_FRAME_MAX (sizeof(js_config_t) + 64)
+#define NA_REPORT_MAX (256)
+#define NA_DEFAULT_PORT (9001)
+#define NA_DEFAULT_BURST_US (1000)
+#define NA_DEFAULT_BURST_MIN (3)
+
+// Tags 0..(NA_TAG_OTHER - 1) are tracked individually, others are aggregated
+#define NA_TAG_OTHER (10)
+#define NA_TAG_SLOTS (NA_TAG_OTHER + 1)
+
+// Inter-arrival display buckets: < 1ms, then power-of-two milliseconds up to
+// the last bucket, which collects everything >= 512ms
+#define NA_IA_BUCKETS (11)
+
+//---------------------------------------------------------------------------
+// Classic pcap file format
+#define PCAP_MAGIC_US (0xA1B2C3D4)
+#define PCAP_MAGIC_NS (0xA1B23C4D)
+#define PCAPNG_MAGIC (0x0A0D0D0A)
+
+#define PCAP_LINKTYPE_NULL (0)
+#define PCAP_LINKTYPE_ETHERNET (1)
+#define PCAP_LINKTYPE_RAW (101)
+#define PCAP_LINKTYPE_LOOP (108)
+#define PCAP_LINKTYPE_LINUX_SLL (113)
+#define PCAP_LINKTYPE_LINUX_SLL2 (276)
+
+#define ETHERTYPE_IPV4 (0x0800)
+#define ETHERTYPE_IPV6 (0x86DD)
+#define ETHERTYPE_VLAN (0x8100)
+#define IP_PROTOCOL_TCP (6)
+
+#define TCP_FLAG_FIN (0x01)
+#define TCP_FLAG_SYN (0x02)
+#define TCP_FLAG_RST (0x04)
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t versionMajor;
+    uint16_t versionMinor;
+    int32_t  thisZone;
+    uint32_t sigFigs;
+    uint32_t snapLen;
+    uint32_t linkType;
+} pcap_file_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t tsSec;
+    uint32_t tsFrac;
+    uint32_t capturedLen;
+    uint32_t originalLen;
+} pcap_record_header_t;
+
+//---------------------------------------------------------------------------
+// Per-tag frame/byte counters
+typedef struct {
+    uint32_t frames;       //!< Frames received with this tag
+    uint64_t payloadBytes; //!< Message payload (TLVC value) bytes
+    uint64_t wireBytes;    //!< Bytes on the wire, including TLVC header/checksum and framing
+} na_tag_stats_t;
+
+//---------------------------------------------------------------------------
+// State and statistics for a single client-to-server stream
+typedef struct {
+    uint8_t            key[36];        //!< Address/port tuple identifying the stream
+    char               name[112];      //!< Printable "src -> dst" description
+    char               device[64];     //!< Device name, from the stream's configuration message
+    framing_type_t     framing;        //!< Framing codec currently in use
+    framing_decoder_t* decoder;        //!< Frame decoder
+    size_t             frameWire;      //!< Wire bytes consumed by the frame in progress
+    bool               desync;         //!< The stream could not be decoded past an error
+    bool               haveSeq;        //!< nextSeq is valid
+    uint32_t           nextSeq;        //!< Next expected TCP sequence number
+    uint64_t           streamBytes;    //!< Stream (TCP payload) bytes processed
+    uint32_t           segments;       //!< TCP segments carrying new data
+    uint32_t           multiFrameSegs; //!< Segments that completed more than one frame
+    uint32_t           gaps;           //!< Holes in the captured sequence space
+    uint32_t           retransmits;    //!< Segments carrying already-seen data
+    uint32_t           framingErrors;  //!< Frames rejected by the framing codec
+    uint32_t           lengthErrors;   //!< Frames whose TLVC length didn't match the frame size
+    uint32_t           checksumErrors; //!< Frames whose TLVC checksum didn't match
+    na_tag_stats_t     tags[NA_TAG_SLOTS];
+
+    uint32_t reports;                   //!< Reports received
+    uint32_t duplicates;                //!< Reports identical to the previous report
+    uint8_t  lastReport[NA_REPORT_MAX]; //!< Previous report payload
+    size_t   lastReportLen;             //!< Size of the previous report (0 = none)
+
+    bool        timed;                    //!< Timestamps are available for this stream
+    uint64_t    firstUs;                  //!< Timestamp of the first segment
+    uint64_t    lastUs;                   //!< Timestamp of the last segment
+    uint64_t    lastReportUs;             //!< Arrival time of the previous report
+    histogram_t interArrivalUs;           //!< Time between consecutive reports
+    uint32_t    iaBuckets[NA_IA_BUCKETS]; //!< Inter-arrival display histogram
+    bool        haveInterArrival;         //!< lastInterArrivalUs is valid
+    uint32_t    lastInterArrivalUs;       //!< Previous inter-arrival time
+    double      jitterUs;                 //!< RFC 3550-style smoothed inter-arrival variation
+    uint32_t    runLength;                //!< Reports in the current run of closely-spaced reports
+    uint32_t    bursts;                   //!< Runs of >= burstMin reports < burstUs apart
+    uint32_t    burstReports;             //!< Reports that were part of a burst
+    uint32_t    maxBurst;                 //!< Longest burst
+} na_stream_t;
+
+//---------------------------------------------------------------------------
+typedef struct {
+    uint16_t       port;     //!< Server port; streams to this port are analyzed (0 = all TCP streams)
+    bool           raw;      //!< Input is a raw stream dump, not a pcap capture
+    bool           json;     //!< Emit JSON instead of a text summary
+    framing_type_t framing;  //!< Framing in use at the start of each stream
+    uint32_t       burstUs;  //!< Reports closer together than this are part of a burst
+    uint32_t       burstMin; //!< Minimum number of reports in a burst
+    const char*    path;     //!< Capture file
+} na_options_t;
+
+//---------------------------------------------------------------------------
+static na_options_t naOptions = {
+    .port     = NA_DEFAULT_PORT,
+    .framing  = FramingSlip,
+    .burstUs  = NA_DEFAULT_BURST_US,
+    .burstMin = NA_DEFAULT_BURST_MIN,
+};
+static na_stream_t streams[NA_MAX_STREAMS];
+static size_t      streamCount;
+static uint32_t    skippedPackets;
+
+//---------------------------------------------------------------------------
+static uint16_t na_be16(const uint8_t* p_)
+{
+    return (uint16_t)((p_[0] << 8) | p_[1]);
+}
+
+//---------------------------------------------------------------------------
+static uint32_t na_be32(const uint8_t* p_)
+{
+    return ((uint32_t)p_[0] << 24) | ((uint32_t)p_[1] << 16) | ((uint32_t)p_[2] << 8) | p_[3];
+}
+
+//---------------------------------------------------------------------------
+static uint32_t na_swap32(uint32_t v_, bool swap_)
+{
+    return swap_ ? __builtin_bswap32(v_) : v_;
+}
+
+//---------------------------------------------------------------------------
+static na_stream_t* na_stream_get(const uint8_t* key_, size_t keyLen_, const char* name_)
+{
+    for (size_t i = 0; i < streamCount; i++) {
+        if (0 == memcmp(streams[i].key, key_, keyLen_)) {
+            return &streams[i];
+        }
+    }
+    if (streamCount == NA_MAX_STREAMS) {
+        return NULL;
+    }
+
+    na_stream_t* stream = &streams[streamCount++];
+    memset(stream, 0, sizeof(*stream));
+    memcpy(stream->key, key_, keyLen_);
+    snprintf(stream->name, sizeof(stream->name), "%s", name_);
+    stream->framing = naOptions.framing;
+    stream->decoder = framing_decoder_create(stream->framing, NA_FRAME_MAX);
+    histogram_init(&stream->interArrivalUs);
+    return stream;
+}
+
+//---------------------------------------------------------------------------
+static void na_stream_end_run(na_stream_t* stream_)
+{
+    if (stream_->runLength >= naOptions.burstMin) {
+        stream_->bursts++;
+        stream_->burstReports += stream_->runLength;
+        if (stream_->runLength > stream_->maxBurst) {
+            stream_->maxBurst = stream_->runLength;
+        }
+    }
+    stream_->runLength = 0;
+}
+
+//---------------------------------------------------------------------------
+static void na_stream_report(na_stream_t* stream_, const void* data_, size_t dataLen_, bool timed_, uint64_t tsUs_)
+{
+    stream_->reports++;
+
+    if ((dataLen_ == stream_->lastReportLen) && (0 == memcmp(stream_->lastReport, data_, dataLen_))) {
+        stream_->duplicates++;
+    }
+    stream_->lastReportLen = (dataLen_ <= NA_REPORT_MAX) ? dataLen_ : 0;
+    memcpy(stream_->lastReport, data_, stream_->lastReportLen);
+
+    if (!timed_) {
+        return;
+    }
+
+    if (stream_->reports > 1) {
+        uint32_t interArrival = (uint32_t)(tsUs_ - stream_->lastReportUs);
+        histogram_record(&stream_->interArrivalUs, interArrival);
+
+        size_t bucket = 0;
+        for (uint32_t ms = interArrival / 1000; (ms != 0) && (bucket < (NA_IA_BUCKETS - 1)); ms >>= 1) { bucket++; }
+        stream_->iaBuckets[bucket]++;
+
+        if (stream_->haveInterArrival) {
+            int64_t delta = (int64_t)interArrival - (int64_t)stream_->lastInterArrivalUs;
+            double  d     = (double)((delta < 0) ? -delta : delta);
+            stream_->jitterUs += (d - stream_->jitterUs) / 16.0;
+        }
+        stream_->lastInterArrivalUs = interArrival;
+        stream_->haveInterArrival   = true;
+
+        if (interArrival >= naOptions.burstUs) {
+            na_stream_end_run(stream_);
+        }
+    }
+    stream_->runLength++;
+    stream_->lastReportUs = tsUs_;
+}
+
+//---------------------------------------------------------------------------
+static void na_stream_frame(na_stream_t* stream_, bool timed_, uint64_t tsUs_)
+{
+    uint8_t*    raw    = stream_->decoder->raw;
+    size_t      rawLen = stream_->decoder->index;
+    tlvc_data_t tlvc   = {};
+
+    if (!tlvc_decode_data(&tlvc, raw, rawLen)) {
+        tlvc_header_t header;
+        memcpy(&header, raw, (rawLen < sizeof(header)) ? rawLen : sizeof(header));
+        if ((rawLen >= (sizeof(tlvc_header_t) + sizeof(tlvc_footer_t)))
+            && (header.length == (rawLen - sizeof(tlvc_header_t) - sizeof(tlvc_footer_t)))) {
+            stream_->checksumErrors++;
+        } else {
+            stream_->lengthErrors++;
+        }
+        return;
+    }
+
+    uint16_t        tag  = tlvc.header.tag;
+    na_tag_stats_t* slot = &stream_->tags[(tag < NA_TAG_OTHER) ? tag : NA_TAG_OTHER];
+    slot->frames++;
+    slot->payloadBytes += tlvc.dataLen;
+    slot->wireBytes += stream_->frameWire;
+
+    switch (tag) {
+        case NetstickTagConfig: {
+            if (tlvc.dataLen == sizeof(js_config_t)) {
+                const js_config_t* config  = (const js_config_t*)tlvc.data;
+                size_t             nameLen = strnlen(config->name, sizeof(stream_->device) - 1);
+                memcpy(stream_->device, config->name, nameLen);
+                stream_->device[nameLen] = '\0';
+            }
+        } break;
+        case NetstickTagReport: na_stream_report(stream_, tlvc.data, tlvc.dataLen, timed_, tsUs_); break;
+        case NetstickTagHintedReport: {
+            netstick_report_hint_t hint;
+            int32_t                velocities[ABS_CNT];
+            size_t                 reportLen = 0;
+            const uint8_t*         report
+                = protocol_parse_hinted_report(tlvc.data, tlvc.dataLen, &hint, velocities, ABS_CNT, &reportLen);
+            if (report) {
+                na_stream_report(stream_, report, reportLen, timed_, tsUs_);
+            }
+        } break;
+        case NetstickTagFraming: {
+            // All subsequent data on the stream uses the selected codec
+            const uint8_t* framing = (const uint8_t*)tlvc.data;
+            if ((tlvc.dataLen == sizeof(netstick_framing_t)) && (*framing < FramingCount)) {
+                stream_->framing = (framing_type_t)*framing;
+                framing_decoder_reset(stream_->decoder, stream_->framing);
+            }
+        } break;
+        default: break;
+    }
+}
+
+//---------------------------------------------------------------------------
+static void na_stream_process(na_stream_t* stream_, const uint8_t* data_, size_t dataLen_, bool timed_, uint64_t tsUs_)
+{
+    uint32_t framesBefore = 0;
+    uint32_t framesAfter  = 0;
+    for (size_t i = 0; i < NA_TAG_SLOTS; i++) { framesBefore += stream_->tags[i].frames; }
+
+    size_t offset = 0;
+    while ((offset < dataLen_) && !stream_->desync) {
+        size_t                  consumed = 0;
+        framing_decode_return_t rc
+            = framing_decode_data(stream_->decoder, &data_[offset], dataLen_ - offset, &consumed);
+        offset += consumed;
+        stream_->frameWire += consumed;
+
+        if (rc == FramingDecodeEndOfFrame) {
+            // Empty frames (i.e. a leading SLIP END) count towards the next frame's overhead
+            if (stream_->decoder->index != 0) {
+                na_stream_frame(stream_, timed_, tsUs_);
+                stream_->frameWire = 0;
+            }
+        } else if (rc != FramingDecodeOk) {
+            stream_->framingErrors++;
+            stream_->frameWire = 0;
+            if (!framing_can_resync(stream_->framing)) {
+                stream_->desync = true;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < NA_TAG_SLOTS; i++) { framesAfter += stream_->tags[i].frames; }
+
+    stream_->streamBytes += dataLen_;
+    stream_->segments++;
+    if ((framesAfter - framesBefore) > 1) {
+        stream_->multiFrameSegs++;
+    }
+
+    if (timed_) {
+        if (!stream_->timed) {
+            stream_->firstUs = tsUs_;
+            stream_->timed   = true;
+        }
+        stream_->lastUs = tsUs_;
+    }
+}
+
+//---------------------------------------------------------------------------
+// Reassemble a TCP segment into its stream: skip data that has already been
+// seen, and resynchronize the decoder across holes in the capture.
+static void na_tcp_segment(na_stream_t*   stream_,
+                           uint32_t       seq_,
+                           uint8_t        flags_,
+                           const uint8_t* data_,
+                           size_t         len_,
+                           uint64_t       tsUs_)
+{
+    if (flags_ & TCP_FLAG_SYN) {
+        stream_->nextSeq = seq_ + 1;
+        stream_->haveSeq = true;
+        return;
+    }
+    if ((len_ == 0) || (flags_ & TCP_FLAG_RST)) {
+        return;
+    }
+    if (!stream_->haveSeq) {
+        // Capture started mid-stream
+        stream_->nextSeq = seq_;
+        stream_->haveSeq = true;
+    }
+
+    int32_t delta = (int32_t)(seq_ - stream_->nextSeq);
+    if (delta > 0) {
+        // Missing data: the frame in progress is lost
+        stream_->gaps++;
+        stream_->frameWire = 0;
+        if (framing_can_resync(stream_->framing)) {
+            framing_decoder_reset(stream_->decoder, stream_->framing);
+        } else {
+            stream_->desync = true;
+        }
+    } else if (delta < 0) {
+        if ((size_t)(-delta) >= len_) {
+            stream_->retransmits++;
+            return;
+        }
+        data_ += -delta;
+        len_ -= -delta;
+        seq_ = stream_->nextSeq;
+    }
+
+    stream_->nextSeq = seq_ + (uint32_t)len_;
+    na_stream_process(stream_, data_, len_, true, tsUs_);
+}
+
+//---------------------------------------------------------------------------
+static void na_ip_packet(const uint8_t* packet_, size_t len_, uint64_t tsUs_)
+{
+    uint8_t        key[36] = {};
+    char           src[INET6_ADDRSTRLEN];
+    char           dst[INET6_ADDRSTRLEN];
+    const uint8_t* tcp;
+    size_t         tcpLen;
+
+    if ((len_ >= 20) && ((packet_[0] >> 4) == 4)) {
+        size_t headerLen = (packet_[0] & 0x0F) * 4;
+        size_t totalLen  = na_be16(&packet_[2]);
+        // Fragments aren't reassembled
+        if ((packet_[9] != IP_PROTOCOL_TCP) || (na_be16(&packet_[6]) & 0x3FFF) || (headerLen < 20)
+            || (totalLen > len_) || (totalLen < headerLen)) {
+            skippedPackets++;
+            return;
+        }
+        memcpy(&key[0], &packet_[12], 4);
+        memcpy(&key[16], &packet_[16], 4);
+        inet_ntop(AF_INET, &packet_[12], src, sizeof(src));
+        inet_ntop(AF_INET, &packet_[16], dst, sizeof(dst));
+        tcp    = packet_ + headerLen;
+        tcpLen = totalLen - headerLen;
+    } else if ((len_ >= 40) && ((packet_[0] >> 4) == 6)) {
+        size_t payloadLen = na_be16(&packet_[4]);
+        // Extension headers aren't followed
+        if ((packet_[6] != IP_PROTOCOL_TCP) || ((payloadLen + 40) > len_)) {
+            skippedPackets++;
+            return;
+        }
+        memcpy(&key[0], &packet_[8], 16);
+        memcpy(&key[16], &packet_[24], 16);
+        inet_ntop(AF_INET6, &packet_[8], src, sizeof(src));
+        inet_ntop(AF_INET6, &packet_[24], dst, sizeof(dst));
+        tcp    = packet_ + 40;
+        tcpLen = payloadLen;
+    } else {
+        skippedPackets++;
+        return;
+    }
+
+    if (tcpLen < 20) {
+        skippedPackets++;
+        return;
+    }
+    uint16_t srcPort   = na_be16(&tcp[0]);
+    uint16_t dstPort   = na_be16(&tcp[2]);
+    uint32_t seq       = na_be32(&tcp[4]);
+    size_t   headerLen = (tcp[12] >> 4) * 4;
+    uint8_t  flags     = tcp[13];
+
+    if ((headerLen < 20) || (headerLen > tcpLen)) {
+        skippedPackets++;
+        return;
+    }
+    if ((naOptions.port != 0) && (dstPort != naOptions.port)) {
+        return;
+    }
+
+    memcpy(&key[32], &tcp[0], 4);
+
+    char name[112];
+    snprintf(name, sizeof(name), "%s:%u -> %s:%u", src, srcPort, dst, dstPort);
+
+    na_stream_t* stream = na_stream_get(key, sizeof(key), name);
+    if (!stream) {
+        skippedPackets++;
+        return;
+    }
+    na_tcp_segment(stream, seq, flags, tcp + headerLen, tcpLen - headerLen, tsUs_);
+}
+
+//---------------------------------------------------------------------------
+static void na_link_packet(uint32_t linkType_, const uint8_t* packet_, size_t len_, uint64_t tsUs_)
+{
+    size_t   offset    = 0;
+    uint16_t etherType = 0;
+
+    switch (linkType_) {
+        case PCAP_LINKTYPE_NULL:
+        case PCAP_LINKTYPE_LOOP: offset = 4; break;
+        case PCAP_LINKTYPE_RAW: offset = 0; break;
+        case PCAP_LINKTYPE_ETHERNET: {
+            offset = 14;
+            if (len_ >= offset) {
+                etherType = na_be16(&packet_[12]);
+                while ((etherType == ETHERTYPE_VLAN) && (len_ >= (offset + 4))) {
+                    etherType = na_be16(&packet_[offset + 2]);
+                    offset += 4;
+                }
+            }
+        } break;
+        case PCAP_LINKTYPE_LINUX_SLL: {
+            offset = 16;
+            if (len_ >= offset) {
+                etherType = na_be16(&packet_[14]);
+            }
+        } break;
+        case PCAP_LINKTYPE_LINUX_SLL2: {
+            offset = 20;
+            if (len_ >= offset) {
+                etherType = na_be16(&packet_[0]);
+            }
+        } break;
+        default: skippedPackets++; return;
+    }
+
+    if ((len_ < offset) || ((etherType != 0) && (etherType != ETHERTYPE_IPV4) && (etherType != ETHERTYPE_IPV6))) {
+        skippedPackets++;
+        return;
+    }
+    na_ip_packet(packet_ + offset, len_ - offset, tsUs_);
+}
+
+//---------------------------------------------------------------------------
+static bool na_read_pcap(FILE* file_)
+{
+    pcap_file_header_t header;
+    if (fread(&header, sizeof(header), 1, file_) != 1) {
+        fprintf(stderr, "%s: too short for a pcap capture\n", naOptions.path);
+        return false;
+    }
+
+    bool swap  = false;
+    bool nanos = false;
+    switch (header.magic) {
+        case PCAP_MAGIC_US: break;
+        case PCAP_MAGIC_NS: nanos = true; break;
+        default: {
+            swap = true;
+            if (__builtin_bswap32(header.magic) == PCAP_MAGIC_NS) {
+                nanos = true;
+            } else if (__builtin_bswap32(header.magic) != PCAP_MAGIC_US) {
+                if (header.magic == PCAPNG_MAGIC) {
+                    fprintf(stderr, "%s: pcapng is not supported; convert with 'editcap -F pcap'\n", naOptions.path);
+                } else {
+                    fprintf(stderr, "%s: not a pcap capture (use -r for raw stream dumps)\n", naOptions.path);
+                }
+                return false;
+            }
+        } break;
+    }
+
+    uint32_t linkType = na_swap32(header.linkType, swap) & 0x0FFFFFFF;
+    uint8_t* packet   = malloc(UINT16_MAX + 1);
+    if (!packet) {
+        return false;
+    }
+
+    pcap_record_header_t record;
+    while (fread(&record, sizeof(record), 1, file_) == 1) {
+        uint32_t capturedLen = na_swap32(record.capturedLen, swap);
+        uint64_t tsUs        = ((uint64_t)na_swap32(record.tsSec, swap) * 1000000)
+                        + (na_swap32(record.tsFrac, swap) / (nanos ? 1000 : 1));
+
+        if (capturedLen > (UINT16_MAX + 1)) {
+            fprintf(stderr, "%s: corrupt record (%u bytes)\n", naOptions.path, capturedLen);
+            break;
+        }
+        if (fread(packet, 1, capturedLen, file_) != capturedLen) {
+            fprintf(stderr, "%s: truncated record\n", naOptions.path);
+            break;
+        }
+        na_link_packet(linkType, packet, capturedLen, tsUs);
+    }
+
+    free(packet);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static bool na_read_raw(FILE* file_)
+{
+    uint8_t      key[36] = {};
+    na_stream_t* stream  = na_stream_get(key, sizeof(key), naOptions.path);
+    uint8_t      buffer[4096];
+    size_t       nRead;
+
+    while ((nRead = fread(buffer, 1, sizeof(buffer), file_)) > 0) {
+        na_stream_process(stream, buffer, nRead, false, 0);
+    }
+
+    // Chunks of the file aren't segments
+    stream->segments       = 0;
+    stream->multiFrameSegs = 0;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static double na_percent(uint64_t part_, uint64_t whole_)
+{
+    return whole_ ? ((100.0 * (double)part_) / (double)whole_) : 0.0;
+}
+
+//---------------------------------------------------------------------------
+static const char* na_tag_slot_name(size_t slot_)
+{
+    return (slot_ < NA_TAG_OTHER) ? protocol_tag_name((uint16_t)slot_) : "other";
+}
+
+//---------------------------------------------------------------------------
+static void na_ia_bucket_bounds(size_t bucket_, uint32_t* lowerMs_, uint32_t* upperMs_)
+{
+    *lowerMs_ = (bucket_ == 0) ? 0 : (1u << (bucket_ - 1));
+    *upperMs_ = (bucket_ == (NA_IA_BUCKETS - 1)) ? 0 : (1u << bucket_);
+}
+
+//---------------------------------------------------------------------------
+static void na_print_text_stream(const na_stream_t* stream_, size_t index_)
+{
+    uint64_t totalPayload = 0;
+    uint64_t totalWire    = 0;
+
+    printf("stream %zu: %s", index_, stream_->name);
+    if (stream_->device[0]) {
+        printf(" (%s)", stream_->device);
+    }
+    printf("\n");
+
+    printf("  framing      : %s%s\n", framing_type_name(stream_->framing), stream_->desync ? " (desynchronized)" : "");
+    printf("  bytes        : %llu", (unsigned long long)stream_->streamBytes);
+    if (stream_->timed) {
+        printf(" in %u segments over %.3f s (%u segments carried >1 frame)",
+               stream_->segments,
+               (double)(stream_->lastUs - stream_->firstUs) / 1000000.0,
+               stream_->multiFrameSegs);
+    }
+    printf("\n");
+
+    printf("  %-14s %8s %10s %10s %9s\n", "tag", "frames", "payload", "wire", "overhead");
+    for (size_t i = 0; i < NA_TAG_SLOTS; i++) {
+        const na_tag_stats_t* tag = &stream_->tags[i];
+        if (tag->frames == 0) {
+            continue;
+        }
+        printf("  %-14s %8u %10llu %10llu %8.1f%%\n",
+               na_tag_slot_name(i),
+               tag->frames,
+               (unsigned long long)tag->payloadBytes,
+               (unsigned long long)tag->wireBytes,
+               na_percent(tag->wireBytes - tag->payloadBytes, tag->wireBytes));
+        totalPayload += tag->payloadBytes;
+        totalWire += tag->wireBytes;
+    }
+    printf("  %-14s %8s %10llu %10llu %8.1f%%\n",
+           "total",
+           "",
+           (unsigned long long)totalPayload,
+           (unsigned long long)totalWire,
+           na_percent(totalWire - totalPayload, totalWire));
+
+    printf("  errors       : %u checksum, %u length, %u framing, %u gaps, %u retransmits\n",
+           stream_->checksumErrors,
+           stream_->lengthErrors,
+           stream_->framingErrors,
+           stream_->gaps,
+           stream_->retransmits);
+    printf("  reports      : %u (%u duplicates, %.1f%%)\n",
+           stream_->reports,
+           stream_->duplicates,
+           na_percent(stream_->duplicates, stream_->reports));
+
+    const histogram_t* ia = &stream_->interArrivalUs;
+    if (!stream_->timed || (ia->total == 0)) {
+        return;
+    }
+
+    printf("  inter-arrival: mean %.2f ms, p50 %.2f, p90 %.2f, p99 %.2f, max %.2f, jitter %.2f ms\n",
+           histogram_mean(ia) / 1000.0,
+           histogram_percentile(ia, 0.50) / 1000.0,
+           histogram_percentile(ia, 0.90) / 1000.0,
+           histogram_percentile(ia, 0.99) / 1000.0,
+           ia->max / 1000.0,
+           stream_->jitterUs / 1000.0);
+
+    uint32_t maxCount = 0;
+    for (size_t i = 0; i < NA_IA_BUCKETS; i++) {
+        if (stream_->iaBuckets[i] > maxCount) {
+            maxCount = stream_->iaBuckets[i];
+        }
+    }
+    for (size_t i = 0; i < NA_IA_BUCKETS; i++) {
+        uint32_t lower;
+        uint32_t upper;
+        char     label[24];
+
+        if (stream_->iaBuckets[i] == 0) {
+            continue;
+        }
+        na_ia_bucket_bounds(i, &lower, &upper);
+        if (upper) {
+            snprintf(label, sizeof(label), "%u-%u ms", lower, upper);
+        } else {
+            snprintf(label, sizeof(label), ">= %u ms", lower);
+        }
+
+        int bar = (int)((40ull * stream_->iaBuckets[i] + maxCount - 1) / maxCount);
+        printf("    %-12s %8u %.*s\n", label, stream_->iaBuckets[i], bar, "########################################");
+    }
+
+    printf("  bursts       : %u (>= %u reports < %u us apart), %u reports in bursts, longest %u\n",
+           stream_->bursts,
+           naOptions.burstMin,
+           naOptions.burstUs,
+           stream_->burstReports,
+           stream_->maxBurst);
+}
+
+//---------------------------------------------------------------------------
+static void na_print_json_string(const char* str_)
+{
+    putchar('"');
+    for (const char* c = str_; *c; c++) {
+        if ((*c == '"') || (*c == '\\')) {
+            printf("\\%c", *c);
+        } else if ((unsigned char)*c < 0x20) {
+            printf("\\u%04x", (unsigned char)*c);
+        } else {
+            putchar(*c);
+        }
+    }
+    putchar('"');
+}
+
+//---------------------------------------------------------------------------
+static void na_print_json_stream(const na_stream_t* stream_)
+{
+    printf("{\"name\": ");
+    na_print_json_string(stream_->name);
+    printf(", \"device\": ");
+    na_print_json_string(stream_->device);
+    printf(", \"framing\": \"%s\", \"desynchronized\": %s",
+           framing_type_name(stream_->framing),
+           stream_->desync ? "true" : "false");
+    printf(", \"bytes\": %llu, \"segments\": %u, \"multi_frame_segments\": %u",
+           (unsigned long long)stream_->streamBytes,
+           stream_->segments,
+           stream_->multiFrameSegs);
+
+    printf(", \"tags\": {");
+    bool first = true;
+    for (size_t i = 0; i < NA_TAG_SLOTS; i++) {
+        const na_tag_stats_t* tag = &stream_->tags[i];
+        if (tag->frames == 0) {
+            continue;
+        }
+        printf("%s\"%s\": {\"frames\": %u, \"payload_bytes\": %llu, \"wire_bytes\": %llu}",
+               first ? "" : ", ",
+               na_tag_slot_name(i),
+               tag->frames,
+               (unsigned long long)tag->payloadBytes,
+               (unsigned long long)tag->wireBytes);
+        first = false;
+    }
+    printf("}");
+
+    printf(", \"errors\": {\"checksum\": %u, \"length\": %u, \"framing\": %u, \"gaps\": %u, \"retransmits\": %u}",
+           stream_->checksumErrors,
+           stream_->lengthErrors,
+           stream_->framingErrors,
+           stream_->gaps,
+           stream_->retransmits);
+    printf(", \"reports\": %u, \"duplicate_reports\": %u, \"duplicate_ratio\": %.4f",
+           stream_->reports,
+           stream_->duplicates,
+           stream_->reports ? ((double)stream_->duplicates / stream_->reports) : 0.0);
+
+    const histogram_t* ia = &stream_->interArrivalUs;
+    if (!stream_->timed || (ia->total == 0)) {
+        printf(", \"inter_arrival_us\": null, \"bursts\": null}");
+        return;
+    }
+
+    printf(", \"duration_us\": %llu", (unsigned long long)(stream_->lastUs - stream_->firstUs));
+    printf(", \"inter_arrival_us\": {\"count\": %u, \"min\": %u, \"mean\": %u, \"p50\": %u, \"p90\": %u, \"p99\": %u, "
+           "\"max\": %u, \"jitter\": %.1f, \"histogram_ms\": [",
+           ia->total,
+           ia->min,
+           histogram_mean(ia),
+           histogram_percentile(ia, 0.50),
+           histogram_percentile(ia, 0.90),
+           histogram_percentile(ia, 0.99),
+           ia->max,
+           stream_->jitterUs);
+    for (size_t i = 0; i < NA_IA_BUCKETS; i++) {
+        uint32_t lower;
+        uint32_t upper;
+        na_ia_bucket_bounds(i, &lower, &upper);
+        printf("%s{\"lower\": %u, \"upper\": ", (i == 0) ? "" : ", ", lower);
+        if (upper) {
+            printf("%u", upper);
+        } else {
+            printf("null");
+        }
+        printf(", \"count\": %u}", stream_->iaBuckets[i]);
+    }
+    printf("]}");
+
+    printf(", \"bursts\": {\"threshold_us\": %u, \"min_reports\": %u, \"count\": %u, \"reports\": %u, "
+           "\"longest\": %u}}",
+           naOptions.burstUs,
+           naOptions.burstMin,
+           stream_->bursts,
+           stream_->burstReports,
+           stream_->maxBurst);
+}
+
+//---------------------------------------------------------------------------
+static void na_print_json(void)
+{
+    printf("{\"source\": ");
+    na_print_json_string(naOptions.path);
+    printf(", \"format\": \"%s\", \"skipped_packets\": %u, \"streams\": [",
+           naOptions.raw ? "raw" : "pcap",
+           skippedPackets);
+    for (size_t i = 0; i < streamCount; i++) {
+        printf("%s", (i == 0) ? "\n  " : ",\n  ");
+        na_print_json_stream(&streams[i]);
+    }
+    printf("\n]}\n");
+}
+
+//---------------------------------------------------------------------------
+static void na_print_text(void)
+{
+    printf("%s: %zu stream(s)", naOptions.path, streamCount);
+    if (skippedPackets) {
+        printf(", %u packets skipped", skippedPackets);
+    }
+    printf("\n");
+
+    for (size_t i = 0; i < streamCount; i++) {
+        printf("\n");
+        na_print_text_stream(&streams[i], i + 1);
+    }
+}
+
+//---------------------------------------------------------------------------
+static void na_usage(const char* argv0_)
+{
+    printf("usage: %s [-p port] [-r] [-f framing] [-b burst_us] [-m burst_min] [-j] capture\n"
+           "  -p port       server port; client streams to this port are analyzed (default %d, 0 = all)\n"
+           "  -r            capture is a raw dump of one client stream's bytes, not a pcap file\n"
+           "  -f framing    framing at the start of each stream: slip, length or cobs (default slip)\n"
+           "  -b burst_us   reports closer together than this are part of a burst (default %d)\n"
+           "  -m burst_min  minimum number of reports in a burst (default %d)\n"
+           "  -j            print JSON instead of a text summary\n",
+           argv0_,
+           NA_DEFAULT_PORT,
+           NA_DEFAULT_BURST_US,
+           NA_DEFAULT_BURST_MIN);
+}
+
+//---------------------------------------------------------------------------
+static bool na_parse_args(int argc_, char** argv_)
+{
+    int opt;
+    while ((opt = getopt(argc_, argv_, "p:rf:b:m:jh")) != -1) {
+        switch (opt) {
+            case 'p': naOptions.port = (uint16_t)atoi(optarg); break;
+            case 'r': naOptions.raw = true; break;
+            case 'f': {
+                if (!framing_type_from_name(optarg, &naOptions.framing)) {
+                    fprintf(stderr, "unknown framing '%s'\n", optarg);
+                    return false;
+                }
+            } break;
+            case 'b': naOptions.burstUs = (uint32_t)atoi(optarg); break;
+            case 'm': naOptions.burstMin = (uint32_t)atoi(optarg); break;
+            case 'j': naOptions.json = true; break;
+            default: na_usage(argv_[0]); return false;
+        }
+    }
+
+    if (optind != (argc_ - 1)) {
+        na_usage(argv_[0]);
+        return false;
+    }
+    naOptions.path = argv_[optind];
+    return true;
+}
+
+//---------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (!na_parse_args(argc, argv)) {
+        return 1;
+    }
+
+    FILE* file = fopen(naOptions.path, "rb");
+    if (!file) {
+        fprintf(stderr, "error opening %s\n", naOptions.path);
+        return 1;
+    }
+
+    bool ok = naOptions.raw ? na_read_raw(file) : na_read_pcap(file);
+    fclose(file);
+    if (!ok) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < streamCount; i++) {
+        na_stream_end_run(&streams[i]);
+    }
+
+    if (naOptions.json) {
+        na_print_json();
+    } else {
+        na_print_text();
+    }
+
+    for (size_t i = 0; i < streamCount; i++) { framing_decoder_destroy(streams[i].decoder); }
+    return 0;
+}
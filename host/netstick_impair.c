@@ -0,0 +1,910 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+//---------------------------------------------------------------------------
+// netstick-impair: userspace relay that sits between netstick clients and a
+// server (or netstick-rx), and applies Wi-Fi-like impairments to the traffic
+// in both directions -- propagation delay and jitter, a bandwidth cap, loss,
+// reordering, duplication and scripted outage windows -- so that reconnects,
+// send backpressure and transports can be exercised reproducibly on one
+// machine.  All randomness comes from a seeded generator.
+//
+// In TCP mode (the default), data is relayed in the chunks it is read in.  The
+// stream must stay ordered and complete, so a "lost" chunk is instead held
+// back for a retransmission timeout, stalling everything behind it (as a
+// retransmission does), and reordering and duplication don't apply.  During an
+// outage, data is held until the outage ends -- or, with -K, every connection
+// is reset and new ones are refused until it ends.  In UDP mode (-u), each
+// datagram is impaired on its own, and datagrams sent during an outage are
+// dropped.
+//
+// Every impairment applied is logged with a timestamp (each delivery too,
+// with -v), and a summary per direction is printed on exit (Ctrl+C).
+//---------------------------------------------------------------------------
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "histogram.h"
+
+//---------------------------------------------------------------------------
+#define IMP_MAX_FLOWS (8)
+#define IMP_MAX_OUTAGES (16)
+#define IMP_MAX_DATAGRAMS (1024)       // Datagrams in flight (UDP mode)
+#define IMP_CHUNK_MAX (4096)           // Largest chunk read at once
+#define IMP_QUEUE_LIMIT (256u * 1024u) // Bytes queued per direction before reading stops
+#define IMP_DEFAULT_LISTEN_PORT (9002)
+#define IMP_DEFAULT_TARGET_PORT (9001)
+#define IMP_DEFAULT_RTO_MS (200)
+#define IMP_DEFAULT_REORDER_MS (10)
+#define IMP_MAX_MS (3600000.0)    // Longest delay, jitter, timeout, gap or outage accepted (1 hour)
+#define IMP_MAX_KBPS (4000000.0)  // Highest bandwidth cap accepted (bits/s must fit in 32 bits)
+
+//---------------------------------------------------------------------------
+typedef enum {
+    ImpDirUp = 0, //!< Client -> server
+    ImpDirDown,   //!< Server -> client
+    //--
+    ImpDirCount
+} imp_dir_t;
+
+static const char* const dirNames[ImpDirCount] = { "c->s", "s->c" };
+
+//---------------------------------------------------------------------------
+typedef struct {
+    uint64_t startNs; //!< Start of the outage, relative to relay start
+    uint64_t endNs;   //!< End of the outage, relative to relay start
+} imp_outage_t;
+
+//---------------------------------------------------------------------------
+typedef struct {
+    const char*  target;        //!< Server address
+    uint16_t     targetPort;    //!< Server port
+    uint16_t     listenPort;    //!< Port clients connect to
+    bool         udp;           //!< Relay datagrams instead of TCP streams
+    uint64_t     delayNs;       //!< Fixed one-way delay
+    uint64_t     jitterNs;      //!< Additional random delay, uniform in [0, jitter]
+    uint32_t     bandwidthBps;  //!< Bandwidth cap per direction, bits/s (0 == unlimited)
+    double       loss;          //!< Probability a chunk/datagram is lost
+    double       reorder;       //!< Probability a datagram is held back, letting later ones overtake it
+    double       duplicate;     //!< Probability a datagram is sent twice
+    uint64_t     rtoNs;         //!< TCP: delay added to a "lost" chunk
+    uint64_t     reorderNs;     //!< UDP: extra delay of a reordered datagram
+    bool         resetOnOutage; //!< TCP: reset connections at the start of an outage, refuse new ones during it
+    imp_outage_t outages[IMP_MAX_OUTAGES];
+    size_t       outageCount;
+    uint64_t     seed;
+    bool         verbose;
+} imp_options_t;
+
+//---------------------------------------------------------------------------
+// A chunk of data (TCP) or datagram (UDP) waiting to be delivered
+typedef struct imp_packet {
+    struct imp_packet* next;
+    uint64_t           readNs;    //!< Time the packet was read
+    uint64_t           deliverNs; //!< Time the packet is due
+    size_t             len;
+    size_t             offset;    //!< TCP: bytes already written
+    int                flow;      //!< UDP: index of the flow
+    imp_dir_t          dir;       //!< UDP: direction
+    uint8_t            data[];
+} imp_packet_t;
+
+//---------------------------------------------------------------------------
+// Per-direction impairment state and counters
+typedef struct {
+    uint64_t    linkFreeNs;   //!< Time the (bandwidth-limited) link finishes sending queued data
+    uint64_t    lastDueNs;    //!< TCP: due time of the newest chunk (delivery stays in order)
+    uint32_t    packets;      //!< Chunks/datagrams read
+    uint64_t    bytes;        //!< Bytes read
+    uint32_t    delivered;    //!< Chunks/datagrams delivered
+    uint32_t    lost;         //!< Datagrams dropped / chunks held for a retransmission timeout
+    uint32_t    reordered;    //!< Datagrams held back
+    uint32_t    duplicated;   //!< Datagrams sent twice
+    uint32_t    outageHeld;   //!< Chunks held (or datagrams dropped) by an outage
+    histogram_t addedDelayUs; //!< Time from read to delivery
+} imp_link_t;
+
+//---------------------------------------------------------------------------
+// A relayed TCP connection (or UDP client)
+typedef struct {
+    bool               inUse;
+    int                fd[ImpDirCount];      //!< TCP: socket read for each direction; UDP: fd[ImpDirDown] only
+    imp_packet_t*      head[ImpDirCount];    //!< TCP: queued chunks, oldest first
+    imp_packet_t*      tail[ImpDirCount];    //!< TCP: newest queued chunk
+    size_t             queued[ImpDirCount];  //!< TCP: bytes queued
+    bool               blocked[ImpDirCount]; //!< TCP: the last write of a due chunk would have blocked
+    struct sockaddr_in client;               //!< UDP: client address
+} imp_flow_t;
+
+//---------------------------------------------------------------------------
+static imp_options_t impOptions = {
+    .target     = "127.0.0.1",
+    .targetPort = IMP_DEFAULT_TARGET_PORT,
+    .listenPort = IMP_DEFAULT_LISTEN_PORT,
+    .rtoNs      = IMP_DEFAULT_RTO_MS * 1000000ULL,
+    .reorderNs  = IMP_DEFAULT_REORDER_MS * 1000000ULL,
+    .seed       = 1,
+};
+
+static imp_flow_t            flows[IMP_MAX_FLOWS];
+static imp_link_t            links[ImpDirCount];
+static imp_packet_t*         datagrams[IMP_MAX_DATAGRAMS];
+static size_t                datagramCount;
+static uint64_t              startNs;
+static uint64_t              rngState;
+static volatile sig_atomic_t exitRequested;
+
+//---------------------------------------------------------------------------
+static void imp_sigint_handler(int signal_)
+{
+    (void)signal_;
+    exitRequested = 1;
+}
+
+//---------------------------------------------------------------------------
+static uint64_t imp_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+//---------------------------------------------------------------------------
+// xorshift64*
+static uint64_t imp_random(void)
+{
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 0x2545F4914F6CDD1DULL;
+}
+
+//---------------------------------------------------------------------------
+static bool imp_chance(double probability_)
+{
+    return (probability_ > 0.0) && (((double)(imp_random() >> 11) * (1.0 / 9007199254740992.0)) < probability_);
+}
+
+//---------------------------------------------------------------------------
+static void imp_log(const char* format_, ...) __attribute__((format(printf, 1, 2)));
+static void imp_log(const char* format_, ...)
+{
+    va_list args;
+    va_start(args, format_);
+    printf("[%10.3f] ", (double)(imp_now_ns() - startNs) / 1e6);
+    vprintf(format_, args);
+    printf("\n");
+    va_end(args);
+}
+
+//---------------------------------------------------------------------------
+// Outage covering the given time (relative to relay start), if any
+static const imp_outage_t* imp_outage_at(uint64_t relNs_)
+{
+    for (size_t i = 0; i < impOptions.outageCount; i++) {
+        const imp_outage_t* outage = &impOptions.outages[i];
+        if ((relNs_ >= outage->startNs) && (relNs_ < outage->endNs)) {
+            return outage;
+        }
+    }
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+// Time a packet read now would be due, before loss/reordering: serialization
+// at the capped bandwidth behind anything already queued, then propagation.
+static uint64_t imp_schedule(imp_link_t* link_, uint64_t nowNs_, size_t len_)
+{
+    uint64_t txStart = (link_->linkFreeNs > nowNs_) ? link_->linkFreeNs : nowNs_;
+    uint64_t txNs    = 0;
+    if (impOptions.bandwidthBps) {
+        txNs = ((uint64_t)len_ * 8ULL * 1000000000ULL) / impOptions.bandwidthBps;
+    }
+
+    link_->linkFreeNs = txStart + txNs;
+
+    uint64_t jitter = impOptions.jitterNs ? (imp_random() % (impOptions.jitterNs + 1)) : 0;
+    return link_->linkFreeNs + impOptions.delayNs + jitter;
+}
+
+//---------------------------------------------------------------------------
+static imp_packet_t* imp_packet_create(const uint8_t* data_, size_t len_, uint64_t readNs_, uint64_t deliverNs_)
+{
+    imp_packet_t* packet = (imp_packet_t*)malloc(sizeof(imp_packet_t) + len_);
+    if (!packet) {
+        return NULL;
+    }
+    memset(packet, 0, sizeof(*packet));
+    memcpy(packet->data, data_, len_);
+    packet->len       = len_;
+    packet->readNs    = readNs_;
+    packet->deliverNs = deliverNs_;
+    return packet;
+}
+
+//---------------------------------------------------------------------------
+static void imp_delivered(imp_link_t* link_, const imp_packet_t* packet_, uint64_t nowNs_)
+{
+    uint64_t us = (nowNs_ - packet_->readNs) / 1000ULL;
+    histogram_record(&link_->addedDelayUs, (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us);
+    link_->delivered++;
+}
+
+//---------------------------------------------------------------------------
+static void imp_flow_close(imp_flow_t* flow_, const char* reason_, bool reset_)
+{
+    uint32_t discarded = 0;
+    for (int d = 0; d < ImpDirCount; d++) {
+        if (flow_->fd[d] >= 0) {
+            if (reset_) {
+                struct linger linger = { 1, 0 };
+                setsockopt(flow_->fd[d], SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+            }
+            close(flow_->fd[d]);
+        }
+        while (flow_->head[d]) {
+            imp_packet_t* next = flow_->head[d]->next;
+            free(flow_->head[d]);
+            flow_->head[d] = next;
+            discarded++;
+        }
+    }
+    imp_log("flow %d closed (%s), %u queued chunks discarded", (int)(flow_ - flows), reason_, discarded);
+    memset(flow_, 0, sizeof(*flow_));
+    flow_->fd[ImpDirUp]   = -1;
+    flow_->fd[ImpDirDown] = -1;
+}
+
+//---------------------------------------------------------------------------
+static int imp_connect_target(int type_)
+{
+    int fd = socket(AF_INET, type_, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in addr = {};
+    addr.sin_family         = AF_INET;
+    addr.sin_port           = htons(impOptions.targetPort);
+    inet_pton(AF_INET, impOptions.target, &addr.sin_addr);
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+//---------------------------------------------------------------------------
+static int imp_listen(int type_)
+{
+    int fd = socket(AF_INET, type_, 0);
+    if (fd < 0) {
+        printf("error creating socket: %d (%s)\n", errno, strerror(errno));
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family         = AF_INET;
+    addr.sin_addr.s_addr    = htonl(INADDR_ANY);
+    addr.sin_port           = htons(impOptions.listenPort);
+
+    if ((bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) || ((type_ == SOCK_STREAM) && (listen(fd, 8) < 0))) {
+        printf("error listening on port %d: %d (%s)\n", impOptions.listenPort, errno, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+//---------------------------------------------------------------------------
+static imp_flow_t* imp_flow_alloc(void)
+{
+    for (size_t i = 0; i < IMP_MAX_FLOWS; i++) {
+        if (!flows[i].inUse) {
+            flows[i].inUse = true;
+            return &flows[i];
+        }
+    }
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+static void imp_tcp_accept(int listenFd_, uint64_t nowNs_)
+{
+    int fd = accept(listenFd_, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+
+    if (impOptions.resetOnOutage && imp_outage_at(nowNs_ - startNs)) {
+        struct linger linger = { 1, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+        close(fd);
+        imp_log("connection refused (outage)");
+        return;
+    }
+
+    imp_flow_t* flow = imp_flow_alloc();
+    int         upFd = flow ? imp_connect_target(SOCK_STREAM) : -1;
+    if (upFd < 0) {
+        imp_log("connection dropped (%s)", flow ? "server unreachable" : "too many connections");
+        if (flow) {
+            flow->inUse = false;
+        }
+        close(fd);
+        return;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    flow->fd[ImpDirUp]   = fd;   // Read client data from here...
+    flow->fd[ImpDirDown] = upFd; // ...and server data from here
+    imp_log("flow %d connected", (int)(flow - flows));
+}
+
+//---------------------------------------------------------------------------
+// Read a chunk from one side of a TCP flow, and queue it for the other side
+static bool imp_tcp_read(imp_flow_t* flow_, imp_dir_t dir_, uint64_t nowNs_)
+{
+    uint8_t buffer[IMP_CHUNK_MAX];
+    ssize_t nRead = recv(flow_->fd[dir_], buffer, sizeof(buffer), 0);
+    if (nRead == 0) {
+        return false;
+    }
+    if (nRead < 0) {
+        return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+    }
+
+    imp_link_t* link = &links[dir_];
+    uint64_t    due  = imp_schedule(link, nowNs_, (size_t)nRead);
+    link->packets++;
+    link->bytes += (uint64_t)nRead;
+
+    if (imp_chance(impOptions.loss)) {
+        due += impOptions.rtoNs;
+        link->lost++;
+        imp_log("%s flow %d: %zdB lost, retransmitted after %llums",
+                dirNames[dir_],
+                (int)(flow_ - flows),
+                nRead,
+                (unsigned long long)(impOptions.rtoNs / 1000000ULL));
+    }
+
+    // Data due during an outage is held until it ends
+    const imp_outage_t* outage = imp_outage_at(due - startNs);
+    if (outage) {
+        due = startNs + outage->endNs;
+        link->outageHeld++;
+    }
+
+    // The stream is delivered in order
+    if (due < link->lastDueNs) {
+        due = link->lastDueNs;
+    }
+    link->lastDueNs = due;
+
+    imp_packet_t* packet = imp_packet_create(buffer, (size_t)nRead, nowNs_, due);
+    if (!packet) {
+        return false;
+    }
+    if (flow_->tail[dir_]) {
+        flow_->tail[dir_]->next = packet;
+    } else {
+        flow_->head[dir_] = packet;
+    }
+    flow_->tail[dir_] = packet;
+    flow_->queued[dir_] += (size_t)nRead;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Write every due chunk queued in one direction of a TCP flow
+static bool imp_tcp_flush(imp_flow_t* flow_, imp_dir_t dir_, uint64_t nowNs_)
+{
+    int outFd = flow_->fd[(dir_ == ImpDirUp) ? ImpDirDown : ImpDirUp];
+
+    while (flow_->head[dir_] && (flow_->head[dir_]->deliverNs <= nowNs_)) {
+        imp_packet_t* packet   = flow_->head[dir_];
+        ssize_t       nWritten = send(outFd, packet->data + packet->offset, packet->len - packet->offset, MSG_NOSIGNAL);
+        if (nWritten < 0) {
+            flow_->blocked[dir_] = (errno == EAGAIN) || (errno == EWOULDBLOCK);
+            return flow_->blocked[dir_];
+        }
+        packet->offset += (size_t)nWritten;
+        flow_->blocked[dir_] = (packet->offset < packet->len);
+        if (flow_->blocked[dir_]) {
+            return true;
+        }
+
+        imp_delivered(&links[dir_], packet, nowNs_);
+        if (impOptions.verbose) {
+            imp_log("%s flow %d: %zuB delivered", dirNames[dir_], (int)(flow_ - flows), packet->len);
+        }
+        flow_->queued[dir_] -= packet->len;
+        flow_->head[dir_] = packet->next;
+        if (!flow_->head[dir_]) {
+            flow_->tail[dir_] = NULL;
+        }
+        free(packet);
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Queue a datagram, applying loss, reordering and duplication
+static void imp_udp_queue(int flowIndex_, imp_dir_t dir_, const uint8_t* data_, size_t len_, uint64_t nowNs_)
+{
+    imp_link_t* link = &links[dir_];
+    uint64_t    due  = imp_schedule(link, nowNs_, len_);
+    link->packets++;
+    link->bytes += len_;
+
+    if (imp_chance(impOptions.loss)) {
+        link->lost++;
+        imp_log("%s flow %d: %zuB datagram lost", dirNames[dir_], flowIndex_, len_);
+        return;
+    }
+    if (imp_outage_at(due - startNs)) {
+        link->outageHeld++;
+        imp_log("%s flow %d: %zuB datagram dropped (outage)", dirNames[dir_], flowIndex_, len_);
+        return;
+    }
+    if (imp_chance(impOptions.reorder)) {
+        due += impOptions.reorderNs;
+        link->reordered++;
+        imp_log("%s flow %d: %zuB datagram held back %llums",
+                dirNames[dir_],
+                flowIndex_,
+                len_,
+                (unsigned long long)(impOptions.reorderNs / 1000000ULL));
+    }
+
+    int copies = 1;
+    if (imp_chance(impOptions.duplicate)) {
+        copies = 2;
+        link->duplicated++;
+        imp_log("%s flow %d: %zuB datagram duplicated", dirNames[dir_], flowIndex_, len_);
+    }
+
+    for (int i = 0; i < copies; i++) {
+        if (datagramCount >= IMP_MAX_DATAGRAMS) {
+            link->lost++;
+            imp_log("%s flow %d: %zuB datagram dropped (queue full)", dirNames[dir_], flowIndex_, len_);
+            return;
+        }
+        imp_packet_t* packet = imp_packet_create(data_, len_, nowNs_, due);
+        if (!packet) {
+            return;
+        }
+        packet->flow               = flowIndex_;
+        packet->dir                = dir_;
+        datagrams[datagramCount++] = packet;
+    }
+}
+
+//---------------------------------------------------------------------------
+static void imp_udp_read_client(int listenFd_, uint64_t nowNs_)
+{
+    uint8_t            buffer[IMP_CHUNK_MAX];
+    struct sockaddr_in from = {};
+    socklen_t          len  = sizeof(from);
+    ssize_t            nRead = recvfrom(listenFd_, buffer, sizeof(buffer), 0, (struct sockaddr*)&from, &len);
+    if (nRead < 0) {
+        return;
+    }
+
+    imp_flow_t* flow = NULL;
+    for (size_t i = 0; i < IMP_MAX_FLOWS; i++) {
+        if (flows[i].inUse && (flows[i].client.sin_addr.s_addr == from.sin_addr.s_addr)
+            && (flows[i].client.sin_port == from.sin_port)) {
+            flow = &flows[i];
+        }
+    }
+    if (!flow) {
+        flow = imp_flow_alloc();
+        int upFd = flow ? imp_connect_target(SOCK_DGRAM) : -1;
+        if (upFd < 0) {
+            if (flow) {
+                flow->inUse = false;
+            }
+            return;
+        }
+        flow->client         = from;
+        flow->fd[ImpDirDown] = upFd;
+        imp_log("flow %d: new client %s:%u", (int)(flow - flows), inet_ntoa(from.sin_addr), ntohs(from.sin_port));
+    }
+
+    imp_udp_queue((int)(flow - flows), ImpDirUp, buffer, (size_t)nRead, nowNs_);
+}
+
+//---------------------------------------------------------------------------
+static void imp_udp_read_server(imp_flow_t* flow_, uint64_t nowNs_)
+{
+    uint8_t buffer[IMP_CHUNK_MAX];
+    ssize_t nRead = recv(flow_->fd[ImpDirDown], buffer, sizeof(buffer), 0);
+    if (nRead >= 0) {
+        imp_udp_queue((int)(flow_ - flows), ImpDirDown, buffer, (size_t)nRead, nowNs_);
+    }
+}
+
+//---------------------------------------------------------------------------
+static void imp_udp_flush(int listenFd_, uint64_t nowNs_)
+{
+    size_t i = 0;
+    while (i < datagramCount) {
+        imp_packet_t* packet = datagrams[i];
+        if (packet->deliverNs > nowNs_) {
+            i++;
+            continue;
+        }
+
+        imp_flow_t* flow = &flows[packet->flow];
+        if (flow->inUse) {
+            if (packet->dir == ImpDirUp) {
+                send(flow->fd[ImpDirDown], packet->data, packet->len, 0);
+            } else {
+                sendto(listenFd_, packet->data, packet->len, 0, (struct sockaddr*)&flow->client, sizeof(flow->client));
+            }
+            imp_delivered(&links[packet->dir], packet, nowNs_);
+            if (impOptions.verbose) {
+                imp_log("%s flow %d: %zuB datagram delivered", dirNames[packet->dir], packet->flow, packet->len);
+            }
+        }
+        free(packet);
+        datagrams[i] = datagrams[--datagramCount];
+    }
+}
+
+//---------------------------------------------------------------------------
+// Earliest time anything queued is due (UINT64_MAX if nothing is)
+static uint64_t imp_next_due(void)
+{
+    uint64_t next = UINT64_MAX;
+    for (size_t i = 0; i < IMP_MAX_FLOWS; i++) {
+        for (int d = 0; d < ImpDirCount; d++) {
+            if (flows[i].inUse && flows[i].head[d] && (flows[i].head[d]->deliverNs < next)) {
+                next = flows[i].head[d]->deliverNs;
+            }
+        }
+    }
+    for (size_t i = 0; i < datagramCount; i++) {
+        if (datagrams[i]->deliverNs < next) {
+            next = datagrams[i]->deliverNs;
+        }
+    }
+    return next;
+}
+
+//---------------------------------------------------------------------------
+// Log outage transitions, resetting connections at the start of one with -K
+static void imp_track_outages(uint64_t nowNs_)
+{
+    static const imp_outage_t* current;
+
+    const imp_outage_t* outage = imp_outage_at(nowNs_ - startNs);
+    if (outage == current) {
+        return;
+    }
+    if (current) {
+        imp_log("outage ended");
+    }
+    current = outage;
+    if (!outage) {
+        return;
+    }
+
+    imp_log("outage started (%llums)", (unsigned long long)((outage->endNs - outage->startNs) / 1000000ULL));
+    if (impOptions.resetOnOutage && !impOptions.udp) {
+        for (size_t i = 0; i < IMP_MAX_FLOWS; i++) {
+            if (flows[i].inUse) {
+                imp_flow_close(&flows[i], "reset by outage", true);
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+static void imp_print_summary(void)
+{
+    printf("\n%-5s %8s %10s %9s %6s %9s %10s %7s  %s\n",
+           "dir",
+           "packets",
+           "bytes",
+           "delivered",
+           "lost",
+           "reordered",
+           "duplicated",
+           "outage",
+           "added delay us: mean/p50/p99/max");
+    for (int d = 0; d < ImpDirCount; d++) {
+        const imp_link_t* link = &links[d];
+        printf("%-5s %8u %10llu %9u %6u %9u %10u %7u  %lu/%lu/%lu/%lu\n",
+               dirNames[d],
+               link->packets,
+               (unsigned long long)link->bytes,
+               link->delivered,
+               link->lost,
+               link->reordered,
+               link->duplicated,
+               link->outageHeld,
+               (unsigned long)histogram_mean(&link->addedDelayUs),
+               (unsigned long)histogram_percentile(&link->addedDelayUs, 0.50),
+               (unsigned long)histogram_percentile(&link->addedDelayUs, 0.99),
+               (unsigned long)link->addedDelayUs.max);
+    }
+}
+
+//---------------------------------------------------------------------------
+static void imp_usage(const char* argv0_)
+{
+    printf("usage: %s [-l port] [-t host:port] [-u] [-d delay_ms] [-j jitter_ms] [-b kbps] [-L loss] [-r reorder]\n"
+           "          [-D duplicate] [-T rto_ms] [-g gap_ms] [-O start_ms,duration_ms] [-K] [-s seed] [-v]\n"
+           "  -l port          port clients connect to (default %d)\n"
+           "  -t host:port     server to relay to (default 127.0.0.1:%d)\n"
+           "  -u               relay UDP datagrams instead of TCP connections\n"
+           "  -d ms            one-way delay, each direction (default 0)\n"
+           "  -j ms            random additional delay, uniform in [0, jitter] (default 0)\n"
+           "  -b kbps          bandwidth cap, each direction (default unlimited)\n"
+           "  -L probability   loss: datagrams are dropped; TCP chunks are held for the RTO (default 0)\n"
+           "  -r probability   UDP: datagrams held back by the reorder gap, so later ones overtake them (default 0)\n"
+           "  -D probability   UDP: datagrams sent twice (default 0)\n"
+           "  -T ms            TCP: retransmission timeout added to a lost chunk (default %d)\n"
+           "  -g ms            UDP: reorder gap (default %d)\n"
+           "  -O start,length  outage window in ms from relay start; may be repeated (up to %d)\n"
+           "  -K               TCP: reset connections when an outage starts, and refuse new ones during it\n"
+           "  -s seed          random seed (default 1)\n"
+           "  -v               log every delivery, not just impairments\n",
+           argv0_,
+           IMP_DEFAULT_LISTEN_PORT,
+           IMP_DEFAULT_TARGET_PORT,
+           IMP_DEFAULT_RTO_MS,
+           IMP_DEFAULT_REORDER_MS,
+           IMP_MAX_OUTAGES);
+}
+
+//---------------------------------------------------------------------------
+// Parse a number in [0, max_] -- durations, rates and probabilities are never
+// negative.  Returns false if the argument isn't one.
+static bool imp_parse_value(const char* arg_, double max_, double* value_)
+{
+    char*  end;
+    double value = strtod(arg_, &end);
+
+    if ((end == arg_) || *end || !(value >= 0.0) || !(value <= max_)) {
+        return false;
+    }
+    *value_ = value;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static bool imp_parse_args(int argc_, char** argv_)
+{
+    static char target[64];
+    int         opt;
+    double      value = 0.0;
+    bool        valid = true;
+
+    while (valid && ((opt = getopt(argc_, argv_, "l:t:ud:j:b:L:r:D:T:g:O:Ks:vh")) != -1)) {
+        switch (opt) {
+            case 'l': impOptions.listenPort = (uint16_t)atoi(optarg); break;
+            case 't': {
+                char* colon = strrchr(optarg, ':');
+                if (!colon || ((size_t)(colon - optarg) >= sizeof(target))) {
+                    fprintf(stderr, "target must be given as host:port\n");
+                    return false;
+                }
+                memcpy(target, optarg, (size_t)(colon - optarg));
+                target[colon - optarg] = '\0';
+                impOptions.target      = target;
+                impOptions.targetPort  = (uint16_t)atoi(colon + 1);
+            } break;
+            case 'u': impOptions.udp = true; break;
+            case 'd': {
+                valid              = imp_parse_value(optarg, IMP_MAX_MS, &value);
+                impOptions.delayNs = (uint64_t)(value * 1e6);
+            } break;
+            case 'j': {
+                valid               = imp_parse_value(optarg, IMP_MAX_MS, &value);
+                impOptions.jitterNs = (uint64_t)(value * 1e6);
+            } break;
+            case 'b': {
+                valid                   = imp_parse_value(optarg, IMP_MAX_KBPS, &value);
+                impOptions.bandwidthBps = (uint32_t)(value * 1000.0);
+            } break;
+            case 'L': valid = imp_parse_value(optarg, 1.0, &impOptions.loss); break;
+            case 'r': valid = imp_parse_value(optarg, 1.0, &impOptions.reorder); break;
+            case 'D': valid = imp_parse_value(optarg, 1.0, &impOptions.duplicate); break;
+            case 'T': {
+                valid            = imp_parse_value(optarg, IMP_MAX_MS, &value);
+                impOptions.rtoNs = (uint64_t)(value * 1e6);
+            } break;
+            case 'g': {
+                valid                = imp_parse_value(optarg, IMP_MAX_MS, &value);
+                impOptions.reorderNs = (uint64_t)(value * 1e6);
+            } break;
+            case 'O': {
+                double start, length;
+                if ((impOptions.outageCount >= IMP_MAX_OUTAGES) || (sscanf(optarg, "%lf,%lf", &start, &length) != 2)
+                    || !(start >= 0.0) || !(start <= IMP_MAX_MS) || !(length >= 0.0) || !(length <= IMP_MAX_MS)) {
+                    fprintf(stderr, "bad outage '%s'\n", optarg);
+                    return false;
+                }
+                imp_outage_t* outage = &impOptions.outages[impOptions.outageCount++];
+                outage->startNs      = (uint64_t)(start * 1e6);
+                outage->endNs        = outage->startNs + (uint64_t)(length * 1e6);
+            } break;
+            case 'K': impOptions.resetOnOutage = true; break;
+            case 's': impOptions.seed = strtoull(optarg, NULL, 10); break;
+            case 'v': impOptions.verbose = true; break;
+            default: imp_usage(argv_[0]); return false;
+        }
+    }
+
+    // Probabilities must be in [0, 1]; durations and rates can't be negative
+    if (!valid) {
+        fprintf(stderr, "bad value for -%c: '%s'\n", opt, optarg);
+        imp_usage(argv_[0]);
+        return false;
+    }
+    if (optind != argc_) {
+        imp_usage(argv_[0]);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (!imp_parse_args(argc, argv)) {
+        return 1;
+    }
+
+    signal(SIGINT, imp_sigint_handler);
+    signal(SIGTERM, imp_sigint_handler);
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    rngState = (impOptions.seed * 0x9E3779B97F4A7C15ULL) | 1;
+    startNs  = imp_now_ns();
+    for (int d = 0; d < ImpDirCount; d++) { histogram_init(&links[d].addedDelayUs); }
+    for (size_t i = 0; i < IMP_MAX_FLOWS; i++) {
+        flows[i].fd[ImpDirUp]   = -1;
+        flows[i].fd[ImpDirDown] = -1;
+    }
+
+    int listenFd = imp_listen(impOptions.udp ? SOCK_DGRAM : SOCK_STREAM);
+    if (listenFd < 0) {
+        return 1;
+    }
+    imp_log("relaying %s port %d -> %s:%d, delay %.1fms, jitter %.1fms, loss %.3f",
+            impOptions.udp ? "udp" : "tcp",
+            impOptions.listenPort,
+            impOptions.target,
+            impOptions.targetPort,
+            (double)impOptions.delayNs / 1e6,
+            (double)impOptions.jitterNs / 1e6,
+            impOptions.loss);
+
+    while (!exitRequested) {
+        struct pollfd fds[1 + (IMP_MAX_FLOWS * ImpDirCount)];
+        imp_flow_t*   fdFlows[1 + (IMP_MAX_FLOWS * ImpDirCount)];
+        imp_dir_t     fdDirs[1 + (IMP_MAX_FLOWS * ImpDirCount)];
+        nfds_t        nfds = 0;
+
+        fds[nfds].fd     = listenFd;
+        fds[nfds].events = POLLIN;
+        fdFlows[nfds++]  = NULL;
+
+        for (size_t i = 0; i < IMP_MAX_FLOWS; i++) {
+            imp_flow_t* flow = &flows[i];
+            if (!flow->inUse) {
+                continue;
+            }
+            for (int d = 0; d < ImpDirCount; d++) {
+                if (flow->fd[d] < 0) {
+                    continue;
+                }
+                // Stop reading a direction with too much queued.  This socket is also
+                // written with the other direction's data; wait for it if blocked.
+                imp_dir_t other  = (d == ImpDirUp) ? ImpDirDown : ImpDirUp;
+                short     events = (flow->queued[d] < IMP_QUEUE_LIMIT) ? POLLIN : 0;
+                if (flow->blocked[other]) {
+                    events |= POLLOUT;
+                }
+                fds[nfds].fd     = flow->fd[d];
+                fds[nfds].events = events;
+                fdFlows[nfds]    = flow;
+                fdDirs[nfds++]   = (imp_dir_t)d;
+            }
+        }
+
+        // Sleep until the next delivery or outage transition (at most 100ms)
+        uint64_t now     = imp_now_ns();
+        uint64_t wakeNs  = now + 100000000ULL;
+        uint64_t nextDue = imp_next_due();
+        if (nextDue < wakeNs) {
+            wakeNs = nextDue;
+        }
+        for (size_t i = 0; i < impOptions.outageCount; i++) {
+            uint64_t edges[2] = { startNs + impOptions.outages[i].startNs, startNs + impOptions.outages[i].endNs };
+            for (int e = 0; e < 2; e++) {
+                if ((edges[e] > now) && (edges[e] < wakeNs)) {
+                    wakeNs = edges[e];
+                }
+            }
+        }
+        uint64_t        waitNs  = (wakeNs > now) ? (wakeNs - now) : 0;
+        struct timespec timeout = { (time_t)(waitNs / 1000000000ULL), (long)(waitNs % 1000000000ULL) };
+
+        int rc = ppoll(fds, nfds, &timeout, NULL);
+        now    = imp_now_ns();
+        imp_track_outages(now);
+
+        if (rc > 0) {
+            for (nfds_t i = 0; i < nfds; i++) {
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                    continue;
+                }
+                if (!fdFlows[i]) {
+                    if (impOptions.udp) {
+                        imp_udp_read_client(listenFd, now);
+                    } else {
+                        imp_tcp_accept(listenFd, now);
+                    }
+                } else if (!fdFlows[i]->inUse) {
+                    continue; // Closed earlier in this pass
+                } else if (impOptions.udp) {
+                    imp_udp_read_server(fdFlows[i], now);
+                } else if (!imp_tcp_read(fdFlows[i], fdDirs[i], now)) {
+                    imp_flow_close(fdFlows[i], (fdDirs[i] == ImpDirUp) ? "client closed" : "server closed", false);
+                }
+            }
+        }
+
+        if (impOptions.udp) {
+            imp_udp_flush(listenFd, now);
+        } else {
+            for (size_t i = 0; i < IMP_MAX_FLOWS; i++) {
+                for (int d = 0; d < ImpDirCount; d++) {
+                    if (flows[i].inUse && !imp_tcp_flush(&flows[i], (imp_dir_t)d, now)) {
+                        imp_flow_close(&flows[i], "write failed", false);
+                    }
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < IMP_MAX_FLOWS; i++) {
+        if (flows[i].inUse) {
+            imp_flow_close(&flows[i], "exiting", false);
+        }
+    }
+    while (datagramCount) { free(datagrams[--datagramCount]); }
+    close(listenFd);
+    imp_print_summary();
+    return 0;
+}
@@ -0,0 +1,821 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+//---------------------------------------------------------------------------
+// netstick-rx: minimal stand-in for the netstick server, built on the
+// client's own slip/tlvc code.  Accepts client connections, decodes their
+// message streams and tracks a "virtual device" for each configuration
+// received.  Implements session resumption: devices outlive their connection
+// for a grace period, during which a client presenting the device's session
+// token can re-attach to it without resending its configuration.
+//
+// With -s, the identity and latest decoded state of every device is also
+// exported to a shared-memory file (see rx_state.h), for local consumers.
+//---------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "framing.h"
+#include "joystick.h"
+#include "logger.h"
+#include "net_util.h"
+#include "protocol.h"
+#include "rx_state.h"
+#include "tlvc.h"
+
+//---------------------------------------------------------------------------
+#define RX_MAX_CLIENTS (16)
+#define RX_MAX_DEVICES (16)
+#define RX_FRAME_MAX (sizeof(js_config_t) + 64)
+#define RX_DEFAULT_PORT (9001)
+#define RX_DEFAULT_GRACE_MS (30000)
+
+// Frames decoded from each read are validated together (see rx_receive())
+#define RX_RECV_SIZE (4096)
+#define RX_BATCH_FRAMES (64)
+#define RX_BATCH_SIZE (RX_FRAME_MAX * 4)
+
+_Static_assert(RX_MAX_DEVICES <= RX_STATE_MAX_DEVICES, "every device needs a slot in the exported state");
+
+//---------------------------------------------------------------------------
+// Server-side state for a device created from a client's configuration
+typedef struct {
+    bool        inUse;                   //!< Slot holds a device
+    bool        attached;                //!< Device is currently bound to a client connection
+    uint64_t    token;                   //!< Session token handed to the client
+    uint32_t    configHash;              //!< Hash of the device's configuration
+    js_config_t config;                  //!< Device configuration
+    size_t      reportSize;              //!< Expected size of a report, derived from the configuration
+    uint64_t    detachedMs;              //!< Time the device lost its connection
+    uint32_t    reports;                 //!< Number of reports received
+    uint32_t    buttonMsgs;              //!< Number of button-only messages received
+    uint32_t    resumes;                 //!< Number of times a client re-attached to the device
+    uint32_t    keepAlives;              //!< Number of keepalive messages received
+    uint32_t    hintedReports;           //!< Number of reports received with motion hints
+    uint8_t     buttons[KEY_CNT];        //!< Current button state, from reports and button messages
+    int32_t     axes[RX_STATE_MAX_AXES]; //!< Axis values from the most recent report
+    uint32_t    generation;              //!< Identifies the device in the exported state
+    uint32_t    updates;                 //!< Reports and button messages applied to the state
+    uint64_t    updateNs;                //!< Time of the most recent update
+} rx_device_t;
+
+//---------------------------------------------------------------------------
+// State for a single client connection
+typedef struct {
+    int                fd;      //!< Connection socket (-1 == unused slot)
+    framing_type_t     framing; //!< Framing codec selected by the client (SLIP until changed)
+    framing_decoder_t* decoder; //!< Decoder for the connection's stream
+    rx_device_t*       device;  //!< Device bound to the connection (NULL until configured)
+} rx_client_t;
+
+//---------------------------------------------------------------------------
+// Frames decoded from a client's stream, held until the end of the read so
+// they can be validated in one tlvc_decode_batch() call
+typedef struct {
+    uint8_t      data[RX_BATCH_SIZE];     //!< Frames, back to back
+    size_t       dataLen;                 //!< Bytes of data in use
+    tlvc_frame_t frames[RX_BATCH_FRAMES]; //!< Boundaries of each frame in data
+    size_t       frameCount;              //!< Number of frames held
+    tlvc_view_t  views[RX_BATCH_FRAMES];  //!< Valid messages, as returned by tlvc_decode_batch()
+} rx_batch_t;
+
+//---------------------------------------------------------------------------
+typedef struct {
+    uint16_t                port;        //!< Port to listen on
+    uint32_t                graceMs;     //!< How long a detached device is kept for resumption
+    bool                    verbose;     //!< Print every decoded message
+    bool                    rateControl; //!< Send the pacing request to each configured device
+    netstick_rate_control_t control;     //!< Pacing requested from clients
+    const char*             statePath;   //!< File device state is exported to (NULL == not exported)
+} rx_options_t;
+
+//---------------------------------------------------------------------------
+static rx_client_t           clients[RX_MAX_CLIENTS];
+static rx_device_t           devices[RX_MAX_DEVICES];
+static rx_options_t          rxOptions = { RX_DEFAULT_PORT, RX_DEFAULT_GRACE_MS, false };
+static rx_state_region_t*    stateRegion;
+static rx_batch_t            rxBatch;
+static uint32_t              nextGeneration;
+static volatile sig_atomic_t exitRequested;
+static volatile sig_atomic_t motionToggled;
+
+//---------------------------------------------------------------------------
+static uint64_t rx_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+//---------------------------------------------------------------------------
+static uint64_t rx_now_ms(void)
+{
+    return rx_now_ns() / 1000000ULL;
+}
+
+//---------------------------------------------------------------------------
+static uint64_t rx_new_token(void)
+{
+    uint64_t token = 0;
+    FILE*    urandom = fopen("/dev/urandom", "rb");
+    if (urandom) {
+        if (fread(&token, sizeof(token), 1, urandom) != 1) {
+            token = 0;
+        }
+        fclose(urandom);
+    }
+    if (!token) {
+        token = (rx_now_ms() << 20) ^ (uint64_t)rand();
+    }
+    return token;
+}
+
+//---------------------------------------------------------------------------
+// Report layout (see PROTOCOL.txt): one int32 per axis, followed by one byte per button
+static size_t rx_report_size(const js_config_t* config_)
+{
+    return (sizeof(int32_t) * (size_t)(config_->absAxisCount + config_->relAxisCount)) + (size_t)config_->buttonCount;
+}
+
+//---------------------------------------------------------------------------
+static void rx_sigint_handler(int signal_)
+{
+    (void)signal_;
+    exitRequested = 1;
+}
+
+//---------------------------------------------------------------------------
+static void rx_sigusr1_handler(int signal_)
+{
+    (void)signal_;
+    motionToggled = 1;
+}
+
+//---------------------------------------------------------------------------
+static void rx_send_rate_control(rx_client_t* client_)
+{
+    if (!rxOptions.rateControl) {
+        return;
+    }
+    net_util_encode_and_transmit(client_->fd,
+                                 client_->framing,
+                                 NULL,
+                                 NULL,
+                                 NetstickTagRateControl,
+                                 &rxOptions.control,
+                                 sizeof(rxOptions.control));
+}
+
+//---------------------------------------------------------------------------
+static void rx_send_session(rx_client_t* client_, const rx_device_t* device_, uint32_t configHash_, bool resumed_)
+{
+    netstick_session_token_t session = {};
+    session.token                    = device_ ? device_->token : 0;
+    session.configHash               = configHash_;
+    session.resumed                  = resumed_ ? 1 : 0;
+
+    net_util_encode_and_transmit(
+        client_->fd, client_->framing, NULL, NULL, NetstickTagSessionToken, &session, sizeof(session));
+}
+
+//---------------------------------------------------------------------------
+// Export a device's identity and current state (or, for a destroyed device,
+// an empty slot), if exporting is enabled
+static void rx_publish_device(const rx_device_t* device_)
+{
+    if (!stateRegion) {
+        return;
+    }
+
+    rx_state_device_t state = {};
+    if (device_->inUse) {
+        state.status       = device_->attached ? RxStateAttached : RxStateDetached;
+        state.generation   = device_->generation;
+        state.vid          = device_->config.vid;
+        state.pid          = device_->config.pid;
+        state.absAxisCount = device_->config.absAxisCount;
+        state.relAxisCount = device_->config.relAxisCount;
+        state.buttonCount  = device_->config.buttonCount;
+        state.updates      = device_->updates;
+        state.updateNs     = device_->updateNs;
+        memcpy(state.name, device_->config.name, sizeof(state.name));
+        memcpy(state.axes, device_->axes, sizeof(state.axes));
+        protocol_pack_buttons(device_->buttons, (size_t)device_->config.buttonCount, state.buttons);
+    }
+    rx_state_publish(stateRegion, (size_t)(device_ - devices), &state);
+}
+
+//---------------------------------------------------------------------------
+static void rx_destroy_device(rx_device_t* device_)
+{
+    printf("device destroyed: %s (%u reports (%u hinted), %u button messages, %u keepalives, %u resumes)\n",
+           device_->config.name,
+           device_->reports,
+           device_->hintedReports,
+           device_->buttonMsgs,
+           device_->keepAlives,
+           device_->resumes);
+    memset(device_, 0, sizeof(*device_));
+    rx_publish_device(device_);
+}
+
+//---------------------------------------------------------------------------
+static void rx_handle_config(rx_client_t* client_, const void* data_, size_t dataLen_)
+{
+    if (dataLen_ != sizeof(js_config_t)) {
+        printf("invalid config size: %zu\n", dataLen_);
+        return;
+    }
+
+    // A new configuration on an already-configured connection replaces the device
+    if (client_->device) {
+        rx_destroy_device(client_->device);
+        client_->device = NULL;
+    }
+
+    rx_device_t* device = NULL;
+    for (size_t i = 0; i < RX_MAX_DEVICES; i++) {
+        if (!devices[i].inUse) {
+            device = &devices[i];
+            break;
+        }
+    }
+    if (!device) {
+        printf("no free device slots\n");
+        return;
+    }
+
+    memset(device, 0, sizeof(*device));
+    memcpy(&device->config, data_, sizeof(js_config_t));
+    device->config.name[sizeof(device->config.name) - 1] = '\0';
+
+    // The state export holds a fixed number of axes and buttons
+    if ((device->config.absAxisCount < 0) || (device->config.relAxisCount < 0)
+        || ((device->config.absAxisCount + device->config.relAxisCount) > RX_STATE_MAX_AXES)
+        || (device->config.buttonCount < 0) || (device->config.buttonCount > KEY_CNT)) {
+        printf("invalid config: %s\n", device->config.name);
+        return;
+    }
+
+    device->inUse      = true;
+    device->attached   = true;
+    device->token      = rx_new_token();
+    device->configHash = protocol_config_hash(&device->config);
+    device->reportSize = rx_report_size(&device->config);
+    device->generation = ++nextGeneration;
+    client_->device    = device;
+
+    if (stateRegion) {
+        rx_state_publish_config(stateRegion, (size_t)(device - devices), device->generation, &device->config);
+    }
+    rx_publish_device(device);
+
+    printf("device created: %s (vid=%04x pid=%04x abs=%d rel=%d buttons=%d)\n",
+           device->config.name,
+           device->config.vid,
+           device->config.pid,
+           device->config.absAxisCount,
+           device->config.relAxisCount,
+           device->config.buttonCount);
+
+    rx_send_session(client_, device, device->configHash, false);
+    rx_send_rate_control(client_);
+}
+
+//---------------------------------------------------------------------------
+static void rx_handle_resume(rx_client_t* client_, const void* data_, size_t dataLen_)
+{
+    if (dataLen_ != sizeof(netstick_session_resume_t)) {
+        return;
+    }
+
+    netstick_session_resume_t resume;
+    memcpy(&resume, data_, sizeof(resume));
+
+    for (size_t i = 0; i < RX_MAX_DEVICES; i++) {
+        rx_device_t* device = &devices[i];
+        if (device->inUse && !device->attached && (device->token == resume.token)
+            && (device->configHash == resume.configHash)) {
+            device->attached = true;
+            device->resumes++;
+            client_->device = device;
+            rx_publish_device(device);
+
+            printf("device resumed: %s (detached for %llums)\n",
+                   device->config.name,
+                   (unsigned long long)(rx_now_ms() - device->detachedMs));
+            rx_send_session(client_, device, device->configHash, true);
+            rx_send_rate_control(client_);
+            return;
+        }
+    }
+
+    // Unknown/expired session -- the client must send its full configuration
+    printf("resume rejected\n");
+    rx_send_session(client_, NULL, resume.configHash, false);
+}
+
+//---------------------------------------------------------------------------
+static void rx_handle_report(rx_client_t* client_, const void* data_, size_t dataLen_)
+{
+    rx_device_t* device = client_->device;
+    if (!device) {
+        return;
+    }
+    if (dataLen_ != device->reportSize) {
+        printf("%s: unexpected report size %zu (expected %zu)\n", device->config.name, dataLen_, device->reportSize);
+        return;
+    }
+
+    size_t axisCount   = (size_t)(device->config.absAxisCount + device->config.relAxisCount);
+    size_t buttonCount = (size_t)device->config.buttonCount;
+    memcpy(device->axes, data_, axisCount * sizeof(int32_t));
+    memcpy(device->buttons, (const uint8_t*)data_ + (axisCount * sizeof(int32_t)), buttonCount);
+
+    device->reports++;
+    device->updates++;
+    device->updateNs = rx_now_ns();
+    rx_publish_device(device);
+    if (rxOptions.verbose) {
+        const int32_t* axis = (const int32_t*)data_;
+        printf("%s: report", device->config.name);
+        for (int i = 0; i < device->config.absAxisCount + device->config.relAxisCount; i++) { printf(" %d", axis[i]); }
+        printf("\n");
+    }
+}
+
+//---------------------------------------------------------------------------
+// A hinted report is a report preceded by its sample time and a velocity for
+// each absolute axis; the report itself is handled as usual.
+static void rx_handle_hinted_report(rx_client_t* client_, const void* data_, size_t dataLen_)
+{
+    rx_device_t* device = client_->device;
+    if (!device) {
+        return;
+    }
+
+    netstick_report_hint_t hint;
+    int32_t                velocities[ABS_CNT];
+    size_t                 reportLen = 0;
+    const uint8_t*         report
+        = protocol_parse_hinted_report(data_, dataLen_, &hint, velocities, ABS_CNT, &reportLen);
+
+    if (!report || (hint.axisCount != device->config.absAxisCount)) {
+        printf("%s: malformed hinted report (%zu bytes)\n", device->config.name, dataLen_);
+        return;
+    }
+
+    device->hintedReports++;
+    if (rxOptions.verbose) {
+        printf("%s: hint t=%uus v/s", device->config.name, hint.sampleUs);
+        for (size_t i = 0; i < hint.axisCount; i++) {
+            printf(" %.1f", (double)velocities[i] / (double)(1 << NETSTICK_HINT_VELOCITY_SHIFT));
+        }
+        printf("\n");
+    }
+    rx_handle_report(client_, report, reportLen);
+}
+
+//---------------------------------------------------------------------------
+static void rx_handle_buttons(rx_client_t* client_, const void* data_, size_t dataLen_)
+{
+    rx_device_t* device = client_->device;
+    if (!device) {
+        return;
+    }
+
+    size_t buttonCount = (size_t)device->config.buttonCount;
+    if ((buttonCount > KEY_CNT) || (dataLen_ != PROTOCOL_BUTTONS_SIZE(buttonCount))) {
+        printf("%s: unexpected button message size %zu\n", device->config.name, dataLen_);
+        return;
+    }
+
+    protocol_unpack_buttons((const uint8_t*)data_, buttonCount, device->buttons);
+
+    device->buttonMsgs++;
+    device->updates++;
+    device->updateNs = rx_now_ns();
+    rx_publish_device(device);
+    if (rxOptions.verbose) {
+        printf("%s: buttons", device->config.name);
+        for (size_t i = 0; i < buttonCount; i++) { printf("%s", device->buttons[i] ? "1" : "0"); }
+        printf("\n");
+    }
+}
+
+//---------------------------------------------------------------------------
+static void rx_handle_keepalive(rx_client_t* client_, const void* data_, size_t dataLen_)
+{
+    if (dataLen_ != sizeof(netstick_keepalive_t)) {
+        return;
+    }
+
+    netstick_keepalive_t keepAlive;
+    memcpy(&keepAlive, data_, sizeof(keepAlive));
+
+    if (client_->device) {
+        client_->device->keepAlives++;
+    }
+    if (rxOptions.verbose) {
+        printf("keepalive %u%s\n", keepAlive.sequence, (keepAlive.flags & NetstickKeepAliveEcho) ? " (echo)" : "");
+    }
+
+    // Echo requests are answered at once, so the client can time the round trip
+    if (keepAlive.flags & NetstickKeepAliveEcho) {
+        keepAlive.flags = NetstickKeepAliveReply;
+        net_util_encode_and_transmit(
+            client_->fd, client_->framing, NULL, NULL, NetstickTagKeepAlive, &keepAlive, sizeof(keepAlive));
+    }
+}
+
+//---------------------------------------------------------------------------
+static void rx_handle_stats(rx_client_t* client_, const void* data_, size_t dataLen_)
+{
+    if (dataLen_ != sizeof(netstick_stats_t)) {
+        return;
+    }
+
+    netstick_stats_t stats;
+    memcpy(&stats, data_, sizeof(stats));
+
+    printf("%s: stats sent=%u suppressed=%u errors=%u eagain=%u connects=%u poll=%uHz loop p50=%uus p99=%uus\n",
+           client_->device ? client_->device->config.name : "(unconfigured)",
+           stats.reportsSent,
+           stats.reportsSuppressed,
+           stats.sendErrors,
+           stats.sendBackpressure,
+           stats.connects,
+           stats.pollRateHz,
+           stats.loopP50Us,
+           stats.loopP99Us);
+}
+
+//---------------------------------------------------------------------------
+static void rx_handle_framing(rx_client_t* client_, const void* data_, size_t dataLen_)
+{
+    if (dataLen_ != sizeof(netstick_framing_t)) {
+        printf("framing message has bad size %zu\n", dataLen_);
+        return;
+    }
+
+    netstick_framing_t framing;
+    memcpy(&framing, data_, sizeof(framing));
+
+    if (framing.framing >= FramingCount) {
+        printf("unknown framing %u\n", framing.framing);
+        return;
+    }
+
+    // All subsequent data in both directions uses the selected codec
+    client_->framing = (framing_type_t)framing.framing;
+    framing_decoder_reset(client_->decoder, client_->framing);
+
+    if (rxOptions.verbose) {
+        printf("client selected %s framing\n", framing_type_name(client_->framing));
+    }
+}
+
+//---------------------------------------------------------------------------
+static void rx_on_message(rx_client_t* client_, uint16_t messageType_, const void* data_, size_t dataLen_)
+{
+    switch (messageType_) {
+        case NetstickTagConfig: rx_handle_config(client_, data_, dataLen_); break;
+        case NetstickTagSessionResume: rx_handle_resume(client_, data_, dataLen_); break;
+        case NetstickTagReport: rx_handle_report(client_, data_, dataLen_); break;
+        case NetstickTagHintedReport: rx_handle_hinted_report(client_, data_, dataLen_); break;
+        case NetstickTagStats: rx_handle_stats(client_, data_, dataLen_); break;
+        case NetstickTagFraming: rx_handle_framing(client_, data_, dataLen_); break;
+        case NetstickTagButtons: rx_handle_buttons(client_, data_, dataLen_); break;
+        case NetstickTagKeepAlive: rx_handle_keepalive(client_, data_, dataLen_); break;
+        default: {
+            if (rxOptions.verbose) {
+                printf("unhandled tag %u (%zu bytes)\n", messageType_, dataLen_);
+            }
+        } break;
+    }
+}
+
+//---------------------------------------------------------------------------
+// Validate the frames held in the batch, and handle each valid message
+static void rx_flush_batch(rx_client_t* client_)
+{
+    uint32_t errors = 0;
+    size_t   count  = tlvc_decode_batch(rxBatch.data, rxBatch.frames, rxBatch.frameCount, rxBatch.views, &errors);
+
+    rxBatch.frameCount = 0;
+    rxBatch.dataLen    = 0;
+
+    if (errors && rxOptions.verbose) {
+        printf("%u corrupt message(s) dropped\n", errors);
+    }
+    for (size_t i = 0; i < count; i++) {
+        rx_on_message(client_, rxBatch.views[i].tag, rxBatch.views[i].data, rxBatch.views[i].length);
+    }
+}
+
+//---------------------------------------------------------------------------
+// Add the frame just completed by a client's decoder to the batch.  Each frame
+// keeps the boundaries the framing codec found for it, so a frame with a
+// corrupt length field is dropped on its own.
+static void rx_batch_frame(rx_client_t* client_)
+{
+    const framing_decoder_t* decoder = client_->decoder;
+    if (decoder->index == 0) {
+        return;
+    }
+
+    if ((rxBatch.frameCount == RX_BATCH_FRAMES) || (decoder->index > (sizeof(rxBatch.data) - rxBatch.dataLen))) {
+        rx_flush_batch(client_);
+    }
+
+    rxBatch.frames[rxBatch.frameCount].offset = rxBatch.dataLen;
+    rxBatch.frames[rxBatch.frameCount].length = decoder->index;
+    memcpy(rxBatch.data + rxBatch.dataLen, decoder->raw, decoder->index);
+    rxBatch.frameCount++;
+    rxBatch.dataLen += decoder->index;
+
+    // A framing change applies to the bytes after it, which mustn't be decoded
+    // until it's been handled
+    tlvc_header_t header;
+    if (decoder->index >= sizeof(header)) {
+        memcpy(&header, decoder->raw, sizeof(header));
+        if (header.tag == NetstickTagFraming) {
+            rx_flush_batch(client_);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Read everything available from a client connection.  Returns false if the
+// connection was closed, or its stream can't be decoded any further.
+static bool rx_receive(rx_client_t* client_)
+{
+    uint8_t buffer[RX_RECV_SIZE];
+
+    while (true) {
+        ssize_t nRead = recv(client_->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (nRead == 0) {
+            printf("connection closed by peer\n");
+            return false;
+        }
+        if (nRead < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return true;
+            }
+            printf("socket error: %d (%s)\n", errno, strerror(errno));
+            return false;
+        }
+
+        size_t offset = 0;
+        while (offset < (size_t)nRead) {
+            size_t                  consumed = 0;
+            framing_decode_return_t rc
+                = framing_decode_data(client_->decoder, &buffer[offset], (size_t)nRead - offset, &consumed);
+            offset += consumed;
+
+            if (rc == FramingDecodeEndOfFrame) {
+                rx_batch_frame(client_);
+            } else if ((rc != FramingDecodeOk) && !framing_can_resync(client_->decoder->type)) {
+                // Corrupt frames are discarded, and the decoder resynchronizes on
+                // the next frame delimiter -- unless the stream has no delimiters.
+                rx_flush_batch(client_);
+                printf("framing error\n");
+                return false;
+            }
+        }
+
+        // Everything decoded from the read is validated in one pass
+        rx_flush_batch(client_);
+    }
+}
+
+//---------------------------------------------------------------------------
+static void rx_close_client(rx_client_t* client_)
+{
+    if (client_->device) {
+        client_->device->attached   = false;
+        client_->device->detachedMs = rx_now_ms();
+        printf("device detached: %s\n", client_->device->config.name);
+        rx_publish_device(client_->device);
+    }
+    close(client_->fd);
+    framing_decoder_destroy(client_->decoder);
+    client_->fd      = -1;
+    client_->decoder = NULL;
+    client_->device  = NULL;
+}
+
+//---------------------------------------------------------------------------
+static void rx_accept_client(int listenFd_)
+{
+    int fd = accept(listenFd_, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < RX_MAX_CLIENTS; i++) {
+        if (clients[i].fd == -1) {
+            clients[i].fd      = fd;
+            clients[i].framing = FramingSlip;
+            clients[i].decoder = framing_decoder_create(FramingSlip, RX_FRAME_MAX);
+            clients[i].device  = NULL;
+            return;
+        }
+    }
+
+    printf("too many clients\n");
+    close(fd);
+}
+
+//---------------------------------------------------------------------------
+static void rx_expire_devices(void)
+{
+    uint64_t now = rx_now_ms();
+    for (size_t i = 0; i < RX_MAX_DEVICES; i++) {
+        rx_device_t* device = &devices[i];
+        if (device->inUse && !device->attached && ((now - device->detachedMs) >= rxOptions.graceMs)) {
+            rx_destroy_device(device);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+static int rx_listen(uint16_t port_)
+{
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        printf("error creating socket: %d (%s)\n", errno, strerror(errno));
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family         = AF_INET;
+    addr.sin_addr.s_addr    = htonl(INADDR_ANY);
+    addr.sin_port           = htons(port_);
+
+    if ((bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0) || (listen(listenFd, 8) < 0)) {
+        printf("error listening on port %d: %d (%s)\n", port_, errno, strerror(errno));
+        close(listenFd);
+        return -1;
+    }
+    return listenFd;
+}
+
+//---------------------------------------------------------------------------
+static void rx_usage(const char* argv0_)
+{
+    printf("usage: %s [-p port] [-g grace_ms] [-i interval_us] [-c coalesce_us] [-m] [-s state_file] [-v]\n"
+           "  -p port      port to listen on (default %d)\n"
+           "  -g grace_ms  time a disconnected device is kept for session resumption (default %d)\n"
+           "  -i us        ask clients to send axis-only reports at most once per interval\n"
+           "  -c us        ask clients to hold axis changes for a coalescing window\n"
+           "  -m           ask clients to stop sending motion-sensor reports (SIGUSR1 toggles this live)\n"
+           "  -s file      export each device's latest state to a shared-memory file (e.g. /dev/shm/netstick)\n"
+           "  -v           print every decoded message\n",
+           argv0_,
+           RX_DEFAULT_PORT,
+           RX_DEFAULT_GRACE_MS);
+}
+
+//---------------------------------------------------------------------------
+static bool rx_parse_args(int argc_, char** argv_)
+{
+    int opt;
+    rxOptions.control.intervalUs = NETSTICK_RATE_CONTROL_DEFAULT;
+    rxOptions.control.coalesceUs = NETSTICK_RATE_CONTROL_DEFAULT;
+
+    while ((opt = getopt(argc_, argv_, "p:g:i:c:ms:vh")) != -1) {
+        switch (opt) {
+            case 'p': rxOptions.port = (uint16_t)atoi(optarg); break;
+            case 'g': rxOptions.graceMs = (uint32_t)atoi(optarg); break;
+            case 'i': {
+                rxOptions.control.intervalUs = (uint32_t)strtoul(optarg, NULL, 10);
+                rxOptions.rateControl        = true;
+            } break;
+            case 'c': {
+                rxOptions.control.coalesceUs = (uint32_t)strtoul(optarg, NULL, 10);
+                rxOptions.rateControl        = true;
+            } break;
+            case 'm': {
+                rxOptions.control.flags |= NetstickRateControlMotionOff;
+                rxOptions.rateControl = true;
+            } break;
+            case 's': rxOptions.statePath = optarg; break;
+            case 'v': rxOptions.verbose = true; break;
+            default: rx_usage(argv_[0]); return false;
+        }
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (!rx_parse_args(argc, argv)) {
+        return 1;
+    }
+
+    signal(SIGINT, rx_sigint_handler);
+    signal(SIGUSR1, rx_sigusr1_handler);
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    logger_init(LoggerLevelDebug, NULL);
+
+    for (size_t i = 0; i < RX_MAX_CLIENTS; i++) { clients[i].fd = -1; }
+
+    int listenFd = rx_listen(rxOptions.port);
+    if (listenFd < 0) {
+        return 1;
+    }
+    printf("listening on port %d\n", rxOptions.port);
+
+    if (rxOptions.statePath) {
+        stateRegion = rx_state_create(rxOptions.statePath);
+        if (!stateRegion) {
+            close(listenFd);
+            return 1;
+        }
+        printf("exporting device state to %s\n", rxOptions.statePath);
+    }
+
+    while (!exitRequested) {
+        struct pollfd fds[RX_MAX_CLIENTS + 1];
+        rx_client_t*  fdClients[RX_MAX_CLIENTS + 1];
+        nfds_t        nfds = 0;
+
+        fds[nfds].fd       = listenFd;
+        fds[nfds].events   = POLLIN;
+        fdClients[nfds++]  = NULL;
+
+        for (size_t i = 0; i < RX_MAX_CLIENTS; i++) {
+            if (clients[i].fd != -1) {
+                fds[nfds].fd      = clients[i].fd;
+                fds[nfds].events  = POLLIN;
+                fdClients[nfds++] = &clients[i];
+            }
+        }
+
+        int rc = poll(fds, nfds, 100);
+        if (rc > 0) {
+            for (nfds_t i = 0; i < nfds; i++) {
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                    continue;
+                }
+                if (!fdClients[i]) {
+                    rx_accept_client(listenFd);
+                } else if (!rx_receive(fdClients[i])) {
+                    // Print any errors logged while handling messages before the disconnect
+                    logger_drain(LOGGER_DRAIN_ALL);
+                    rx_close_client(fdClients[i]);
+                }
+            }
+        }
+
+        // Pacing changes are applied by connected clients without reconnecting
+        if (motionToggled) {
+            motionToggled = 0;
+            rxOptions.control.flags ^= NetstickRateControlMotionOff;
+            rxOptions.rateControl = true;
+            printf("motion sensors %s\n", (rxOptions.control.flags & NetstickRateControlMotionOff) ? "off" : "on");
+            for (size_t i = 0; i < RX_MAX_CLIENTS; i++) {
+                if ((clients[i].fd != -1) && clients[i].device) {
+                    rx_send_rate_control(&clients[i]);
+                }
+            }
+        }
+
+        rx_expire_devices();
+        logger_drain(LOGGER_DRAIN_ALL);
+    }
+
+    for (size_t i = 0; i < RX_MAX_CLIENTS; i++) {
+        if (clients[i].fd != -1) {
+            rx_close_client(&clients[i]);
+        }
+    }
+    if (stateRegion) {
+        rx_state_destroy(stateRegion, rxOptions.statePath);
+    }
+    close(listenFd);
+    logger_exit();
+    return 0;
+}
@@ -0,0 +1,767 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+//---------------------------------------------------------------------------
+// netstick-sim: deterministic discrete-event simulator for the client's input
+// loop.  Replays an input trace (in the ctru_shim script format) against a
+// model of the HID module's sampling, the cost of scanning input and of each
+// device's handle_hid_events(), the frame work and the socket, entirely in
+// virtual time, under each of several scheduling policies:
+//
+//   current  - wait for vblank, then poll three times, 1/180s apart
+//   fixed    - poll at a fixed rate, on an absolute schedule
+//   event    - poll as soon as each HID sample is published
+//   deadline - each device has its own deadline; poll when the earliest is due
+//
+// For each policy it reports the press-to-send latency distribution, polls and
+// reports per second, and the fraction of time the CPU is busy.  Runs are
+// deterministic for a given trace, seed and cost model, so scheduling changes
+// can be compared on numbers before they're tried on hardware.  Sub-frame
+// capture isn't modelled: a press and release between two polls is lost.
+//---------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "histogram.h"
+
+//---------------------------------------------------------------------------
+#define SIM_VBLANK_NS (1000000000ULL / 60ULL)
+#define SIM_POLL_PERIOD_NS (1000000000ULL / 180ULL)
+#define SIM_POLLS_PER_FRAME (3)
+#define SIM_KEY_TOUCH (1u << 20) // KEY_TOUCH, as reported by hidKeysHeld()
+
+#define SIM_MAX_TRACE (1u << 20)
+#define SIM_MAX_EDGES (4096) // Key edges in flight (changed but not yet sent); power of two
+
+#define SIM_DEFAULT_DURATION_MS (10000)
+#define SIM_DEFAULT_RATE_HZ (500)
+#define SIM_DEFAULT_SAMPLE_US (4000)
+#define SIM_DEFAULT_SEND_US (60)
+#define SIM_DEFAULT_FRAME_US (400)
+#define SIM_DEFAULT_WAKE_US (50)
+#define SIM_DEFAULT_RETRY_MS (2000)
+
+//---------------------------------------------------------------------------
+typedef enum {
+    SimPolicyCurrent = 0,
+    SimPolicyFixed,
+    SimPolicyEvent,
+    SimPolicyDeadline,
+    //--
+    SimPolicyCount
+} sim_policy_t;
+
+typedef enum {
+    SimDeviceGamepad = 0,
+    SimDeviceAccel,
+    SimDeviceTouch,
+    //--
+    SimDeviceCount
+} sim_device_t;
+
+#define SIM_ALL_DEVICES ((1u << SimDeviceCount) - 1)
+
+static const char* const policyNames[SimPolicyCount] = {
+    [SimPolicyCurrent]  = "current",
+    [SimPolicyFixed]    = "fixed",
+    [SimPolicyEvent]    = "event",
+    [SimPolicyDeadline] = "deadline",
+};
+
+//---------------------------------------------------------------------------
+// One input change from the trace
+typedef enum {
+    SimInputKeys = 0,
+    SimInputCircle,
+    SimInputCstick,
+    SimInputTouch,
+    SimInputAccel,
+    SimInputGyro
+} sim_input_kind_t;
+
+typedef struct {
+    uint64_t         timeNs; //!< Time of the change, relative to the start of the run
+    sim_input_kind_t kind;   //!< Input that changed
+    int32_t          v[3];   //!< New value(s)
+} sim_trace_entry_t;
+
+//---------------------------------------------------------------------------
+// Input state, as seen by the HID "hardware" and as captured by each sample
+typedef struct {
+    uint32_t keys;
+    int32_t  circle[2];
+    int32_t  cstick[2];
+    int32_t  touch[2];
+    int32_t  motion[6];   //!< Accelerometer x/y/z, gyroscope x/y/z
+    uint32_t motionNoise; //!< Bumped on every sample while the motion sensors are live
+} sim_input_t;
+
+//---------------------------------------------------------------------------
+// A key change that hasn't been sent yet
+typedef struct {
+    uint64_t changeNs; //!< Time the key state changed
+    uint64_t sampleNs; //!< Time of the sample that published it (0 == not sampled yet)
+} sim_edge_t;
+
+//---------------------------------------------------------------------------
+typedef struct {
+    const char* tracePath;   //!< Input trace (NULL == synthetic)
+    uint64_t    durationNs;  //!< Simulated time (0 == end of the trace)
+    int         policy;      //!< Policy to simulate (SimPolicyCount == all)
+    uint32_t    rateHz;      //!< Poll rate of the fixed-rate policy
+    uint64_t    sampleNs;    //!< HID sample period
+    uint64_t    scanNs;      //!< Cost of a scan (hidScanInput() + snapshot)
+    uint64_t    deviceNs[SimDeviceCount]; //!< Cost of each device's handle_hid_events(), excluding the send
+    uint64_t    sendNs;      //!< Cost of encoding and sending a report
+    uint64_t    frameNs;     //!< Per-frame work: log drain, overlay, buffer swap
+    uint64_t    wakeNs;      //!< Latency from a HID sample to the event-driven loop running
+    uint64_t    retryNs;     //!< Delay after a send failure before the devices are processed again
+    double      errorRate;   //!< Probability that any one send fails
+    bool        motionStill; //!< The motion sensors only change when the trace says so
+    uint64_t    seed;        //!< Seed for the synthetic trace and send failures
+} sim_options_t;
+
+//---------------------------------------------------------------------------
+// State of one simulation run
+typedef struct {
+    sim_policy_t policy;
+    uint64_t     now;        //!< Virtual time at which the loop is next free to run
+    uint64_t     end;        //!< End of the run
+    uint64_t     rng;        //!< Send-failure random state
+    size_t       nextTrace;  //!< Next trace entry to apply
+    sim_input_t  live;       //!< Input as seen by the hardware
+    sim_input_t  sampled;    //!< Input as of the most recent HID sample
+    uint64_t     sampledNs;  //!< Time of the most recent HID sample
+    uint64_t     nextSample; //!< Time of the next HID sample
+    uint64_t     samples;    //!< HID samples taken so far
+    uint64_t     lastWoken;  //!< Samples already seen by the event-driven wait
+
+    sim_input_t sent[SimDeviceCount]; //!< Input as of each device's last report
+    uint64_t    retryUntil;           //!< Devices aren't processed until this time (after a send failure)
+
+    sim_edge_t edges[SIM_MAX_EDGES]; //!< Unsent key edges, oldest first
+    size_t     edgeHead;
+    size_t     edgeCount;
+
+    histogram_t latencyUs; //!< Press-to-send latency
+    uint64_t    busyNs;    //!< Time the loop spent working
+    uint32_t    polls;
+    uint32_t    reports;
+    uint32_t    sendErrors;
+    uint32_t    keyEdges;  //!< Key changes in the trace
+    uint32_t    lostEdges; //!< Key changes never sent (reverted before a sample, or between polls)
+} sim_t;
+
+//---------------------------------------------------------------------------
+static sim_options_t simOptions = {
+    .policy    = SimPolicyCount,
+    .rateHz    = SIM_DEFAULT_RATE_HZ,
+    .sampleNs  = SIM_DEFAULT_SAMPLE_US * 1000ULL,
+    .scanNs    = 30000ULL,
+    .deviceNs  = { 40000ULL, 25000ULL, 20000ULL },
+    .sendNs    = SIM_DEFAULT_SEND_US * 1000ULL,
+    .frameNs   = SIM_DEFAULT_FRAME_US * 1000ULL,
+    .wakeNs    = SIM_DEFAULT_WAKE_US * 1000ULL,
+    .retryNs   = SIM_DEFAULT_RETRY_MS * 1000000ULL,
+    .errorRate = 0.0,
+    .seed      = 1,
+};
+
+static sim_trace_entry_t* trace;
+static size_t             traceCount;
+
+//---------------------------------------------------------------------------
+// xorshift64* -- small, fast and deterministic across platforms
+static uint64_t sim_random(uint64_t* state_)
+{
+    uint64_t x = *state_;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state_ = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+//---------------------------------------------------------------------------
+static double sim_random_unit(uint64_t* state_)
+{
+    return (double)(sim_random(state_) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//---------------------------------------------------------------------------
+static bool sim_trace_add(uint64_t timeNs_, sim_input_kind_t kind_, int32_t v0_, int32_t v1_, int32_t v2_)
+{
+    if (traceCount >= SIM_MAX_TRACE) {
+        return false;
+    }
+    sim_trace_entry_t* entry = &trace[traceCount++];
+    entry->timeNs            = timeNs_;
+    entry->kind              = kind_;
+    entry->v[0]              = v0_;
+    entry->v[1]              = v1_;
+    entry->v[2]              = v2_;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static int sim_trace_compare(const void* a_, const void* b_)
+{
+    const sim_trace_entry_t* a = (const sim_trace_entry_t*)a_;
+    const sim_trace_entry_t* b = (const sim_trace_entry_t*)b_;
+    return (a->timeNs < b->timeNs) ? -1 : ((a->timeNs > b->timeNs) ? 1 : 0);
+}
+
+//---------------------------------------------------------------------------
+// Load a ctru_shim input script.  An "exit" command sets the duration (unless
+// one was given on the command line).
+static bool sim_trace_load(const char* path_)
+{
+    FILE* file = fopen(path_, "r");
+    if (!file) {
+        fprintf(stderr, "error opening %s\n", path_);
+        return false;
+    }
+
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long timeMs;
+        char          input[16];
+        long          v[3] = { 0, 0, 0 };
+
+        if ((line[0] == '#')
+            || (sscanf(line, "%lu %15s %li %li %li", &timeMs, input, &v[0], &v[1], &v[2]) < 2)) {
+            continue;
+        }
+
+        uint64_t         when = (uint64_t)timeMs * 1000000ULL;
+        sim_input_kind_t kind;
+        if (!strcmp(input, "keys")) {
+            kind = SimInputKeys;
+        } else if (!strcmp(input, "circle")) {
+            kind = SimInputCircle;
+        } else if (!strcmp(input, "cstick")) {
+            kind = SimInputCstick;
+        } else if (!strcmp(input, "touch")) {
+            kind = SimInputTouch;
+        } else if (!strcmp(input, "accel")) {
+            kind = SimInputAccel;
+        } else if (!strcmp(input, "gyro")) {
+            kind = SimInputGyro;
+        } else {
+            if (!strcmp(input, "exit") && !simOptions.durationNs) {
+                simOptions.durationNs = when;
+            }
+            continue;
+        }
+
+        if (!sim_trace_add(when, kind, (int32_t)v[0], (int32_t)v[1], (int32_t)v[2])) {
+            fprintf(stderr, "trace too long (max %u entries)\n", SIM_MAX_TRACE);
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+
+    qsort(trace, traceCount, sizeof(*trace), sim_trace_compare);
+    if (!simOptions.durationNs) {
+        simOptions.durationNs = (traceCount != 0) ? trace[traceCount - 1].timeNs : 0;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Synthetic trace: button taps of random length at random intervals, while
+// the circle pad sweeps back and forth.
+static void sim_trace_generate(void)
+{
+    uint64_t rng = simOptions.seed | 1;
+
+    for (uint64_t t = 0; t < simOptions.durationNs; t += 8000000ULL) {
+        int32_t phase = (int32_t)((t / 8000000ULL) % 100);
+        sim_trace_add(t, SimInputCircle, (phase < 50) ? (phase * 6) - 150 : 450 - (phase * 6), 0, 0);
+    }
+
+    uint64_t t = 100000000ULL;
+    while (t < simOptions.durationNs) {
+        uint32_t key    = 1u << (sim_random(&rng) % 4);
+        uint64_t holdNs = (20 + (sim_random(&rng) % 100)) * 1000000ULL;
+        sim_trace_add(t + (sim_random(&rng) % 1000000ULL), SimInputKeys, (int32_t)key, 0, 0);
+        sim_trace_add(t + holdNs, SimInputKeys, 0, 0, 0);
+        t += holdNs + ((30 + (sim_random(&rng) % 200)) * 1000000ULL);
+    }
+
+    qsort(trace, traceCount, sizeof(*trace), sim_trace_compare);
+}
+
+//---------------------------------------------------------------------------
+static void sim_apply_trace_entry(sim_t* sim_, const sim_trace_entry_t* entry_)
+{
+    sim_input_t* live = &sim_->live;
+    switch (entry_->kind) {
+        case SimInputKeys: {
+            uint32_t keys = (uint32_t)entry_->v[0];
+            if (keys == live->keys) {
+                break;
+            }
+            live->keys = keys;
+            sim_->keyEdges++;
+            if (sim_->edgeCount < SIM_MAX_EDGES) {
+                sim_edge_t* edge = &sim_->edges[(sim_->edgeHead + sim_->edgeCount++) & (SIM_MAX_EDGES - 1)];
+                edge->changeNs   = entry_->timeNs;
+                edge->sampleNs   = 0;
+            } else {
+                sim_->lostEdges++;
+            }
+        } break;
+        case SimInputCircle: memcpy(live->circle, entry_->v, sizeof(live->circle)); break;
+        case SimInputCstick: memcpy(live->cstick, entry_->v, sizeof(live->cstick)); break;
+        case SimInputTouch: memcpy(live->touch, entry_->v, sizeof(live->touch)); break;
+        case SimInputAccel: memcpy(&live->motion[0], entry_->v, 3 * sizeof(int32_t)); break;
+        case SimInputGyro: memcpy(&live->motion[3], entry_->v, 3 * sizeof(int32_t)); break;
+    }
+}
+
+//---------------------------------------------------------------------------
+// Take a HID sample.  Key edges reverted before they could be sampled are lost.
+static void sim_take_sample(sim_t* sim_, uint64_t timeNs_)
+{
+    uint32_t previousKeys = sim_->sampled.keys;
+
+    sim_->sampled   = sim_->live;
+    sim_->sampledNs = timeNs_;
+    sim_->samples++;
+    if (!simOptions.motionStill) {
+        sim_->live.motionNoise++;
+        sim_->sampled.motionNoise = sim_->live.motionNoise;
+    }
+
+    for (size_t i = 0; i < sim_->edgeCount; i++) {
+        sim_edge_t* edge = &sim_->edges[(sim_->edgeHead + i) & (SIM_MAX_EDGES - 1)];
+        if (edge->sampleNs == 0) {
+            edge->sampleNs = (sim_->sampled.keys != previousKeys) ? timeNs_ : UINT64_MAX;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Apply every trace entry and HID sample up to (and including) timeNs_, in
+// time order.  Trace entries at the same time as a sample are applied first.
+static void sim_advance(sim_t* sim_, uint64_t timeNs_)
+{
+    while (true) {
+        uint64_t traceNs = (sim_->nextTrace < traceCount) ? trace[sim_->nextTrace].timeNs : UINT64_MAX;
+        if ((traceNs <= sim_->nextSample) && (traceNs <= timeNs_)) {
+            sim_apply_trace_entry(sim_, &trace[sim_->nextTrace++]);
+        } else if (sim_->nextSample <= timeNs_) {
+            sim_take_sample(sim_, sim_->nextSample);
+            sim_->nextSample += simOptions.sampleNs;
+        } else {
+            break;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+static bool sim_device_changed(const sim_t* sim_, sim_device_t device_, const sim_input_t* input_)
+{
+    const sim_input_t* sent = &sim_->sent[device_];
+    switch (device_) {
+        case SimDeviceGamepad:
+            return ((input_->keys & ~SIM_KEY_TOUCH) != (sent->keys & ~SIM_KEY_TOUCH))
+                   || memcmp(input_->circle, sent->circle, sizeof(sent->circle))
+                   || memcmp(input_->cstick, sent->cstick, sizeof(sent->cstick));
+        case SimDeviceAccel:
+            return memcmp(input_->motion, sent->motion, sizeof(sent->motion))
+                   || (input_->motionNoise != sent->motionNoise);
+        case SimDeviceTouch:
+            return ((input_->keys & SIM_KEY_TOUCH) != (sent->keys & SIM_KEY_TOUCH))
+                   || memcmp(input_->touch, sent->touch, sizeof(sent->touch));
+        default: return false;
+    }
+}
+
+//---------------------------------------------------------------------------
+// A gamepad report built from the sample taken at sampleNs_ has been sent (or,
+// if !sent_, found nothing to send): settle every edge that sample published.
+static void sim_settle_edges(sim_t* sim_, uint64_t sampleNs_, bool sent_)
+{
+    while (sim_->edgeCount != 0) {
+        sim_edge_t* edge = &sim_->edges[sim_->edgeHead];
+        if ((edge->sampleNs == 0) || ((edge->sampleNs != UINT64_MAX) && (edge->sampleNs > sampleNs_))) {
+            break;
+        }
+
+        if (sent_ && (edge->sampleNs != UINT64_MAX)) {
+            uint64_t latencyUs = (sim_->now - edge->changeNs) / 1000ULL;
+            histogram_record(&sim_->latencyUs, (latencyUs > UINT32_MAX) ? UINT32_MAX : (uint32_t)latencyUs);
+        } else {
+            sim_->lostEdges++;
+        }
+        sim_->edgeHead = (sim_->edgeHead + 1) & (SIM_MAX_EDGES - 1);
+        sim_->edgeCount--;
+    }
+}
+
+//---------------------------------------------------------------------------
+static void sim_busy(sim_t* sim_, uint64_t ns_)
+{
+    sim_->now += ns_;
+    sim_->busyNs += ns_;
+}
+
+//---------------------------------------------------------------------------
+// One pass of the loop body: scan input, then run handle_hid_events() for
+// each device in the mask, in device order, sending any report that changed.
+static void sim_poll(sim_t* sim_, uint32_t deviceMask_)
+{
+    sim_advance(sim_, sim_->now);
+
+    sim_input_t input     = sim_->sampled;
+    uint64_t    sampledNs = sim_->sampledNs;
+
+    sim_busy(sim_, simOptions.scanNs);
+    sim_->polls++;
+
+    for (int i = 0; i < SimDeviceCount; i++) {
+        if (!(deviceMask_ & (1u << i)) || (sim_->now < sim_->retryUntil)) {
+            continue;
+        }
+
+        sim_busy(sim_, simOptions.deviceNs[i]);
+        if (!sim_device_changed(sim_, (sim_device_t)i, &input)) {
+            if (i == SimDeviceGamepad) {
+                sim_settle_edges(sim_, sampledNs, false);
+            }
+            continue;
+        }
+
+        sim_busy(sim_, simOptions.sendNs);
+        if ((simOptions.errorRate > 0.0) && (sim_random_unit(&sim_->rng) < simOptions.errorRate)) {
+            sim_->sendErrors++;
+            sim_->retryUntil = sim_->now + simOptions.retryNs;
+            continue;
+        }
+
+        sim_->reports++;
+        sim_->sent[i] = input;
+        if (i == SimDeviceGamepad) {
+            sim_settle_edges(sim_, sampledNs, true);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+static void sim_sleep_until(sim_t* sim_, uint64_t timeNs_)
+{
+    if (timeNs_ > sim_->now) {
+        sim_->now = timeNs_;
+    }
+}
+
+//---------------------------------------------------------------------------
+// Today's loop: vblank wait, then three polls separated by 1/180s sleeps, then
+// the frame work.  Only the first poll of a frame processes every device.
+static void sim_run_current(sim_t* sim_)
+{
+    while (sim_->now < sim_->end) {
+        sim_sleep_until(sim_, ((sim_->now / SIM_VBLANK_NS) + 1) * SIM_VBLANK_NS);
+        for (int i = 0; i < SIM_POLLS_PER_FRAME; i++) {
+            if (i != 0) {
+                sim_->now += SIM_POLL_PERIOD_NS;
+            }
+            sim_poll(sim_, (i == 0) ? SIM_ALL_DEVICES : (1u << SimDeviceGamepad));
+        }
+        sim_busy(sim_, simOptions.frameNs);
+    }
+}
+
+//---------------------------------------------------------------------------
+// Polls (and, once per frame, the other devices and the frame work) driven by
+// a wakeup time chosen by each policy.
+static void sim_run_frames(sim_t* sim_, uint64_t (*nextWake_)(sim_t* sim_))
+{
+    uint64_t lastFrame = UINT64_MAX;
+    while (sim_->now < sim_->end) {
+        sim_sleep_until(sim_, nextWake_(sim_));
+
+        uint64_t frame    = sim_->now / SIM_VBLANK_NS;
+        bool     newFrame = (frame != lastFrame);
+        sim_poll(sim_, newFrame ? SIM_ALL_DEVICES : (1u << SimDeviceGamepad));
+        if (newFrame) {
+            sim_busy(sim_, simOptions.frameNs);
+            lastFrame = frame;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Fixed-rate polling on an absolute schedule; polls that can't start on time
+// are skipped rather than run back-to-back.
+static uint64_t sim_wake_fixed(sim_t* sim_)
+{
+    uint64_t period = 1000000000ULL / simOptions.rateHz;
+    return ((sim_->now / period) + 1) * period;
+}
+
+//---------------------------------------------------------------------------
+// Event-driven: the wait returns as soon as a HID sample newer than the last
+// one seen has been published (immediately, if one already has).
+static uint64_t sim_wake_event(sim_t* sim_)
+{
+    uint64_t published = (sim_->now / simOptions.sampleNs) + 1; // Samples taken at or before now (sample 0 at t=0)
+    uint64_t wake      = sim_->now;
+    if (published <= sim_->lastWoken) {
+        wake = (sim_->lastWoken * simOptions.sampleNs) + simOptions.wakeNs;
+        published = sim_->lastWoken + 1;
+    }
+    sim_->lastWoken = published;
+    return wake;
+}
+
+//---------------------------------------------------------------------------
+// Per-device deadlines: the gamepad is due on every HID sample, the motion
+// sensors and touchscreen once per frame.  The loop wakes for the earliest
+// deadline and processes every device that's due.
+static void sim_run_deadline(sim_t* sim_)
+{
+    uint64_t period[SimDeviceCount]   = { simOptions.sampleNs, SIM_VBLANK_NS, SIM_VBLANK_NS };
+    uint64_t deadline[SimDeviceCount] = { simOptions.wakeNs, 0, 0 };
+    uint64_t lastFrame                = UINT64_MAX;
+
+    while (sim_->now < sim_->end) {
+        uint64_t next = UINT64_MAX;
+        for (int i = 0; i < SimDeviceCount; i++) {
+            if (deadline[i] < next) {
+                next = deadline[i];
+            }
+        }
+        sim_sleep_until(sim_, next);
+
+        uint32_t due = 0;
+        for (int i = 0; i < SimDeviceCount; i++) {
+            if (deadline[i] <= sim_->now) {
+                due |= 1u << i;
+                while (deadline[i] <= sim_->now) { deadline[i] += period[i]; }
+            }
+        }
+        sim_poll(sim_, due);
+
+        uint64_t frame = sim_->now / SIM_VBLANK_NS;
+        if (frame != lastFrame) {
+            sim_busy(sim_, simOptions.frameNs);
+            lastFrame = frame;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+static void sim_run(sim_t* sim_, sim_policy_t policy_)
+{
+    memset(sim_, 0, sizeof(*sim_));
+    histogram_init(&sim_->latencyUs);
+    sim_->policy = policy_;
+    sim_->end    = simOptions.durationNs;
+    sim_->rng    = (simOptions.seed * 0x9E3779B97F4A7C15ULL) | 1;
+
+    switch (policy_) {
+        case SimPolicyCurrent: sim_run_current(sim_); break;
+        case SimPolicyFixed: sim_run_frames(sim_, sim_wake_fixed); break;
+        case SimPolicyEvent: sim_run_frames(sim_, sim_wake_event); break;
+        case SimPolicyDeadline: sim_run_deadline(sim_); break;
+        default: break;
+    }
+
+    // Edges still in flight at the end of the run were never sent
+    sim_->lostEdges += (uint32_t)sim_->edgeCount;
+}
+
+//---------------------------------------------------------------------------
+static void sim_print_header(void)
+{
+    printf("netstick-sim: %.2fs simulated, %zu trace entries, sample period %lluus, costs (us): scan %llu, "
+           "gamepad %llu, accel %llu, touch %llu, send %llu, frame %llu\n\n",
+           (double)simOptions.durationNs / 1e9,
+           traceCount,
+           (unsigned long long)(simOptions.sampleNs / 1000ULL),
+           (unsigned long long)(simOptions.scanNs / 1000ULL),
+           (unsigned long long)(simOptions.deviceNs[SimDeviceGamepad] / 1000ULL),
+           (unsigned long long)(simOptions.deviceNs[SimDeviceAccel] / 1000ULL),
+           (unsigned long long)(simOptions.deviceNs[SimDeviceTouch] / 1000ULL),
+           (unsigned long long)(simOptions.sendNs / 1000ULL),
+           (unsigned long long)(simOptions.frameNs / 1000ULL));
+    printf("%-9s %8s %10s %6s %7s  %-31s %6s %6s\n",
+           "policy",
+           "polls/s",
+           "reports/s",
+           "busy%",
+           "errors",
+           "press->send us: p50/p90/p99/max",
+           "edges",
+           "lost");
+}
+
+//---------------------------------------------------------------------------
+static void sim_print_result(const sim_t* sim_)
+{
+    double seconds = (double)sim_->end / 1e9;
+    char   latency[48];
+
+    snprintf(latency,
+             sizeof(latency),
+             "%lu/%lu/%lu/%lu",
+             (unsigned long)histogram_percentile(&sim_->latencyUs, 0.50),
+             (unsigned long)histogram_percentile(&sim_->latencyUs, 0.90),
+             (unsigned long)histogram_percentile(&sim_->latencyUs, 0.99),
+             (unsigned long)sim_->latencyUs.max);
+
+    printf("%-9s %8.1f %10.1f %5.1f%% %7u  %-31s %6u %6u\n",
+           policyNames[sim_->policy],
+           (double)sim_->polls / seconds,
+           (double)sim_->reports / seconds,
+           ((double)sim_->busyNs * 100.0) / (double)sim_->now,
+           sim_->sendErrors,
+           latency,
+           sim_->keyEdges,
+           sim_->lostEdges);
+}
+
+//---------------------------------------------------------------------------
+static void sim_usage(const char* argv0_)
+{
+    printf("usage: %s [-t trace] [-d duration_ms] [-p policy] [-r rate_hz] [-s sample_us] [-c scan,pad,accel,touch]\n"
+           "          [-S send_us] [-F frame_us] [-w wake_us] [-e error_rate] [-R retry_ms] [-M] [-x seed]\n"
+           "  -t trace      input script in the ctru_shim format (default: synthetic taps and stick motion)\n"
+           "  -d ms         simulated time (default: the trace's exit command or last entry, or %d)\n"
+           "  -p policy     current, fixed, event, deadline or all (default all)\n"
+           "  -r hz         poll rate of the fixed-rate policy (default %d)\n"
+           "  -s us         HID sample period (default %d)\n"
+           "  -c us,...     cost of a scan, and of handle_hid_events() for the gamepad, accelerometer and\n"
+           "                touchscreen (default 30,40,25,20)\n"
+           "  -S us         cost of encoding and sending a report (default %d)\n"
+           "  -F us         per-frame work: log drain, overlay, buffer swap (default %d)\n"
+           "  -w us         wakeup latency after a HID sample, for the event and deadline policies (default %d)\n"
+           "  -e rate       probability that a send fails (default 0)\n"
+           "  -R ms         delay after a send failure before reports resume (default %d)\n"
+           "  -M            motion sensors are still (by default their readings change on every sample)\n"
+           "  -x seed       seed for the synthetic trace and send failures (default 1)\n",
+           argv0_,
+           SIM_DEFAULT_DURATION_MS,
+           SIM_DEFAULT_RATE_HZ,
+           SIM_DEFAULT_SAMPLE_US,
+           SIM_DEFAULT_SEND_US,
+           SIM_DEFAULT_FRAME_US,
+           SIM_DEFAULT_WAKE_US,
+           SIM_DEFAULT_RETRY_MS);
+}
+
+//---------------------------------------------------------------------------
+static bool sim_parse_costs(const char* arg_)
+{
+    unsigned long scan, pad, accel, touch;
+    if (sscanf(arg_, "%lu,%lu,%lu,%lu", &scan, &pad, &accel, &touch) != 4) {
+        fprintf(stderr, "costs must be given as scan,pad,accel,touch\n");
+        return false;
+    }
+    simOptions.scanNs                     = scan * 1000ULL;
+    simOptions.deviceNs[SimDeviceGamepad] = pad * 1000ULL;
+    simOptions.deviceNs[SimDeviceAccel]   = accel * 1000ULL;
+    simOptions.deviceNs[SimDeviceTouch]   = touch * 1000ULL;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static bool sim_parse_args(int argc_, char** argv_)
+{
+    int opt;
+    while ((opt = getopt(argc_, argv_, "t:d:p:r:s:c:S:F:w:e:R:Mx:h")) != -1) {
+        switch (opt) {
+            case 't': simOptions.tracePath = optarg; break;
+            case 'd': simOptions.durationNs = strtoull(optarg, NULL, 10) * 1000000ULL; break;
+            case 'p': {
+                simOptions.policy = -1;
+                for (int i = 0; i < SimPolicyCount; i++) {
+                    if (!strcmp(optarg, policyNames[i])) {
+                        simOptions.policy = i;
+                    }
+                }
+                if (!strcmp(optarg, "all")) {
+                    simOptions.policy = SimPolicyCount;
+                }
+                if (simOptions.policy < 0) {
+                    fprintf(stderr, "unknown policy '%s'\n", optarg);
+                    return false;
+                }
+            } break;
+            case 'r': simOptions.rateHz = (uint32_t)atoi(optarg); break;
+            case 's': simOptions.sampleNs = strtoull(optarg, NULL, 10) * 1000ULL; break;
+            case 'c': {
+                if (!sim_parse_costs(optarg)) {
+                    return false;
+                }
+            } break;
+            case 'S': simOptions.sendNs = strtoull(optarg, NULL, 10) * 1000ULL; break;
+            case 'F': simOptions.frameNs = strtoull(optarg, NULL, 10) * 1000ULL; break;
+            case 'w': simOptions.wakeNs = strtoull(optarg, NULL, 10) * 1000ULL; break;
+            case 'e': simOptions.errorRate = atof(optarg); break;
+            case 'R': simOptions.retryNs = strtoull(optarg, NULL, 10) * 1000000ULL; break;
+            case 'M': simOptions.motionStill = true; break;
+            case 'x': simOptions.seed = strtoull(optarg, NULL, 10); break;
+            default: sim_usage(argv_[0]); return false;
+        }
+    }
+
+    if ((optind != argc_) || (simOptions.rateHz == 0) || (simOptions.sampleNs == 0)) {
+        sim_usage(argv_[0]);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (!sim_parse_args(argc, argv)) {
+        return 1;
+    }
+
+    trace = (sim_trace_entry_t*)calloc(SIM_MAX_TRACE, sizeof(*trace));
+    if (!trace) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    if (simOptions.tracePath) {
+        if (!sim_trace_load(simOptions.tracePath)) {
+            free(trace);
+            return 1;
+        }
+    } else {
+        if (!simOptions.durationNs) {
+            simOptions.durationNs = SIM_DEFAULT_DURATION_MS * 1000000ULL;
+        }
+        sim_trace_generate();
+    }
+    if (!simOptions.durationNs) {
+        fprintf(stderr, "nothing to simulate\n");
+        free(trace);
+        return 1;
+    }
+
+    static sim_t sim;
+    sim_print_header();
+    for (int i = 0; i < SimPolicyCount; i++) {
+        if ((simOptions.policy == SimPolicyCount) || (simOptions.policy == i)) {
+            sim_run(&sim, (sim_policy_t)i);
+            sim_print_result(&sim);
+        }
+    }
+
+    free(trace);
+    return 0;
+}
@@ -0,0 +1,412 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+//---------------------------------------------------------------------------
+// netstick-state: reader for the device state exported by netstick-rx (-s),
+// and a reference for other local consumers (overlays, recorders, bots).  It
+// maps the state file read-only and takes snapshots of each device with
+// rx_state_read() -- no system calls, no waiting on the writer.  It prints
+// the current state of every device, watches for updates at a fixed rate, or
+// measures the snapshot rate a reader can sustain while netstick-rx writes.
+// The benchmark can also run against a writer thread of its own (-t) that
+// publishes a payload derived entirely from the update count, so that every
+// field of every snapshot can be checked.
+//---------------------------------------------------------------------------
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+#include "joystick.h"
+#include "rx_state.h"
+
+//---------------------------------------------------------------------------
+#define NS_DEFAULT_PATH "/dev/shm/netstick"
+#define NS_DEFAULT_RATE_HZ (60)
+#define NS_SELF_TEST_PATH "/dev/shm/netstick-self-test"
+
+//---------------------------------------------------------------------------
+typedef struct {
+    const char* path;     //!< State file to read
+    bool        watch;    //!< Print each device's state whenever it changes
+    uint32_t    rateHz;   //!< Snapshot rate while watching
+    uint32_t    benchSec; //!< Duration of the read benchmark (0 == no benchmark)
+    bool        selfTest; //!< Benchmark against a writer thread of our own, checking every field
+    bool        filter;   //!< Only show the device matching vid/pid/name
+    uint16_t    vid;      //!< Vendor ID of the device to show
+    uint16_t    pid;      //!< Product ID of the device to show
+    const char* name;     //!< Name of the device to show (NULL == any)
+} ns_options_t;
+
+typedef struct {
+    rx_state_region_t* region;    //!< Region written
+    atomic_bool        stop;      //!< Set to stop the writer
+    uint32_t           published; //!< Rounds of updates published (one per slot)
+} ns_writer_t;
+
+static ns_options_t          nsOptions = { .rateHz = NS_DEFAULT_RATE_HZ };
+static volatile sig_atomic_t exitRequested;
+
+//---------------------------------------------------------------------------
+static uint64_t ns_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+//---------------------------------------------------------------------------
+static void ns_sigint_handler(int signal_)
+{
+    (void)signal_;
+    exitRequested = 1;
+}
+
+//---------------------------------------------------------------------------
+static const char* ns_status_name(uint32_t status_)
+{
+    switch (status_) {
+        case RxStateAttached: return "attached";
+        case RxStateDetached: return "detached";
+        default: return "empty";
+    }
+}
+
+//---------------------------------------------------------------------------
+// Snapshot of a slot, if it holds the device(s) selected on the command line
+static bool ns_read_slot(const rx_state_region_t* region_, size_t index_, rx_state_device_t* state_)
+{
+    if (!rx_state_read(region_, index_, state_) || (state_->status == RxStateEmpty)) {
+        return false;
+    }
+    state_->name[sizeof(state_->name) - 1] = '\0';
+    if (nsOptions.filter) {
+        return (state_->vid == nsOptions.vid) && (state_->pid == nsOptions.pid)
+               && (!nsOptions.name || !strcmp(state_->name, nsOptions.name));
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static void ns_print_state(const rx_state_region_t* region_, size_t index_, const rx_state_device_t* state_)
+{
+    // Axis IDs come from the configuration, which belongs to the snapshot's generation
+    js_config_t config;
+    bool        haveConfig = rx_state_read_config(region_, index_, state_->generation, &config);
+    uint64_t    now        = ns_now_ns();
+    uint64_t    ageUs      = (state_->updateNs && (now > state_->updateNs)) ? ((now - state_->updateNs) / 1000ULL) : 0;
+
+    printf("[%zu] %s (vid=%04x pid=%04x) %s, %u updates, last %lluus ago\n    axes:",
+           index_,
+           state_->name,
+           state_->vid,
+           state_->pid,
+           ns_status_name(state_->status),
+           state_->updates,
+           (unsigned long long)ageUs);
+
+    for (int i = 0; i < (state_->absAxisCount + state_->relAxisCount) && (i < RX_STATE_MAX_AXES); i++) {
+        if (!haveConfig) {
+            printf(" %d", state_->axes[i]);
+        } else if (i < state_->absAxisCount) {
+            printf(" abs%02x=%d", config.absAxis[i], state_->axes[i]);
+        } else {
+            printf(" rel%02x=%d", config.relAxis[i - state_->absAxisCount], state_->axes[i]);
+        }
+    }
+
+    printf("\n    buttons: ");
+    for (int i = 0; i < state_->buttonCount; i++) { printf("%s", rx_state_button(state_, (size_t)i) ? "1" : "0"); }
+    printf("\n");
+}
+
+//---------------------------------------------------------------------------
+static void ns_print_all(const rx_state_region_t* region_)
+{
+    rx_state_device_t state;
+    bool              found = false;
+
+    for (size_t i = 0; i < RX_STATE_MAX_DEVICES; i++) {
+        if (ns_read_slot(region_, i, &state)) {
+            ns_print_state(region_, i, &state);
+            found = true;
+        }
+    }
+    if (!found) {
+        printf("no devices\n");
+    }
+}
+
+//---------------------------------------------------------------------------
+static void ns_watch(const rx_state_region_t* region_)
+{
+    uint32_t          lastGeneration[RX_STATE_MAX_DEVICES] = { 0 };
+    uint32_t          lastUpdates[RX_STATE_MAX_DEVICES]    = { 0 };
+    uint32_t          lastStatus[RX_STATE_MAX_DEVICES]     = { 0 };
+    rx_state_device_t state;
+    uint64_t          periodNs = 1000000000ULL / nsOptions.rateHz;
+    struct timespec   period   = { (time_t)(periodNs / 1000000000ULL), (long)(periodNs % 1000000000ULL) };
+
+    while (!exitRequested) {
+        for (size_t i = 0; i < RX_STATE_MAX_DEVICES; i++) {
+            if (!ns_read_slot(region_, i, &state)) {
+                continue;
+            }
+            if ((state.generation != lastGeneration[i]) || (state.updates != lastUpdates[i])
+                || (state.status != lastStatus[i])) {
+                lastGeneration[i] = state.generation;
+                lastUpdates[i]    = state.updates;
+                lastStatus[i]     = state.status;
+                ns_print_state(region_, i, &state);
+            }
+        }
+        nanosleep(&period, NULL);
+    }
+}
+
+//---------------------------------------------------------------------------
+// Self-test payload: every field is derived from the slot and the update
+// count, so a snapshot mixing two updates can be told apart from either
+static void ns_self_test_fill(rx_state_device_t* state_, size_t index_, uint32_t updates_)
+{
+    memset(state_, 0, sizeof(*state_));
+    state_->status     = RxStateAttached;
+    state_->generation = (uint32_t)index_ + 1;
+    state_->vid        = (uint16_t)updates_;
+    state_->pid        = (uint16_t)(updates_ >> 16);
+    snprintf(state_->name, sizeof(state_->name), "netstick-state self-test %zu/%u", index_, updates_);
+    state_->absAxisCount = (int32_t)(updates_ % RX_STATE_MAX_AXES);
+    state_->relAxisCount = (int32_t)(RX_STATE_MAX_AXES - state_->absAxisCount);
+    state_->buttonCount  = (int32_t)(updates_ % KEY_CNT);
+    state_->updates      = updates_;
+    state_->updateNs     = ((uint64_t)updates_ << 32) | updates_;
+    for (size_t i = 0; i < RX_STATE_MAX_AXES; i++) { state_->axes[i] = (int32_t)updates_; }
+    memset(state_->buttons, (int)(updates_ & 0xFF), sizeof(state_->buttons));
+}
+
+//---------------------------------------------------------------------------
+// Self-test writer: publish a new update to every slot, as fast as possible
+static void* ns_self_test_writer(void* arg_)
+{
+    ns_writer_t*      writer = (ns_writer_t*)arg_;
+    rx_state_device_t state;
+
+    while (!atomic_load_explicit(&writer->stop, memory_order_relaxed)) {
+        writer->published++;
+        for (size_t i = 0; i < RX_STATE_MAX_DEVICES; i++) {
+            ns_self_test_fill(&state, i, writer->published);
+            rx_state_publish(writer->region, i, &state);
+        }
+    }
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+// Read every slot back-to-back for the benchmark's duration.  Each
+// device's update count must never go backwards within a generation -- a
+// snapshot mixing two updates would eventually show up as one that does.
+// In the self-test, every field of every snapshot is also checked against
+// the payload for its update count.  Returns false if any check failed.
+static bool ns_bench(const rx_state_region_t* region_)
+{
+    uint32_t          lastGeneration[RX_STATE_MAX_DEVICES] = { 0 };
+    uint32_t          lastUpdates[RX_STATE_MAX_DEVICES]    = { 0 };
+    uint64_t          snapshots                            = 0;
+    uint64_t          failed                               = 0;
+    uint64_t          regressions                          = 0;
+    uint64_t          torn                                 = 0;
+    uint64_t          updatesSeen                          = 0;
+    rx_state_device_t state;
+    rx_state_device_t expected;
+
+    uint64_t start = ns_now_ns();
+    uint64_t end   = start + ((uint64_t)nsOptions.benchSec * 1000000000ULL);
+    uint64_t now   = start;
+
+    while ((now < end) && !exitRequested) {
+        for (int pass = 0; pass < 1024; pass++) {
+            for (size_t i = 0; i < RX_STATE_MAX_DEVICES; i++) {
+                if (!rx_state_read(region_, i, &state)) {
+                    failed++;
+                    continue;
+                }
+                snapshots++;
+                if (state.status == RxStateEmpty) {
+                    continue;
+                }
+                if (nsOptions.selfTest) {
+                    ns_self_test_fill(&expected, i, state.updates);
+                    if (memcmp(&state, &expected, sizeof(state)) != 0) {
+                        torn++;
+                    }
+                }
+                if (state.generation != lastGeneration[i]) {
+                    lastGeneration[i] = state.generation;
+                    lastUpdates[i]    = state.updates;
+                } else if (state.updates < lastUpdates[i]) {
+                    regressions++;
+                } else {
+                    updatesSeen += state.updates - lastUpdates[i];
+                    lastUpdates[i] = state.updates;
+                }
+            }
+        }
+        now = ns_now_ns();
+    }
+
+    double seconds = (double)(now - start) / 1e9;
+    printf("%llu snapshots in %.2fs (%.1fM/s, %.1fns each), %llu failed after %d attempts, "
+           "%llu device updates observed, %llu out of order\n",
+           (unsigned long long)snapshots,
+           seconds,
+           ((double)snapshots / seconds) / 1e6,
+           (snapshots != 0) ? (((double)(now - start)) / (double)snapshots) : 0.0,
+           (unsigned long long)failed,
+           RX_STATE_READ_ATTEMPTS,
+           (unsigned long long)updatesSeen,
+           (unsigned long long)regressions);
+    if (nsOptions.selfTest) {
+        printf("self-test: %llu snapshots whose fields didn't match their update count\n", (unsigned long long)torn);
+    }
+    return !regressions && !torn;
+}
+
+//---------------------------------------------------------------------------
+// Run the benchmark against a writer thread of our own, in a region of our
+// own -- mapped a second time for reading, as another process would
+static bool ns_self_test(void)
+{
+    ns_writer_t writer = { .region = rx_state_create(nsOptions.path) };
+    if (!writer.region) {
+        return false;
+    }
+    atomic_init(&writer.stop, false);
+
+    const rx_state_region_t* region = rx_state_open(nsOptions.path);
+    if (!region) {
+        printf("error opening %s\n", nsOptions.path);
+        rx_state_destroy(writer.region, nsOptions.path);
+        return false;
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, ns_self_test_writer, &writer);
+    bool ok = ns_bench(region);
+    atomic_store(&writer.stop, true);
+    pthread_join(thread, NULL);
+
+    printf("self-test: %u updates published to each of %d slots: %s\n",
+           writer.published,
+           RX_STATE_MAX_DEVICES,
+           ok ? "ok" : "FAILED");
+
+    rx_state_close(region);
+    rx_state_destroy(writer.region, nsOptions.path);
+    return ok;
+}
+
+//---------------------------------------------------------------------------
+static void ns_usage(const char* argv0_)
+{
+    printf("usage: %s [-f file] [-d vid:pid[:name]] [-w] [-r hz] [-b seconds [-t]]\n"
+           "  -f file             state file exported by netstick-rx -s (default %s; %s with -t)\n"
+           "  -d vid:pid[:name]   only show this device (hex IDs)\n"
+           "  -w                  print each device's state whenever it changes, until interrupted\n"
+           "  -r hz               snapshot rate while watching (default %d)\n"
+           "  -b seconds          read every slot back-to-back, and report the snapshot rate\n"
+           "  -t                  benchmark against a writer thread of our own (creating the file),\n"
+           "                      checking every field of every snapshot\n",
+           argv0_,
+           NS_DEFAULT_PATH,
+           NS_SELF_TEST_PATH,
+           NS_DEFAULT_RATE_HZ);
+}
+
+//---------------------------------------------------------------------------
+static bool ns_parse_device(char* arg_)
+{
+    char* end;
+    nsOptions.vid = (uint16_t)strtoul(arg_, &end, 16);
+    if (*end != ':') {
+        return false;
+    }
+    nsOptions.pid = (uint16_t)strtoul(end + 1, &end, 16);
+    if (*end == ':') {
+        nsOptions.name = end + 1;
+    } else if (*end) {
+        return false;
+    }
+    nsOptions.filter = true;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static bool ns_parse_args(int argc_, char** argv_)
+{
+    int opt;
+    while ((opt = getopt(argc_, argv_, "f:d:wr:b:th")) != -1) {
+        switch (opt) {
+            case 'f': nsOptions.path = optarg; break;
+            case 'd': {
+                if (!ns_parse_device(optarg)) {
+                    ns_usage(argv_[0]);
+                    return false;
+                }
+            } break;
+            case 'w': nsOptions.watch = true; break;
+            case 'r': nsOptions.rateHz = (uint32_t)atoi(optarg); break;
+            case 'b': nsOptions.benchSec = (uint32_t)atoi(optarg); break;
+            case 't': nsOptions.selfTest = true; break;
+            default: ns_usage(argv_[0]); return false;
+        }
+    }
+    if ((nsOptions.rateHz == 0) || (nsOptions.selfTest && !nsOptions.benchSec)) {
+        ns_usage(argv_[0]);
+        return false;
+    }
+    if (!nsOptions.path) {
+        nsOptions.path = nsOptions.selfTest ? NS_SELF_TEST_PATH : NS_DEFAULT_PATH;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (!ns_parse_args(argc, argv)) {
+        return 1;
+    }
+
+    signal(SIGINT, ns_sigint_handler);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (nsOptions.selfTest) {
+        return ns_self_test() ? 0 : 1;
+    }
+
+    const rx_state_region_t* region = rx_state_open(nsOptions.path);
+    if (!region) {
+        printf("no netstick-rx state at %s (is netstick-rx running with -s?)\n", nsOptions.path);
+        return 1;
+    }
+
+    bool ok = true;
+    if (nsOptions.benchSec) {
+        ok = ns_bench(region);
+    } else if (nsOptions.watch) {
+        ns_watch(region);
+    } else {
+        ns_print_all(region);
+    }
+
+    rx_state_close(region);
+    return ok ? 0 : 1;
+}
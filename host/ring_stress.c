@@ -0,0 +1,312 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+//---------------------------------------------------------------------------
+// ring-stress: runs the client's cross-thread handoffs between two real
+// threads, checking everything that comes out against what went in.
+//
+// The input ring (sampler -> sender): a producer pushes numbered snapshots
+// whose fields are all derived from the number, while a consumer that
+// stalls now and then pops them.  Every snapshot popped must be whole and
+// newer than the last; every snapshot pushed must be either popped or
+// counted as an overflow; and a snapshot asking for all devices to report
+// must never be lost, only merged into the next one popped.
+//
+// The statistics snapshots (snapshot.h): a writer publishes blocks whose
+// words all hold the same number, as fast as it can, while a reader checks
+// that every copy it takes is whole and never older than the last.
+//---------------------------------------------------------------------------
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "input_ring.h"
+#include "input_state.h"
+#include "snapshot.h"
+
+//---------------------------------------------------------------------------
+#define STRESS_DEFAULT_SNAPSHOTS (5000000)
+#define STRESS_DEFAULT_SECONDS (2)
+
+// Every STRESS_ALL_DEVICES_EVERY'th snapshot asks for all devices to report
+#define STRESS_ALL_DEVICES_EVERY (5)
+
+// The producer yields after every STRESS_YIELD_EVERY pushes, so the threads
+// interleave even on a single core; the consumer stalls after every
+// STRESS_STALL_EVERY pops (for STRESS_STALL_NS), to force overflows
+#define STRESS_YIELD_EVERY (16)
+#define STRESS_STALL_EVERY (4096)
+#define STRESS_STALL_NS (200000L)
+
+// Size of the blocks published through the snapshot latch (about the size of
+// loop_stats_t, which is the biggest one the client publishes)
+#define STRESS_BLOCK_WORDS (256)
+
+//---------------------------------------------------------------------------
+typedef struct {
+    input_ring_t ring;
+    uint32_t     count;   //!< Snapshots to push (numbered 1..count)
+    atomic_bool  done;    //!< The producer has published its last snapshot
+    uint32_t     popped;  //!< Snapshots popped by the consumer
+    uint32_t     torn;    //!< Snapshots popped whose fields didn't match their number
+    uint32_t     order;   //!< Snapshots popped out of order
+    uint32_t     lostAll; //!< Requests for all devices lost in an overflow
+} stress_ring_t;
+
+typedef struct {
+    uint32_t words[STRESS_BLOCK_WORDS];
+} stress_block_t;
+
+typedef struct {
+    snapshot_latch_t latch;
+    stress_block_t   copies[2];
+    atomic_bool      stop;      //!< Set to stop the writer
+    uint32_t         published; //!< Blocks published by the writer
+    uint64_t         reads;     //!< Copies taken by the reader
+    uint64_t         failed;    //!< Reads that gave up after SNAPSHOT_READ_ATTEMPTS attempts
+    uint64_t         torn;      //!< Copies whose words didn't all match
+    uint64_t         order;     //!< Copies older than the one before
+} stress_latch_t;
+
+//---------------------------------------------------------------------------
+// Fill every field of a snapshot from its number, so that a snapshot mixing
+// two pushes can be told apart from either
+static void stress_fill(input_state_t* state_, uint32_t n_)
+{
+    memset(state_, 0, sizeof(*state_));
+    state_->ticks      = ((uint64_t)n_ << 32) | n_;
+    state_->keys       = n_ * 2654435761U;
+    state_->circleX    = (int16_t)n_;
+    state_->circleY    = (int16_t)(n_ >> 16);
+    state_->cstickX    = (int16_t)~n_;
+    state_->cstickY    = (int16_t)(~n_ >> 16);
+    state_->touchX     = (uint16_t)(n_ * 3);
+    state_->touchY     = (uint16_t)(n_ * 5);
+    state_->accelX     = (int16_t)(n_ * 7);
+    state_->accelY     = (int16_t)(n_ * 11);
+    state_->accelZ     = (int16_t)(n_ * 13);
+    state_->gyroX      = (int16_t)(n_ * 17);
+    state_->gyroY      = (int16_t)(n_ * 19);
+    state_->gyroZ      = (int16_t)(n_ * 23);
+    state_->allDevices = ((n_ % STRESS_ALL_DEVICES_EVERY) == 0);
+    state_->idle       = (n_ & 1);
+}
+
+//---------------------------------------------------------------------------
+static void* stress_ring_producer(void* arg_)
+{
+    stress_ring_t* stress = (stress_ring_t*)arg_;
+    input_state_t  state;
+
+    for (uint32_t n = 1; n <= stress->count; n++) {
+        stress_fill(&state, n);
+        input_ring_push(&stress->ring, &state);
+        if ((n % STRESS_YIELD_EVERY) == 0) {
+            sched_yield();
+        }
+    }
+
+    // The last snapshot may still be held back as pending.  Pending snapshots
+    // go out with the next push that finds room, so keep pushing (new numbers)
+    // until one is published directly.
+    uint32_t n = stress->count + 1;
+    do {
+        stress_fill(&state, n++);
+        sched_yield();
+    } while (!input_ring_push(&stress->ring, &state));
+
+    atomic_store(&stress->done, true);
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+static void* stress_ring_consumer(void* arg_)
+{
+    stress_ring_t* stress = (stress_ring_t*)arg_;
+    uint32_t       last   = 0;
+    input_state_t  state;
+    input_state_t  expected;
+
+    while (true) {
+        // Read done before popping, so the final snapshot isn't missed
+        bool done = atomic_load(&stress->done);
+        if (!input_ring_pop(&stress->ring, &state)) {
+            if (done) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+
+        stress->popped++;
+        if ((stress->popped % STRESS_STALL_EVERY) == 0) {
+            struct timespec stall = { 0, STRESS_STALL_NS };
+            nanosleep(&stall, NULL);
+        }
+
+        uint32_t n = (uint32_t)state.ticks;
+        stress_fill(&expected, n);
+
+        // A request for all devices survives an overflow by being merged into
+        // the snapshot that replaced it
+        bool skippedAll = false;
+        for (uint32_t i = last + 1; i < n; i++) {
+            skippedAll = skippedAll || ((i % STRESS_ALL_DEVICES_EVERY) == 0);
+        }
+        if (skippedAll && !state.allDevices) {
+            stress->lostAll++;
+        }
+        expected.allDevices = state.allDevices;
+
+        if (memcmp(&state, &expected, sizeof(state)) != 0) {
+            stress->torn++;
+        }
+        if (n <= last) {
+            stress->order++;
+        }
+        last = n;
+    }
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+static bool stress_ring(uint32_t count_)
+{
+    stress_ring_t* stress = (stress_ring_t*)calloc(1, sizeof(stress_ring_t));
+    if (!stress) {
+        return false;
+    }
+    input_ring_init(&stress->ring);
+    atomic_init(&stress->done, false);
+    stress->count = count_;
+
+    pthread_t producer;
+    pthread_t consumer;
+    pthread_create(&consumer, NULL, stress_ring_consumer, stress);
+    pthread_create(&producer, NULL, stress_ring_producer, stress);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    // Everything pushed was either popped, or overwritten while pending
+    bool accounted = (stress->ring.pushed == (stress->popped + stress->ring.overflows));
+    bool ok        = accounted && !stress->torn && !stress->order && !stress->lostAll;
+
+    printf("input ring: %lu pushed, %lu popped, %lu overflowed -- %s; "
+           "%lu torn, %lu out of order, %lu all-device requests lost: %s\n",
+           (unsigned long)stress->ring.pushed,
+           (unsigned long)stress->popped,
+           (unsigned long)stress->ring.overflows,
+           accounted ? "all accounted for" : "SNAPSHOTS MISSING",
+           (unsigned long)stress->torn,
+           (unsigned long)stress->order,
+           (unsigned long)stress->lostAll,
+           ok ? "ok" : "FAILED");
+
+    free(stress);
+    return ok;
+}
+
+//---------------------------------------------------------------------------
+static void* stress_latch_writer(void* arg_)
+{
+    stress_latch_t* stress = (stress_latch_t*)arg_;
+    stress_block_t  block;
+
+    while (!atomic_load_explicit(&stress->stop, memory_order_relaxed)) {
+        stress->published++;
+        for (size_t i = 0; i < STRESS_BLOCK_WORDS; i++) { block.words[i] = stress->published; }
+        snapshot_publish(&stress->latch, stress->copies, &block, sizeof(block));
+    }
+    return NULL;
+}
+
+//---------------------------------------------------------------------------
+static bool stress_latch(uint32_t seconds_)
+{
+    stress_latch_t* stress = (stress_latch_t*)calloc(1, sizeof(stress_latch_t));
+    if (!stress) {
+        return false;
+    }
+
+    stress_block_t block = {};
+    snapshot_init(&stress->latch, stress->copies, &block, sizeof(block));
+    atomic_init(&stress->stop, false);
+
+    pthread_t writer;
+    pthread_create(&writer, NULL, stress_latch_writer, stress);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    time_t   end  = now.tv_sec + (time_t)seconds_;
+    uint32_t last = 0;
+
+    while (now.tv_sec < end) {
+        for (int pass = 0; pass < 1024; pass++) {
+            if (!snapshot_read(&stress->latch, stress->copies, &block, sizeof(block))) {
+                stress->failed++;
+                continue;
+            }
+            stress->reads++;
+
+            bool whole = true;
+            for (size_t i = 1; i < STRESS_BLOCK_WORDS; i++) { whole = whole && (block.words[i] == block.words[0]); }
+            if (!whole) {
+                stress->torn++;
+            }
+            if (block.words[0] < last) {
+                stress->order++;
+            }
+            last = block.words[0];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+
+    atomic_store(&stress->stop, true);
+    pthread_join(writer, NULL);
+
+    bool ok = !stress->torn && !stress->order;
+    printf("snapshot latch: %lu published, %llu read, %llu failed after %d attempts, "
+           "%llu torn, %llu out of order: %s\n",
+           (unsigned long)stress->published,
+           (unsigned long long)stress->reads,
+           (unsigned long long)stress->failed,
+           SNAPSHOT_READ_ATTEMPTS,
+           (unsigned long long)stress->torn,
+           (unsigned long long)stress->order,
+           ok ? "ok" : "FAILED");
+
+    free(stress);
+    return ok;
+}
+
+//---------------------------------------------------------------------------
+int main(int argc_, char** argv_)
+{
+    uint32_t count   = STRESS_DEFAULT_SNAPSHOTS;
+    uint32_t seconds = STRESS_DEFAULT_SECONDS;
+
+    int opt;
+    while ((opt = getopt(argc_, argv_, "n:t:h")) != -1) {
+        switch (opt) {
+            case 'n': count = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 't': seconds = (uint32_t)strtoul(optarg, NULL, 0); break;
+            default: {
+                printf("usage: %s [-n snapshots] [-t seconds]\n", argv_[0]);
+                return 1;
+            }
+        }
+    }
+
+    bool ok = stress_ring(count);
+    ok      = stress_latch(seconds) && ok;
+    return ok ? 0 : 1;
+}
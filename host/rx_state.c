@@ -0,0 +1,218 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "rx_state.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// The sequences are shared between processes, so they must be plain 32-bit
+// memory operations rather than calls into a lock
+_Static_assert((ATOMIC_INT_LOCK_FREE == 2) && (sizeof(atomic_uint_least32_t) == sizeof(uint32_t)),
+               "shared-memory sequences need lock-free 32-bit atomics");
+
+//---------------------------------------------------------------------------
+rx_state_region_t* rx_state_create(const char* path_)
+{
+    int fd = open(path_, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("error creating %s: %d (%s)\n", path_, errno, strerror(errno));
+        return NULL;
+    }
+
+    if (ftruncate(fd, (off_t)sizeof(rx_state_region_t)) < 0) {
+        printf("error sizing %s: %d (%s)\n", path_, errno, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, sizeof(rx_state_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("error mapping %s: %d (%s)\n", path_, errno, strerror(errno));
+        return NULL;
+    }
+
+    rx_state_region_t* region = (rx_state_region_t*)map;
+    memset(region, 0, sizeof(*region));
+    for (size_t i = 0; i < RX_STATE_MAX_DEVICES; i++) {
+        atomic_init(&region->slots[i].sequence, 0);
+        atomic_init(&region->slots[i].configSequence, 0);
+    }
+    region->version   = RX_STATE_VERSION;
+    region->slotCount = RX_STATE_MAX_DEVICES;
+    region->slotSize  = (uint32_t)sizeof(rx_state_slot_t);
+    region->writerPid = (uint64_t)getpid();
+
+    // Readers check the magic number last, so it goes in once everything else is
+    atomic_thread_fence(memory_order_release);
+    region->magic = RX_STATE_MAGIC;
+    return region;
+}
+
+//---------------------------------------------------------------------------
+void rx_state_publish(rx_state_region_t* region_, size_t index_, const rx_state_device_t* state_)
+{
+    rx_state_slot_t* slot     = &region_->slots[index_];
+    uint32_t         sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+
+    // Steer readers to copy 1 while copy 0 is written, then back to copy 0.
+    // Each bump is a release, so the copy readers are steered to is complete;
+    // the fence after it keeps the copy's writes from moving ahead of the bump,
+    // so a reader that saw any of them sees the bump when it re-checks.
+    atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&slot->copies[0], state_, sizeof(*state_));
+
+    atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&slot->copies[1], state_, sizeof(*state_));
+}
+
+//---------------------------------------------------------------------------
+void rx_state_publish_config(rx_state_region_t* region_,
+                             size_t             index_,
+                             uint32_t           generation_,
+                             const js_config_t* config_)
+{
+    rx_state_slot_t* slot     = &region_->slots[index_];
+    uint32_t         sequence = atomic_load_explicit(&slot->configSequence, memory_order_relaxed);
+
+    // Odd while the configuration is rewritten; as above, the fence keeps its
+    // writes behind the bump
+    atomic_store_explicit(&slot->configSequence, sequence + 1, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    slot->configGeneration = generation_;
+    memcpy(&slot->config, config_, sizeof(*config_));
+    atomic_store_explicit(&slot->configSequence, sequence + 2, memory_order_release);
+}
+
+//---------------------------------------------------------------------------
+void rx_state_destroy(rx_state_region_t* region_, const char* path_)
+{
+    rx_state_device_t empty = {};
+    for (size_t i = 0; i < RX_STATE_MAX_DEVICES; i++) { rx_state_publish(region_, i, &empty); }
+
+    munmap(region_, sizeof(*region_));
+    unlink(path_);
+}
+
+//---------------------------------------------------------------------------
+const rx_state_region_t* rx_state_open(const char* path_)
+{
+    int fd = open(path_, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat info;
+    if ((fstat(fd, &info) < 0) || ((size_t)info.st_size < sizeof(rx_state_region_t))) {
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, sizeof(rx_state_region_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    const rx_state_region_t* region = (const rx_state_region_t*)map;
+    bool                     valid  = (region->magic == RX_STATE_MAGIC);
+    atomic_thread_fence(memory_order_acquire);
+    valid = valid && (region->version == RX_STATE_VERSION) && (region->slotCount == RX_STATE_MAX_DEVICES)
+            && (region->slotSize == sizeof(rx_state_slot_t));
+    if (!valid) {
+        munmap(map, sizeof(rx_state_region_t));
+        return NULL;
+    }
+    return region;
+}
+
+//---------------------------------------------------------------------------
+void rx_state_close(const rx_state_region_t* region_)
+{
+    munmap((void*)region_, sizeof(*region_));
+}
+
+//---------------------------------------------------------------------------
+bool rx_state_read(const rx_state_region_t* region_, size_t index_, rx_state_device_t* state_)
+{
+    if (index_ >= RX_STATE_MAX_DEVICES) {
+        return false;
+    }
+
+    const rx_state_slot_t* slot = &region_->slots[index_];
+    for (int attempt = 0; attempt < RX_STATE_READ_ATTEMPTS; attempt++) {
+        uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        memcpy(state_, &slot->copies[sequence & 1], sizeof(*state_));
+
+        // The copy is only good if the writer didn't move on to (and start
+        // rewriting) the same copy in the meantime
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) == sequence) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------
+bool rx_state_read_config(const rx_state_region_t* region_,
+                          size_t                   index_,
+                          uint32_t                 generation_,
+                          js_config_t*             config_)
+{
+    if (index_ >= RX_STATE_MAX_DEVICES) {
+        return false;
+    }
+
+    const rx_state_slot_t* slot     = &region_->slots[index_];
+    uint32_t               sequence = atomic_load_explicit(&slot->configSequence, memory_order_acquire);
+    if (sequence & 1) {
+        return false;
+    }
+
+    uint32_t generation = slot->configGeneration;
+    memcpy(config_, &slot->config, sizeof(*config_));
+
+    atomic_thread_fence(memory_order_acquire);
+    return (atomic_load_explicit(&slot->configSequence, memory_order_relaxed) == sequence)
+           && (generation == generation_);
+}
+
+//---------------------------------------------------------------------------
+int rx_state_find(const rx_state_region_t* region_,
+                  uint16_t                 vid_,
+                  uint16_t                 pid_,
+                  const char*              name_,
+                  rx_state_device_t*       state_)
+{
+    rx_state_device_t state;
+    for (size_t i = 0; i < RX_STATE_MAX_DEVICES; i++) {
+        if (!rx_state_read(region_, i, &state) || (state.status == RxStateEmpty) || (state.vid != vid_)
+            || (state.pid != pid_)) {
+            continue;
+        }
+        state.name[sizeof(state.name) - 1] = '\0';
+        if (name_ && strcmp(state.name, name_)) {
+            continue;
+        }
+        if (state_) {
+            memcpy(state_, &state, sizeof(state));
+        }
+        return (int)i;
+    }
+    return -1;
+}
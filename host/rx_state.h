@@ -0,0 +1,208 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "joystick.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Shared-memory export of netstick-rx's device state.  netstick-rx (-s) maps
+// a file holding one slot per device and publishes each device's identity
+// and latest decoded state into it; local consumers map the same file
+// read-only and take snapshots without any system call.
+//
+// Each slot's state is guarded by a latched seqlock: the writer keeps two
+// copies and updates them one at a time, bumping the slot's sequence before
+// each, so that readers always copy the one not being written
+// (copies[sequence & 1]).  A reader only has to retry when the writer
+// finished a whole update during its copy, never to wait for one in progress,
+// and the writer never waits for readers at all.
+//---------------------------------------------------------------------------
+#define RX_STATE_MAGIC (0x5453534EU) // "NSST"
+#define RX_STATE_VERSION (1)
+
+#define RX_STATE_MAX_DEVICES (16)
+#define RX_STATE_MAX_AXES (ABS_CNT + REL_CNT)
+#define RX_STATE_BUTTON_BYTES ((KEY_CNT + 7) / 8)
+
+// Attempts made by rx_state_read() before giving up on a slot that the
+// writer kept updating
+#define RX_STATE_READ_ATTEMPTS (8)
+
+//---------------------------------------------------------------------------
+typedef enum {
+    RxStateEmpty = 0, //!< Slot holds no device
+    RxStateAttached,  //!< Device is connected and sending input
+    RxStateDetached,  //!< Device lost its connection, and is held for session resumption
+} rx_state_status_t;
+
+//---------------------------------------------------------------------------
+// Snapshot of a device: its identity and the state decoded from its latest
+// report and button message
+typedef struct {
+    uint32_t status;                         //!< Slot status (rx_state_status_t)
+    uint32_t generation;                     //!< Changes whenever the slot is given to a new device
+    uint16_t vid;                            //!< USB vendor ID, from the device's configuration
+    uint16_t pid;                            //!< USB product ID, from the device's configuration
+    char     name[256];                      //!< Device name, from the device's configuration
+    int32_t  absAxisCount;                   //!< Absolute axes held in axes[]
+    int32_t  relAxisCount;                   //!< Relative axes held in axes[], after the absolute ones
+    int32_t  buttonCount;                    //!< Buttons held in buttons[]
+    uint32_t updates;                        //!< Reports and button messages applied to the state
+    uint64_t updateNs;                       //!< Time of the last update (CLOCK_MONOTONIC, ns)
+    int32_t  axes[RX_STATE_MAX_AXES];        //!< Axis values, in registration order (relative axes: last delta)
+    uint8_t  buttons[RX_STATE_BUTTON_BYTES]; //!< Button state, one bit per button in registration order (LSB first)
+} rx_state_device_t;
+
+//---------------------------------------------------------------------------
+typedef struct {
+    atomic_uint_least32_t sequence;  //!< Latch sequence -- readers use copies[sequence & 1]
+    uint32_t              reserved;
+    rx_state_device_t     copies[2]; //!< Two copies of the device's state, written in turn
+
+    // The full configuration (axis and button IDs, ranges) changes only with
+    // the device, so it is kept once, under a plain seqlock (odd == writing)
+    atomic_uint_least32_t configSequence;
+    uint32_t              configGeneration; //!< Generation of the device the configuration belongs to
+    js_config_t           config;           //!< Configuration of the device
+} rx_state_slot_t;
+
+//---------------------------------------------------------------------------
+typedef struct {
+    uint32_t magic;     //!< RX_STATE_MAGIC, once the region is initialized
+    uint32_t version;   //!< RX_STATE_VERSION
+    uint32_t slotCount; //!< Number of slots
+    uint32_t slotSize;  //!< sizeof(rx_state_slot_t), to catch mismatched builds
+    uint64_t writerPid; //!< Process ID of the writer
+
+    rx_state_slot_t slots[RX_STATE_MAX_DEVICES];
+} rx_state_region_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief rx_state_create Create (or replace) the state file and map it for
+ * writing.  All slots start empty.
+ * @param path_ file to create (e.g. under /dev/shm)
+ * @return mapped region, or NULL on error
+ */
+rx_state_region_t* rx_state_create(const char* path_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief rx_state_publish Publish a device's state into a slot (writer only).
+ * Never blocks, regardless of readers.
+ * @param region_ region to publish into
+ * @param index_ slot index
+ * @param state_ new state of the slot
+ */
+void rx_state_publish(rx_state_region_t* region_, size_t index_, const rx_state_device_t* state_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief rx_state_publish_config Publish the configuration of the device
+ * that now holds a slot (writer only).  Call before publishing the device's
+ * first state, so readers seeing the new generation can find its
+ * configuration.
+ * @param region_ region to publish into
+ * @param index_ slot index
+ * @param generation_ generation of the device
+ * @param config_ device configuration
+ */
+void rx_state_publish_config(rx_state_region_t* region_,
+                             size_t             index_,
+                             uint32_t           generation_,
+                             const js_config_t* config_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief rx_state_destroy Mark every slot empty, unmap the region and remove
+ * the state file.  Readers still attached see empty slots.
+ * @param region_ region created by rx_state_create()
+ * @param path_ path the region was created at
+ */
+void rx_state_destroy(rx_state_region_t* region_, const char* path_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief rx_state_open Map an existing state file for reading
+ * @param path_ state file written by netstick-rx
+ * @return mapped region, or NULL if the file is missing, or not a state file
+ * of this version
+ */
+const rx_state_region_t* rx_state_open(const char* path_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief rx_state_close Unmap a region opened with rx_state_open()
+ * @param region_ region to unmap
+ */
+void rx_state_close(const rx_state_region_t* region_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief rx_state_read Take a consistent snapshot of a slot.  Makes no system
+ * calls, and never waits for the writer.
+ * @param region_ mapped region
+ * @param index_ slot index
+ * @param state_ [out] snapshot of the slot
+ * @return true on success, false if the slot was rewritten during each of
+ * RX_STATE_READ_ATTEMPTS attempts (state_ is then undefined)
+ */
+bool rx_state_read(const rx_state_region_t* region_, size_t index_, rx_state_device_t* state_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief rx_state_read_config Read the configuration of the device holding a
+ * slot
+ * @param region_ mapped region
+ * @param index_ slot index
+ * @param generation_ generation of the device, from its snapshot
+ * @param config_ [out] configuration of the device
+ * @return true on success, false if the configuration belongs to another
+ * generation, or is being rewritten
+ */
+bool rx_state_read_config(const rx_state_region_t* region_,
+                          size_t                   index_,
+                          uint32_t                 generation_,
+                          js_config_t*             config_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief rx_state_find Find the slot of a device by its identity
+ * @param region_ mapped region
+ * @param vid_ USB vendor ID of the device
+ * @param pid_ USB product ID of the device
+ * @param name_ name of the device (NULL == any)
+ * @param state_ [out] snapshot of the device's slot, if found (may be NULL)
+ * @return slot index, or -1 if no attached or detached device matches
+ */
+int rx_state_find(const rx_state_region_t* region_,
+                  uint16_t                 vid_,
+                  uint16_t                 pid_,
+                  const char*              name_,
+                  rx_state_device_t*       state_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief rx_state_button Return the state of a button in a snapshot
+ * @param state_ snapshot
+ * @param button_ index of the button, in registration order
+ * @return true if the button is pressed
+ */
+static inline bool rx_state_button(const rx_state_device_t* state_, size_t button_)
+{
+    return (button_ < (size_t)KEY_CNT) && ((state_->buttons[button_ / 8] >> (button_ % 8)) & 1);
+}
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,73 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "axis_curve.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//---------------------------------------------------------------------------
+// Accepted range of the sensitivity exponent
+#define AXIS_CURVE_EXPONENT_MIN (0.1f)
+#define AXIS_CURVE_EXPONENT_MAX (10.0f)
+
+//---------------------------------------------------------------------------
+void axis_curve_params_init(axis_curve_params_t* params_)
+{
+    params_->deadzone     = 0;
+    params_->antiDeadzone = 0;
+    params_->exponent     = 1.0f;
+    params_->saturation   = 100;
+}
+
+//---------------------------------------------------------------------------
+bool axis_curve_params_parse(axis_curve_params_t* params_, const char* value_)
+{
+    axis_curve_params_t params;
+    if (sscanf(value_, "%d,%d,%f,%d", &params.deadzone, &params.antiDeadzone, &params.exponent, &params.saturation)
+        != 4) {
+        return false;
+    }
+
+    if ((params.deadzone < 0) || (params.saturation > 100) || (params.deadzone >= params.saturation)) {
+        return false;
+    }
+    if ((params.antiDeadzone < 0) || (params.antiDeadzone >= 100)) {
+        return false;
+    }
+    if (!(params.exponent >= AXIS_CURVE_EXPONENT_MIN) || !(params.exponent <= AXIS_CURVE_EXPONENT_MAX)) {
+        return false;
+    }
+
+    *params_ = params;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void axis_curve_build(axis_curve_t* curve_, const axis_curve_params_t* params_, bool invert_)
+{
+    double deadzone   = (double)params_->deadzone / 100.0;
+    double anti       = (double)params_->antiDeadzone / 100.0;
+    double saturation = (double)params_->saturation / 100.0;
+
+    for (int32_t raw = -AXIS_CURVE_LIMIT; raw <= AXIS_CURVE_LIMIT; raw++) {
+        // Shape the magnitude of the deflection; the sign is kept
+        double magnitude = (double)((raw < 0) ? -raw : raw) / (double)AXIS_CURVE_LIMIT;
+        double out       = 0.0;
+
+        if ((raw != 0) && (magnitude > deadzone)) {
+            double t = (magnitude - deadzone) / (saturation - deadzone);
+            t        = (t > 1.0) ? 1.0 : t;
+            out      = anti + ((1.0 - anti) * pow(t, (double)params_->exponent));
+        }
+
+        int32_t value = (int32_t)lround(out * (double)AXIS_CURVE_LIMIT);
+        if ((raw < 0) != invert_) {
+            value = -value;
+        }
+        curve_->table[raw + AXIS_CURVE_LIMIT] = (int16_t)value;
+    }
+}
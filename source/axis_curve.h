@@ -0,0 +1,94 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Largest deflection reported by the circle pad and c-stick, in either direction
+#define AXIS_CURVE_LIMIT (156)
+#define AXIS_CURVE_SIZE ((2 * AXIS_CURVE_LIMIT) + 1)
+
+//---------------------------------------------------------------------------
+// Analog stick axes with a configurable response curve
+typedef enum {
+    AxisCirclePadX = 0,
+    AxisCirclePadY,
+    AxisCStickX,
+    AxisCStickY,
+    AxisCount
+} axis_id_t;
+
+//---------------------------------------------------------------------------
+// Response curve of an axis, as set in the config file.  Percentages are of
+// full deflection.  The defaults (0, 0, 1.0, 100) pass values through as-is.
+typedef struct {
+    int   deadzone;     //!< Deflection around the center reported as zero (%)
+    int   antiDeadzone; //!< Output just outside the deadzone, to skip the consumer's own deadzone (%)
+    float exponent;     //!< Sensitivity exponent: > 1 for finer control near the center, < 1 for coarser
+    int   saturation;   //!< Deflection at and beyond which full output is reported (%)
+} axis_curve_params_t;
+
+//---------------------------------------------------------------------------
+// Response curve compiled into a lookup table, indexed by the raw value
+// (offset by AXIS_CURVE_LIMIT), so shaping a sample costs a single load.
+typedef struct {
+    int16_t table[AXIS_CURVE_SIZE];
+} axis_curve_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief axis_curve_params_init Set a response curve to the identity (no
+ * shaping)
+ * @param params_ object to initialize
+ */
+void axis_curve_params_init(axis_curve_params_t* params_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief axis_curve_params_parse Parse a response curve from a config value
+ * of the form "deadzone,anti_deadzone,exponent,saturation" (e.g. "8,0,1.5,95").
+ * @param params_ [out] parsed curve (unchanged on error)
+ * @param value_ text to parse
+ * @return true on success, false if the value is malformed or out of range
+ */
+bool axis_curve_params_parse(axis_curve_params_t* params_, const char* value_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief axis_curve_build Compile a response curve into a lookup table.  All
+ * floating-point work happens here, once, at load time.
+ * @param curve_ [out] table to build
+ * @param params_ response curve to compile
+ * @param invert_ negate the output (the axis' invert option)
+ */
+void axis_curve_build(axis_curve_t* curve_, const axis_curve_params_t* params_, bool invert_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief axis_curve_apply Shape a raw axis value.  Values beyond the native
+ * range are clamped to it.
+ * @param curve_ compiled response curve
+ * @param value_ raw axis value
+ * @return shaped axis value, in the range +/- AXIS_CURVE_LIMIT
+ */
+static inline int32_t axis_curve_apply(const axis_curve_t* curve_, int32_t value_)
+{
+    if (value_ > AXIS_CURVE_LIMIT) {
+        value_ = AXIS_CURVE_LIMIT;
+    } else if (value_ < -AXIS_CURVE_LIMIT) {
+        value_ = -AXIS_CURVE_LIMIT;
+    }
+    return curve_->table[value_ + AXIS_CURVE_LIMIT];
+}
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,174 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "congestion.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hid_device.h"
+#include "logger.h"
+#include "net_util.h"
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+// Length of each measurement window
+#define CONGESTION_WINDOW_US (250000ULL)
+
+// Clear windows in a row before the level is lowered by one step
+#define CONGESTION_RECOVERY_WINDOWS (8)
+
+// Unacknowledged bytes, summed over all connections, above which the link is
+// considered congested, and at or below which it is considered clear.
+#define CONGESTION_QUEUE_HIGH (1536)
+#define CONGESTION_QUEUE_LOW (256)
+
+// Round-trip time growth over the lowest one seen, above which the link is
+// considered congested, and at or below which it is considered clear.
+#define CONGESTION_RTT_RISE_HIGH_US (40000)
+#define CONGESTION_RTT_RISE_LOW_US (10000)
+
+//---------------------------------------------------------------------------
+void congestion_init(congestion_t* congestion_)
+{
+    memset(congestion_, 0, sizeof(*congestion_));
+    congestion_->level       = CongestionLevelClear;
+    congestion_->windowTicks = time_util_ticks();
+    congestion_->levelTicks  = congestion_->windowTicks;
+}
+
+//---------------------------------------------------------------------------
+static void congestion_set_level(congestion_t*             congestion_,
+                                 congestion_level_t        level_,
+                                 struct hid_device* const* devices_,
+                                 size_t                    deviceCount_,
+                                 uint64_t                  now_)
+{
+    congestion_->levelTimeTicks[congestion_->level] += now_ - congestion_->levelTicks;
+    congestion_->levelTicks = now_;
+    congestion_->clearRun   = 0;
+
+    if (level_ > congestion_->level) {
+        congestion_->raised++;
+    } else {
+        congestion_->lowered++;
+    }
+    congestion_->level = level_;
+
+    for (size_t i = 0; i < deviceCount_; i++) {
+        hid_device_set_shedding(devices_[i], level_ >= devices_[i]->shed.level);
+    }
+}
+
+//---------------------------------------------------------------------------
+void congestion_update(congestion_t* congestion_, struct hid_device* const* devices_, size_t deviceCount_)
+{
+    uint64_t now = time_util_ticks();
+    if ((now - congestion_->windowTicks) < time_util_us_to_ticks(CONGESTION_WINDOW_US)) {
+        return;
+    }
+    congestion_->windowTicks = now;
+
+    uint32_t sent         = 0;
+    uint32_t backpressure = 0;
+    uint32_t queuedBytes  = 0;
+    uint32_t rttUs        = 0;
+
+    for (size_t i = 0; i < deviceCount_; i++) {
+        const hid_device_t* device = devices_[i];
+
+        sent += device->stats.messagesSent;
+        backpressure += device->stats.sendBackpressure;
+
+        // A frame held back for a full socket buffer is queued data too, and
+        // the only sign of a queue where the socket reports none (e.g. the 3DS)
+        queuedBytes += (uint32_t)device->txBacklog.pendingLen;
+
+        uint32_t queued;
+        uint32_t rtt;
+        if ((device->sockFd >= 0) && net_util_send_queue(device->sockFd, &queued, &rtt)) {
+            queuedBytes += queued;
+            rttUs = (rtt > rttUs) ? rtt : rttUs;
+        }
+    }
+
+    uint32_t windowSent         = sent - congestion_->sent;
+    uint32_t windowBackpressure = backpressure - congestion_->backpressure;
+    congestion_->sent           = sent;
+    congestion_->backpressure   = backpressure;
+
+    uint32_t rttRiseUs = 0;
+    if (rttUs != 0) {
+        if ((congestion_->rttBaseUs == 0) || (rttUs < congestion_->rttBaseUs)) {
+            congestion_->rttBaseUs = rttUs;
+        }
+        rttRiseUs = rttUs - congestion_->rttBaseUs;
+    }
+
+    bool congested = (windowBackpressure > 0) || (queuedBytes > CONGESTION_QUEUE_HIGH)
+                     || (rttRiseUs > CONGESTION_RTT_RISE_HIGH_US);
+
+    // A window in which nothing was sent (e.g. while reconnecting) says nothing
+    // about the link, so it neither raises nor lowers the level.
+    bool clear = (windowSent > 0) && (windowBackpressure == 0) && (queuedBytes <= CONGESTION_QUEUE_LOW)
+                 && (rttRiseUs <= CONGESTION_RTT_RISE_LOW_US);
+
+    if (congested) {
+        congestion_->clearRun = 0;
+        if (congestion_->level < (CongestionLevelCount - 1)) {
+            congestion_level_t level = (congestion_level_t)(congestion_->level + 1);
+            LOG_WARNING("congestion: %s -> %s (eagain %lu, queue %luB, rtt %luus)",
+                        congestion_level_name(congestion_->level),
+                        congestion_level_name(level),
+                        (unsigned long)windowBackpressure,
+                        (unsigned long)queuedBytes,
+                        (unsigned long)rttUs);
+            congestion_set_level(congestion_, level, devices_, deviceCount_, now);
+        }
+    } else if (clear) {
+        congestion_->clearRun++;
+        if ((congestion_->level > CongestionLevelClear) && (congestion_->clearRun >= CONGESTION_RECOVERY_WINDOWS)) {
+            congestion_level_t level = (congestion_level_t)(congestion_->level - 1);
+            LOG_INFO("congestion: %s -> %s", congestion_level_name(congestion_->level), congestion_level_name(level));
+            congestion_set_level(congestion_, level, devices_, deviceCount_, now);
+        }
+    } else {
+        congestion_->clearRun = 0;
+    }
+}
+
+//---------------------------------------------------------------------------
+const char* congestion_level_name(congestion_level_t level_)
+{
+    static const char* const names[CongestionLevelCount] = {
+        [CongestionLevelClear]  = "clear",
+        [CongestionLevelMotion] = "motion",
+        [CongestionLevelTouch]  = "touch",
+        [CongestionLevelAnalog] = "analog",
+    };
+
+    if (level_ >= CongestionLevelCount) {
+        return "unknown";
+    }
+    return names[level_];
+}
+
+//---------------------------------------------------------------------------
+void congestion_print(const congestion_t* congestion_)
+{
+    uint64_t levelTimeTicks[CongestionLevelCount];
+    memcpy(levelTimeTicks, congestion_->levelTimeTicks, sizeof(levelTimeTicks));
+    levelTimeTicks[congestion_->level] += time_util_ticks() - congestion_->levelTicks;
+
+    LOG_SUMMARY("congestion: %lu raised, %lu lowered, level %s",
+                (unsigned long)congestion_->raised,
+                (unsigned long)congestion_->lowered,
+                congestion_level_name(congestion_->level));
+    for (int i = 0; i < CongestionLevelCount; i++) {
+        LOG_SUMMARY("  %-8s %llu ms",
+                    congestion_level_name((congestion_level_t)i),
+                    (unsigned long long)(time_util_ticks_to_us(levelTimeTicks[i]) / 1000ULL));
+    }
+}
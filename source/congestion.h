@@ -0,0 +1,95 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+struct hid_device;
+
+//---------------------------------------------------------------------------
+// Congestion levels, in the order fidelity is given up as the link saturates.
+// Each level includes the degradation of the ones before it.  Button changes
+// are never held back at any level.
+typedef enum {
+    CongestionLevelClear = 0, //!< Every device reports at full rate and precision
+    CongestionLevelMotion,    //!< Motion-sensor (accel/gyro) reports are sent at a reduced rate
+    CongestionLevelTouch,     //!< ...as are touch position reports
+    CongestionLevelAnalog,    //!< ...and small stick movements are ignored (reduced analog precision)
+    CongestionLevelCount
+} congestion_level_t;
+
+//---------------------------------------------------------------------------
+// How a device's axis updates are degraded once the link is congested
+typedef struct {
+    congestion_level_t level;      //!< Lowest congestion level at which the policy applies
+    uint32_t           intervalUs; //!< Shortest time between reports sent for axis changes alone (0 == unchanged)
+    uint32_t           steps;      //!< Absolute-axis resolution, in steps across the axis' range (0 == unchanged)
+} congestion_shed_t;
+
+//---------------------------------------------------------------------------
+// Client-side congestion controller.  Once per measurement window, the
+// send-path counters of every connection (EAGAIN failures) and, where the
+// platform reports them, their unacknowledged send-queue depth and round-trip
+// times, are checked for signs of congestion.  A congested window raises the
+// level by one step; the level is lowered one step at a time after a run of
+// clear windows.
+typedef struct {
+    congestion_level_t level;        //!< Current congestion level
+    uint64_t           windowTicks;  //!< Start of the current measurement window
+    uint64_t           levelTicks;   //!< Time the current level was entered
+    uint32_t           clearRun;     //!< Consecutive windows without congestion
+    uint32_t           sent;         //!< Messages sent on all connections, at the start of the window
+    uint32_t           backpressure; //!< EAGAIN failures on all connections, at the start of the window
+    uint32_t           rttBaseUs;    //!< Lowest round-trip time reported on any connection (0 == unknown)
+
+    uint32_t raised;                               //!< Number of times the level was raised
+    uint32_t lowered;                              //!< Number of times the level was lowered
+    uint64_t levelTimeTicks[CongestionLevelCount]; //!< Time spent at each level (excluding the current stay)
+} congestion_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief congestion_init Initialize a congestion controller, starting from
+ * CongestionLevelClear.
+ * @param congestion_ object to initialize
+ */
+void congestion_init(congestion_t* congestion_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief congestion_update Measure the devices' connections and, at the end of
+ * each measurement window, adjust the congestion level and apply it to every
+ * device (see hid_device_set_shedding()).  Level changes are logged.  Calls
+ * made before the window ends return immediately.
+ * @param congestion_ controller to update
+ * @param devices_ devices whose connections share the link
+ * @param deviceCount_ number of devices
+ */
+void congestion_update(congestion_t* congestion_, struct hid_device* const* devices_, size_t deviceCount_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief congestion_level_name Get the name of a congestion level, for logging
+ * @param level_ level to name
+ * @return name of the level
+ */
+const char* congestion_level_name(congestion_level_t level_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief congestion_print Print the controller's level transition counts and
+ * the time spent at each level.
+ * @param congestion_ controller to report on
+ */
+void congestion_print(const congestion_t* congestion_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
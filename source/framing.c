@@ -0,0 +1,382 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "framing.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slip.h"
+
+//---------------------------------------------------------------------------
+// COBS blocks hold at most 254 data bytes (code value 0xFF)
+#define COBS_MAX_CODE ((uint8_t)(0xFF))
+#define COBS_DELIMITER ((uint8_t)(0x00))
+
+//---------------------------------------------------------------------------
+static const char* framingNames[FramingCount] = {
+    [FramingSlip]   = "slip",
+    [FramingLength] = "length",
+    [FramingCobs]   = "cobs",
+};
+
+//---------------------------------------------------------------------------
+const char* framing_type_name(framing_type_t type_)
+{
+    if (type_ >= FramingCount) {
+        return "unknown";
+    }
+    return framingNames[type_];
+}
+
+//---------------------------------------------------------------------------
+bool framing_type_from_name(const char* name_, framing_type_t* type_)
+{
+    for (int i = 0; i < FramingCount; i++) {
+        if (0 == strcmp(framingNames[i], name_)) {
+            *type_ = (framing_type_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------
+size_t framing_max_encoded_size(framing_type_t type_, size_t rawSize_)
+{
+    switch (type_) {
+        case FramingSlip: return (rawSize_ * 2) + 2;
+        case FramingLength: return rawSize_ + FRAMING_LENGTH_PREFIX_SIZE;
+        case FramingCobs: return rawSize_ + (rawSize_ / 254) + 2;
+        default: return 0;
+    }
+}
+
+//---------------------------------------------------------------------------
+static void framing_encode_put(framing_encoder_t* encoder_, uint8_t b_)
+{
+    if (encoder_->index >= encoder_->size) {
+        encoder_->overflow = true;
+        return;
+    }
+    encoder_->encoded[encoder_->index++] = b_;
+}
+
+//---------------------------------------------------------------------------
+static void framing_encode_cobs_byte(framing_encoder_t* encoder_, uint8_t b_)
+{
+    if (b_ != COBS_DELIMITER) {
+        framing_encode_put(encoder_, b_);
+        encoder_->code++;
+    }
+
+    // Close the current block on a zero, or when it is full
+    if ((b_ == COBS_DELIMITER) || (encoder_->code == COBS_MAX_CODE)) {
+        if (encoder_->codeIndex < encoder_->size) {
+            encoder_->encoded[encoder_->codeIndex] = encoder_->code;
+        }
+        encoder_->codeIndex = encoder_->index;
+        encoder_->code      = 1;
+        framing_encode_put(encoder_, 0);
+    }
+}
+
+//---------------------------------------------------------------------------
+void framing_encode_begin(framing_encoder_t* encoder_, framing_type_t type_, uint8_t* buffer_, size_t bufferSize_)
+{
+    encoder_->type     = type_;
+    encoder_->encoded  = buffer_;
+    encoder_->size     = bufferSize_;
+    encoder_->index    = 0;
+    encoder_->overflow = false;
+
+    switch (type_) {
+        case FramingSlip: {
+            framing_encode_put(encoder_, SLIP_END);
+        } break;
+        case FramingLength: {
+            // Prefix is filled in once the frame size is known
+            framing_encode_put(encoder_, 0);
+            framing_encode_put(encoder_, 0);
+        } break;
+        case FramingCobs: {
+            encoder_->codeIndex = 0;
+            encoder_->code      = 1;
+            framing_encode_put(encoder_, 0);
+        } break;
+        default: {
+            encoder_->overflow = true;
+        } break;
+    }
+}
+
+//---------------------------------------------------------------------------
+void framing_encode_data(framing_encoder_t* encoder_, const void* data_, size_t dataLen_)
+{
+    const uint8_t* data = (const uint8_t*)data_;
+
+    switch (encoder_->type) {
+        case FramingSlip: {
+            slip_encode_message_t slip = { encoder_->encoded, encoder_->size, encoder_->index };
+            for (size_t i = 0; i < dataLen_; i++) {
+                if (slip_encode_byte(&slip, data[i]) != SlipEncodeOk) {
+                    encoder_->overflow = true;
+                    break;
+                }
+            }
+            encoder_->index = slip.index;
+        } break;
+        case FramingLength: {
+            if ((encoder_->index + dataLen_) > encoder_->size) {
+                encoder_->overflow = true;
+                break;
+            }
+            memcpy(&encoder_->encoded[encoder_->index], data, dataLen_);
+            encoder_->index += dataLen_;
+        } break;
+        case FramingCobs: {
+            for (size_t i = 0; i < dataLen_; i++) { framing_encode_cobs_byte(encoder_, data[i]); }
+        } break;
+        default: break;
+    }
+}
+
+//---------------------------------------------------------------------------
+size_t framing_encode_finish(framing_encoder_t* encoder_)
+{
+    switch (encoder_->type) {
+        case FramingSlip: {
+            framing_encode_put(encoder_, SLIP_END);
+        } break;
+        case FramingLength: {
+            size_t frameSize = encoder_->index - FRAMING_LENGTH_PREFIX_SIZE;
+            if (frameSize > UINT16_MAX) {
+                encoder_->overflow = true;
+                break;
+            }
+            encoder_->encoded[0] = (uint8_t)(frameSize & 0xFF);
+            encoder_->encoded[1] = (uint8_t)(frameSize >> 8);
+        } break;
+        case FramingCobs: {
+            if (encoder_->codeIndex < encoder_->size) {
+                encoder_->encoded[encoder_->codeIndex] = encoder_->code;
+            }
+            framing_encode_put(encoder_, COBS_DELIMITER);
+        } break;
+        default: break;
+    }
+
+    if (encoder_->overflow) {
+        return 0;
+    }
+    return encoder_->index;
+}
+
+//---------------------------------------------------------------------------
+framing_decoder_t* framing_decoder_create(framing_type_t type_, size_t rawSize_)
+{
+    framing_decoder_t* decoder = (framing_decoder_t*)calloc(1, sizeof(framing_decoder_t));
+    if (!decoder) {
+        return NULL;
+    }
+
+    decoder->raw = (uint8_t*)calloc(1, rawSize_);
+    if (!decoder->raw) {
+        free(decoder);
+        return NULL;
+    }
+    decoder->rawSize = rawSize_;
+
+    framing_decoder_reset(decoder, type_);
+    return decoder;
+}
+
+//---------------------------------------------------------------------------
+void framing_decoder_destroy(framing_decoder_t* decoder_)
+{
+    free(decoder_->raw);
+    free(decoder_);
+}
+
+//---------------------------------------------------------------------------
+void framing_decoder_reset(framing_decoder_t* decoder_, framing_type_t type_)
+{
+    decoder_->type  = type_;
+    decoder_->index = 0;
+
+    decoder_->slip.raw      = decoder_->raw;
+    decoder_->slip.rawSize  = decoder_->rawSize;
+    decoder_->slip.inEscape = false;
+    slip_decode_begin(&decoder_->slip);
+
+    decoder_->headerIndex = 0;
+    decoder_->expected    = 0;
+
+    decoder_->code      = 0;
+    decoder_->remaining = 0;
+}
+
+//---------------------------------------------------------------------------
+static framing_decode_return_t framing_decode_slip(framing_decoder_t* decoder_, uint8_t b_)
+{
+    slip_decode_return_t rc = slip_decode_byte(&decoder_->slip, b_);
+    decoder_->index         = decoder_->slip.index;
+
+    switch (rc) {
+        case SlipDecodeOk: return FramingDecodeOk;
+        case SlipDecodeEndOfFrame: {
+            slip_decode_begin(&decoder_->slip);
+            return FramingDecodeEndOfFrame;
+        }
+        case SlipDecodeErrorTooBig: {
+            decoder_->slip.inEscape = false;
+            slip_decode_begin(&decoder_->slip);
+            return FramingDecodeErrorTooBig;
+        }
+        default: {
+            decoder_->slip.inEscape = false;
+            slip_decode_begin(&decoder_->slip);
+            return FramingDecodeErrorInvalidFrame;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+static framing_decode_return_t framing_decode_length(framing_decoder_t* decoder_, uint8_t b_)
+{
+    if (decoder_->headerIndex < FRAMING_LENGTH_PREFIX_SIZE) {
+        decoder_->header[decoder_->headerIndex++] = b_;
+        if (decoder_->headerIndex < FRAMING_LENGTH_PREFIX_SIZE) {
+            return FramingDecodeOk;
+        }
+
+        decoder_->expected = (size_t)decoder_->header[0] | ((size_t)decoder_->header[1] << 8);
+        decoder_->index    = 0;
+        if (decoder_->expected > decoder_->rawSize) {
+            decoder_->headerIndex = 0;
+            return FramingDecodeErrorTooBig;
+        }
+        if (decoder_->expected != 0) {
+            return FramingDecodeOk;
+        }
+    } else {
+        decoder_->raw[decoder_->index++] = b_;
+        if (decoder_->index < decoder_->expected) {
+            return FramingDecodeOk;
+        }
+    }
+
+    // Frame complete -- the next byte starts a new prefix
+    decoder_->headerIndex = 0;
+    return FramingDecodeEndOfFrame;
+}
+
+//---------------------------------------------------------------------------
+static framing_decode_return_t framing_decode_cobs(framing_decoder_t* decoder_, uint8_t b_)
+{
+    if (b_ == COBS_DELIMITER) {
+        bool truncated = (decoder_->remaining != 0);
+        if (decoder_->code == 0) {
+            // Empty frame
+            decoder_->index = 0;
+        }
+        decoder_->code      = 0;
+        decoder_->remaining = 0;
+        if (truncated) {
+            decoder_->index = 0;
+            return FramingDecodeErrorInvalidFrame;
+        }
+        return FramingDecodeEndOfFrame;
+    }
+
+    // Start of a frame -- discard the previous one
+    if ((decoder_->code == 0) && (decoder_->remaining == 0)) {
+        decoder_->index = 0;
+    }
+
+    if (decoder_->remaining == 0) {
+        // New block; every block but the first follows an encoded zero, unless
+        // the previous block was full.
+        if ((decoder_->code != 0) && (decoder_->code != COBS_MAX_CODE)) {
+            if (decoder_->index >= decoder_->rawSize) {
+                return FramingDecodeErrorTooBig;
+            }
+            decoder_->raw[decoder_->index++] = 0;
+        }
+        decoder_->code      = b_;
+        decoder_->remaining = b_ - 1;
+        return FramingDecodeOk;
+    }
+
+    if (decoder_->index >= decoder_->rawSize) {
+        return FramingDecodeErrorTooBig;
+    }
+    decoder_->raw[decoder_->index++] = b_;
+    decoder_->remaining--;
+    return FramingDecodeOk;
+}
+
+//---------------------------------------------------------------------------
+framing_decode_return_t framing_decode_byte(framing_decoder_t* decoder_, uint8_t b_)
+{
+    switch (decoder_->type) {
+        case FramingSlip: return framing_decode_slip(decoder_, b_);
+        case FramingLength: return framing_decode_length(decoder_, b_);
+        case FramingCobs: return framing_decode_cobs(decoder_, b_);
+        default: return FramingDecodeErrorInvalidFrame;
+    }
+}
+
+//---------------------------------------------------------------------------
+framing_decode_return_t framing_decode_data(framing_decoder_t* decoder_,
+                                            const uint8_t*     data_,
+                                            size_t             dataLen_,
+                                            size_t*            consumed_)
+{
+    size_t i = 0;
+
+    while (i < dataLen_) {
+        // Copy as much of a length-prefixed frame's body as is available
+        if ((decoder_->type == FramingLength) && (decoder_->headerIndex == FRAMING_LENGTH_PREFIX_SIZE)
+            && ((decoder_->expected - decoder_->index) > 1)) {
+            size_t count = decoder_->expected - decoder_->index - 1;
+            if (count > (dataLen_ - i)) {
+                count = dataLen_ - i;
+            }
+            memcpy(&decoder_->raw[decoder_->index], &data_[i], count);
+            decoder_->index += count;
+            i += count;
+            continue;
+        }
+
+        framing_decode_return_t rc = framing_decode_byte(decoder_, data_[i++]);
+        if (rc != FramingDecodeOk) {
+            *consumed_ = i;
+            return rc;
+        }
+    }
+
+    *consumed_ = i;
+    return FramingDecodeOk;
+}
+
+//---------------------------------------------------------------------------
+size_t framing_decode_bytes_needed(const framing_decoder_t* decoder_)
+{
+    if (decoder_->type != FramingLength) {
+        return 0;
+    }
+    if (decoder_->headerIndex < FRAMING_LENGTH_PREFIX_SIZE) {
+        return FRAMING_LENGTH_PREFIX_SIZE - decoder_->headerIndex;
+    }
+    return decoder_->expected - decoder_->index;
+}
+
+//---------------------------------------------------------------------------
+bool framing_can_resync(framing_type_t type_)
+{
+    return (type_ != FramingLength);
+}
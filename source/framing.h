@@ -0,0 +1,203 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "slip.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Stream framing codecs.  Each connection uses one codec for the lifetime of
+// the connection (see PROTOCOL.txt for how it is selected).
+typedef enum {
+    FramingSlip = 0, //!< SLIP -- END-delimited, escaped; up to 2x expansion
+    FramingLength,   //!< 16-bit little-endian length prefix; 2 bytes overhead, no resynchronization
+    FramingCobs,     //!< COBS, 0x00-delimited; at most 1 byte overhead per 254 bytes, plus delimiter
+    //--
+    FramingCount
+} framing_type_t;
+
+//---------------------------------------------------------------------------
+// Size of the length prefix used by FramingLength
+#define FRAMING_LENGTH_PREFIX_SIZE (2)
+
+//---------------------------------------------------------------------------
+// Return values for decoding operations
+typedef enum {
+    FramingDecodeOk = 0,            //!< Byte consumed; frame not yet complete
+    FramingDecodeErrorTooBig,       //!< Frame exceeds the decoder's buffer
+    FramingDecodeErrorInvalidFrame, //!< Invalid framing bytes / escape sequences
+    FramingDecodeEndOfFrame         //!< A complete frame is available in the decoder
+} framing_decode_return_t;
+
+//---------------------------------------------------------------------------
+// Frame encoder.  Encodes directly into a caller-provided buffer, so that no
+// allocation is required per frame.
+typedef struct {
+    framing_type_t type;      //!< Codec in use
+    uint8_t*       encoded;   //!< Buffer holding the encoded frame
+    size_t         size;      //!< Size of the buffer
+    size_t         index;     //!< Current write index / size of the encoded frame (if complete)
+    bool           overflow;  //!< The frame didn't fit in the buffer
+    size_t         codeIndex; //!< COBS: index of the current block's code byte
+    uint8_t        code;      //!< COBS: current block's code value
+} framing_encoder_t;
+
+//---------------------------------------------------------------------------
+// Streaming frame decoder
+typedef struct {
+    framing_type_t type;    //!< Codec in use
+    uint8_t*       raw;     //!< Buffer holding the decoded frame
+    size_t         rawSize; //!< Size of the buffer
+    size_t         index;   //!< Current write index / size of the decoded frame (if complete)
+
+    slip_decode_message_t slip; //!< SLIP: decoder state (shares the raw buffer)
+
+    uint8_t header[FRAMING_LENGTH_PREFIX_SIZE]; //!< Length: prefix bytes received so far
+    size_t  headerIndex;                        //!< Length: number of prefix bytes received
+    size_t  expected;                           //!< Length: size of the frame being received
+
+    uint8_t code;      //!< COBS: current block's code value
+    uint8_t remaining; //!< COBS: bytes left in the current block
+} framing_decoder_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_type_name Get the configuration-file name of a codec
+ * @param type_ codec
+ * @return name of the codec ("slip", "length" or "cobs")
+ */
+const char* framing_type_name(framing_type_t type_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_type_from_name Look up a codec by its configuration-file name
+ * @param name_ name of the codec
+ * @param type_ [out] codec
+ * @return true if the name was recognized
+ */
+bool framing_type_from_name(const char* name_, framing_type_t* type_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_max_encoded_size Get the worst-case size of a frame encoded
+ * from rawSize_ bytes of data
+ * @param type_ codec
+ * @param rawSize_ size of the data to encode
+ * @return size of buffer required to hold the encoded frame
+ */
+size_t framing_max_encoded_size(framing_type_t type_, size_t rawSize_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_encode_begin Begin encoding a frame into a buffer
+ * @param encoder_ encoder to initialize
+ * @param type_ codec to encode with
+ * @param buffer_ buffer to hold the encoded frame
+ * @param bufferSize_ size of the buffer
+ */
+void framing_encode_begin(framing_encoder_t* encoder_, framing_type_t type_, uint8_t* buffer_, size_t bufferSize_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_encode_data Append data to an in-progress frame
+ * @param encoder_ encoder to append to
+ * @param data_ data to encode
+ * @param dataLen_ size of the data in bytes
+ */
+void framing_encode_data(framing_encoder_t* encoder_, const void* data_, size_t dataLen_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_encode_finish Complete an in-progress frame
+ * @param encoder_ encoder to complete
+ * @return size of the encoded frame, or 0 if it didn't fit in the buffer
+ */
+size_t framing_encode_finish(framing_encoder_t* encoder_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_decoder_create Construct a streaming frame decoder
+ * @param type_ codec to decode
+ * @param rawSize_ largest decoded frame to accept
+ * @return newly-constructed decoder, or NULL on allocation error
+ */
+framing_decoder_t* framing_decoder_create(framing_type_t type_, size_t rawSize_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_decoder_destroy Destroy a decoder created with
+ * framing_decoder_create().  The decoder must not be used afterwards.
+ * @param decoder_ decoder to destroy
+ */
+void framing_decoder_destroy(framing_decoder_t* decoder_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_decoder_reset Discard any partial frame and select the codec
+ * used for subsequent data.
+ * @param decoder_ decoder to reset
+ * @param type_ codec to decode
+ */
+void framing_decoder_reset(framing_decoder_t* decoder_, framing_type_t type_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_decode_byte Process a byte of data from the stream.  On
+ * FramingDecodeEndOfFrame, the frame is held in raw/index until the next call.
+ * After an error, SLIP and COBS decoders resynchronize on the next frame
+ * delimiter; a length-prefixed stream cannot be recovered.
+ * @param decoder_ decoder to update
+ * @param b_ byte to decode
+ * @return decoder status
+ */
+framing_decode_return_t framing_decode_byte(framing_decoder_t* decoder_, uint8_t b_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_decode_data Process a block of data from the stream, stopping
+ * at the end of the first complete frame (or the first error).  Equivalent to
+ * calling framing_decode_byte() for each byte, but length-prefixed frame
+ * bodies are copied in bulk.
+ * @param decoder_ decoder to update
+ * @param data_ data to decode
+ * @param dataLen_ size of the data in bytes
+ * @param consumed_ [out] number of bytes consumed
+ * @return FramingDecodeOk if all data was consumed without completing a
+ * frame, FramingDecodeEndOfFrame if a frame completed, errors otherwise
+ */
+framing_decode_return_t framing_decode_data(framing_decoder_t* decoder_,
+                                            const uint8_t*     data_,
+                                            size_t             dataLen_,
+                                            size_t*            consumed_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_decode_bytes_needed Get the number of bytes the decoder needs
+ * to make progress on the current length-prefixed frame -- the rest of the
+ * prefix, then the rest of the frame -- allowing a receiver to read each frame
+ * with two bounded reads.
+ * @param decoder_ decoder to query
+ * @return bytes needed, or 0 if the codec is delimiter-based
+ */
+size_t framing_decode_bytes_needed(const framing_decoder_t* decoder_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief framing_can_resync Determine whether a codec can recover from a
+ * decode error without closing the connection.
+ * @param type_ codec
+ * @return true for delimiter-based codecs
+ */
+bool framing_can_resync(framing_type_t type_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -3,78 +3,58 @@
 
 #include "hid_device.h"
 #include "hid_common.h"
-
-#include "net_util.h"
+#include "hid_descriptor.h"
 
 #include <string.h>
-#include <malloc.h>
 
 #include <3ds.h>
 
 #define NINTENDO_3DS_NAME_MOTION (NINTENDO_3DS_NAME " - Accelerometer")
 
-#define RAW_REPORT_ACCEL_SIZE (3 * sizeof(int32_t))
 
 //---------------------------------------------------------------------------
-static bool hid_accel_config(hid_device_t* device_, const program_options_t* options_)
-{
-    (void)options_;
-
-    // Set the device identifiers for the 3DS
-    js_config_t* config = &device_->config;
-    config->pid         = NINTENDO_USB_PID + 2; // Dummy value
-    config->vid         = NINTENDO_USB_VID;
-    strcpy(config->name, NINTENDO_3DS_NAME_MOTION);
-
-    config->absAxisCount = 3;
-    config->buttonCount  = 0;
-    config->relAxisCount = 0;
-
-    // Set up the 3DS's absolution-axis identifiers, mapping the supported
-    // absolute axis IDs to their corresponding IDs on linux
-    config->absAxis[0] = LINUX_ABS_X;
-    config->absAxis[1] = LINUX_ABS_Y;
-    config->absAxis[2] = LINUX_ABS_Z;
-
-    for (int i = 0; i < 3; i++) {
-        config->absAxisMin[i]  = NDS_ACCEL_MIN;
-        config->absAxisMax[i]  = NDS_ACCEL_MAX;
-        config->absAxisFuzz[i] = NDS_ACCEL_FUZZ;
-    }
-
-    device_->rawReportSize = RAW_REPORT_ACCEL_SIZE;
-    device_->rawReport     = (uint8_t*)malloc(device_->rawReportSize);
-
-    return true;
-}
+// Accelerometer axes: AXIS(field, linux ID, min, max, fuzz, flat)
+#define ACCEL_ABS_AXES(AXIS)                                                                                           \
+    AXIS(x, LINUX_ABS_X, NDS_ACCEL_MIN, NDS_ACCEL_MAX, NDS_ACCEL_FUZZ, 0)                                              \
+    AXIS(y, LINUX_ABS_Y, NDS_ACCEL_MIN, NDS_ACCEL_MAX, NDS_ACCEL_FUZZ, 0)                                              \
+    AXIS(z, LINUX_ABS_Z, NDS_ACCEL_MIN, NDS_ACCEL_MAX, NDS_ACCEL_FUZZ, 0)
+
+#define ACCEL_REL_AXES(REL)
+#define ACCEL_BUTTONS(BUTTON)
+
+HID_DESCRIPTOR_DEFINE(hid_accel_report_t,
+                      accelDescriptor,
+                      NINTENDO_3DS_NAME_MOTION,
+                      NINTENDO_USB_VID,
+                      NINTENDO_USB_PID + 2, // Dummy value
+                      ACCEL_ABS_AXES,
+                      ACCEL_REL_AXES,
+                      ACCEL_BUTTONS);
 
 //---------------------------------------------------------------------------
-static bool hid_accel_event(hid_device_t* device_, const program_options_t* options_)
+static bool hid_accel_event(hid_device_t* device_, const program_options_t* options_, const input_state_t* input_)
 {
     (void)options_;
 
-    js_report_t report = {};
-
-    uint8_t*     rawReport = device_->rawReport;
-    js_config_t* config    = &device_->config;
-
-    report.absAxis = (int32_t*)rawReport;
-    report.relAxis = (int32_t*)(rawReport + (sizeof(int32_t) * config->absAxisCount));
-    report.buttons
-        = (uint8_t*)(rawReport + (sizeof(int32_t) * config->absAxisCount) + (sizeof(int32_t) * config->relAxisCount));
+    hid_accel_report_t* report = (hid_accel_report_t*)device_->rawReport;
 
-    accelVector accel;
-    hidAccelRead(&accel);
+    report->x = input_->accelX;
+    report->y = input_->accelY;
+    report->z = input_->accelZ;
 
-    report.absAxis[0] = accel.x;
-    report.absAxis[1] = accel.y;
-    report.absAxis[2] = accel.z;
-
-    return net_util_encode_and_transmit(device_->sockFd, 1, device_->rawReport, device_->rawReportSize);
+    return true;
 }
 
 //---------------------------------------------------------------------------
 bool hid_accel_init(hid_device_t* device_, const program_options_t* options_)
 {
-    return hid_device_init(device_, "accel", hid_accel_config, hid_accel_event, options_);
+    if (!hid_device_init(device_, "accel", &accelDescriptor, NULL, hid_accel_event, options_)) {
+        return false;
+    }
+    device_->isMotionSensor  = true;
+    device_->shed.level      = CongestionLevelMotion;
+    device_->shed.intervalUs = NDS_MOTION_SHED_INTERVAL_US;
+    device_->shed.steps      = 0;
+    device_->motionHints     = options_->motionHints;
+    return true;
 }
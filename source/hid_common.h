@@ -81,6 +81,7 @@
 // Max/Min values for circle pad reports
 #define NDS_CIRCLE_PAD_MIN -156
 #define NDS_CIRCLE_PAD_MAX 156
+#define NDS_CIRCLE_PAD_FUZZ 2
 
 //---------------------------------------------------------------------------
 // Max/Min values for accelerometer reports
@@ -93,3 +94,9 @@
 #define NDS_GYRO_MIN -12000
 #define NDS_GYRO_MAX 12000
 #define NDS_GYRO_FUZZ 5
+
+//---------------------------------------------------------------------------
+// Shortest time between axis reports from the motion sensors and the
+// touchscreen while they're shedding load under congestion (us)
+#define NDS_MOTION_SHED_INTERVAL_US 100000
+#define NDS_TOUCH_SHED_INTERVAL_US 50000
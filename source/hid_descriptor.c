@@ -0,0 +1,34 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "hid_descriptor.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+void hid_descriptor_apply(const hid_descriptor_t* descriptor_, js_config_t* config_)
+{
+    strncpy(config_->name, descriptor_->name, sizeof(config_->name) - 1);
+    config_->vid = descriptor_->vid;
+    config_->pid = descriptor_->pid;
+
+    config_->absAxisCount = (int32_t)descriptor_->absAxisCount;
+    config_->relAxisCount = (int32_t)descriptor_->relAxisCount;
+    config_->buttonCount  = (int32_t)descriptor_->buttonCount;
+
+    for (size_t i = 0; i < descriptor_->absAxisCount; i++) {
+        const hid_abs_axis_desc_t* axis = &descriptor_->absAxes[i];
+
+        config_->absAxis[i]     = axis->id;
+        config_->absAxisMin[i]  = axis->min;
+        config_->absAxisMax[i]  = axis->max;
+        config_->absAxisFuzz[i] = axis->fuzz;
+        config_->absAxisFlat[i] = axis->flat;
+    }
+
+    for (size_t i = 0; i < descriptor_->relAxisCount; i++) { config_->relAxis[i] = descriptor_->relAxes[i]; }
+    for (size_t i = 0; i < descriptor_->buttonCount; i++) { config_->buttons[i] = descriptor_->buttons[i]; }
+}
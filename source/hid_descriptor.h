@@ -0,0 +1,108 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "joystick.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Largest report supported by any device (used to size the report buffer
+// embedded in each hid_device_t).
+#define HID_REPORT_MAX_SIZE (64)
+
+//---------------------------------------------------------------------------
+// Description of a single absolute axis
+typedef struct {
+    uint32_t id;   //!< Linux axis ID
+    int32_t  min;  //!< Minimum value reported by the axis
+    int32_t  max;  //!< Maximum value reported by the axis
+    int32_t  fuzz; //!< Changes within this many counts are considered noise
+    int32_t  flat; //!< Dead-zone around the axis' center
+} hid_abs_axis_desc_t;
+
+//---------------------------------------------------------------------------
+// Static description of a HID device -- used to generate the device's
+// js_config_t and describes the layout of its report.
+typedef struct {
+    const char* name; //!< Device "friendly" name
+    uint16_t    vid;  //!< USB Device Vendor ID
+    uint16_t    pid;  //!< USB Device Product ID
+
+    const hid_abs_axis_desc_t* absAxes;      //!< Absolute axis descriptions, in report order
+    size_t                     absAxisCount; //!< Number of absolute axes
+    const uint32_t*            relAxes;      //!< Relative axis IDs, in report order
+    size_t                     relAxisCount; //!< Number of relative axes
+    const uint32_t*            buttons;      //!< Button IDs, in report order
+    size_t                     buttonCount;  //!< Number of buttons
+
+    size_t reportSize; //!< Size of the packed report structure in bytes
+} hid_descriptor_t;
+
+//---------------------------------------------------------------------------
+// Device tables are written as X-macros taking a single macro argument, with
+// one entry per axis/button, in report order:
+//
+//   #define MY_ABS_AXES(AXIS) AXIS(field, linuxId, min, max, fuzz, flat) ...
+//   #define MY_REL_AXES(REL) REL(field, linuxId) ...
+//   #define MY_BUTTONS(BUTTON) BUTTON(field, linuxId, source) ...
+//
+// where "source" is a device-specific value identifying the native input that
+// drives the button (i.e. a 3DS key mask).  Empty tables are allowed.
+// HID_DESCRIPTOR_DEFINE() then expands the tables into a packed report struct
+// with one named field per entry, and a matching hid_descriptor_t.
+//---------------------------------------------------------------------------
+#define HID_DESC_ABS_FIELD(field_, id_, min_, max_, fuzz_, flat_) int32_t field_;
+#define HID_DESC_REL_FIELD(field_, id_) int32_t field_;
+#define HID_DESC_BUTTON_FIELD(field_, id_, source_) uint8_t field_;
+
+#define HID_DESC_ABS_ENTRY(field_, id_, min_, max_, fuzz_, flat_) { (id_), (min_), (max_), (fuzz_), (flat_) },
+#define HID_DESC_REL_ENTRY(field_, id_) (id_),
+#define HID_DESC_BUTTON_ENTRY(field_, id_, source_) (id_),
+
+#define HID_DESC_COUNT(...) +1
+
+//---------------------------------------------------------------------------
+#define HID_DESCRIPTOR_DEFINE(reportType_, descriptor_, name_, vid_, pid_, ABS_, REL_, BUTTONS_)                       \
+    typedef struct __attribute__((packed)) {                                                                           \
+        ABS_(HID_DESC_ABS_FIELD) REL_(HID_DESC_REL_FIELD) BUTTONS_(HID_DESC_BUTTON_FIELD)                              \
+    } reportType_;                                                                                                     \
+                                                                                                                       \
+    _Static_assert(sizeof(reportType_) <= HID_REPORT_MAX_SIZE, #reportType_ " exceeds HID_REPORT_MAX_SIZE");           \
+                                                                                                                       \
+    static const hid_abs_axis_desc_t descriptor_##AbsAxes[] = { ABS_(HID_DESC_ABS_ENTRY) };                            \
+    static const uint32_t            descriptor_##RelAxes[] = { REL_(HID_DESC_REL_ENTRY) };                            \
+    static const uint32_t            descriptor_##Buttons[] = { BUTTONS_(HID_DESC_BUTTON_ENTRY) };                     \
+                                                                                                                       \
+    static const hid_descriptor_t descriptor_ = {                                                                      \
+        (name_),                                                                                                       \
+        (vid_),                                                                                                        \
+        (pid_),                                                                                                        \
+        descriptor_##AbsAxes,                                                                                          \
+        (0 ABS_(HID_DESC_COUNT)),                                                                                      \
+        descriptor_##RelAxes,                                                                                          \
+        (0 REL_(HID_DESC_COUNT)),                                                                                      \
+        descriptor_##Buttons,                                                                                          \
+        (0 BUTTONS_(HID_DESC_COUNT)),                                                                                  \
+        sizeof(reportType_),                                                                                           \
+    }
+
+//---------------------------------------------------------------------------
+/**
+ * @brief hid_descriptor_apply Fill in a device configuration structure from
+ * its static descriptor.
+ * @param descriptor_ descriptor to generate the configuration from
+ * @param config_ [out] configuration structure to fill in
+ */
+void hid_descriptor_apply(const hid_descriptor_t* descriptor_, js_config_t* config_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
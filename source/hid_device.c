@@ -12,58 +12,707 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "logger.h"
 #include "net_util.h"
+#include "protocol.h"
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+// Largest message expected from the server
+#define HID_DEVICE_RX_FRAME_MAX (64)
+
+// Delay before reconnecting to the server after a socket error
+#define HID_DEVICE_RETRY_US (2000000ULL)
+
+// Absolute-axis resolution of analog controls while shedding load, in steps
+// across the axis' range
+#define HID_DEVICE_SHED_STEPS (64)
+
+// Extrapolation horizon over which a change in an axis' velocity is compared
+// against its fuzz value, to decide whether the velocity last sent is stale
+#define HID_DEVICE_HINT_HORIZON_US (50000)
+
+// Axes with no fuzz value (the gamepad's wheel, the touchscreen) are treated as
+// having this many steps across their range when judging velocity drift, so
+// that estimator noise alone doesn't keep refreshing the velocity
+#define HID_DEVICE_HINT_FUZZLESS_STEPS (64)
+
+#define ABS(x) (((x) < 0) ? ((x) * -1) : (x))
+
+//---------------------------------------------------------------------------
+static int32_t hid_device_report_value(const uint8_t* report_, size_t index_)
+{
+    int32_t value;
+    memcpy(&value, report_ + (index_ * sizeof(int32_t)), sizeof(value));
+    return value;
+}
+
+//---------------------------------------------------------------------------
+// Compare the device's report against the last one sent, using the layout
+// generated by HID_DESCRIPTOR_DEFINE(): absolute axes, relative axes, then
+// buttons.  Absolute-axis changes the server would treat as noise are ignored,
+// as are those finer than the congestion policy's resolution while shedding.
+// Returns a combination of hid_change_t flags.
+static uint32_t hid_device_classify_changes(const hid_device_t* device_)
+{
+    const js_config_t* config  = &device_->config;
+    uint32_t           changes = HidChangeNone;
+
+    for (int32_t i = 0; i < config->absAxisCount; i++) {
+        int32_t value = hid_device_report_value(device_->rawReport, i);
+        int32_t last  = hid_device_report_value(device_->sentReport, i);
+        if (value == last) {
+            continue;
+        }
+
+        // Movement within the flat zone around the axis' center is ignored
+        int32_t center = (config->absAxisMin[i] + config->absAxisMax[i]) / 2;
+        int32_t flat   = config->absAxisFlat[i];
+        if ((flat != 0) && (ABS(value - center) <= flat) && (ABS(last - center) <= flat)) {
+            continue;
+        }
+
+        // ...as is jitter within half the axis' fuzz value
+        if ((ABS(value - last) * 2) <= config->absAxisFuzz[i]) {
+            continue;
+        }
+
+        // ...and, while shedding load, anything finer than the reduced resolution
+        int32_t range = config->absAxisMax[i] - config->absAxisMin[i];
+        if (device_->shedding && (device_->shed.steps != 0)
+            && ((int64_t)ABS(value - last) * device_->shed.steps < range)) {
+            continue;
+        }
+        changes |= HidChangeAxes;
+        break;
+    }
+
+    // With motion hints, a receiver extrapolating from the last report would
+    // drift once an axis' velocity has changed by more than the axis' noise
+    if (device_->motionHints && !(changes & HidChangeAxes)) {
+        for (size_t i = 0; i < device_->motionHint.axisCount; i++) {
+            int32_t  velocity = motion_hint_velocity(&device_->motionHint, i);
+            uint32_t drift    = motion_hint_drift(velocity, device_->sentVelocity[i], HID_DEVICE_HINT_HORIZON_US);
+            int64_t  fuzz     = config->absAxisFuzz[i];
+            if (fuzz == 0) {
+                fuzz = ((int64_t)config->absAxisMax[i] - config->absAxisMin[i]) / HID_DEVICE_HINT_FUZZLESS_STEPS;
+            }
+            if ((drift != 0) && (((int64_t)drift * 2) > fuzz)) {
+                changes |= HidChangeAxes;
+                break;
+            }
+        }
+    }
+
+    // Any relative motion is significant
+    size_t axisCount = (size_t)(config->absAxisCount + config->relAxisCount);
+    for (size_t i = (size_t)config->absAxisCount; i < axisCount; i++) {
+        if (hid_device_report_value(device_->rawReport, i) != 0) {
+            changes |= HidChangeAxes;
+            break;
+        }
+    }
+
+    size_t buttonOffset = axisCount * sizeof(int32_t);
+    if (0
+        != memcmp(device_->rawReport + buttonOffset,
+                  device_->sentReport + buttonOffset,
+                  device_->rawReportSize - buttonOffset)) {
+        changes |= HidChangeButtons;
+    }
+    return changes;
+}
+
+//---------------------------------------------------------------------------
+// The server's connection takes reports once it has the device's configuration,
+// unless the server asked the device to stop reporting
+static bool hid_device_server_ready(const hid_device_t* device_)
+{
+    return (device_->sockFd >= 0) && !device_->needConfig && !device_->motionOff;
+}
+
+//---------------------------------------------------------------------------
+// Encode a message once, and send the same frame on the device's connection
+// (if it's ready for it), then to each of its mirrors.  Every destination has
+// its own connection: a mirror that can't take the frame drops it and flags
+// itself for resynchronization, whatever became of the frame on the server's
+// connection.  Only the outcome on the server's connection is reported; with
+// no server connection to fall behind on, the frame counts as sent.
+static net_util_send_return_t hid_device_send_stream(hid_device_t* device_,
+                                                     uint16_t      messageType_,
+                                                     void*         data_,
+                                                     size_t        dataLen_)
+{
+    uint8_t frame[NET_UTIL_FRAME_BUFFER_SIZE];
+    size_t  frameLen = net_util_encode(device_->framing, messageType_, data_, dataLen_, frame, sizeof(frame));
+    if (frameLen == 0) {
+        return NetUtilSendError;
+    }
+
+    net_util_send_return_t rc = NetUtilSendOk;
+    if (hid_device_server_ready(device_)) {
+        rc = net_util_transmit(device_->sockFd, &device_->stats, &device_->txBacklog, frame, frameLen);
+    }
+    for (size_t i = 0; i < device_->mirrorCount; i++) { mirror_send(&device_->mirrors[i], frame, frameLen); }
+    return rc;
+}
+
+//---------------------------------------------------------------------------
+// Encode a message and send it to a single mirror.  Reports are encoded on the
+// stack; larger messages (the configuration) use the mirror's frame buffer.
+static bool hid_device_send_mirror(mirror_t*      mirror_,
+                                   framing_type_t framing_,
+                                   uint16_t       messageType_,
+                                   void*          data_,
+                                   size_t         dataLen_)
+{
+    uint8_t  stackFrame[NET_UTIL_FRAME_BUFFER_SIZE];
+    uint8_t* frame     = stackFrame;
+    size_t   frameSize = sizeof(stackFrame);
+    if (net_util_encoded_size(framing_, dataLen_) > frameSize) {
+        frame     = mirror_->frame;
+        frameSize = mirror_->pendingSize;
+    }
+
+    size_t frameLen = net_util_encode(framing_, messageType_, data_, dataLen_, frame, frameSize);
+    return (frameLen != 0) && mirror_send(mirror_, frame, frameLen);
+}
+
+//---------------------------------------------------------------------------
+// Keep the device's mirrors connected.  A newly-connected mirror is sent the
+// device's configuration (mirrors never resume sessions), and one that has
+// missed frames is sent the last report streamed -- minus any relative
+// motion, which the mirror has already been sent or has lost.
+static void hid_device_service_mirrors(hid_device_t* device_)
+{
+    const js_config_t* config    = &device_->config;
+    size_t             relOffset = (size_t)config->absAxisCount * sizeof(int32_t);
+    size_t             relSize   = (size_t)config->relAxisCount * sizeof(int32_t);
+
+    for (size_t i = 0; i < device_->mirrorCount; i++) {
+        mirror_t* mirror = &device_->mirrors[i];
+
+        if (mirror_poll(mirror)) {
+            netstick_framing_t framing = {};
+            framing.framing            = (uint8_t)device_->framing;
+
+            if (((device_->framing != FramingSlip)
+                 && !hid_device_send_mirror(mirror, FramingSlip, NetstickTagFraming, &framing, sizeof(framing)))
+                || !hid_device_send_mirror(
+                    mirror, device_->framing, NetstickTagConfig, &device_->config, sizeof(js_config_t))) {
+                mirror_close(mirror);
+                continue;
+            }
+            mirror->resync = true;
+        }
+
+        if (mirror->resync && (mirror->state == MirrorStateConnected) && (mirror->pendingLen == 0)
+            && (device_->sentTicks != 0)) {
+            uint8_t report[HID_REPORT_MAX_SIZE];
+            memcpy(report, device_->sentReport, device_->rawReportSize);
+            memset(report + relOffset, 0, relSize);
+
+            if (hid_device_send_mirror(mirror, device_->framing, NetstickTagReport, report, device_->rawReportSize)) {
+                mirror->resync = false;
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Send only the button section of the report, as a NetstickTagButtons message.
+// If it's dropped, a full report is forced out instead once the socket clears.
+static bool hid_device_send_buttons(hid_device_t* device_)
+{
+    const js_config_t* config       = &device_->config;
+    size_t             buttonOffset = (size_t)(config->absAxisCount + config->relAxisCount) * sizeof(int32_t);
+    size_t             buttonCount  = device_->rawReportSize - buttonOffset;
+    uint8_t            packed[PROTOCOL_BUTTONS_SIZE(KEY_CNT)];
+
+    protocol_pack_buttons(device_->rawReport + buttonOffset, buttonCount, packed);
+    bool                   toServer = hid_device_server_ready(device_);
+    net_util_send_return_t rc
+        = hid_device_send_stream(device_, NetstickTagButtons, packed, PROTOCOL_BUTTONS_SIZE(buttonCount));
+    if (rc != NetUtilSendOk) {
+        device_->forceReport = (rc == NetUtilSendDropped);
+        return (rc == NetUtilSendDropped);
+    }
+    if (toServer) {
+        device_->stats.buttonFramesSent++;
+    }
+    memcpy(device_->sentReport + buttonOffset, device_->rawReport + buttonOffset, buttonCount);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Send the device's configuration.  If the socket buffer is full, needConfig
+// stays set, and the configuration is sent again on the next poll.
+static bool hid_device_send_config(hid_device_t* device_)
+{
+    net_util_send_return_t rc = net_util_encode_and_transmit(device_->sockFd,
+                                                             device_->framing,
+                                                             &device_->stats,
+                                                             &device_->txBacklog,
+                                                             NetstickTagConfig,
+                                                             &device_->config,
+                                                             sizeof(js_config_t));
+    device_->resumePending = false;
+    device_->needConfig    = (rc == NetUtilSendDropped);
+    return (rc != NetUtilSendError);
+}
+
+//---------------------------------------------------------------------------
+// Send the first message on a new connection -- a request to resume the
+// previous session if the server has given us a token, the full device
+// configuration otherwise.
+static bool hid_device_send_hello(hid_device_t* device_)
+{
+    // Select the connection's framing codec first, if it isn't the default
+    if (device_->framing != FramingSlip) {
+        netstick_framing_t framing = {};
+        framing.framing            = (uint8_t)device_->framing;
+        if (net_util_encode_and_transmit(device_->sockFd,
+                                         FramingSlip,
+                                         &device_->stats,
+                                         &device_->txBacklog,
+                                         NetstickTagFraming,
+                                         &framing,
+                                         sizeof(framing))
+            != NetUtilSendOk) {
+            return false;
+        }
+    }
+
+    if (!device_->hasSession) {
+        return hid_device_send_config(device_);
+    }
+
+    netstick_session_resume_t resume = {};
+    resume.token                     = device_->sessionToken;
+    resume.configHash                = device_->configHash;
+
+    device_->resumePending = true;
+    return net_util_encode_and_transmit(device_->sockFd,
+                                        device_->framing,
+                                        &device_->stats,
+                                        &device_->txBacklog,
+                                        NetstickTagSessionResume,
+                                        &resume,
+                                        sizeof(resume))
+           == NetUtilSendOk;
+}
+
+//---------------------------------------------------------------------------
+// Apply the server's pacing request to the device, without reconnecting
+static void hid_device_on_rate_control(hid_device_t* device_, const void* data_, size_t dataLen_)
+{
+    if (dataLen_ != sizeof(netstick_rate_control_t)) {
+        return;
+    }
+
+    netstick_rate_control_t control;
+    memcpy(&control, data_, sizeof(control));
+
+    if (control.intervalUs == NETSTICK_RATE_CONTROL_DEFAULT) {
+        device_->analogTicks = device_->optionTicks;
+    } else {
+        device_->analogTicks = time_util_us_to_ticks(control.intervalUs);
+    }
+    if (control.coalesceUs == NETSTICK_RATE_CONTROL_DEFAULT) {
+        device_->coalesceTicks = 0;
+    } else {
+        device_->coalesceTicks = time_util_us_to_ticks(control.coalesceUs);
+    }
+
+    bool motionOff = device_->isMotionSensor && (control.flags & NetstickRateControlMotionOff);
+    if (device_->motionOff && !motionOff) {
+        // Bring the server's view of the sensor up to date when it resumes
+        device_->forceReport = true;
+    }
+    device_->motionOff = motionOff;
+
+    LOG_INFO("%s: interval %luus, coalesce %luus%s",
+             device_->name,
+             (unsigned long)time_util_ticks_to_us(device_->analogTicks),
+             (unsigned long)time_util_ticks_to_us(device_->coalesceTicks),
+             motionOff ? ", off" : "");
+}
+
+//---------------------------------------------------------------------------
+static void hid_device_on_message(void* context_, uint16_t messageType_, void* data_, size_t dataLen_)
+{
+    hid_device_t* device = (hid_device_t*)context_;
+
+    if (messageType_ == NetstickTagRateControl) {
+        hid_device_on_rate_control(device, data_, dataLen_);
+        return;
+    }
+
+    if ((messageType_ == NetstickTagKeepAlive) && (dataLen_ == sizeof(netstick_keepalive_t))) {
+        netstick_keepalive_t keepAlive;
+        memcpy(&keepAlive, data_, sizeof(keepAlive));
+        if (keepAlive.flags & NetstickKeepAliveReply) {
+            device->echoSequence = keepAlive.sequence;
+            device->echoTicks    = time_util_ticks();
+        }
+        return;
+    }
+
+    if ((messageType_ != NetstickTagSessionToken) || (dataLen_ != sizeof(netstick_session_token_t))) {
+        return;
+    }
+
+    netstick_session_token_t session;
+    memcpy(&session, data_, sizeof(session));
+
+    if (session.configHash != device->configHash) {
+        return;
+    }
+
+    if (device->resumePending && !session.resumed) {
+        // Server no longer has our device -- fall back to a full configuration
+        LOG_INFO("session expired -- %s", device->name);
+        device->hasSession = false;
+        device->needConfig = true;
+        return;
+    }
+
+    if (device->resumePending) {
+        LOG_INFO("resumed -- %s!", device->name);
+    }
+
+    device->resumePending = false;
+    device->sessionToken  = session.token;
+    device->hasSession    = true;
+}
 
 //---------------------------------------------------------------------------
 bool hid_device_init(hid_device_t*            device_,
                      const char*              name_,
+                     const hid_descriptor_t*  descriptor_,
                      hid_config_handler_t     configHandler_,
                      hid_event_handler_t      eventHandler_,
                      const program_options_t* options_)
 {
     memset(device_, 0, sizeof(*device_));
     device_->name            = name_;
+    device_->descriptor      = descriptor_;
     device_->configHandlerFn = configHandler_;
     device_->eventHandlerFn  = eventHandler_;
     device_->sockFd          = -1;
+    device_->connectFd       = -1;
+    device_->stateTicks      = time_util_ticks();
+    net_stats_init(&device_->stats);
 
-    if (device_->configHandlerFn(device_, options_)) {
-        device_->isInit = true;
-        return true;
+    hid_device_status_t status = {};
+    status.stateTicks          = device_->stateTicks;
+    snapshot_init(&device_->statusLatch, device_->statusCopies, &status, sizeof(status));
+
+    hid_descriptor_apply(descriptor_, &device_->config);
+    device_->rawReportSize = descriptor_->reportSize;
+
+    if (device_->configHandlerFn && !device_->configHandlerFn(device_, options_)) {
+        return false;
     }
 
-    return false;
+    device_->configHash   = protocol_config_hash(&device_->config);
+    device_->framing      = (framing_type_t)options_->framing;
+    device_->buttonFrames = options_->buttonFrames;
+    device_->optionTicks  = time_util_us_to_ticks((uint64_t)options_->analogIntervalMs * 1000ULL);
+    device_->analogTicks  = device_->optionTicks;
+    device_->rxDecoder    = framing_decoder_create(device_->framing, HID_DEVICE_RX_FRAME_MAX);
+    motion_hint_init(&device_->motionHint, (size_t)device_->config.absAxisCount);
+
+    // Unless the device says otherwise, it's an analog controller: its
+    // precision is the last thing given up under congestion.
+    device_->shed.level = CongestionLevelAnalog;
+    device_->shed.steps = HID_DEVICE_SHED_STEPS;
+
+    // Connections hold back at most one frame, which may be the configuration
+    size_t mirrorFrame = net_util_encoded_size(device_->framing, sizeof(js_config_t));
+    size_t maxFrame    = (mirrorFrame > NET_UTIL_FRAME_BUFFER_SIZE) ? mirrorFrame : NET_UTIL_FRAME_BUFFER_SIZE;
+    if (!net_util_backlog_init(&device_->txBacklog, maxFrame)) {
+        return false;
+    }
+    for (int i = 0; (i < options_->mirrorCount) && (i < PROGRAM_OPTIONS_MIRROR_MAX); i++) {
+        if (!mirror_init(&device_->mirrors[i], options_->mirrorHost[i], options_->mirrorPort[i], mirrorFrame)) {
+            return false;
+        }
+        device_->mirrorCount++;
+    }
+
+    device_->isInit = true;
+    return true;
 }
 
 //---------------------------------------------------------------------------
-bool handle_hid_events(hid_device_t* device_, const program_options_t* options_)
+// Service the device's connection to the server: connect (at most once per
+// retry period), handle the server's messages, finish sending whatever was
+// held back, and send the configuration if the server needs it.
+static void hid_device_service_server(hid_device_t* device_, const program_options_t* options_)
 {
-    if (!device_->isInit) {
-        return false;
+    // Connect without waiting, so a server that is slow to answer (or isn't
+    // there) never holds up the device's mirrors
+    if ((device_->sockFd == -1) && (device_->connectFd == -1)) {
+        uint64_t now = time_util_ticks();
+        if (now < device_->retryTicks) {
+            return;
+        }
+        device_->connectFd = net_util_connect_start(options_->host, options_->port);
+        if (device_->connectFd < 0) {
+            device_->retryTicks = now + time_util_us_to_ticks(HID_DEVICE_RETRY_US);
+            device_->stats.connectFailures++;
+            return;
+        }
+        LOG_INFO("connecting to %s:%u -- %s", options_->host, (unsigned)options_->port, device_->name);
     }
 
-    if (device_->sockFd == -1) {
-        device_->sockFd = net_util_connect(options_->host, options_->port);
-
-        // Connection succeeded -- try to send configuration data.
-        if (device_->sockFd >= 0) {
-            if (!net_util_encode_and_transmit(device_->sockFd, 0, &device_->config, sizeof(js_config_t))) {
-                close(device_->sockFd);
-                device_->sockFd = -1;
-                return false;
-            } else {
-                printf("connected -- %s!\n", device_->name);
-            }
-        } else {
-            return false;
+    if (device_->connectFd >= 0) {
+        int rc = net_util_connect_check(device_->connectFd);
+        if (rc == 0) {
+            return;
         }
-    } else {
-        if (!device_->eventHandlerFn(device_, options_)) {
+
+        device_->sockFd    = device_->connectFd;
+        device_->connectFd = -1;
+
+        // Connection succeeded -- try to send configuration data (or resume the previous session)
+        if (rc > 0) {
+            framing_decoder_reset(device_->rxDecoder, device_->framing);
+            device_->txBacklog.pendingLen = 0;
+        }
+        if ((rc < 0) || !hid_device_send_hello(device_)) {
             close(device_->sockFd);
-            device_->sockFd = -1;
-            printf("disconnected -- %s!\n", device_->name);
-            return false;
+            device_->sockFd     = -1;
+            device_->retryTicks = time_util_ticks() + time_util_us_to_ticks(HID_DEVICE_RETRY_US);
+            device_->stats.connectFailures++;
+            return;
+        }
+
+        LOG_INFO("%s -- %s!", device_->resumePending ? "resuming" : "connected", device_->name);
+        device_->stats.connects++;
+        device_->stateTicks = time_util_ticks();
+
+        // Bring the server's view of the device up to date immediately.
+        device_->forceReport = true;
+    }
+
+    if (!net_util_receive(device_->sockFd, device_->rxDecoder, hid_device_on_message, device_)
+        || !net_util_flush(device_->sockFd, &device_->stats, &device_->txBacklog)) {
+        hid_device_disconnect(device_);
+        return;
+    }
+
+    if (device_->needConfig) {
+        if (!hid_device_send_config(device_)) {
+            hid_device_disconnect(device_);
+            return;
+        }
+        if (!device_->needConfig) {
+            device_->forceReport = true;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Build the device's report, and send it if needed -- to the server if its
+// connection is ready for reports, and to every connected mirror either way.
+// Returns false on a socket error on the server's connection.
+static bool hid_device_send_updates(hid_device_t*            device_,
+                                    const program_options_t* options_,
+                                    const input_state_t*     input_)
+{
+    // Reports mean nothing to the server until it has the configuration, nor
+    // while it has turned the device off, but mirrors are still sent them; and
+    // with no destination at all, the last report streamed is kept current for
+    // whichever connects first.
+    bool toServer = hid_device_server_ready(device_);
+
+    device_->stats.reportsGenerated++;
+    if (!device_->eventHandlerFn(device_, options_, input_)) {
+        return false;
+    }
+
+    if (device_->motionHints) {
+        int32_t axes[MOTION_HINT_MAX_AXES];
+        memcpy(axes, device_->rawReport, device_->motionHint.axisCount * sizeof(int32_t));
+        motion_hint_record(&device_->motionHint, time_util_ticks_to_us(input_->ticks), axes);
+    }
+
+    // Only send the report if it changed, or is due for a refresh
+    uint64_t refreshTicks = time_util_us_to_ticks((uint64_t)options_->reportRefreshMs * 1000ULL);
+    uint64_t silentTicks  = time_util_ticks() - device_->sentTicks;
+    bool     stale        = (options_->reportRefreshMs > 0) && (silentTicks >= refreshTicks);
+    bool     sendReport   = device_->forceReport || stale;
+    uint32_t changes      = hid_device_classify_changes(device_);
+
+    if (!sendReport && (changes == HidChangeNone)) {
+        device_->stats.reportsSuppressed++;
+        return true;
+    }
+
+    // Analog lane: axis changes go out at most once per analogTicks (or the
+    // congestion policy's interval, if longer, while shedding), and not until
+    // coalesceTicks after the first of them was seen.  Anything held back is
+    // compared against the last report again on the next poll.
+    uint64_t analogTicks = device_->analogTicks;
+    if (device_->shedding && (device_->shedTicks > analogTicks)) {
+        analogTicks = device_->shedTicks;
+    }
+
+    if (!(changes & HidChangeAxes)) {
+        device_->axisTicks = 0;
+    } else if (!sendReport) {
+        uint64_t now = time_util_ticks();
+        if (!device_->axisTicks) {
+            device_->axisTicks = now;
+        }
+        if ((silentTicks >= analogTicks) && ((now - device_->axisTicks) >= device_->coalesceTicks)) {
+            sendReport = true;
+        } else {
+            device_->stats.reportsDeferred++;
         }
     }
+
+    // Priority lane: button changes are never held back.  Unless a full report
+    // is going out anyway, they're sent on their own as a button message (if
+    // the server takes them).
+    bool sendButtons = false;
+    if (changes & HidChangeButtons) {
+        sendButtons = device_->buttonFrames && !sendReport;
+        sendReport  = sendReport || !device_->buttonFrames;
+    }
+
+    if ((sendButtons && !hid_device_send_buttons(device_)) || (sendReport && !hid_device_send_report(device_))) {
+        return false;
+    }
+
+    // A dropped frame forces the next report, and its button changes are
+    // measured when that goes out instead
+    if ((changes & HidChangeButtons) && toServer && !device_->forceReport) {
+        uint64_t latency = time_util_ticks_to_us(time_util_ticks() - input_->ticks);
+        histogram_record(&device_->stats.edgeLatencyUs, (latency > UINT32_MAX) ? UINT32_MAX : (uint32_t)latency);
+        device_->stats.buttonEdges++;
+    }
     return true;
 }
+
+//---------------------------------------------------------------------------
+bool handle_hid_events(hid_device_t* device_, const program_options_t* options_, const input_state_t* input_)
+{
+    if (!device_->isInit) {
+        return false;
+    }
+
+    // Mirrors are serviced after the server, so they never delay its updates.
+    // The report is built and streamed whatever the state of the server's
+    // connection, so a server that is down or behind never starves a mirror.
+    hid_device_service_server(device_, options_);
+    hid_device_service_mirrors(device_);
+    if (!hid_device_send_updates(device_, options_, input_)) {
+        hid_device_disconnect(device_);
+    }
+    return (device_->sockFd >= 0);
+}
+
+//---------------------------------------------------------------------------
+// Send the report as a NetstickTagHintedReport: the time of the newest sample
+// and the velocity of each absolute axis, followed by the report itself
+static net_util_send_return_t hid_device_send_hinted_report(hid_device_t* device_)
+{
+    const motion_hint_t*   motion = &device_->motionHint;
+    netstick_report_hint_t hint   = {};
+    uint8_t                payload[PROTOCOL_HINT_SIZE(MOTION_HINT_MAX_AXES) + HID_REPORT_MAX_SIZE];
+
+    hint.sampleUs  = (uint32_t)motion->timeUs[motion->head];
+    hint.axisCount = (uint8_t)motion->axisCount;
+    for (size_t i = 0; i < motion->axisCount; i++) {
+        device_->sentVelocity[i] = motion_hint_velocity(motion, i);
+    }
+
+    size_t hintSize = PROTOCOL_HINT_SIZE(motion->axisCount);
+    memcpy(payload, &hint, sizeof(hint));
+    memcpy(payload + sizeof(hint), device_->sentVelocity, motion->axisCount * sizeof(int32_t));
+    memcpy(payload + hintSize, device_->rawReport, device_->rawReportSize);
+
+    return hid_device_send_stream(device_, NetstickTagHintedReport, payload, hintSize + device_->rawReportSize);
+}
+
+//---------------------------------------------------------------------------
+bool hid_device_send_report(hid_device_t* device_)
+{
+    bool                   toServer = hid_device_server_ready(device_);
+    net_util_send_return_t rc
+        = device_->motionHints
+              ? hid_device_send_hinted_report(device_)
+              : hid_device_send_stream(device_, NetstickTagReport, device_->rawReport, device_->rawReportSize);
+    if (rc != NetUtilSendOk) {
+        device_->forceReport = (rc == NetUtilSendDropped);
+        return (rc == NetUtilSendDropped);
+    }
+    if (toServer) {
+        device_->stats.reportsSent++;
+    }
+    device_->forceReport = false;
+    device_->sentTicks   = time_util_ticks();
+    device_->axisTicks   = 0;
+    memcpy(device_->sentReport, device_->rawReport, device_->rawReportSize);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void hid_device_publish_status(hid_device_t* device_)
+{
+    const net_stats_t*  stats  = &device_->stats;
+    hid_device_status_t status = {};
+
+    status.connected        = (device_->sockFd >= 0);
+    status.stateTicks       = device_->stateTicks;
+    status.reportsSent      = stats->reportsSent;
+    status.bytesSent        = stats->bytesSent;
+    status.sendErrors       = stats->sendErrors;
+    status.sendBackpressure = stats->sendBackpressure;
+    status.connects         = stats->connects;
+    status.connectFailures  = stats->connectFailures;
+    snapshot_publish(&device_->statusLatch, device_->statusCopies, &status, sizeof(status));
+}
+
+//---------------------------------------------------------------------------
+bool hid_device_read_status(const hid_device_t* device_, hid_device_status_t* status_)
+{
+    return snapshot_read(&device_->statusLatch, device_->statusCopies, status_, sizeof(*status_));
+}
+
+//---------------------------------------------------------------------------
+void hid_device_set_shedding(hid_device_t* device_, bool shedding_)
+{
+    if (device_->shedding && !shedding_) {
+        // Replace the last degraded update with the device's exact state
+        device_->forceReport = true;
+    }
+    device_->shedding  = shedding_;
+    device_->shedTicks = time_util_us_to_ticks(device_->shed.intervalUs);
+}
+
+//---------------------------------------------------------------------------
+void hid_device_disconnect(hid_device_t* device_)
+{
+    if (device_->connectFd >= 0) {
+        close(device_->connectFd);
+        device_->connectFd  = -1;
+        device_->retryTicks = time_util_ticks() + time_util_us_to_ticks(HID_DEVICE_RETRY_US);
+    }
+    if (device_->sockFd == -1) {
+        return;
+    }
+    close(device_->sockFd);
+    device_->sockFd     = -1;
+    device_->stateTicks = time_util_ticks();
+    device_->retryTicks = device_->stateTicks + time_util_us_to_ticks(HID_DEVICE_RETRY_US);
+
+    // Pacing requested by the server applies to its connection only
+    device_->analogTicks   = device_->optionTicks;
+    device_->coalesceTicks = 0;
+    device_->motionOff     = false;
+    LOG_INFO("disconnected -- %s!", device_->name);
+}
@@ -9,8 +9,17 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "congestion.h"
+#include "framing.h"
+#include "hid_descriptor.h"
+#include "input_state.h"
 #include "joystick.h"
+#include "mirror.h"
+#include "motion_hint.h"
+#include "net_util.h"
 #include "options.h"
+#include "snapshot.h"
+#include "stats.h"
 
 #if defined(__cplusplus)
 extern "C" {
@@ -18,21 +27,93 @@ extern "C" {
 
 struct hid_device;
 
+//---------------------------------------------------------------------------
+// Kinds of change between a device's report and the last one sent.  Button
+// changes are sent immediately (the priority lane); axis-only changes may be
+// paced (the analog lane).
+typedef enum {
+    HidChangeNone    = 0,
+    HidChangeAxes    = (1 << 0), //!< An axis moved by more than its noise threshold, or relative motion
+    HidChangeButtons = (1 << 1), //!< A button was pressed or released
+} hid_change_t;
+
+//---------------------------------------------------------------------------
+// State of a device's connection, published by the sender thread (which owns
+// the connection) for display on other threads
+typedef struct {
+    bool     connected;        //!< The device is connected to the server
+    uint64_t stateTicks;       //!< Time of the last connect/disconnect (from time_util_ticks())
+    uint32_t reportsSent;      //!< See net_stats_t
+    uint64_t bytesSent;        //!< See net_stats_t
+    uint32_t sendErrors;       //!< See net_stats_t
+    uint32_t sendBackpressure; //!< See net_stats_t
+    uint32_t connects;         //!< See net_stats_t
+    uint32_t connectFailures;  //!< See net_stats_t
+} hid_device_status_t;
+
 //---------------------------------------------------------------------------
 // Callouts invoked to handle initialization + event handling for a HID device
+// Event handlers build the device's report (rawReport) from the input snapshot;
+// handle_hid_events() then decides whether the report needs to be sent.
 typedef bool (*hid_config_handler_t)(struct hid_device* device_, const program_options_t* options_);
-typedef bool (*hid_event_handler_t)(struct hid_device* device_, const program_options_t* options_);
+typedef bool (*hid_event_handler_t)(struct hid_device*       device_,
+                                    const program_options_t* options_,
+                                    const input_state_t*     input_);
 
 //---------------------------------------------------------------------------
 // Generic HID device data strcture, which can be specialized for any specific
 // type of input device supported by the system
 typedef struct hid_device {
-    const char* name;
-    bool        isInit;
-    int         sockFd;
-    js_config_t config;
-    uint8_t*    rawReport;
-    size_t      rawReportSize;
+    const char*             name;
+    bool                    isInit;
+    int                     sockFd;
+    int                     connectFd; //!< Connection to the server in progress (-1 == none)
+    const hid_descriptor_t* descriptor;
+    js_config_t             config;
+    uint8_t                 rawReport[HID_REPORT_MAX_SIZE] __attribute__((aligned(4)));
+    size_t                  rawReportSize;
+
+    // Last report sent, used to suppress reports that haven't changed
+    uint8_t  sentReport[HID_REPORT_MAX_SIZE] __attribute__((aligned(4)));
+    uint64_t sentTicks; //!< Time the last report was sent (from time_util_ticks())
+
+    net_stats_t        stats;      //!< Send-path counters for the device's connection
+    net_util_backlog_t txBacklog;  //!< Unsent tail of the last frame, while the socket buffer is full
+    uint64_t           stateTicks; //!< Time of the last connect/disconnect (from time_util_ticks())
+    uint64_t           retryTicks; //!< Time before which no connection to the server is started
+
+    framing_type_t         framing;        //!< Framing codec used on the device's connection
+    framing_decoder_t*     rxDecoder;      //!< Decoder for messages received from the server
+    uint32_t               configHash;     //!< Hash of the device's configuration, used to resume sessions
+    uint64_t               sessionToken;   //!< Session token assigned by the server (valid if hasSession)
+    bool                   hasSession;     //!< The server has assigned a session token to the device
+    bool                   resumePending;  //!< A resume request was sent; awaiting the server's reply
+    bool                   needConfig;     //!< The server rejected a resume; full configuration must be sent
+    bool                   forceReport;    //!< Send the next report even if the input hasn't changed
+    bool                   isMotionSensor; //!< Reports are suspended while idle
+    bool                   buttonFrames;   //!< Send button-only changes as NetstickTagButtons messages
+    uint64_t               analogTicks;    //!< Shortest time between reports sent for axis changes alone
+    uint64_t               optionTicks;    //!< analogTicks as configured by the user (restored on server request)
+    uint64_t               coalesceTicks;  //!< Time an axis change is held before it is sent (set by the server)
+    uint64_t               axisTicks;      //!< Time the oldest unsent axis change was seen (0 == none pending)
+    bool                   motionOff;      //!< The server asked the (motion-sensor) device to stop reporting
+    congestion_shed_t      shed;           //!< How the device's axis updates are degraded under congestion
+    uint64_t               shedTicks;      //!< shed.intervalUs, in ticks
+    bool                   shedding;       //!< Axis updates are currently degraded to relieve congestion
+    uint32_t               echoSequence;   //!< Sequence number of the last keepalive echoed by the server
+    uint64_t               echoTicks;      //!< Time the last keepalive echo was received (0 == none)
+
+    mirror_t mirrors[PROGRAM_OPTIONS_MIRROR_MAX]; //!< Secondary destinations sent a copy of the device's stream
+    size_t   mirrorCount;                         //!< Number of mirrors in use
+
+    snapshot_latch_t    statusLatch;     //!< Guards statusCopies (see hid_device_read_status())
+    hid_device_status_t statusCopies[2]; //!< Connection state, as last published by the sender thread
+
+    // Motion hints: reports carry their sample time and a velocity for each
+    // absolute axis (NetstickTagHintedReport), for receiver-side extrapolation
+    bool          motionHints;                        //!< Send hinted reports (set by devices that support them)
+    motion_hint_t motionHint;                         //!< Recent axis samples, for the velocity estimates
+    int32_t       sentVelocity[MOTION_HINT_MAX_AXES]; //!< Velocities sent with the last report
 
     hid_config_handler_t configHandlerFn;
     hid_event_handler_t  eventHandlerFn;
@@ -44,13 +125,17 @@ typedef struct hid_device {
  * type of device.
  * @param device_ pointer to the object used to create the object
  * @param name_ name used to give the device additional context in logging functions
- * @param configHandler_ function invoked during HID device configuration
+ * @param descriptor_ static description of the device, used to generate its
+ * configuration and size its report
+ * @param configHandler_ optional function invoked during HID device
+ * configuration to apply option-specific changes to the generated config (may be NULL)
  * @param eventHandler_ function invoked during HID device event handling
  * @param options_ program options object used in configuring the device
  * @return true on success, false on failure
  */
 bool hid_device_init(hid_device_t*            device_,
                      const char*              name_,
+                     const hid_descriptor_t*  descriptor_,
                      hid_config_handler_t     configHandler_,
                      hid_event_handler_t      eventHandler_,
                      const program_options_t* options_);
@@ -60,12 +145,86 @@ bool hid_device_init(hid_device_t*            device_,
  * @brief handle_hid_events run the HID event handling routine associated with
  * the device.  This abstracts the HID device's periodic event polling logic,
  * and performs connection management operations on behalf of the HID device.
+ * The report built by the device is only sent if it differs meaningfully from
+ * the last one sent -- absolute-axis changes within half the axis' fuzz value,
+ * or within its flat zone, are ignored -- or if no report has been sent for
+ * the configured refresh interval.  Button changes are sent immediately, as a
+ * button message if enabled; changes to axes alone are held back until
+ * analogTicks have passed since the last report, and for coalesceTicks after
+ * they were first seen.  Pacing can be changed by the server at any time with
+ * a rate control message, which is applied as soon as it is received.  While
+ * the device is shedding load (see hid_device_set_shedding()), axis changes
+ * are further limited to its congestion policy's interval and resolution.
+ * Each report and button message is encoded once, and the same frame is sent
+ * to the device's mirrors (if any) after the server; a mirror that can't keep
+ * up drops frames without delaying the server's connection.  Each destination
+ * has its own connection state: reports are built and sent to the mirrors
+ * while the server is disconnected, waiting to be retried, or behind.  After a
+ * socket error, the server's connection is retried every couple of seconds;
+ * connections are made without waiting.  With motion
+ * hints, a report is also sent when the velocities last sent no longer match
+ * the axes' motion (e.g. when a stick stops), even if no value has changed.
+ * A full socket buffer never closes the connection: the rest of a frame that
+ * didn't fit is sent first on later polls, and reports that can't be sent in
+ * the meantime are dropped, with the next one forced out once it clears.
  * @param device_ pointer to the HID device object to process
  * @param options_ program options, used by the device to choose how to process
  * its event data.
- * @return true on success, false on failure
+ * @param input_ input snapshot from which the device builds its report
+ * @return true if the device is connected to the server, false if its
+ * connection failed or is waiting to be retried
+ */
+bool handle_hid_events(hid_device_t* device_, const program_options_t* options_, const input_state_t* input_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief hid_device_publish_status Publish the state of the device's
+ * connection (from the thread that services the device).  Never blocks.
+ * @param device_ pointer to the HID device object
+ */
+void hid_device_publish_status(hid_device_t* device_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief hid_device_read_status Read the state of the device's connection, as
+ * last published, from any thread.  Never waits for the publishing thread.
+ * @param device_ pointer to the HID device object
+ * @param status_ [out] state of the device's connection
+ * @return true on success, false if the state was republished during each
+ * attempt
+ */
+bool hid_device_read_status(const hid_device_t* device_, hid_device_status_t* status_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief hid_device_send_report Transmit the device's current raw report on
+ * its connection (and to its mirrors), updating the device's send-path
+ * counters and last-sent report.  If the socket buffer is full, the report is
+ * dropped and the next one forced.
+ * @param device_ pointer to the HID device object whose report is sent
+ * @return true on success (including a dropped report), false on socket error
+ */
+bool hid_device_send_report(hid_device_t* device_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief hid_device_set_shedding Start or stop degrading the device's axis
+ * updates according to its congestion policy (shed).  Button changes are
+ * unaffected.  When shedding stops, the device's full-precision state is sent
+ * on the next poll.
+ * @param device_ pointer to the HID device object to update
+ * @param shedding_ true to degrade the device's axis updates, false to restore them
+ */
+void hid_device_set_shedding(hid_device_t* device_, bool shedding_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief hid_device_disconnect Close the device's connection to the server (if
+ * open).  The connection is re-established by handle_hid_events() after a
+ * delay, and any pacing the server requested is dropped.
+ * @param device_ pointer to the HID device object to disconnect
  */
-bool handle_hid_events(hid_device_t* device_, const program_options_t* options_);
+void hid_device_disconnect(hid_device_t* device_);
 
 #if defined(__cplusplus)
 } // extern "C"
@@ -3,11 +3,9 @@
 
 #include "hid_device.h"
 #include "hid_common.h"
-
-#include "net_util.h"
+#include "hid_descriptor.h"
 
 #include <string.h>
-#include <malloc.h>
 
 #include <3ds.h>
 
@@ -19,64 +17,45 @@
 #define TOUCHSCREEN_HEIGHT (240)
 
 //---------------------------------------------------------------------------
-#define RAW_REPORT_TOUCH_SIZE (sizeof(uint8_t) + (2 * sizeof(int32_t)))
+// Touchscreen axes: AXIS(field, linux ID, min, max, fuzz, flat).  The axis
+// maxima are reduced by the configured touch offset at init.
+#define TOUCH_ABS_AXES(AXIS)                                                                                           \
+    AXIS(x, LINUX_ABS_X, 0, TOUCHSCREEN_WIDTH, 0, 0)                                                                   \
+    AXIS(y, LINUX_ABS_Y, 0, TOUCHSCREEN_HEIGHT, 0, 0)
+
+#define TOUCH_REL_AXES(REL)
+
+// Touchscreen buttons: BUTTON(field, linux ID, 3DS key mask)
+#define TOUCH_BUTTONS(BUTTON) BUTTON(touch, LINUX_BTN_TOUCH, (1u << NDS_KEY_TOUCH))
+
+HID_DESCRIPTOR_DEFINE(hid_touch_report_t,
+                      touchDescriptor,
+                      NINTENDO_3DS_NAME_TOUCH,
+                      NINTENDO_USB_VID,
+                      NINTENDO_USB_PID + 1, // Dummy value
+                      TOUCH_ABS_AXES,
+                      TOUCH_REL_AXES,
+                      TOUCH_BUTTONS);
 
 //---------------------------------------------------------------------------
 static bool hid_touch_config(hid_device_t* device_, const program_options_t* options_)
 {
     js_config_t* config = &device_->config;
 
-    // Set the device identifiers for the 3DS
-    config->pid = NINTENDO_USB_PID + 1; // Dummy value
-    config->vid = NINTENDO_USB_VID;
-    strcpy(config->name, NINTENDO_3DS_NAME_TOUCH);
-
-    // Set the count of buttons/axis supported by the 3DS
-    config->absAxisCount = 2;
-
-    // Set up a single button to handle touch events
-    config->buttonCount = 1;
-    config->buttons[0]  = LINUX_BTN_TOUCH;
-
-    config->relAxisCount = 0;
-
-    // Set up the 3DS's touchscreen parameters
-    config->absAxis[0] = LINUX_ABS_X;
-    config->absAxis[1] = LINUX_ABS_Y;
-
-    config->absAxisMin[0] = 0;
+    // Shrink the active area of the touchscreen by the configured offset
     config->absAxisMax[0] = TOUCHSCREEN_WIDTH - (options_->touchOffset * 2);
-
-    config->absAxisMin[1] = 0;
     config->absAxisMax[1] = TOUCHSCREEN_HEIGHT - (options_->touchOffset * 2);
 
-    device_->rawReportSize = RAW_REPORT_TOUCH_SIZE;
-    device_->rawReport     = (uint8_t*)malloc(device_->rawReportSize);
-
     return true;
 }
 
 //---------------------------------------------------------------------------
-static bool hid_touch_event(hid_device_t* device_, const program_options_t* options_)
+static bool hid_touch_event(hid_device_t* device_, const program_options_t* options_, const input_state_t* input_)
 {
-    js_report_t  report = {};
-    js_config_t* config = &device_->config;
-
-    uint8_t* rawReport = device_->rawReport;
-    report.absAxis     = (int32_t*)rawReport;
-    report.relAxis     = (int32_t*)(rawReport + (sizeof(int32_t) * config->absAxisCount));
-    report.buttons
-        = (uint8_t*)(rawReport + (sizeof(int32_t) * config->absAxisCount) + (sizeof(int32_t) * config->relAxisCount));
-
-    bool doUpdate = true;
-
-    static int32_t  lastX    = 0;
-    static int32_t  lastY    = 0;
-    static uint32_t lastKeys = 0;
+    hid_touch_report_t* report = (hid_touch_report_t*)device_->rawReport;
 
-    uint32_t      keys = hidKeysHeld();
-    touchPosition touch;
-    hidTouchRead(&touch);
+    uint32_t      keys  = input_->keys;
+    touchPosition touch = { input_->touchX, input_->touchY };
 
     // clamp touch events to limits set by border offsets
     if (touch.px < options_->touchOffset) {
@@ -95,40 +74,29 @@ static bool hid_touch_event(hid_device_t* device_, const program_options_t* opti
         touch.py -= options_->touchOffset;
     }
 
-    // Only send an update if there's a change in the data...
-    if ((keys == lastKeys) && (touch.px == lastX) && (touch.py == lastY)) {
-        doUpdate = false;
-    }
-
+    // While the screen isn't touched, the report keeps the last touched position
     if (keys & (1 << NDS_KEY_TOUCH)) {
-        report.absAxis[0] = touch.px;
-        report.absAxis[1] = touch.py;
-
-        lastX = touch.px;
-        lastY = touch.py;
+        report->x = touch.px;
+        report->y = touch.py;
 
         if (options_->sendTouchDownEvent == true) {
-            report.buttons[0] = 1;
-        }
-    } else {
-        report.absAxis[0] = lastX;
-        report.absAxis[1] = lastY;
-
-        if (options_->sendTouchDownEvent == true) {
-            report.buttons[0] = 0;
+            report->touch = 1;
         }
+    } else if (options_->sendTouchDownEvent == true) {
+        report->touch = 0;
     }
 
-    lastKeys = keys;
-
-    if (doUpdate) {
-        return net_util_encode_and_transmit(device_->sockFd, 1, device_->rawReport, device_->rawReportSize);
-    }
     return true;
 }
 
 //---------------------------------------------------------------------------
 bool hid_touch_init(hid_device_t* device_, const program_options_t* options_)
 {
-    return hid_device_init(device_, "touch", hid_touch_config, hid_touch_event, options_);
+    if (!hid_device_init(device_, "touch", &touchDescriptor, hid_touch_config, hid_touch_event, options_)) {
+        return false;
+    }
+    device_->shed.level      = CongestionLevelTouch;
+    device_->shed.intervalUs = NDS_TOUCH_SHED_INTERVAL_US;
+    device_->shed.steps      = 0;
+    return true;
 }
@@ -0,0 +1,119 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "histogram.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+static size_t histogram_bucket_index(uint32_t value_)
+{
+    if (value_ < HISTOGRAM_SUB_BUCKETS) {
+        return value_;
+    }
+
+    // Position of the most-significant bit selects the power-of-two range,
+    // the next HISTOGRAM_SUB_BUCKET_BITS bits select the linear bucket within it.
+    uint32_t msb   = 31 - __builtin_clz(value_);
+    uint32_t shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+    return ((shift + 1) * HISTOGRAM_SUB_BUCKETS) + ((value_ >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+//---------------------------------------------------------------------------
+uint32_t histogram_bucket_lower(size_t index_)
+{
+    if (index_ < HISTOGRAM_SUB_BUCKETS) {
+        return (uint32_t)index_;
+    }
+    uint32_t shift = (index_ / HISTOGRAM_SUB_BUCKETS) - 1;
+    return (uint32_t)(HISTOGRAM_SUB_BUCKETS + (index_ % HISTOGRAM_SUB_BUCKETS)) << shift;
+}
+
+//---------------------------------------------------------------------------
+uint32_t histogram_bucket_upper(size_t index_)
+{
+    if (index_ < HISTOGRAM_SUB_BUCKETS) {
+        return (uint32_t)index_;
+    }
+    uint32_t shift = (index_ / HISTOGRAM_SUB_BUCKETS) - 1;
+    return histogram_bucket_lower(index_) + ((1u << shift) - 1);
+}
+
+//---------------------------------------------------------------------------
+void histogram_init(histogram_t* hist_)
+{
+    memset(hist_, 0, sizeof(*hist_));
+    hist_->min = UINT32_MAX;
+}
+
+//---------------------------------------------------------------------------
+void histogram_record(histogram_t* hist_, uint32_t value_)
+{
+    hist_->counts[histogram_bucket_index(value_)]++;
+    hist_->total++;
+    hist_->sum += value_;
+
+    if (value_ < hist_->min) {
+        hist_->min = value_;
+    }
+    if (value_ > hist_->max) {
+        hist_->max = value_;
+    }
+}
+
+//---------------------------------------------------------------------------
+uint32_t histogram_percentile(const histogram_t* hist_, double quantile_)
+{
+    if (hist_->total == 0) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)((double)hist_->total * quantile_);
+    if (target >= hist_->total) {
+        target = hist_->total - 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+        seen += hist_->counts[i];
+        if (seen > target) {
+            uint32_t upper = histogram_bucket_upper(i);
+            // Don't report a value larger than anything we've actually seen
+            return (upper > hist_->max) ? hist_->max : upper;
+        }
+    }
+    return hist_->max;
+}
+
+//---------------------------------------------------------------------------
+uint32_t histogram_mean(const histogram_t* hist_)
+{
+    if (hist_->total == 0) {
+        return 0;
+    }
+    return (uint32_t)(hist_->sum / hist_->total);
+}
+
+//---------------------------------------------------------------------------
+void histogram_delta(histogram_t* out_, const histogram_t* current_, const histogram_t* previous_)
+{
+    histogram_init(out_);
+
+    out_->total = current_->total - previous_->total;
+    out_->sum   = current_->sum - previous_->sum;
+
+    // Exact min/max aren't recoverable for the window -- use the bounds of the
+    // populated buckets instead.
+    for (size_t i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+        out_->counts[i] = current_->counts[i] - previous_->counts[i];
+        if (out_->counts[i]) {
+            if (out_->min == UINT32_MAX) {
+                out_->min = histogram_bucket_lower(i);
+            }
+            out_->max = histogram_bucket_upper(i);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Log-linear histogram layout: each power-of-two range is split into
+// HISTOGRAM_SUB_BUCKETS linear buckets, bounding the relative error of any
+// reported value to 1/HISTOGRAM_SUB_BUCKETS across the full 32-bit range.
+#define HISTOGRAM_SUB_BUCKET_BITS (3)
+#define HISTOGRAM_SUB_BUCKETS (1u << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKET_COUNT ((32 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+//---------------------------------------------------------------------------
+// Fixed-size histogram object -- no allocations are performed when recording
+// values, so it's safe to use from the input hot-path.
+typedef struct {
+    uint32_t counts[HISTOGRAM_BUCKET_COUNT]; //!< Number of samples recorded in each bucket
+    uint32_t total;                          //!< Total number of samples recorded
+    uint32_t min;                            //!< Smallest value recorded
+    uint32_t max;                            //!< Largest value recorded
+    uint64_t sum;                            //!< Sum of all values recorded (used to compute the mean)
+} histogram_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief histogram_init Initialize (or reset) a histogram object, discarding
+ * any previously-recorded samples.
+ * @param hist_ histogram to initialize
+ */
+void histogram_init(histogram_t* hist_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief histogram_record Add a sample to the histogram
+ * @param hist_ histogram to update
+ * @param value_ value to record
+ */
+void histogram_record(histogram_t* hist_, uint32_t value_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief histogram_percentile Return the value at or below which a given
+ * fraction of the recorded samples fall.
+ * @param hist_ histogram to query
+ * @param quantile_ fraction of samples (0.0 - 1.0), i.e. 0.99 for p99
+ * @return upper bound of the bucket containing the requested quantile, or 0
+ * if no samples have been recorded.
+ */
+uint32_t histogram_percentile(const histogram_t* hist_, double quantile_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief histogram_mean Return the arithmetic mean of all recorded samples
+ * @param hist_ histogram to query
+ * @return mean value of the samples, or 0 if no samples have been recorded
+ */
+uint32_t histogram_mean(const histogram_t* hist_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief histogram_delta Compute a histogram containing only the samples
+ * recorded into current_ since previous_ was copied from it.  Used to derive
+ * windowed statistics from a cumulative histogram without resetting it.
+ * @param out_ [out] histogram containing the difference
+ * @param current_ cumulative histogram
+ * @param previous_ earlier snapshot of the same cumulative histogram
+ */
+void histogram_delta(histogram_t* out_, const histogram_t* current_, const histogram_t* previous_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief histogram_bucket_lower Return the smallest value that maps to the
+ * specified bucket index.
+ * @param index_ bucket index (0 - HISTOGRAM_BUCKET_COUNT - 1)
+ * @return lower bound of the bucket
+ */
+uint32_t histogram_bucket_lower(size_t index_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief histogram_bucket_upper Return the largest value that maps to the
+ * specified bucket index.
+ * @param index_ bucket index (0 - HISTOGRAM_BUCKET_COUNT - 1)
+ * @return upper bound of the bucket
+ */
+uint32_t histogram_bucket_upper(size_t index_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
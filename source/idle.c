@@ -0,0 +1,103 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "idle.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <3ds.h>
+
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+// Analog movement (in counts) from the last active position that counts as
+// activity -- large enough to ignore circle-pad jitter.
+#define IDLE_AXIS_THRESHOLD (8)
+
+#define ABS(x) (((x) < 0) ? ((x) * -1) : (x))
+
+//---------------------------------------------------------------------------
+static void idle_enter(idle_state_t* idle_, uint64_t now_)
+{
+    idle_->idle      = true;
+    idle_->idleSince = now_;
+    idle_->idleEntries++;
+
+    if (idle_->backlightOff) {
+        GSPLCD_PowerOffBacklight(GSPLCD_SCREEN_BOTH);
+    }
+}
+
+//---------------------------------------------------------------------------
+static void idle_leave(idle_state_t* idle_, uint64_t now_)
+{
+    idle_->idle = false;
+    idle_->idleTicksTotal += now_ - idle_->idleSince;
+
+    if (idle_->backlightOff) {
+        GSPLCD_PowerOnBacklight(GSPLCD_SCREEN_BOTH);
+    }
+}
+
+//---------------------------------------------------------------------------
+void idle_init(idle_state_t* idle_, uint32_t timeoutMs_, uint32_t pollMs_, bool backlightOff_)
+{
+    memset(idle_, 0, sizeof(*idle_));
+
+    if (pollMs_ == 0) {
+        pollMs_ = IDLE_DEFAULT_POLL_MS;
+    }
+
+    idle_->enabled      = (timeoutMs_ != 0);
+    idle_->backlightOff = backlightOff_;
+    idle_->timeoutTicks = time_util_us_to_ticks((uint64_t)timeoutMs_ * 1000ULL);
+    idle_->pollPeriodNs = (uint64_t)pollMs_ * 1000000ULL;
+    idle_->lastActivity = time_util_ticks();
+}
+
+//---------------------------------------------------------------------------
+bool idle_update(idle_state_t* idle_, const input_state_t* input_)
+{
+    if (!idle_->enabled) {
+        return false;
+    }
+
+    uint64_t now  = input_->ticks;
+    uint32_t keys = input_->keys;
+
+    int16_t axis[4] = { input_->circleX, input_->circleY, input_->cstickX, input_->cstickY };
+
+    // Any change in buttons (including touch), held buttons, or significant
+    // analog movement counts as activity.
+    bool active = (keys != idle_->lastKeys) || (keys != 0);
+    for (int i = 0; i < 4; i++) {
+        if (ABS(axis[i] - idle_->lastAxis[i]) > IDLE_AXIS_THRESHOLD) {
+            active = true;
+        }
+    }
+
+    if (active) {
+        idle_->lastActivity = now;
+        idle_->lastKeys     = keys;
+        memcpy(idle_->lastAxis, axis, sizeof(axis));
+
+        if (idle_->idle) {
+            idle_leave(idle_, now);
+        }
+    } else if (!idle_->idle && ((now - idle_->lastActivity) >= idle_->timeoutTicks)) {
+        idle_enter(idle_, now);
+    }
+
+    return idle_->idle;
+}
+
+//---------------------------------------------------------------------------
+void idle_exit(idle_state_t* idle_)
+{
+    if (idle_->idle) {
+        idle_leave(idle_, time_util_ticks());
+    }
+}
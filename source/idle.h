@@ -0,0 +1,70 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "input_state.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Default poll period used while idle, if not set in the config file
+#define IDLE_DEFAULT_POLL_MS (50)
+
+//---------------------------------------------------------------------------
+// State of the idle detector.  The detector watches the buttons, circle pad,
+// c-stick and touchscreen for activity; motion sensors are deliberately not
+// considered, as they never settle completely while the console is held.
+typedef struct {
+    bool     enabled;        //!< Idle detection is enabled
+    bool     idle;           //!< Currently in idle mode
+    bool     backlightOff;   //!< Turn the backlights off while idle
+    uint64_t timeoutTicks;   //!< Inactivity period before entering idle mode
+    uint64_t pollPeriodNs;   //!< Period between polls while idle
+    uint64_t lastActivity;   //!< Time of the last input activity
+    uint64_t idleSince;      //!< Time idle mode was last entered
+    uint32_t lastKeys;       //!< Buttons held at the last activity
+    int16_t  lastAxis[4];    //!< Circle pad / c-stick position at the last activity
+    uint32_t idleEntries;    //!< Number of times idle mode was entered
+    uint64_t idleTicksTotal; //!< Total time spent in idle mode (excluding the current period)
+} idle_state_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief idle_init Initialize the idle detector
+ * @param idle_ object to initialize
+ * @param timeoutMs_ inactivity period before entering idle mode (0 == disabled)
+ * @param pollMs_ poll period while idle (0 == IDLE_DEFAULT_POLL_MS)
+ * @param backlightOff_ turn the backlights off while idle
+ */
+void idle_init(idle_state_t* idle_, uint32_t timeoutMs_, uint32_t pollMs_, bool backlightOff_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief idle_update Examine an input snapshot for activity, entering or
+ * leaving idle mode as appropriate.  Must be called for each snapshot taken.
+ * Any input edge leaves idle mode immediately, so the poll that observed it is
+ * processed at full rate.
+ * @param idle_ idle detector to update
+ * @param input_ most recent input snapshot
+ * @return true if the detector is in idle mode after the update
+ */
+bool idle_update(idle_state_t* idle_, const input_state_t* input_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief idle_exit Leave idle mode (if idle) and restore the display.  Called
+ * before the application exits.
+ * @param idle_ idle detector to update
+ */
+void idle_exit(idle_state_t* idle_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,232 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "input_capture.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <3ds.h>
+
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+// HID shared memory layout (in 32-bit words), as used by libctru's
+// hidScanInput().  Each section starts with the timestamps of its newest and
+// previous entries, and the index of its newest entry.
+#define HID_SECTION_TICK (0)
+#define HID_SECTION_PREV_TICK (2)
+#define HID_SECTION_INDEX (4)
+
+#define HID_PAD_SECTION (0)
+#define HID_PAD_ENTRIES (HID_PAD_SECTION + 10)
+#define HID_PAD_ENTRY_WORDS (4) // held, pressed, released, circle pad (dx | dy << 16)
+#define HID_PAD_ENTRY_KEYS (0)
+#define HID_PAD_ENTRY_CIRCLE (3)
+
+#define HID_TOUCH_SECTION (42)
+#define HID_TOUCH_ENTRIES (HID_TOUCH_SECTION + 8)
+#define HID_TOUCH_ENTRY_WORDS (2) // position (px | py << 16), touched
+#define HID_TOUCH_ENTRY_POSITION (0)
+#define HID_TOUCH_ENTRY_TOUCHED (1)
+
+#define INPUT_CAPTURE_RING_MASK (INPUT_CAPTURE_RING_DEPTH - 1)
+#define INPUT_CAPTURE_READ_ATTEMPTS (3)
+
+// Sample period assumed when a ring's timestamps can't provide one
+#define INPUT_CAPTURE_NOMINAL_PERIOD_US (4000)
+
+// Keys that don't come from the pad ring (they're merged in from the IR
+// service by hidScanInput()), and so are only known at the poll rate.
+#define INPUT_CAPTURE_IRRST_KEYS                                                                                       \
+    (KEY_ZL | KEY_ZR | KEY_CSTICK_RIGHT | KEY_CSTICK_LEFT | KEY_CSTICK_UP | KEY_CSTICK_DOWN)
+
+_Static_assert((INPUT_CAPTURE_RING_DEPTH & INPUT_CAPTURE_RING_MASK) == 0, "ring depth must be a power of two");
+
+//---------------------------------------------------------------------------
+// Consistent copy of one shared-memory ring
+typedef struct {
+    uint64_t tick;                                                  //!< Time of the newest entry
+    uint64_t period;                                                //!< Time between entries
+    uint32_t index;                                                 //!< Index of the newest entry
+    uint32_t words[INPUT_CAPTURE_RING_DEPTH * HID_PAD_ENTRY_WORDS]; //!< Entries
+    size_t   count;                                                 //!< New entries since the last drain
+    size_t   next;                                                  //!< Next new entry to consume (0 = oldest)
+} input_capture_section_t;
+
+//---------------------------------------------------------------------------
+static uint64_t input_capture_tick(size_t word_)
+{
+    return (uint64_t)hidSharedMem[word_] | ((uint64_t)hidSharedMem[word_ + 1] << 32);
+}
+
+//---------------------------------------------------------------------------
+// The HID module updates the rings concurrently, so the copy is retried if
+// the newest entry changed while it was being made.
+static bool input_capture_read_section(size_t                   section_,
+                                       size_t                   entries_,
+                                       size_t                   entryWords_,
+                                       input_capture_section_t* out_)
+{
+    for (int attempt = 0; attempt < INPUT_CAPTURE_READ_ATTEMPTS; attempt++) {
+        uint64_t tick     = input_capture_tick(section_ + HID_SECTION_TICK);
+        uint64_t prevTick = input_capture_tick(section_ + HID_SECTION_PREV_TICK);
+        uint32_t index    = hidSharedMem[section_ + HID_SECTION_INDEX];
+
+        for (size_t i = 0; i < (INPUT_CAPTURE_RING_DEPTH * entryWords_); i++) {
+            out_->words[i] = hidSharedMem[entries_ + i];
+        }
+
+        if (input_capture_tick(section_ + HID_SECTION_TICK) == tick) {
+            // A sample published late can land right behind its predecessor,
+            // so only trust measured periods close to the nominal one.
+            uint64_t nominal = time_util_us_to_ticks(INPUT_CAPTURE_NOMINAL_PERIOD_US);
+            uint64_t period  = ((prevTick != 0) && (prevTick < tick)) ? (tick - prevTick) : nominal;
+            if ((period < (nominal / 2)) || (period > (nominal * 2))) {
+                period = nominal;
+            }
+
+            out_->tick   = tick;
+            out_->index  = (index > INPUT_CAPTURE_RING_MASK) ? INPUT_CAPTURE_RING_MASK : index;
+            out_->period = period;
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------
+// Work out how many entries have been added since the last drain, and
+// advance the read position past them.
+static void input_capture_advance(input_capture_t*         capture_,
+                                  input_capture_ring_t*    ring_,
+                                  input_capture_section_t* section_)
+{
+    section_->count = 0;
+    section_->next  = 0;
+
+    if (section_->tick == ring_->tick) {
+        return;
+    }
+
+    // The index wraps every INPUT_CAPTURE_RING_DEPTH entries, so use the
+    // elapsed time to tell whether the ring has lapped since the last drain.
+    uint64_t elapsed  = section_->tick - ring_->tick;
+    uint64_t expected = (elapsed + (section_->period / 2)) / section_->period;
+    size_t   count    = (section_->index - ring_->index) & INPUT_CAPTURE_RING_MASK;
+
+    if ((count == 0) || (expected > INPUT_CAPTURE_RING_DEPTH)) {
+        count = INPUT_CAPTURE_RING_DEPTH;
+        capture_->overruns++;
+    }
+
+    section_->count = count;
+    ring_->index    = section_->index;
+    ring_->tick     = section_->tick;
+    capture_->entries += count;
+}
+
+//---------------------------------------------------------------------------
+// Ring index and interpolated time of the next unconsumed entry
+static uint32_t input_capture_next_entry(const input_capture_section_t* section_, uint64_t* ticks_)
+{
+    size_t stepsBack = section_->count - 1 - section_->next;
+    *ticks_          = section_->tick - (stepsBack * section_->period);
+    return (section_->index - stepsBack) & INPUT_CAPTURE_RING_MASK;
+}
+
+//---------------------------------------------------------------------------
+void input_capture_init(input_capture_t* capture_)
+{
+    memset(capture_, 0, sizeof(*capture_));
+}
+
+//---------------------------------------------------------------------------
+size_t input_capture_drain(input_capture_t* capture_, const input_state_t* current_, input_state_t* edges_)
+{
+    input_capture_section_t pad;
+    input_capture_section_t touch;
+
+    if (!input_capture_read_section(HID_PAD_SECTION, HID_PAD_ENTRIES, HID_PAD_ENTRY_WORDS, &pad)
+        || !input_capture_read_section(HID_TOUCH_SECTION, HID_TOUCH_ENTRIES, HID_TOUCH_ENTRY_WORDS, &touch)) {
+        return 0;
+    }
+
+    if (!capture_->primed) {
+        capture_->pad.index   = pad.index;
+        capture_->pad.tick    = pad.tick;
+        capture_->touch.index = touch.index;
+        capture_->touch.tick  = touch.tick;
+        capture_->keys        = current_->keys;
+        capture_->primed      = true;
+        return 0;
+    }
+
+    input_capture_advance(capture_, &capture_->pad, &pad);
+    input_capture_advance(capture_, &capture_->touch, &touch);
+
+    // Replay both rings' entries in time order, producing a snapshot for each
+    // change in key state.
+    input_state_t state  = *current_;
+    uint32_t      keys   = capture_->keys & ~INPUT_CAPTURE_IRRST_KEYS;
+    uint64_t      now    = time_util_ticks();
+    size_t        nEdges = 0;
+
+    state.allDevices = false;
+    state.idle       = false;
+
+    while ((pad.next < pad.count) || (touch.next < touch.count)) {
+        uint64_t padTicks   = UINT64_MAX;
+        uint64_t touchTicks = UINT64_MAX;
+        uint32_t padEntry   = 0;
+        uint32_t touchEntry = 0;
+        bool     touchEdge  = false;
+
+        if (pad.next < pad.count) {
+            padEntry = input_capture_next_entry(&pad, &padTicks);
+        }
+        if (touch.next < touch.count) {
+            touchEntry = input_capture_next_entry(&touch, &touchTicks);
+        }
+
+        if (padTicks <= touchTicks) {
+            const uint32_t* entry  = &pad.words[padEntry * HID_PAD_ENTRY_WORDS];
+            uint32_t        circle = entry[HID_PAD_ENTRY_CIRCLE];
+
+            keys = (keys & KEY_TOUCH) | (entry[HID_PAD_ENTRY_KEYS] & ~(KEY_TOUCH | INPUT_CAPTURE_IRRST_KEYS));
+            state.ticks   = padTicks;
+            state.circleX = (int16_t)(circle & 0xFFFF);
+            state.circleY = (int16_t)(circle >> 16);
+            pad.next++;
+        } else {
+            const uint32_t* entry    = &touch.words[touchEntry * HID_TOUCH_ENTRY_WORDS];
+            uint32_t        position = entry[HID_TOUCH_ENTRY_POSITION];
+            uint32_t        touched  = entry[HID_TOUCH_ENTRY_TOUCHED] ? KEY_TOUCH : 0;
+
+            touchEdge    = ((keys & KEY_TOUCH) != touched);
+            keys         = (keys & ~KEY_TOUCH) | touched;
+            state.ticks  = touchTicks;
+            state.touchX = (uint16_t)(position & 0xFFFF);
+            state.touchY = (uint16_t)(position >> 16);
+            touch.next++;
+        }
+
+        state.keys = keys | (current_->keys & INPUT_CAPTURE_IRRST_KEYS);
+        if (((state.keys ^ capture_->keys) & ~INPUT_CAPTURE_IRRST_KEYS) && (nEdges < INPUT_CAPTURE_MAX_EDGES)) {
+            // Touch edges are also reported by the touchscreen device
+            edges_[nEdges]            = state;
+            edges_[nEdges].allDevices = touchEdge;
+            capture_->keys            = state.keys;
+            capture_->edgeAgeTicks += now - state.ticks;
+            nEdges++;
+        }
+    }
+
+    capture_->edges += nEdges;
+    if (nEdges > 1) {
+        capture_->hiddenEdges += nEdges - 1;
+    }
+    return nEdges;
+}
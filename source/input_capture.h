@@ -0,0 +1,75 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "input_state.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// The HID module records pad and touch samples into rings of this many
+// entries in HID shared memory, several times per frame.  hidScanInput() only
+// latches the newest entry of each ring, so a button tapped and released
+// between two scans is never seen; draining every entry added since the last
+// poll recovers it.
+#define INPUT_CAPTURE_RING_DEPTH (8)
+
+// Largest number of edge snapshots produced by a single drain
+#define INPUT_CAPTURE_MAX_EDGES (2 * INPUT_CAPTURE_RING_DEPTH)
+
+//---------------------------------------------------------------------------
+// Read position and counters for one shared-memory ring
+typedef struct {
+    uint32_t index; //!< Index of the newest entry consumed
+    uint64_t tick;  //!< Section timestamp of the newest entry consumed
+} input_capture_ring_t;
+
+//---------------------------------------------------------------------------
+// Sub-frame input capture state
+typedef struct {
+    bool                 primed;       //!< Ring positions have been initialized
+    input_capture_ring_t pad;          //!< Pad ring read position
+    input_capture_ring_t touch;        //!< Touch ring read position
+    uint32_t             keys;         //!< Key state as of the newest entry consumed
+    uint32_t             entries;      //!< Ring entries consumed
+    uint32_t             edges;        //!< Edge snapshots produced
+    uint32_t             hiddenEdges;  //!< Edges that polling alone would have missed or merged
+    uint32_t             overruns;     //!< Drains that found more new entries than the ring holds
+    uint64_t             edgeAgeTicks; //!< Sum of the time between each edge and the drain that found it
+} input_capture_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief input_capture_init Initialize the capture state.  The first drain
+ * only records the rings' positions.
+ * @param capture_ capture state to initialize
+ */
+void input_capture_init(input_capture_t* capture_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief input_capture_drain Read every pad and touch entry that the HID
+ * module has added since the previous drain, and produce a snapshot for each
+ * change in key state, oldest first.  Entries don't carry their own
+ * timestamps -- each ring only records the time of its newest two entries --
+ * so each snapshot's ticks are interpolated from the ring's sample period.
+ * Call before hidScanInput(), so that the poll's own snapshot is never older
+ * than the edges produced here.
+ * @param capture_ capture state
+ * @param current_ most recent snapshot; supplies the inputs not recorded in
+ * the rings (motion sensors, c-stick)
+ * @param edges_ [out] array of at least INPUT_CAPTURE_MAX_EDGES snapshots
+ * @return number of edge snapshots written to edges_
+ */
+size_t input_capture_drain(input_capture_t* capture_, const input_state_t* current_, input_state_t* edges_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,80 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "input_ring.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+#define INPUT_RING_MASK (INPUT_RING_SIZE - 1)
+
+_Static_assert((INPUT_RING_SIZE & INPUT_RING_MASK) == 0, "INPUT_RING_SIZE must be a power of two");
+
+//---------------------------------------------------------------------------
+static bool input_ring_publish(input_ring_t* ring_, const input_state_t* state_)
+{
+    uint_fast32_t head = atomic_load_explicit(&ring_->head, memory_order_relaxed);
+    uint_fast32_t tail = atomic_load_explicit(&ring_->tail, memory_order_acquire);
+
+    if ((head - tail) >= INPUT_RING_SIZE) {
+        return false;
+    }
+
+    ring_->slots[head & INPUT_RING_MASK] = *state_;
+    atomic_store_explicit(&ring_->head, head + 1, memory_order_release);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void input_ring_init(input_ring_t* ring_)
+{
+    memset(ring_, 0, sizeof(*ring_));
+    atomic_init(&ring_->head, 0);
+    atomic_init(&ring_->tail, 0);
+}
+
+//---------------------------------------------------------------------------
+bool input_ring_push(input_ring_t* ring_, const input_state_t* state_)
+{
+    ring_->pushed++;
+
+    // Flush a previously-held snapshot first, to keep snapshots in order
+    if (ring_->hasPending) {
+        if (!input_ring_publish(ring_, &ring_->pending)) {
+            // Still full -- the newer snapshot wins, but a request for all
+            // devices to report must survive the collapse.
+            bool allDevices           = ring_->pending.allDevices;
+            ring_->pending            = *state_;
+            ring_->pending.allDevices = ring_->pending.allDevices || allDevices;
+            ring_->overflows++;
+            return false;
+        }
+        ring_->hasPending = false;
+    }
+
+    if (!input_ring_publish(ring_, state_)) {
+        ring_->pending    = *state_;
+        ring_->hasPending = true;
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool input_ring_pop(input_ring_t* ring_, input_state_t* state_)
+{
+    uint_fast32_t tail = atomic_load_explicit(&ring_->tail, memory_order_relaxed);
+    uint_fast32_t head = atomic_load_explicit(&ring_->head, memory_order_acquire);
+
+    if (tail == head) {
+        return false;
+    }
+
+    *state_ = ring_->slots[tail & INPUT_RING_MASK];
+    atomic_store_explicit(&ring_->tail, tail + 1, memory_order_release);
+    return true;
+}
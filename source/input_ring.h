@@ -0,0 +1,65 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "input_state.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Number of snapshots held in the ring (must be a power of two)
+#define INPUT_RING_SIZE (16)
+
+//---------------------------------------------------------------------------
+// Lock-free single-producer/single-consumer ring of input snapshots.  The
+// producer only writes head (and the pending slot), the consumer only writes
+// tail.  When the ring is full, the producer holds the newest snapshot in a
+// pending slot -- overwriting any older pending snapshot -- and publishes it
+// as soon as space is available, so overflow degrades to latest-state-wins.
+typedef struct {
+    input_state_t        slots[INPUT_RING_SIZE];
+    atomic_uint_fast32_t head; //!< Next slot to write (producer-owned)
+    atomic_uint_fast32_t tail; //!< Next slot to read (consumer-owned)
+
+    input_state_t pending;    //!< Newest snapshot that didn't fit (producer-owned)
+    bool          hasPending; //!< The pending slot holds a snapshot
+    uint32_t      pushed;     //!< Snapshots offered to the ring
+    uint32_t      overflows;  //!< Snapshots overwritten in the pending slot before being published
+} input_ring_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief input_ring_init Initialize an empty ring
+ * @param ring_ ring to initialize
+ */
+void input_ring_init(input_ring_t* ring_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief input_ring_push Publish a snapshot to the consumer (producer only).
+ * @param ring_ ring to push into
+ * @param state_ snapshot to publish
+ * @return true if the snapshot was published, false if it was held as pending
+ */
+bool input_ring_push(input_ring_t* ring_, const input_state_t* state_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief input_ring_pop Take the oldest published snapshot (consumer only).
+ * @param ring_ ring to pop from
+ * @param state_ [out] snapshot removed from the ring
+ * @return true if a snapshot was returned, false if the ring was empty
+ */
+bool input_ring_pop(input_ring_t* ring_, input_state_t* state_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
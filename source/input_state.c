@@ -0,0 +1,45 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "input_state.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <3ds.h>
+
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+void input_state_sample(input_state_t* state_)
+{
+    circlePosition circle;
+    circlePosition cstick;
+    touchPosition  touch;
+    accelVector    accel;
+    angularRate    gyro;
+
+    hidCircleRead(&circle);
+    hidCstickRead(&cstick);
+    hidTouchRead(&touch);
+    hidAccelRead(&accel);
+    hidGyroRead(&gyro);
+
+    state_->ticks      = time_util_ticks();
+    state_->keys       = hidKeysHeld();
+    state_->circleX    = circle.dx;
+    state_->circleY    = circle.dy;
+    state_->cstickX    = cstick.dx;
+    state_->cstickY    = cstick.dy;
+    state_->touchX     = touch.px;
+    state_->touchY     = touch.py;
+    state_->accelX     = accel.x;
+    state_->accelY     = accel.y;
+    state_->accelZ     = accel.z;
+    state_->gyroX      = gyro.x;
+    state_->gyroY      = gyro.y;
+    state_->gyroZ      = gyro.z;
+    state_->allDevices = false;
+    state_->idle       = false;
+}
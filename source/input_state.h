@@ -0,0 +1,48 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Compact snapshot of all HID inputs, taken once per poll.  Devices build their
+// reports from a snapshot rather than reading the HID service directly, so
+// that sampling and sending can run on separate threads.
+typedef struct {
+    uint64_t ticks;      //!< Time the snapshot was taken (from time_util_ticks())
+    uint32_t keys;       //!< Buttons held
+    int16_t  circleX;    //!< Circle pad X
+    int16_t  circleY;    //!< Circle pad Y
+    int16_t  cstickX;    //!< C-stick X
+    int16_t  cstickY;    //!< C-stick Y
+    uint16_t touchX;     //!< Touchscreen X (pixels)
+    uint16_t touchY;     //!< Touchscreen Y (pixels)
+    int16_t  accelX;     //!< Accelerometer X
+    int16_t  accelY;     //!< Accelerometer Y
+    int16_t  accelZ;     //!< Accelerometer Z
+    int16_t  gyroX;      //!< Gyroscope X
+    int16_t  gyroY;      //!< Gyroscope Y
+    int16_t  gyroZ;      //!< Gyroscope Z
+    bool     allDevices; //!< Snapshot should be reported by all devices, not just the gamepad
+    bool     idle;       //!< Snapshot was taken in idle mode
+} input_state_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief input_state_sample Capture the input state latched by the most recent
+ * call to hidScanInput() into a snapshot.  The allDevices and idle flags are
+ * cleared; it is up to the caller to set them.
+ * @param state_ snapshot to fill
+ */
+void input_state_sample(input_state_t* state_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,66 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "input_wakeup.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <3ds.h>
+
+//---------------------------------------------------------------------------
+#define INPUT_WAKEUP_PAD_EVENT (0)
+
+//---------------------------------------------------------------------------
+bool input_wakeup_init(input_wakeup_t* wakeup_)
+{
+    memset(wakeup_, 0, sizeof(*wakeup_));
+
+    // These are our own copies of the handles libctru holds; waiting on (and
+    // clearing) them doesn't interfere with hidScanInput().
+    Result rc = HIDUSER_GetHandles(&wakeup_->memHandle,
+                                   &wakeup_->events[0],
+                                   &wakeup_->events[1],
+                                   &wakeup_->events[2],
+                                   &wakeup_->events[3],
+                                   &wakeup_->events[4]);
+    if (R_FAILED(rc)) {
+        return false;
+    }
+
+    wakeup_->enabled = true;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool input_wakeup_wait(input_wakeup_t* wakeup_, int64_t timeoutNs_)
+{
+    Handle event = wakeup_->events[INPUT_WAKEUP_PAD_EVENT];
+
+    // The event is sticky.  It's cleared after the wait rather than before, so
+    // a sample published while the previous one was being processed wakes the
+    // next wait immediately; the scan that follows always reads the newest.
+    Result rc = svcWaitSynchronization(event, timeoutNs_);
+    if (R_DESCRIPTION(rc) == RD_TIMEOUT) {
+        wakeup_->timeouts++;
+        return false;
+    }
+
+    svcClearEvent(event);
+    wakeup_->wakeups++;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void input_wakeup_exit(input_wakeup_t* wakeup_)
+{
+    if (!wakeup_->enabled) {
+        return;
+    }
+
+    svcCloseHandle(wakeup_->memHandle);
+    for (size_t i = 0; i < INPUT_WAKEUP_EVENT_COUNT; i++) { svcCloseHandle(wakeup_->events[i]); }
+    wakeup_->enabled = false;
+}
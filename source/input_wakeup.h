@@ -0,0 +1,60 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <3ds.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+#define INPUT_WAKEUP_EVENT_COUNT (5) //!< Events returned by HIDUSER_GetHandles()
+
+//---------------------------------------------------------------------------
+// Event-driven input wakeup.  The HID module signals an event each time it
+// publishes a new pad sample; waiting on it lets the input thread scan (and
+// hand off) each sample as soon as it exists, rather than at fixed points
+// relative to vblank.
+typedef struct {
+    Handle   memHandle;                        //!< HID shared memory handle (returned with the events; unused)
+    Handle   events[INPUT_WAKEUP_EVENT_COUNT]; //!< HID events: pad0, pad1, accel, gyro, debug pad
+    bool     enabled;                          //!< Handles were acquired
+    uint32_t wakeups;                          //!< Waits ended by a new pad sample
+    uint32_t timeouts;                         //!< Waits that timed out
+} input_wakeup_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief input_wakeup_init Acquire the HID service's event handles
+ * @param wakeup_ object to initialize
+ * @return true on success; on failure, input_wakeup_wait() must not be used
+ */
+bool input_wakeup_init(input_wakeup_t* wakeup_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief input_wakeup_wait Block until the HID module publishes a new pad
+ * sample, or the timeout expires.  Returns immediately if a sample was
+ * published since the previous wait returned.
+ * @param wakeup_ wakeup object
+ * @param timeoutNs_ longest time to wait, in nanoseconds
+ * @return true if woken by a new pad sample, false on timeout
+ */
+bool input_wakeup_wait(input_wakeup_t* wakeup_, int64_t timeoutNs_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief input_wakeup_exit Release the event handles
+ * @param wakeup_ wakeup object
+ */
+void input_wakeup_exit(input_wakeup_t* wakeup_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,163 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "keep_warm.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "logger.h"
+#include "net_util.h"
+#include "protocol.h"
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+// Time without input traffic after which the next press is probed (in
+// measurement mode) -- long enough for a radio without keepalives to doze.
+#define KEEP_WARM_QUIET_US (500000ULL)
+
+// Longest a probe waits for the server's echo
+#define KEEP_WARM_PROBE_TIMEOUT_US (2000000ULL)
+
+//---------------------------------------------------------------------------
+void keep_warm_init(keep_warm_t* keepWarm_, uint32_t intervalMs_, bool measure_)
+{
+    memset(keepWarm_, 0, sizeof(*keepWarm_));
+
+    if (measure_ && (intervalMs_ == 0)) {
+        intervalMs_ = KEEP_WARM_DEFAULT_INTERVAL_MS;
+    }
+    keepWarm_->intervalTicks = time_util_us_to_ticks((uint64_t)intervalMs_ * 1000ULL);
+    keepWarm_->measure       = measure_;
+    keepWarm_->warm          = true;
+    keepWarm_->trafficTicks  = time_util_ticks();
+    keepWarm_->inputTicks    = keepWarm_->trafficTicks;
+
+    histogram_init(&keepWarm_->warmRttUs);
+    histogram_init(&keepWarm_->coldRttUs);
+}
+
+//---------------------------------------------------------------------------
+// Send a keepalive.  Returns true if it went out; one dropped because the
+// socket buffer is full is simply tried again on a later update.
+static bool keep_warm_send(keep_warm_t* keepWarm_, hid_device_t* device_, uint8_t flags_)
+{
+    netstick_keepalive_t keepAlive = {};
+    keepAlive.sequence             = ++keepWarm_->sequence;
+    keepAlive.flags                = flags_;
+
+    net_util_send_return_t rc = net_util_encode_and_transmit(device_->sockFd,
+                                                             device_->framing,
+                                                             &device_->stats,
+                                                             &device_->txBacklog,
+                                                             NetstickTagKeepAlive,
+                                                             &keepAlive,
+                                                             sizeof(keepAlive));
+    if (rc != NetUtilSendOk) {
+        if (rc == NetUtilSendError) {
+            hid_device_disconnect(device_);
+        }
+        return false;
+    }
+
+    // Don't mistake our own message for input traffic on the next update
+    keepWarm_->messagesSeen   = device_->stats.messagesSent;
+    keepWarm_->trafficTicks   = time_util_ticks();
+    keepWarm_->keepAliveTicks = keepWarm_->trafficTicks;
+    keepWarm_->sent++;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static void keep_warm_check_probe(keep_warm_t* keepWarm_, const hid_device_t* device_, uint64_t now_)
+{
+    if ((device_->echoSequence == keepWarm_->probeSequence) && (device_->echoTicks >= keepWarm_->probeTicks)) {
+        uint64_t rtt = time_util_ticks_to_us(device_->echoTicks - keepWarm_->probeTicks);
+        rtt          = (rtt > UINT32_MAX) ? UINT32_MAX : rtt;
+
+        histogram_record(keepWarm_->probeWarm ? &keepWarm_->warmRttUs : &keepWarm_->coldRttUs, (uint32_t)rtt);
+        LOG_INFO("keep-warm: first press rtt %lu us (%s)", (unsigned long)rtt, keepWarm_->probeWarm ? "warm" : "cold");
+        keepWarm_->probePending = false;
+    } else if ((now_ - keepWarm_->probeTicks) >= time_util_us_to_ticks(KEEP_WARM_PROBE_TIMEOUT_US)) {
+        LOG_WARNING("keep-warm: probe %lu not echoed", (unsigned long)keepWarm_->probeSequence);
+        keepWarm_->probeTimeouts++;
+        keepWarm_->probePending = false;
+    }
+}
+
+//---------------------------------------------------------------------------
+void keep_warm_update(keep_warm_t* keepWarm_, hid_device_t* device_, bool active_)
+{
+    if (keepWarm_->intervalTicks == 0) {
+        return;
+    }
+
+    uint64_t now = time_util_ticks();
+
+    if (device_->sockFd < 0) {
+        keepWarm_->probePending = false;
+        keepWarm_->messagesSeen = device_->stats.messagesSent;
+        keepWarm_->edgesSeen    = device_->stats.buttonEdges;
+        return;
+    }
+
+    // A button press that ends a quiet spell is the one that pays for a dozing
+    // radio -- time an echo sent right behind it.
+    bool quiet = (now - keepWarm_->inputTicks) >= time_util_us_to_ticks(KEEP_WARM_QUIET_US);
+    bool press = (device_->stats.buttonEdges != keepWarm_->edgesSeen);
+
+    keepWarm_->edgesSeen = device_->stats.buttonEdges;
+    if (device_->stats.messagesSent != keepWarm_->messagesSeen) {
+        keepWarm_->messagesSeen = device_->stats.messagesSent;
+        keepWarm_->trafficTicks = now;
+        keepWarm_->inputTicks   = now;
+    }
+
+    if (keepWarm_->probePending) {
+        keep_warm_check_probe(keepWarm_, device_, now);
+    } else if (keepWarm_->measure && press && quiet) {
+        keepWarm_->probeWarm = (keepWarm_->keepAliveTicks != 0)
+                               && ((now - keepWarm_->keepAliveTicks) <= (2 * keepWarm_->intervalTicks));
+        if (!keep_warm_send(keepWarm_, device_, NetstickKeepAliveEcho)) {
+            return;
+        }
+        keepWarm_->probePending  = true;
+        keepWarm_->probeSequence = keepWarm_->sequence;
+        keepWarm_->probeTicks    = keepWarm_->trafficTicks;
+
+        // Alternate keep-warm on and off between quiet spells
+        keepWarm_->warm = !keepWarm_->warm;
+        return;
+    }
+
+    if (active_ && keepWarm_->warm && ((now - keepWarm_->trafficTicks) >= keepWarm_->intervalTicks)) {
+        keep_warm_send(keepWarm_, device_, 0);
+    }
+}
+
+//---------------------------------------------------------------------------
+void keep_warm_print(const keep_warm_t* keepWarm_)
+{
+    if (keepWarm_->intervalTicks == 0) {
+        return;
+    }
+
+    LOG_SUMMARY("keep-warm: %lu keepalives sent", (unsigned long)keepWarm_->sent);
+    if (!keepWarm_->measure) {
+        return;
+    }
+
+    const histogram_t* hists[2] = { &keepWarm_->warmRttUs, &keepWarm_->coldRttUs };
+    const char*        names[2] = { "warm", "cold" };
+    for (size_t i = 0; i < 2; i++) {
+        LOG_SUMMARY("  first press rtt (%s) n=%lu p50=%lu p90=%lu max=%lu us",
+                    names[i],
+                    (unsigned long)hists[i]->total,
+                    (unsigned long)histogram_percentile(hists[i], 0.50),
+                    (unsigned long)histogram_percentile(hists[i], 0.90),
+                    (unsigned long)hists[i]->max);
+    }
+    LOG_SUMMARY("  %lu probes not echoed", (unsigned long)keepWarm_->probeTimeouts);
+}
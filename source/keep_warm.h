@@ -0,0 +1,89 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hid_device.h"
+#include "histogram.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Keepalive interval used by the measurement mode, if not set in the config file
+#define KEEP_WARM_DEFAULT_INTERVAL_MS (100)
+
+//---------------------------------------------------------------------------
+// Keep-warm state.  Reports are only sent when input changes, so after a
+// quiet spell the Wi-Fi radio may have dozed into power-save, and the next
+// press waits for it (and the access point's buffering) to wake up.  While
+// the app is in the foreground and not idle, a tiny keepalive message is sent
+// on a device's connection whenever nothing else has been sent on it for the
+// keep-warm interval.
+//
+// In measurement mode, the first button press after each quiet spell is
+// followed at once by a keepalive the server echoes, and the round trip is
+// recorded as "warm" or "cold" depending on whether keepalives were being
+// sent before the press.  Keepalives are sent in every other quiet spell, so
+// both cases are sampled under the same conditions.
+typedef struct {
+    uint64_t intervalTicks; //!< Time without traffic before a keepalive is sent (0 == disabled)
+    bool     measure;       //!< Probe the first press after each quiet spell, alternating keep-warm on and off
+    bool     warm;          //!< Keepalives are sent during the current quiet spell
+
+    uint32_t messagesSeen;   //!< Messages sent on the connection, as of the last update
+    uint32_t edgesSeen;      //!< Button edges sent on the connection, as of the last update
+    uint64_t trafficTicks;   //!< Time of the last message sent on the connection (including keepalives)
+    uint64_t inputTicks;     //!< Time of the last message sent for input (excluding keepalives)
+    uint64_t keepAliveTicks; //!< Time of the last keepalive sent (0 == none)
+    uint32_t sequence;       //!< Sequence number of the last keepalive sent
+    uint32_t sent;           //!< Number of keepalives sent
+
+    bool        probePending;  //!< An echo request is awaiting the server's reply
+    bool        probeWarm;     //!< The pending probe followed a warm quiet spell
+    uint32_t    probeSequence; //!< Sequence number of the pending probe
+    uint64_t    probeTicks;    //!< Time the pending probe was sent
+    uint32_t    probeTimeouts; //!< Probes the server never answered
+    histogram_t warmRttUs;     //!< First-press round-trip times with keep-warm (us)
+    histogram_t coldRttUs;     //!< First-press round-trip times without keep-warm (us)
+} keep_warm_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief keep_warm_init Initialize the keep-warm state
+ * @param keepWarm_ object to initialize
+ * @param intervalMs_ time without traffic before a keepalive is sent (0 ==
+ * disabled, unless measuring, in which case KEEP_WARM_DEFAULT_INTERVAL_MS)
+ * @param measure_ enable the first-press round-trip measurement mode
+ */
+void keep_warm_init(keep_warm_t* keepWarm_, uint32_t intervalMs_, bool measure_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief keep_warm_update Send a keepalive on the device's connection if it
+ * has been quiet for the keep-warm interval, and (in measurement mode) probe
+ * or complete a first-press round-trip measurement.  Must be called from the
+ * thread that services the device, after its events have been handled.
+ * @param keepWarm_ keep-warm state to update
+ * @param device_ device whose connection is kept warm
+ * @param active_ true while the app is in the foreground and not idle;
+ * keepalives are only sent while active
+ */
+void keep_warm_update(keep_warm_t* keepWarm_, hid_device_t* device_, bool active_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief keep_warm_print Print the number of keepalives sent and, in
+ * measurement mode, the warm and cold first-press round-trip distributions.
+ * @param keepWarm_ keep-warm state to report on
+ */
+void keep_warm_print(const keep_warm_t* keepWarm_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
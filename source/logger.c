@@ -0,0 +1,262 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "logger.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+#define LOGGER_RING_MASK (LOGGER_RING_SIZE - 1)
+
+_Static_assert((LOGGER_RING_SIZE & LOGGER_RING_MASK) == 0, "LOGGER_RING_SIZE must be a power of two");
+
+//---------------------------------------------------------------------------
+// Ring entry.  The sequence number hands each entry back and forth between
+// the writers and the drain: a writer may claim the entry for ring position
+// n when sequence == n, and publishes it by setting sequence = n + 1; the
+// drain releases it for the next lap by setting sequence = n + LOGGER_RING_SIZE.
+typedef struct {
+    atomic_uint sequence;                 //!< Ownership/publication sequence number
+    uint32_t    timeMs;                   //!< Time the message was written, relative to logger_init()
+    uint8_t     level;                    //!< logger_level_t of the message
+    char        text[LOGGER_MESSAGE_MAX]; //!< Formatted message
+} logger_entry_t;
+
+//---------------------------------------------------------------------------
+static logger_entry_t          entries[LOGGER_RING_SIZE];
+static _Atomic(logger_rate_t*) rateSites; //!< Call sites that have written a message (newest first)
+static atomic_uint             writePosition;
+static unsigned int            readPosition;
+static atomic_uint             dropped;
+static logger_level_t          minLevel;
+static uint64_t                startTicks;
+static FILE*                   logFile;
+
+static const char* const levelNames[LoggerLevelCount] = {
+    [LoggerLevelDebug]   = "debug",
+    [LoggerLevelInfo]    = "info",
+    [LoggerLevelWarning] = "warning",
+    [LoggerLevelError]   = "error",
+};
+
+//---------------------------------------------------------------------------
+static uint32_t logger_now_ms(void)
+{
+    return (uint32_t)(time_util_ticks_to_us(time_util_ticks() - startTicks) / 1000ULL);
+}
+
+//---------------------------------------------------------------------------
+static bool logger_rate_check(logger_rate_t* rate_, const char* format_, uint32_t nowMs_)
+{
+    if (!rate_) {
+        return true;
+    }
+
+    // A call site's first message starts its first window, and adds it to the
+    // list checked for suppressed messages (once its format is set)
+    if (!atomic_exchange_explicit(&rate_->registered, true, memory_order_relaxed)) {
+        rate_->format = format_;
+        atomic_store_explicit(&rate_->windowStartMs, nowMs_, memory_order_relaxed);
+        atomic_store_explicit(&rate_->count, 0, memory_order_relaxed);
+
+        logger_rate_t* head = atomic_load_explicit(&rateSites, memory_order_relaxed);
+        do {
+            rate_->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(
+            &rateSites, &head, rate_, memory_order_release, memory_order_relaxed));
+    } else if ((nowMs_ - atomic_load_explicit(&rate_->windowStartMs, memory_order_relaxed)) >= LOGGER_RATE_WINDOW_MS) {
+        atomic_store_explicit(&rate_->windowStartMs, nowMs_, memory_order_relaxed);
+        atomic_store_explicit(&rate_->count, 0, memory_order_relaxed);
+    }
+
+    if (atomic_fetch_add_explicit(&rate_->count, 1, memory_order_relaxed) >= LOGGER_RATE_BURST) {
+        atomic_fetch_add_explicit(&rate_->suppressed, 1, memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static void logger_print(uint32_t timeMs_, logger_level_t level_, const char* text_)
+{
+    if (level_ >= LoggerLevelWarning) {
+        printf("%s: %s\n", levelNames[level_], text_);
+    } else {
+        printf("%s\n", text_);
+    }
+
+    if (logFile) {
+        fprintf(logFile, "[%6lu.%03lu] %-7s %s\n",
+                (unsigned long)(timeMs_ / 1000),
+                (unsigned long)(timeMs_ % 1000),
+                levelNames[level_],
+                text_);
+    }
+}
+
+//---------------------------------------------------------------------------
+// Report call sites whose rate-limiting window has ended (or all of them, if
+// flushing) with messages suppressed.  Returns the number of lines printed.
+static size_t logger_report_suppressed(uint32_t nowMs_, bool flush_)
+{
+    size_t printed = 0;
+
+    logger_rate_t* rate = atomic_load_explicit(&rateSites, memory_order_acquire);
+    for (; rate; rate = rate->next) {
+        if ((atomic_load_explicit(&rate->suppressed, memory_order_relaxed) == 0)
+            || (!flush_
+                && ((nowMs_ - atomic_load_explicit(&rate->windowStartMs, memory_order_relaxed))
+                    < LOGGER_RATE_WINDOW_MS))) {
+            continue;
+        }
+
+        unsigned int suppressed = atomic_exchange_explicit(&rate->suppressed, 0, memory_order_relaxed);
+        if (suppressed) {
+            char text[LOGGER_MESSAGE_MAX];
+            snprintf(text, sizeof(text), "suppressed %u messages like \"%s\"", suppressed, rate->format);
+            logger_print(nowMs_, LoggerLevelInfo, text);
+            printed++;
+        }
+    }
+    return printed;
+}
+
+//---------------------------------------------------------------------------
+bool logger_init(logger_level_t level_, const char* filePath_)
+{
+    for (size_t i = 0; i < LOGGER_RING_SIZE; i++) { atomic_init(&entries[i].sequence, i); }
+    for (logger_rate_t* rate = atomic_load(&rateSites); rate; rate = rate->next) {
+        atomic_store(&rate->windowStartMs, 0);
+        atomic_store(&rate->count, 0);
+        atomic_store(&rate->suppressed, 0);
+    }
+    atomic_init(&writePosition, 0);
+    atomic_init(&dropped, 0);
+    readPosition = 0;
+    minLevel     = level_;
+    startTicks   = time_util_ticks();
+    logFile      = NULL;
+
+    if (filePath_ && filePath_[0]) {
+        logFile = fopen(filePath_, "a");
+        if (!logFile) {
+            printf("Error opening %s\n", filePath_);
+            return false;
+        }
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void logger_write(logger_rate_t* rate_, logger_level_t level_, const char* format_, ...)
+{
+    if (level_ < minLevel) {
+        return;
+    }
+
+    uint32_t nowMs = logger_now_ms();
+    if (!logger_rate_check(rate_, format_, nowMs)) {
+        return;
+    }
+
+    // Claim the next free entry
+    logger_entry_t* entry;
+    unsigned int    position = atomic_load_explicit(&writePosition, memory_order_relaxed);
+    while (true) {
+        entry             = &entries[position & LOGGER_RING_MASK];
+        unsigned int seq  = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+        int          diff = (int)(seq - position);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &writePosition, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Ring is full -- the drain hasn't caught up
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            position = atomic_load_explicit(&writePosition, memory_order_relaxed);
+        }
+    }
+
+    va_list args;
+    va_start(args, format_);
+    vsnprintf(entry->text, sizeof(entry->text), format_, args);
+    va_end(args);
+
+    entry->timeMs = nowMs;
+    entry->level  = (uint8_t)level_;
+    atomic_store_explicit(&entry->sequence, position + 1, memory_order_release);
+}
+
+//---------------------------------------------------------------------------
+size_t logger_drain(size_t maxMessages_)
+{
+    size_t printed = 0;
+
+    while (printed < maxMessages_) {
+        logger_entry_t* entry = &entries[readPosition & LOGGER_RING_MASK];
+        unsigned int    seq   = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+        if (seq != (readPosition + 1)) {
+            break;
+        }
+
+        logger_print(entry->timeMs, (logger_level_t)entry->level, entry->text);
+        atomic_store_explicit(&entry->sequence, readPosition + LOGGER_RING_SIZE, memory_order_release);
+        readPosition++;
+        printed++;
+    }
+
+    uint32_t nowMs = logger_now_ms();
+    if (printed < maxMessages_) {
+        unsigned int droppedCount = atomic_exchange_explicit(&dropped, 0, memory_order_relaxed);
+        if (droppedCount) {
+            char text[LOGGER_MESSAGE_MAX];
+            snprintf(text, sizeof(text), "log full -- %u messages dropped", droppedCount);
+            logger_print(nowMs, LoggerLevelWarning, text);
+            printed++;
+        }
+    }
+    if (printed < maxMessages_) {
+        printed += logger_report_suppressed(nowMs, false);
+    }
+
+    if (logFile && printed) {
+        fflush(logFile);
+    }
+    return printed;
+}
+
+//---------------------------------------------------------------------------
+void logger_exit(void)
+{
+    logger_drain(LOGGER_DRAIN_ALL);
+    logger_report_suppressed(logger_now_ms(), true);
+
+    if (logFile) {
+        fclose(logFile);
+        logFile = NULL;
+    }
+}
+
+//---------------------------------------------------------------------------
+bool logger_level_from_name(const char* name_, logger_level_t* level_)
+{
+    for (int i = 0; i < LoggerLevelCount; i++) {
+        if (0 == strcmp(levelNames[i], name_)) {
+            *level_ = (logger_level_t)i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,126 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Log messages are formatted into a fixed-size ring of fixed-size entries
+// when they're written, and printed to the console (and optionally a log
+// file) later, when the ring is drained.  Writing a message never blocks or
+// allocates, and is safe from any thread.
+#define LOGGER_RING_SIZE (32)     //!< Number of messages held between drains (power of two)
+#define LOGGER_MESSAGE_MAX (96)   //!< Longest message, including the terminator -- longer messages are truncated
+#define LOGGER_DRAIN_ALL (SIZE_MAX)
+
+//---------------------------------------------------------------------------
+// Repeated messages from the same call site are rate-limited: at most
+// LOGGER_RATE_BURST messages are logged per LOGGER_RATE_WINDOW_MS, and the
+// number suppressed is reported when the window ends.
+#define LOGGER_RATE_BURST (4)
+#define LOGGER_RATE_WINDOW_MS (1000)
+
+//---------------------------------------------------------------------------
+// Rate-limiting state of a call site.  Each LOG_*() call site has its own
+// (a static in the macro's expansion), which is added to the logger's list of
+// call sites the first time it's used.  Updates from concurrent writers may
+// race; the limit is approximate, but never blocks.
+typedef struct logger_rate {
+    const char*         format;        //!< Format string of the call site (set when registered)
+    atomic_uint         windowStartMs; //!< Start of the current rate-limiting window
+    atomic_uint         count;         //!< Messages written during the current window
+    atomic_uint         suppressed;    //!< Messages discarded since the last report
+    atomic_bool         registered;    //!< The call site has been added to the list
+    struct logger_rate* next;          //!< Next call site in the list
+} logger_rate_t;
+
+//---------------------------------------------------------------------------
+// Message severity levels
+typedef enum {
+    LoggerLevelDebug = 0, //!< Diagnostic detail
+    LoggerLevelInfo,      //!< Normal events (connects, disconnects)
+    LoggerLevelWarning,   //!< Recoverable problems
+    LoggerLevelError,     //!< Failures
+    //--
+    LoggerLevelCount
+} logger_level_t;
+
+//---------------------------------------------------------------------------
+#define LOGGER_WRITE(level_, ...)                                                                                      \
+    do {                                                                                                               \
+        static logger_rate_t loggerRate;                                                                               \
+        logger_write(&loggerRate, (level_), __VA_ARGS__);                                                              \
+    } while (0)
+
+#define LOG_DEBUG(...) LOGGER_WRITE(LoggerLevelDebug, __VA_ARGS__)
+#define LOG_INFO(...) LOGGER_WRITE(LoggerLevelInfo, __VA_ARGS__)
+#define LOG_WARNING(...) LOGGER_WRITE(LoggerLevelWarning, __VA_ARGS__)
+#define LOG_ERROR(...) LOGGER_WRITE(LoggerLevelError, __VA_ARGS__)
+
+// Summaries printed once, such as the statistics printed on exit, are never
+// rate-limited -- one call site may print a line for each device
+#define LOG_SUMMARY(...) logger_write(NULL, LoggerLevelInfo, __VA_ARGS__)
+
+//---------------------------------------------------------------------------
+/**
+ * @brief logger_init Reset the logger, and open the log file (if any).  Must
+ * be called before any other logger function.
+ * @param level_ minimum severity of messages to log
+ * @param filePath_ file that drained messages are appended to, in addition to
+ * the console (NULL or "" for console only)
+ * @return true if the logger was initialized, false if the log file couldn't
+ * be opened (messages are still logged to the console)
+ */
+bool logger_init(logger_level_t level_, const char* filePath_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief logger_write Format a message into the log ring.  Messages below
+ * the configured severity, rate-limited messages, and messages written while
+ * the ring is full are discarded (and counted).  A trailing newline is added
+ * when the message is printed.  Normally called through the LOG_*() macros.
+ * @param rate_ rate-limiting state of the call site (NULL == not rate-limited)
+ * @param level_ severity of the message
+ * @param format_ printf-style format string
+ */
+void logger_write(logger_rate_t* rate_, logger_level_t level_, const char* format_, ...)
+    __attribute__((format(printf, 3, 4)));
+
+//---------------------------------------------------------------------------
+/**
+ * @brief logger_drain Print messages from the ring to the console and log
+ * file.  Must only be called from one thread, and outside of latency-critical
+ * code -- printing to the console is slow.
+ * @param maxMessages_ largest number of messages to print (LOGGER_DRAIN_ALL
+ * to empty the ring)
+ * @return number of messages printed
+ */
+size_t logger_drain(size_t maxMessages_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief logger_exit Drain all remaining messages (including suppression
+ * counts for rate-limiting windows that haven't ended), and close the log file.
+ */
+void logger_exit(void);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief logger_level_from_name Look up a severity level by name
+ * @param name_ name of the level ("debug", "info", "warning" or "error")
+ * @param level_ [out] level corresponding to the name
+ * @return true if the name is valid
+ */
+bool logger_level_from_name(const char* name_, logger_level_t* level_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
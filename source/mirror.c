@@ -0,0 +1,189 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "mirror.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "net_util.h"
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+// Time between attempts to (re)connect to a mirror
+#define MIRROR_RETRY_US (2000000ULL)
+
+// Send buffer requested for mirror connections -- input that sat in a large
+// buffer behind a stalled receiver would be stale by the time it got there,
+// so frames start being dropped after a few hundred reports instead.
+#define MIRROR_SEND_BUFFER_SIZE (8192)
+
+//---------------------------------------------------------------------------
+bool mirror_init(mirror_t* mirror_, const char* host_, uint16_t port_, size_t maxFrame_)
+{
+    memset(mirror_, 0, sizeof(*mirror_));
+    mirror_->host        = host_;
+    mirror_->port        = port_;
+    mirror_->sockFd      = -1;
+    mirror_->state       = MirrorStateIdle;
+    mirror_->pending     = (uint8_t*)malloc(maxFrame_);
+    mirror_->pendingSize = maxFrame_;
+    mirror_->frame       = (uint8_t*)malloc(maxFrame_);
+
+    return (mirror_->pending != NULL) && (mirror_->frame != NULL);
+}
+
+//---------------------------------------------------------------------------
+// Write as much of a buffer as the socket takes without waiting.  Returns the
+// number of bytes written (0 if the socket is full), or -1 on error.
+static int mirror_write(mirror_t* mirror_, const uint8_t* data_, size_t dataLen_)
+{
+    int nWritten = send(mirror_->sockFd, data_, dataLen_, MSG_DONTWAIT);
+    if (nWritten < 0) {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            return 0;
+        }
+        LOG_WARNING("mirror %s:%u: socket error %d", mirror_->host, (unsigned)mirror_->port, errno);
+        mirror_close(mirror_);
+        return -1;
+    }
+    mirror_->bytesSent += (uint64_t)nWritten;
+    return nWritten;
+}
+
+//---------------------------------------------------------------------------
+// Send whatever is left of a partly-written frame.  Returns false on error.
+static bool mirror_flush(mirror_t* mirror_)
+{
+    if (mirror_->pendingLen == 0) {
+        return true;
+    }
+
+    int nWritten = mirror_write(mirror_, mirror_->pending, mirror_->pendingLen);
+    if (nWritten < 0) {
+        return false;
+    }
+
+    mirror_->pendingLen -= (size_t)nWritten;
+    memmove(mirror_->pending, mirror_->pending + nWritten, mirror_->pendingLen);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Read and discard anything the receiver sent (session tokens, pacing
+// requests...) -- those are meant for the primary connection.  Returns false
+// if the connection was closed.
+static bool mirror_drain(mirror_t* mirror_)
+{
+    uint8_t buffer[64];
+
+    while (true) {
+        int nRead = recv(mirror_->sockFd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (nRead > 0) {
+            continue;
+        }
+        if ((nRead < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            return true;
+        }
+        LOG_INFO("mirror %s:%u: connection closed", mirror_->host, (unsigned)mirror_->port);
+        mirror_close(mirror_);
+        return false;
+    }
+}
+
+//---------------------------------------------------------------------------
+bool mirror_poll(mirror_t* mirror_)
+{
+    uint64_t now = time_util_ticks();
+
+    if (mirror_->state == MirrorStateIdle) {
+        if (now < mirror_->retryTicks) {
+            return false;
+        }
+        mirror_->sockFd = net_util_connect_start(mirror_->host, mirror_->port);
+        if (mirror_->sockFd < 0) {
+            mirror_->retryTicks = now + time_util_us_to_ticks(MIRROR_RETRY_US);
+            return false;
+        }
+        int sendBuffer = MIRROR_SEND_BUFFER_SIZE;
+        setsockopt(mirror_->sockFd, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+        mirror_->state = MirrorStateConnecting;
+    }
+
+    if (mirror_->state == MirrorStateConnecting) {
+        int rc = net_util_connect_check(mirror_->sockFd);
+        if (rc == 0) {
+            return false;
+        }
+        if (rc < 0) {
+            mirror_close(mirror_);
+            return false;
+        }
+
+        LOG_INFO("mirror connected -- %s:%u!", mirror_->host, (unsigned)mirror_->port);
+        mirror_->state      = MirrorStateConnected;
+        mirror_->pendingLen = 0;
+        mirror_->resync     = false;
+        mirror_->connects++;
+        return true;
+    }
+
+    if (mirror_drain(mirror_)) {
+        mirror_flush(mirror_);
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------
+bool mirror_send(mirror_t* mirror_, const uint8_t* frame_, size_t frameLen_)
+{
+    if ((mirror_->state != MirrorStateConnected) || !mirror_flush(mirror_)) {
+        return false;
+    }
+
+    // The receiver is behind: drop the frame rather than queue it, so its
+    // backlog never grows beyond a single frame.
+    int nWritten = 0;
+    if (mirror_->pendingLen == 0) {
+        nWritten = mirror_write(mirror_, frame_, frameLen_);
+        if (nWritten < 0) {
+            return false;
+        }
+    }
+    if (nWritten == 0) {
+        mirror_->framesDropped++;
+        mirror_->resync = true;
+        return false;
+    }
+
+    size_t remaining = frameLen_ - (size_t)nWritten;
+    if (remaining > mirror_->pendingSize) {
+        mirror_close(mirror_);
+        return false;
+    }
+    memcpy(mirror_->pending, frame_ + nWritten, remaining);
+    mirror_->pendingLen = remaining;
+    mirror_->messagesSent++;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void mirror_close(mirror_t* mirror_)
+{
+    if (mirror_->sockFd >= 0) {
+        close(mirror_->sockFd);
+    }
+    mirror_->sockFd     = -1;
+    mirror_->state      = MirrorStateIdle;
+    mirror_->pendingLen = 0;
+    mirror_->retryTicks = time_util_ticks() + time_util_us_to_ticks(MIRROR_RETRY_US);
+}
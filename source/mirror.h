@@ -0,0 +1,93 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+typedef enum {
+    MirrorStateIdle = 0,   //!< Not connected; a connection is started once retryTicks has passed
+    MirrorStateConnecting, //!< Connection in progress
+    MirrorStateConnected,  //!< Connected; frames are sent
+} mirror_state_t;
+
+//---------------------------------------------------------------------------
+// Connection to a secondary destination (e.g. a recorder or spectator) that
+// receives a copy of a device's stream.  A mirror never blocks: it connects in
+// the background, sends without waiting, and when its receiver falls behind,
+// drops whole frames rather than delaying the primary connection.  The tail of
+// a frame the socket only partly accepted is held and sent first next time,
+// so the stream stays intact.
+typedef struct {
+    const char*    host;       //!< Host (IP) to connect to
+    uint16_t       port;       //!< Port to connect to
+    int            sockFd;     //!< Connection socket (-1 == none)
+    mirror_state_t state;      //!< Connection state
+    uint64_t       retryTicks; //!< Time before which no connection is started
+    bool           resync;     //!< Frames were dropped since the last report, so the next one must be sent
+
+    uint8_t* pending;     //!< Unsent tail of the last frame
+    size_t   pendingLen;  //!< Bytes in the pending buffer
+    size_t   pendingSize; //!< Capacity of the pending and frame buffers (the largest frame)
+    uint8_t* frame;       //!< Buffer for encoding frames too large for the stack (e.g. the configuration)
+
+    uint32_t connects;      //!< Successful connections
+    uint32_t messagesSent;  //!< Frames handed to the socket (in full or in part)
+    uint64_t bytesSent;     //!< Bytes handed to the socket
+    uint32_t framesDropped; //!< Frames dropped because the receiver was behind
+} mirror_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief mirror_init Initialize a mirror.  No connection is made until the
+ * first call to mirror_poll().
+ * @param mirror_ object to initialize
+ * @param host_ host (IP) to connect to; must outlive the mirror
+ * @param port_ port to connect to
+ * @param maxFrame_ size of the largest frame that will be sent
+ * @return true on success, false if the buffers couldn't be allocated
+ */
+bool mirror_init(mirror_t* mirror_, const char* host_, uint16_t port_, size_t maxFrame_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief mirror_poll Advance the mirror's connection without blocking:
+ * start or complete a connection, discard anything the receiver sent, and
+ * flush the pending tail of the last frame.
+ * @param mirror_ mirror to service
+ * @return true if the mirror has just connected (and needs the device's
+ * configuration), false otherwise
+ */
+bool mirror_poll(mirror_t* mirror_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief mirror_send Send an encoded frame to the mirror, if it's connected.
+ * If the frame can't be sent without waiting, it's dropped and the mirror is
+ * flagged for resynchronization.
+ * @param mirror_ mirror to send to
+ * @param frame_ encoded frame
+ * @param frameLen_ size of the frame (in bytes)
+ * @return true if the frame was sent (in full or in part), false if it was
+ * dropped or the mirror isn't connected
+ */
+bool mirror_send(mirror_t* mirror_, const uint8_t* frame_, size_t frameLen_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief mirror_close Close the mirror's connection (if open).  A new one is
+ * started by mirror_poll() after a delay.
+ * @param mirror_ mirror to disconnect
+ */
+void mirror_close(mirror_t* mirror_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,139 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "motion_hint.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+// Axis values are clamped to this magnitude, which bounds the intermediate
+// sums of the fit (see motion_hint_velocity()) well within 64 bits.
+#define MOTION_HINT_VALUE_LIMIT (32767)
+
+#define MOTION_HINT_US_PER_SECOND (1000000LL)
+
+//---------------------------------------------------------------------------
+void motion_hint_init(motion_hint_t* hint_, size_t axisCount_)
+{
+    memset(hint_, 0, sizeof(*hint_));
+    hint_->axisCount = (axisCount_ > MOTION_HINT_MAX_AXES) ? MOTION_HINT_MAX_AXES : axisCount_;
+}
+
+//---------------------------------------------------------------------------
+void motion_hint_record(motion_hint_t* hint_, uint64_t timeUs_, const int32_t* values_)
+{
+    if ((hint_->count != 0) && (timeUs_ <= hint_->timeUs[hint_->head])) {
+        return;
+    }
+
+    hint_->head = (hint_->head + 1) % MOTION_HINT_HISTORY;
+    if (hint_->count < MOTION_HINT_HISTORY) {
+        hint_->count++;
+    }
+
+    hint_->timeUs[hint_->head] = timeUs_;
+    for (size_t i = 0; i < hint_->axisCount; i++) {
+        int32_t value = values_[i];
+        if (value > MOTION_HINT_VALUE_LIMIT) {
+            value = MOTION_HINT_VALUE_LIMIT;
+        } else if (value < -MOTION_HINT_VALUE_LIMIT) {
+            value = -MOTION_HINT_VALUE_LIMIT;
+        }
+        hint_->values[hint_->head][i] = value;
+    }
+}
+
+//---------------------------------------------------------------------------
+// The slope of the least-squares line through n points is
+//   sum(T * X) / sum(T * T), where T = n * t - sum(t) and X = n * x - sum(x)
+// (the n^2 factors cancel), which keeps everything in integers.  With at most
+// 8 samples, times within the 40ms window and values within +/- 32767, |T| and
+// |X| stay below 2^19 and 2^20, so sum(T * X) * 10^6 fits in 63 bits.
+int32_t motion_hint_velocity(const motion_hint_t* hint_, size_t axis_)
+{
+    if (axis_ >= hint_->axisCount) {
+        return 0;
+    }
+
+    uint64_t newest = hint_->timeUs[hint_->head];
+    int64_t  t[MOTION_HINT_HISTORY];
+    int64_t  x[MOTION_HINT_HISTORY];
+    int64_t  sumT = 0;
+    int64_t  sumX = 0;
+    int64_t  n    = 0;
+
+    for (size_t i = 0; i < hint_->count; i++) {
+        size_t   index = (hint_->head + MOTION_HINT_HISTORY - i) % MOTION_HINT_HISTORY;
+        uint64_t age   = newest - hint_->timeUs[index];
+        if (age > MOTION_HINT_WINDOW_US) {
+            break;
+        }
+        t[n] = -(int64_t)age;
+        x[n] = hint_->values[index][axis_];
+        sumT += t[n];
+        sumX += x[n];
+        n++;
+    }
+    if (n < 2) {
+        return 0;
+    }
+
+    int64_t sumTT = 0;
+    int64_t sumTX = 0;
+    for (int64_t i = 0; i < n; i++) {
+        int64_t dt = (n * t[i]) - sumT;
+        int64_t dx = (n * x[i]) - sumX;
+        sumTT += dt * dt;
+        sumTX += dt * dx;
+    }
+    if (sumTT == 0) {
+        return 0;
+    }
+
+    // Units per second, with the fraction bits taken from the remainder
+    bool     negative  = (sumTX < 0);
+    uint64_t magnitude = (uint64_t)(negative ? -sumTX : sumTX) * (uint64_t)MOTION_HINT_US_PER_SECOND;
+    uint64_t whole     = magnitude / (uint64_t)sumTT;
+    uint64_t fraction  = ((magnitude % (uint64_t)sumTT) << MOTION_HINT_VELOCITY_SHIFT) / (uint64_t)sumTT;
+
+    uint64_t velocity = (uint64_t)INT32_MAX;
+    if (whole < ((uint64_t)INT32_MAX >> MOTION_HINT_VELOCITY_SHIFT)) {
+        velocity = (whole << MOTION_HINT_VELOCITY_SHIFT) + fraction;
+    }
+    return negative ? -(int32_t)velocity : (int32_t)velocity;
+}
+
+//---------------------------------------------------------------------------
+int32_t motion_hint_extrapolate(int32_t value_, int32_t velocity_, uint32_t elapsedUs_)
+{
+    int64_t delta = ((int64_t)velocity_ * (int64_t)elapsedUs_)
+                    / (MOTION_HINT_US_PER_SECOND << MOTION_HINT_VELOCITY_SHIFT);
+    int64_t value = (int64_t)value_ + delta;
+
+    if (value > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (value < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)value;
+}
+
+//---------------------------------------------------------------------------
+uint32_t motion_hint_drift(int32_t velocity_, int32_t sentVelocity_, uint32_t elapsedUs_)
+{
+    // The difference of two velocities needs 33 bits; clamp it back to 32 so
+    // the extrapolation can't overflow either
+    int64_t change = (int64_t)velocity_ - (int64_t)sentVelocity_;
+    if (change > INT32_MAX) {
+        change = INT32_MAX;
+    } else if (change < -INT32_MAX) {
+        change = -INT32_MAX;
+    }
+
+    int64_t drift = motion_hint_extrapolate(0, (int32_t)change, elapsedUs_);
+    return (uint32_t)((drift < 0) ? -drift : drift);
+}
@@ -0,0 +1,97 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Most axes a velocity is estimated for, per device
+#define MOTION_HINT_MAX_AXES (8)
+
+// Samples kept per device, and the age beyond which they no longer count
+#define MOTION_HINT_HISTORY (8)
+#define MOTION_HINT_WINDOW_US (40000)
+
+// Fraction bits of a velocity: axis units per second, in Q24.8 fixed point
+#define MOTION_HINT_VELOCITY_SHIFT (8)
+
+//---------------------------------------------------------------------------
+// Recent axis samples of a device, from which the velocity of each axis is
+// estimated -- the slope of a least-squares line through the samples taken
+// within the last MOTION_HINT_WINDOW_US.  Fitting a line, rather than
+// differencing the last two samples, keeps a single noisy or repeated sample
+// from swinging the estimate.  All arithmetic is integer.
+typedef struct {
+    size_t   axisCount;                                         //!< Axes sampled
+    size_t   head;                                              //!< Index of the newest sample
+    size_t   count;                                             //!< Samples held
+    uint64_t timeUs[MOTION_HINT_HISTORY];                       //!< Time of each sample (us)
+    int32_t  values[MOTION_HINT_HISTORY][MOTION_HINT_MAX_AXES]; //!< Axis values of each sample
+} motion_hint_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief motion_hint_init Initialize a device's sample history
+ * @param hint_ object to initialize
+ * @param axisCount_ number of axes sampled (at most MOTION_HINT_MAX_AXES; more are ignored)
+ */
+void motion_hint_init(motion_hint_t* hint_, size_t axisCount_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief motion_hint_record Add a sample to the history.  A sample no newer
+ * than the last one is ignored.
+ * @param hint_ sample history
+ * @param timeUs_ time the sample was taken (us, monotonic)
+ * @param values_ value of each axis (axisCount entries, within +/- 32767)
+ */
+void motion_hint_record(motion_hint_t* hint_, uint64_t timeUs_, const int32_t* values_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief motion_hint_velocity Estimate an axis' velocity as of the newest
+ * sample
+ * @param hint_ sample history
+ * @param axis_ index of the axis
+ * @return velocity, in axis units per second (Q24.8); 0 if fewer than two
+ * samples fall within the window
+ */
+int32_t motion_hint_velocity(const motion_hint_t* hint_, size_t axis_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief motion_hint_extrapolate Project an axis value forward in time using
+ * its velocity -- for receivers, to estimate where an axis is "now" rather
+ * than where it was when last sampled.  The caller should limit elapsedUs_
+ * (extrapolating far past a sample amplifies any error in the velocity), and
+ * clamp the result to the axis' range.
+ * @param value_ axis value, as sampled
+ * @param velocity_ velocity of the axis (Q24.8 units per second)
+ * @param elapsedUs_ time since the sample was taken (us)
+ * @return projected axis value
+ */
+int32_t motion_hint_extrapolate(int32_t value_, int32_t velocity_, uint32_t elapsedUs_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief motion_hint_drift How far apart two extrapolations from the same
+ * value end up when made with different velocities -- for senders, to decide
+ * whether the velocity last sent has gone stale.  Safe for any pair of
+ * velocities, however far apart.
+ * @param velocity_ current velocity of the axis (Q24.8 units per second)
+ * @param sentVelocity_ velocity last sent for the axis (Q24.8 units per second)
+ * @param elapsedUs_ extrapolation horizon (us)
+ * @return distance between the two projected values (axis units)
+ */
+uint32_t motion_hint_drift(int32_t velocity_, int32_t sentVelocity_, uint32_t elapsedUs_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -13,65 +13,201 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#if defined(__linux__)
+#include <linux/sockios.h>
+#endif
 
-#include "slip.h"
+#include "framing.h"
+#include "logger.h"
+#include "perf.h"
+#include "stats.h"
 #include "tlvc.h"
 
 //---------------------------------------------------------------------------
-bool net_util_encode_and_transmit(int sockFd_, uint16_t messageType_, void* data_, size_t dataLen_)
+size_t net_util_encoded_size(framing_type_t framing_, size_t dataLen_)
 {
-    tlvc_data_t tlvc = {};
-    tlvc_encode_data(&tlvc, messageType_, dataLen_, data_);
+    return framing_max_encoded_size(framing_, sizeof(tlvc_header_t) + dataLen_ + sizeof(tlvc_footer_t));
+}
 
-    slip_encode_message_t* encode = slip_encode_message_create(dataLen_);
-    slip_encode_begin(encode);
+//---------------------------------------------------------------------------
+size_t net_util_encode(framing_type_t framing_,
+                       uint16_t       messageType_,
+                       void*          data_,
+                       size_t         dataLen_,
+                       uint8_t*       frame_,
+                       size_t         frameSize_)
+{
+    PERF_SCOPE(PerfStageEncode);
 
-    uint8_t* raw = (uint8_t*)&tlvc.header;
-    for (size_t i = 0; i < sizeof(tlvc.header); i++) { slip_encode_byte(encode, *raw++); }
+    tlvc_data_t       tlvc    = {};
+    framing_encoder_t encoder = {};
 
-    raw = (uint8_t*)tlvc.data;
-    for (size_t i = 0; i < tlvc.dataLen; i++) { slip_encode_byte(encode, *raw++); }
+    if (frameSize_ < net_util_encoded_size(framing_, dataLen_)) {
+        return 0;
+    }
 
-    raw = (uint8_t*)&tlvc.footer;
-    for (size_t i = 0; i < sizeof(tlvc.footer); i++) { slip_encode_byte(encode, *raw++); }
+    tlvc_encode_data(&tlvc, messageType_, dataLen_, data_);
 
-    slip_encode_finish(encode);
+    framing_encode_begin(&encoder, framing_, frame_, frameSize_);
+    framing_encode_data(&encoder, &tlvc.header, sizeof(tlvc.header));
+    framing_encode_data(&encoder, tlvc.data, tlvc.dataLen);
+    framing_encode_data(&encoder, &tlvc.footer, sizeof(tlvc.footer));
+    return framing_encode_finish(&encoder);
+}
 
-    int toWrite = encode->index;
-    raw         = encode->encoded;
+//---------------------------------------------------------------------------
+bool net_util_backlog_init(net_util_backlog_t* backlog_, size_t maxFrame_)
+{
+    backlog_->pending     = (uint8_t*)malloc(maxFrame_);
+    backlog_->pendingLen  = 0;
+    backlog_->pendingSize = maxFrame_;
+    return backlog_->pending != NULL;
+}
 
-    bool died = false;
+//---------------------------------------------------------------------------
+// Write as much of a buffer as the socket takes without waiting.  Returns the
+// number of bytes written (0 if the socket buffer is full), or -1 on error.
+static int net_util_write(int sockFd_, net_stats_t* stats_, const uint8_t* data_, size_t dataLen_)
+{
+    int nWritten = send(sockFd_, data_, dataLen_, MSG_DONTWAIT);
+    if (nWritten < 0) {
+        // Logging may clobber errno, so it's read first
+        int error = errno;
+        if ((error == EAGAIN) || (error == EWOULDBLOCK)) {
+            if (stats_) {
+                stats_->sendBackpressure++;
+            }
+            return 0;
+        }
+        if (stats_) {
+            stats_->sendErrors++;
+        }
+        LOG_ERROR("socket error: %d", error);
+        return -1;
+    }
 
-    int nWritten = send(sockFd_, raw, toWrite, MSG_DONTWAIT);
-    if (nWritten == -1) {
-        printf("socket error: %d\n", errno);
-        died = true;
+    if (stats_) {
+        stats_->bytesSent += (uint64_t)nWritten;
+        if ((size_t)nWritten < dataLen_) {
+            stats_->sendBackpressure++;
+        }
     }
+    return nWritten;
+}
 
-    slip_encode_message_destroy(encode);
+//---------------------------------------------------------------------------
+bool net_util_flush(int sockFd_, net_stats_t* stats_, net_util_backlog_t* backlog_)
+{
+    if (backlog_->pendingLen == 0) {
+        return true;
+    }
 
-    if (died) {
-        printf("socket died during write\n");
+    int nWritten = net_util_write(sockFd_, stats_, backlog_->pending, backlog_->pendingLen);
+    if (nWritten < 0) {
         return false;
     }
 
+    backlog_->pendingLen -= (size_t)nWritten;
+    memmove(backlog_->pending, backlog_->pending + nWritten, backlog_->pendingLen);
     return true;
 }
 
+//---------------------------------------------------------------------------
+net_util_send_return_t net_util_transmit(int                 sockFd_,
+                                         net_stats_t*        stats_,
+                                         net_util_backlog_t* backlog_,
+                                         const uint8_t*      frame_,
+                                         size_t              frameLen_)
+{
+    PERF_SCOPE(PerfStageSend);
+
+    // The rest of an earlier frame goes first; if it still doesn't fit, this
+    // frame is dropped whole rather than queued behind it.
+    if (backlog_ && !net_util_flush(sockFd_, stats_, backlog_)) {
+        return NetUtilSendError;
+    }
+    if (backlog_ && (backlog_->pendingLen != 0)) {
+        if (stats_) {
+            stats_->framesDropped++;
+        }
+        return NetUtilSendDropped;
+    }
+
+    int nWritten = net_util_write(sockFd_, stats_, frame_, frameLen_);
+    if (nWritten < 0) {
+        LOG_WARNING("socket died during write");
+        return NetUtilSendError;
+    }
+
+    size_t remaining = frameLen_ - (size_t)nWritten;
+    if (remaining != 0) {
+        if (!backlog_ && (nWritten == 0)) {
+            if (stats_) {
+                stats_->framesDropped++;
+            }
+            return NetUtilSendDropped;
+        }
+        if (!backlog_ || (remaining > backlog_->pendingSize)) {
+            // Anything sent after a partial frame would corrupt the stream
+            LOG_WARNING("partial write with no backlog (%lu bytes unsent)", (unsigned long)remaining);
+            return NetUtilSendError;
+        }
+        memcpy(backlog_->pending, frame_ + nWritten, remaining);
+        backlog_->pendingLen = remaining;
+    }
+
+    if (stats_) {
+        stats_->messagesSent++;
+    }
+    return NetUtilSendOk;
+}
+
+//---------------------------------------------------------------------------
+net_util_send_return_t net_util_encode_and_transmit(int                 sockFd_,
+                                                    framing_type_t      framing_,
+                                                    net_stats_t*        stats_,
+                                                    net_util_backlog_t* backlog_,
+                                                    uint16_t            messageType_,
+                                                    void*               data_,
+                                                    size_t              dataLen_)
+{
+    uint8_t  frameBuffer[NET_UTIL_FRAME_BUFFER_SIZE];
+    uint8_t* raw       = frameBuffer;
+    size_t   frameSize = net_util_encoded_size(framing_, dataLen_);
+
+    if (frameSize > sizeof(frameBuffer)) {
+        raw = (uint8_t*)malloc(frameSize);
+        if (!raw) {
+            return NetUtilSendError;
+        }
+    }
+
+    size_t                 toWrite = net_util_encode(framing_, messageType_, data_, dataLen_, raw, frameSize);
+    net_util_send_return_t rc      = net_util_transmit(sockFd_, stats_, backlog_, raw, toWrite);
+
+    if (raw != frameBuffer) {
+        free(raw);
+    }
+    return rc;
+}
+
 //---------------------------------------------------------------------------
 // Attempt to connect to the server, return open socket fd on success.
 int net_util_connect(const char* serverAddr_, uint16_t serverPort_)
 {
-    printf("connecting to %s:%d\n", serverAddr_, serverPort_);
+    LOG_INFO("connecting to %s:%d", serverAddr_, serverPort_);
 
     // Create the client socket address
     int sockFd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockFd < 0) {
-        printf("error connecting socket: %d (%s)\n", errno, strerror(errno));
+        LOG_ERROR("error connecting socket: %d (%s)", errno, strerror(errno));
         return -1;
     }
 
@@ -84,9 +220,135 @@ int net_util_connect(const char* serverAddr_, uint16_t serverPort_)
 
     int rc = connect(sockFd, (struct sockaddr*)&addr, sizeof(addr));
     if (rc < 0) {
-        printf("error connecting to server: %d (%s)\n", errno, strerror(errno));
+        LOG_WARNING("error connecting to server: %d (%s)", errno, strerror(errno));
         close(sockFd);
         return -1;
     }
     return sockFd;
 }
+
+//---------------------------------------------------------------------------
+int net_util_connect_start(const char* serverAddr_, uint16_t serverPort_)
+{
+    int sockFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockFd < 0) {
+        LOG_ERROR("error creating socket: %d (%s)", errno, strerror(errno));
+        return -1;
+    }
+
+    int flags = fcntl(sockFd, F_GETFL, 0);
+    if ((flags < 0) || (fcntl(sockFd, F_SETFL, flags | O_NONBLOCK) < 0)) {
+        close(sockFd);
+        return -1;
+    }
+
+    struct sockaddr_in addr = {};
+
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, serverAddr_, &(addr.sin_addr));
+    addr.sin_port = htons(serverPort_);
+
+    if ((connect(sockFd, (struct sockaddr*)&addr, sizeof(addr)) < 0) && (errno != EINPROGRESS)) {
+        LOG_WARNING("error connecting to %s:%d: %d", serverAddr_, serverPort_, errno);
+        close(sockFd);
+        return -1;
+    }
+    return sockFd;
+}
+
+//---------------------------------------------------------------------------
+int net_util_connect_check(int sockFd_)
+{
+    struct pollfd fd = {};
+    fd.fd            = sockFd_;
+    fd.events        = POLLOUT;
+
+    int rc = poll(&fd, 1, 0);
+    if (rc == 0) {
+        return 0;
+    }
+    if (rc < 0) {
+        return -1;
+    }
+
+    int       error    = 0;
+    socklen_t errorLen = sizeof(error);
+    if ((getsockopt(sockFd_, SOL_SOCKET, SO_ERROR, &error, &errorLen) < 0) || (error != 0)) {
+        return -1;
+    }
+    return 1;
+}
+
+//---------------------------------------------------------------------------
+bool net_util_receive(int                        sockFd_,
+                      framing_decoder_t*         decoder_,
+                      net_util_message_handler_t handler_,
+                      void*                      context_)
+{
+    uint8_t buffer[256];
+
+    while (true) {
+        int nRead = recv(sockFd_, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (nRead == 0) {
+            LOG_INFO("connection closed by peer");
+            return false;
+        }
+        if (nRead < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return true;
+            }
+            LOG_ERROR("socket error: %d", errno);
+            return false;
+        }
+
+        size_t offset = 0;
+        while (offset < (size_t)nRead) {
+            size_t                  consumed = 0;
+            framing_decode_return_t rc = framing_decode_data(decoder_, &buffer[offset], nRead - offset, &consumed);
+            offset += consumed;
+
+            if (rc == FramingDecodeEndOfFrame) {
+                tlvc_data_t tlvc = {};
+                if ((decoder_->index != 0) && tlvc_decode_data(&tlvc, decoder_->raw, decoder_->index)) {
+                    handler_(context_, tlvc.header.tag, tlvc.data, tlvc.dataLen);
+                }
+            } else if (rc != FramingDecodeOk) {
+                // Corrupt frames are discarded, and the decoder resynchronizes on
+                // the next frame delimiter -- unless the stream has no delimiters.
+                if (!framing_can_resync(decoder_->type)) {
+                    LOG_ERROR("framing error");
+                    return false;
+                }
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+bool net_util_send_queue(int sockFd_, uint32_t* queuedBytes_, uint32_t* rttUs_)
+{
+    bool reported = false;
+
+    *queuedBytes_ = 0;
+    *rttUs_       = 0;
+
+    // Neither is available from the 3DS' socket service; on Linux hosts they
+    // come from the kernel's TCP state.
+#if defined(SIOCOUTQ)
+    int queued = 0;
+    if ((ioctl(sockFd_, SIOCOUTQ, &queued) == 0) && (queued >= 0)) {
+        *queuedBytes_ = (uint32_t)queued;
+        reported      = true;
+    }
+#endif
+#if defined(TCP_INFO)
+    struct tcp_info info    = {};
+    socklen_t       infoLen = sizeof(info);
+    if (getsockopt(sockFd_, IPPROTO_TCP, TCP_INFO, &info, &infoLen) == 0) {
+        *rttUs_  = info.tcpi_rtt;
+        reported = true;
+    }
+#endif
+    (void)sockFd_;
+    return reported;
+}
@@ -7,10 +7,18 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "framing.h"
+#include "stats.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
+//---------------------------------------------------------------------------
+// Frames up to this size are encoded on the stack; larger ones (i.e. device
+// configuration) are allocated.
+#define NET_UTIL_FRAME_BUFFER_SIZE (256)
+
 //---------------------------------------------------------------------------
 /**
  * @brief net_util_connect Helper function; creates a TCP/IP connection to the
@@ -21,17 +29,171 @@ extern "C" {
  */
 int net_util_connect(const char* serverAddr_, uint16_t serverPort_);
 
+//---------------------------------------------------------------------------
+/**
+ * @brief net_util_connect_start Begin a TCP/IP connection to a host without
+ * waiting for it to complete.  The socket is left in non-blocking mode.
+ * @param serverAddr_ IP Address of the server (encoded as char string)
+ * @param serverPort_ Port on the server to connect to
+ * @return fd of the connecting socket, or -1 on error
+ */
+int net_util_connect_start(const char* serverAddr_, uint16_t serverPort_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief net_util_connect_check Check (without blocking) on a connection
+ * begun by net_util_connect_start()
+ * @param sockFd_ fd of the connecting socket
+ * @return 1 if connected, 0 if still in progress, -1 if the connection failed
+ */
+int net_util_connect_check(int sockFd_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief net_util_encoded_size Get the largest size of an encoded message
+ * @param framing_ framing codec used on the connection
+ * @param dataLen_ Length of the message payload (in bytes)
+ * @return worst-case size of the framed message, in bytes
+ */
+size_t net_util_encoded_size(framing_type_t framing_, size_t dataLen_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief net_util_encode Encode a message as a framed TLVC message, without
+ * sending it -- so the same frame can be sent to several connections.
+ * @param framing_ framing codec used on the connection(s)
+ * @param messageType_ Message ID associated with the data being sent
+ * @param data_ Raw blob of data to encode
+ * @param dataLen_ Length of the data blob (in bytes)
+ * @param frame_ [out] buffer receiving the encoded frame
+ * @param frameSize_ size of the frame_ buffer; at least
+ * net_util_encoded_size(framing_, dataLen_) bytes
+ * @return size of the encoded frame, or 0 if the buffer is too small
+ */
+size_t net_util_encode(framing_type_t framing_,
+                       uint16_t       messageType_,
+                       void*          data_,
+                       size_t         dataLen_,
+                       uint8_t*       frame_,
+                       size_t         frameSize_);
+
+//---------------------------------------------------------------------------
+// Outcome of sending a frame without blocking
+typedef enum {
+    NetUtilSendOk = 0,  //!< Frame sent (the part that didn't fit, if any, is held in the backlog)
+    NetUtilSendDropped, //!< Socket buffer full -- frame dropped whole; the connection is intact
+    NetUtilSendError,   //!< Socket error -- the connection must be closed
+} net_util_send_return_t;
+
+//---------------------------------------------------------------------------
+// Unsent part of a connection's last frame.  When the socket buffer fills up
+// (EAGAIN, or a short write), whatever didn't fit is held here and sent ahead
+// of anything else, so frames are never cut short or interleaved; frames sent
+// while it is still waiting are dropped whole.
+typedef struct {
+    uint8_t* pending;     //!< Unsent bytes
+    size_t   pendingLen;  //!< Number of unsent bytes
+    size_t   pendingSize; //!< Size of the pending buffer (the largest frame sent on the connection)
+} net_util_backlog_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief net_util_backlog_init Allocate a connection's backlog
+ * @param backlog_ backlog to initialize
+ * @param maxFrame_ size of the largest frame sent on the connection
+ * @return true on success, false if out of memory
+ */
+bool net_util_backlog_init(net_util_backlog_t* backlog_, size_t maxFrame_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief net_util_flush Send as much of a connection's backlog as the socket
+ * takes without blocking
+ * @param sockFd_ fd representing the active socket connection
+ * @param stats_ send-path counters to update for the connection (may be NULL)
+ * @param backlog_ the connection's backlog
+ * @return true on success (even if some of the backlog is left), false on
+ * socket error
+ */
+bool net_util_flush(int sockFd_, net_stats_t* stats_, net_util_backlog_t* backlog_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief net_util_transmit Send an encoded frame to an active socket
+ * connection (without blocking).  A full socket buffer is backpressure, not
+ * an error: the frame is queued in the backlog if it is empty, and dropped
+ * otherwise.
+ * @param sockFd_ fd representing the active socket connection
+ * @param stats_ send-path counters to update for the connection (may be NULL)
+ * @param backlog_ the connection's backlog (NULL == none: a frame that only
+ * partly fits is a socket error, since the rest would be lost)
+ * @param frame_ encoded frame, from net_util_encode()
+ * @param frameLen_ size of the frame (in bytes)
+ * @return outcome of the send
+ */
+net_util_send_return_t net_util_transmit(int                 sockFd_,
+                                         net_stats_t*        stats_,
+                                         net_util_backlog_t* backlog_,
+                                         const uint8_t*      frame_,
+                                         size_t              frameLen_);
+
 //---------------------------------------------------------------------------
 /**
  * @brief net_util_encode_and_transmit Send a message to an active socket
- * connection using TLVC encoding.
+ * connection using TLVC encoding (see net_util_transmit()).
  * @param sockFd_ fd representing the active socket connection
+ * @param framing_ framing codec used on the connection
+ * @param stats_ send-path counters to update for the connection (may be NULL)
+ * @param backlog_ the connection's backlog (may be NULL)
  * @param messageType_ Message ID associated with the data being sent
  * @param data_ Raw blob of data to send over the socket
  * @param dataLen_ Length of the data blob (in bytes)
- * @return true on success, false on socket error
+ * @return outcome of the send
+ */
+net_util_send_return_t net_util_encode_and_transmit(int                 sockFd_,
+                                                    framing_type_t      framing_,
+                                                    net_stats_t*        stats_,
+                                                    net_util_backlog_t* backlog_,
+                                                    uint16_t            messageType_,
+                                                    void*               data_,
+                                                    size_t              dataLen_);
+
+//---------------------------------------------------------------------------
+// Callout invoked for each intact TLVC message received on a socket
+typedef void (*net_util_message_handler_t)(void* context_, uint16_t messageType_, void* data_, size_t dataLen_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief net_util_receive Read any data that is already waiting on a socket
+ * (without blocking), decode it as a stream of framed TLVC messages, and
+ * invoke a handler for each complete and valid message.  Partial frames are
+ * held in the decoder until the rest of the frame arrives.  The handler may
+ * reset the decoder to switch codecs; the change applies from the next byte.
+ * @param sockFd_ fd representing the active socket connection
+ * @param decoder_ frame decoder holding the connection's receive state
+ * @param handler_ function invoked for each decoded message
+ * @param context_ user-defined context passed to the handler
+ * @return true on success (including when no data was available), false if
+ * the connection was closed by the peer, a socket error occurred, or the
+ * stream was corrupt and can't be resynchronized.
+ */
+bool net_util_receive(int                        sockFd_,
+                      framing_decoder_t*         decoder_,
+                      net_util_message_handler_t handler_,
+                      void*                      context_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief net_util_send_queue Read the state of a connection's send queue, on
+ * platforms whose socket layer reports it.
+ * @param sockFd_ fd representing the active socket connection
+ * @param queuedBytes_ [out] bytes written to the socket but not yet acknowledged
+ * by the peer (0 if not reported)
+ * @param rttUs_ [out] the connection's smoothed round-trip time estimate, in
+ * microseconds (0 if not reported)
+ * @return true if either value was reported, false otherwise
  */
-bool net_util_encode_and_transmit(int sockFd_, uint16_t messageType_, void* data_, size_t dataLen_);
+bool net_util_send_queue(int sockFd_, uint32_t* queuedBytes_, uint32_t* rttUs_);
 
 #if defined(__cplusplus)
 } // extern "C"
@@ -1,177 +1,371 @@
-// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
-// for more details.
-
-#include <stdbool.h>
-#include <stdint.h>
-#include <stddef.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <errno.h>
-#include <malloc.h>
-#include <stdarg.h>
-#include <string.h>
-#include <unistd.h>
-
-#include <fcntl.h>
-#include <sys/socket.h>
-#include <sys/types.h>
-#include <arpa/inet.h>
-#include <netinet/in.h>
-
-#include <3ds.h>
-
-#include "hid_device.h"
-#include "hid_accel.h"
-#include "hid_gyro.h"
-#include "hid_touch.h"
-#include "hid_gamepad.h"
-
-#include "joystick.h"
-#include "options.h"
-#include "tlvc.h"
-#include "slip.h"
-
-//---------------------------------------------------------------------------
-// SOC service stuff... from the examples.
-#define SOC_ALIGN 0x1000
-#define SOC_BUFFERSIZE 0x100000
-
-//---------------------------------------------------------------------------
-static program_options_t programOptions;
-
-static hid_device_t hidGamepad;
-static hid_device_t hidAccel;
-static hid_device_t hidGyro;
-static hid_device_t hidTouchscreen;
-
-//---------------------------------------------------------------------------
-static bool init_config()
-{
-    // Read config file on device
-    program_options_init(&programOptions);
-
-    if (!program_options_load(&programOptions, "config.txt")) {
-        printf("Please create a file named config.txt in the \n"
-               "app's directory, with lines containing \n"
-               "the server's IP and port, as below:\n\n"
-               "server:192.168.1.1\n"
-               "port:1234\n\n"
-               "\n"
-               "Press any key to exit...\n");
-
-        // Fail loop to run if we couldn't read the config file.
-        while (aptMainLoop()) {
-            gspWaitForVBlank();
-            hidScanInput();
-
-            uint32_t keys = hidKeysDown();
-            if (keys) {
-                break;
-            }
-
-            gfxFlushBuffers();
-            gfxSwapBuffers();
-        }
-        return false;
-    }
-    return true;
-}
-
-//---------------------------------------------------------------------------
-static void init_hid_devices()
-{
-    hid_gamepad_init(&hidGamepad, &programOptions);
-
-    if (programOptions.useAccel) {
-        hid_accel_init(&hidAccel, &programOptions);
-    }
-
-    if (programOptions.useGyro) {
-        hid_gyro_init(&hidGyro, &programOptions);
-    }
-
-    if (programOptions.useTouch) {
-        hid_touch_init(&hidTouchscreen, &programOptions);
-    }
-}
-
-//---------------------------------------------------------------------------
-int main(void)
-{
-    // ToDo: 3ds init stuff...
-    gfxInitDefault();
-
-    consoleInit(GFX_TOP, NULL);
-
-    // Read from the config file and ensure we have all required properties
-    if (!init_config()) {
-        gfxExit();
-        return 0;
-    }
-
-    init_hid_devices();
-
-    // allocate buffer for SOC service
-    uint32_t* socBuffer = (uint32_t*)memalign(SOC_ALIGN, SOC_BUFFERSIZE);
-    socInit(socBuffer, SOC_BUFFERSIZE);
-
-    // Enable the accel
-    if (programOptions.useAccel || programOptions.useSteeringControls) {
-        HIDUSER_EnableAccelerometer();
-    }
-    if (programOptions.useGyro) {
-        HIDUSER_EnableGyroscope();
-    }
-
-    while (aptMainLoop()) {
-        gspWaitForVBlank();
-
-        hidScanInput();
-
-        bool rc = true;
-
-        rc = handle_hid_events(&hidGamepad, &programOptions);
-        if (rc && programOptions.useTouch) {
-            rc = handle_hid_events(&hidTouchscreen, &programOptions);
-        }
-        if (rc && programOptions.useAccel) {
-            rc = handle_hid_events(&hidAccel, &programOptions);
-        }
-        if (rc && programOptions.useGyro) {
-            rc = handle_hid_events(&hidGyro, &programOptions);
-        }
-
-        if (rc) {
-            // Poll input multiple times per vblank in order to reduce latency
-            // Don't think the touchscreen/accel latency is as big a concern...
-            for (int i = 0; i < 2; i++) {
-                svcSleepThread(1000000000ULL / 180ULL);
-                hidScanInput();
-                rc = handle_hid_events(&hidGamepad, &programOptions);
-                if (!rc) {
-                    break;
-                }
-            }
-        }
-
-        // If we encountered any socket errors, wait a couple seconds before continuing.
-        if (!rc) {
-            svcSleepThread(2000000000ULL);
-        }
-
-        gfxFlushBuffers();
-        gfxSwapBuffers();
-    }
-
-    if (programOptions.useGyro) {
-        HIDUSER_DisableGyroscope();
-    }
-    if (programOptions.useAccel || programOptions.useSteeringControls) {
-        HIDUSER_DisableAccelerometer();
-    }
-
-    socExit();
-    gfxExit();
-
-    return 0;
-}
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <malloc.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <3ds.h>
+
+#include "hid_device.h"
+#include "hid_accel.h"
+#include "hid_gyro.h"
+#include "hid_touch.h"
+#include "hid_gamepad.h"
+
+#include "idle.h"
+#include "input_capture.h"
+#include "input_state.h"
+#include "input_wakeup.h"
+#include "joystick.h"
+#include "logger.h"
+#include "options.h"
+#include "overlay.h"
+#include "perf.h"
+#include "pipeline.h"
+#include "stats.h"
+#include "telemetry.h"
+#include "time_util.h"
+#include "tlvc.h"
+#include "slip.h"
+
+//---------------------------------------------------------------------------
+// SOC service stuff... from the examples.
+#define SOC_ALIGN 0x1000
+#define SOC_BUFFERSIZE 0x100000
+
+//---------------------------------------------------------------------------
+// Input is polled 3x per vblank; each poll has this long before the next is due.
+#define POLLS_PER_FRAME (3)
+#define POLL_PERIOD_NS (1000000000ULL / 180ULL)
+#define FRAME_PERIOD_NS (POLLS_PER_FRAME * POLL_PERIOD_NS)
+#define MAX_HID_DEVICES (4)
+
+// Log messages printed to the console per frame, after the frame's polls
+#define LOG_MESSAGES_PER_FRAME (2)
+
+//---------------------------------------------------------------------------
+static program_options_t programOptions;
+
+static hid_device_t hidGamepad;
+static hid_device_t hidAccel;
+static hid_device_t hidGyro;
+static hid_device_t hidTouchscreen;
+
+static hid_device_t* hidDevices[MAX_HID_DEVICES];
+static size_t        hidDeviceCount;
+
+static loop_stats_t    loopStats;
+static idle_state_t    idleState;
+static pipeline_t      pipeline;
+static input_capture_t inputCapture;
+static input_wakeup_t  inputWakeup;
+
+//---------------------------------------------------------------------------
+static bool init_config()
+{
+    // Read config file on device
+    program_options_init(&programOptions);
+
+    if (!program_options_load(&programOptions, "config.txt")) {
+        printf("Please create a file named config.txt in the \n"
+               "app's directory, with lines containing \n"
+               "the server's IP and port, as below:\n\n"
+               "server:192.168.1.1\n"
+               "port:1234\n\n"
+               "\n"
+               "Press any key to exit...\n");
+
+        // Fail loop to run if we couldn't read the config file.
+        while (aptMainLoop()) {
+            gspWaitForVBlank();
+            hidScanInput();
+
+            uint32_t keys = hidKeysDown();
+            if (keys) {
+                break;
+            }
+
+            gfxFlushBuffers();
+            gfxSwapBuffers();
+        }
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static void init_hid_devices()
+{
+    hid_gamepad_init(&hidGamepad, &programOptions);
+    hidDevices[hidDeviceCount++] = &hidGamepad;
+
+    if (programOptions.useAccel) {
+        hid_accel_init(&hidAccel, &programOptions);
+        hidDevices[hidDeviceCount++] = &hidAccel;
+    }
+
+    if (programOptions.useGyro) {
+        hid_gyro_init(&hidGyro, &programOptions);
+        hidDevices[hidDeviceCount++] = &hidGyro;
+    }
+
+    if (programOptions.useTouch) {
+        hid_touch_init(&hidTouchscreen, &programOptions);
+        hidDevices[hidDeviceCount++] = &hidTouchscreen;
+    }
+}
+
+//---------------------------------------------------------------------------
+static void scan_input(input_state_t* input_)
+{
+    PERF_SCOPE(PerfStageHidScan);
+    hidScanInput();
+    input_state_sample(input_);
+}
+
+//---------------------------------------------------------------------------
+// Poll input, handing the pipeline a snapshot for every key edge recorded by
+// the HID module since the last poll, followed by the poll's own snapshot.
+// Each edge goes out as a report of its own, but the wire carries no edge
+// time -- the server sees them in order, all at the time of this poll.
+static void poll_input(input_state_t* input_, bool allDevices_, uint64_t pollBudget_)
+{
+    input_state_t edges[INPUT_CAPTURE_MAX_EDGES];
+    size_t        edgeCount = 0;
+    uint64_t      pollStart = time_util_ticks();
+
+    // Edges are drained before scanning, so the scan is never older than them
+    if (programOptions.subframeCapture) {
+        edgeCount = input_capture_drain(&inputCapture, input_, edges);
+    }
+
+    scan_input(input_);
+    input_->allDevices = allDevices_;
+
+    for (size_t i = 0; i < edgeCount; i++) {
+        idle_update(&idleState, &edges[i]);
+        pipeline_submit(&pipeline, &edges[i]);
+    }
+
+    input_->idle = idle_update(&idleState, input_);
+    pipeline_submit(&pipeline, input_);
+
+    loop_stats_record_poll(&loopStats, pollStart, pollBudget_);
+}
+
+//---------------------------------------------------------------------------
+// Poll each HID sample as soon as it's published, until a frame's worth of
+// time has passed.  The wait times out after a poll period, so the motion
+// sensors and c-stick are still polled at least as often as in vblank mode.
+static void poll_frame_on_events(input_state_t* input_, uint64_t pollBudget_)
+{
+    uint64_t frameEnd = time_util_ticks() + time_util_us_to_ticks(FRAME_PERIOD_NS / 1000ULL);
+    bool     first    = true;
+
+    do {
+        input_wakeup_wait(&inputWakeup, POLL_PERIOD_NS);
+        poll_input(input_, first, pollBudget_);
+        first = false;
+    } while (!idleState.idle && (time_util_ticks() < frameEnd));
+}
+
+//---------------------------------------------------------------------------
+int main(void)
+{
+    // ToDo: 3ds init stuff...
+    gfxInitDefault();
+
+    consoleInit(GFX_TOP, NULL);
+
+    // Read from the config file and ensure we have all required properties
+    if (!init_config()) {
+        gfxExit();
+        return 0;
+    }
+
+    logger_init((logger_level_t)programOptions.logLevel, programOptions.logFile);
+
+    init_hid_devices();
+
+    if (programOptions.showOverlay) {
+        overlay_init();
+    }
+
+    // allocate buffer for SOC service
+    uint32_t* socBuffer = (uint32_t*)memalign(SOC_ALIGN, SOC_BUFFERSIZE);
+    socInit(socBuffer, SOC_BUFFERSIZE);
+
+    // Enable the accel
+    if (programOptions.useAccel || programOptions.useSteeringControls) {
+        HIDUSER_EnableAccelerometer();
+    }
+    if (programOptions.useGyro) {
+        HIDUSER_EnableGyroscope();
+    }
+
+    PERF_INIT();
+    loop_stats_init(&loopStats);
+    telemetry_init();
+
+    const uint64_t pollBudget = time_util_us_to_ticks(POLL_PERIOD_NS / 1000ULL);
+
+    idle_init(&idleState, programOptions.idleTimeoutMs, programOptions.idlePollMs, programOptions.idleBacklightOff);
+    if (idleState.enabled && idleState.backlightOff) {
+        gspLcdInit();
+    }
+
+    if (!pipeline_start(&pipeline, hidDevices, hidDeviceCount, &programOptions)) {
+        logger_exit();
+        socExit();
+        gfxExit();
+        return 0;
+    }
+
+    // The most recent snapshot; also supplies the inputs that sub-frame
+    // capture doesn't record (motion sensors, c-stick) to its edge snapshots.
+    input_state_t input = {};
+    input_capture_init(&inputCapture);
+
+    if (programOptions.eventWakeup && !input_wakeup_init(&inputWakeup)) {
+        LOG_WARNING("Couldn't get HID event handles; polling on vblank");
+    }
+
+    // The main thread is the sampler: it polls input at a steady rate and hands
+    // snapshots to the pipeline's sender thread, which does all socket I/O.
+    while (aptMainLoop()) {
+        PERF_SCOPE(PerfStageLoop);
+
+        // While idle, poll at a low rate instead of following the display
+        if (idleState.idle) {
+            svcSleepThread(idleState.pollPeriodNs);
+            poll_input(&input, true, pollBudget);
+        } else if (inputWakeup.enabled) {
+            poll_frame_on_events(&input, pollBudget);
+        } else {
+            gspWaitForVBlank();
+
+            // Poll input multiple times per vblank in order to reduce latency.
+            // Only the first poll of each frame is reported by all devices; don't
+            // think the touchscreen/accel latency is as big a concern...
+            for (int i = 0; i < POLLS_PER_FRAME; i++) {
+                if (i != 0) {
+                    svcSleepThread(POLL_PERIOD_NS);
+                }
+
+                poll_input(&input, (i == 0), pollBudget);
+                if (idleState.idle) {
+                    break;
+                }
+            }
+        }
+
+        // The loop statistics belong to this thread; the sender gets a copy for
+        // its telemetry once per frame
+        pipeline_publish_loop_stats(&pipeline, &loopStats);
+
+        // Console output is slow, so log messages are printed here -- after the
+        // frame's polls -- and only a few at a time.
+        logger_drain(LOG_MESSAGES_PER_FRAME);
+
+        // Nothing is drawn while idle, so the overlay and buffer swaps are skipped
+        if (!idleState.idle) {
+            if (programOptions.showOverlay) {
+                overlay_update(hidDevices, hidDeviceCount, &loopStats);
+            }
+
+            gfxFlushBuffers();
+            gfxSwapBuffers();
+        }
+    }
+
+    pipeline_stop(&pipeline);
+
+    // Make room in the log for the exit statistics
+    logger_drain(LOGGER_DRAIN_ALL);
+
+    if (programOptions.subframeCapture) {
+        LOG_SUMMARY("capture: %lu entries, %lu edges (%lu between polls), %lu overruns, mean edge age %lu us",
+                    (unsigned long)inputCapture.entries,
+                    (unsigned long)inputCapture.edges,
+                    (unsigned long)inputCapture.hiddenEdges,
+                    (unsigned long)inputCapture.overruns,
+                    (unsigned long)(inputCapture.edges
+                                        ? time_util_ticks_to_us(inputCapture.edgeAgeTicks / inputCapture.edges)
+                                        : 0));
+    }
+    for (size_t i = 0; i < hidDeviceCount; i++) {
+        const net_stats_t* stats = &hidDevices[i]->stats;
+        if (stats->buttonEdges || stats->reportsDeferred) {
+            LOG_SUMMARY("%s: %lu button edges (%lu messages), press->wire p50/p99 %lu/%lu us, %lu axis deferred",
+                        hidDevices[i]->name,
+                        (unsigned long)stats->buttonEdges,
+                        (unsigned long)stats->buttonFramesSent,
+                        (unsigned long)histogram_percentile(&stats->edgeLatencyUs, 0.50),
+                        (unsigned long)histogram_percentile(&stats->edgeLatencyUs, 0.99),
+                        (unsigned long)stats->reportsDeferred);
+        }
+        if (stats->framesDropped) {
+            LOG_SUMMARY("%s: %lu frames dropped (socket buffer full)",
+                        hidDevices[i]->name,
+                        (unsigned long)stats->framesDropped);
+        }
+        for (size_t m = 0; m < hidDevices[i]->mirrorCount; m++) {
+            const mirror_t* mirror = &hidDevices[i]->mirrors[m];
+            LOG_SUMMARY("%s: mirror %s:%u, %lu connects, %lu messages, %lu bytes, %lu dropped",
+                        hidDevices[i]->name,
+                        mirror->host,
+                        (unsigned)mirror->port,
+                        (unsigned long)mirror->connects,
+                        (unsigned long)mirror->messagesSent,
+                        (unsigned long)mirror->bytesSent,
+                        (unsigned long)mirror->framesDropped);
+        }
+    }
+    if (inputWakeup.enabled) {
+        LOG_SUMMARY("wakeup: %lu pad events, %lu timeouts",
+                    (unsigned long)inputWakeup.wakeups,
+                    (unsigned long)inputWakeup.timeouts);
+        input_wakeup_exit(&inputWakeup);
+    }
+    if (idleState.enabled) {
+        uint64_t idleTicks = idleState.idleTicksTotal + (idleState.idle ? time_util_ticks() - idleState.idleSince : 0);
+        LOG_SUMMARY("idle: %lu periods, %lu ms total",
+                    (unsigned long)idleState.idleEntries,
+                    (unsigned long)(time_util_ticks_to_us(idleTicks) / 1000ULL));
+    }
+    logger_exit();
+
+    idle_exit(&idleState);
+    if (idleState.enabled && idleState.backlightOff) {
+        gspLcdExit();
+    }
+
+    // Write out the per-stage timing data (if instrumentation is enabled)
+    PERF_DUMP_TO_FILE("perf.txt");
+
+    if (programOptions.useGyro) {
+        HIDUSER_DisableGyroscope();
+    }
+    if (programOptions.useAccel || programOptions.useSteeringControls) {
+        HIDUSER_DisableAccelerometer();
+    }
+
+    socExit();
+    gfxExit();
+
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include "options.h"
 
 #include <stdbool.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -15,6 +16,10 @@
 #include <unistd.h>
 
 #include <fcntl.h>
+
+#include "framing.h"
+#include "logger.h"
+
 //---------------------------------------------------------------------------
 typedef enum {
     PROGRAM_OPTION_HOST,
@@ -31,6 +36,28 @@ typedef enum {
     PROGRAM_OPTION_USE_GYRO,
     PROGRAM_OPTION_TOUCH_OFFSET,
     PROGRAM_OPTION_USE_STEERING_WHEEL,
+    PROGRAM_OPTION_SHOW_OVERLAY,
+    PROGRAM_OPTION_STATS_INTERVAL,
+    PROGRAM_OPTION_IDLE_TIMEOUT,
+    PROGRAM_OPTION_IDLE_POLL,
+    PROGRAM_OPTION_IDLE_BACKLIGHT_OFF,
+    PROGRAM_OPTION_REPORT_REFRESH,
+    PROGRAM_OPTION_FRAMING,
+    PROGRAM_OPTION_LOG_LEVEL,
+    PROGRAM_OPTION_LOG_FILE,
+    PROGRAM_OPTION_SUBFRAME_CAPTURE,
+    PROGRAM_OPTION_EVENT_WAKEUP,
+    PROGRAM_OPTION_BUTTON_FRAMES,
+    PROGRAM_OPTION_ANALOG_INTERVAL,
+    PROGRAM_OPTION_CONGESTION_CONTROL,
+    PROGRAM_OPTION_KEEP_WARM,
+    PROGRAM_OPTION_KEEP_WARM_MEASURE,
+    PROGRAM_OPTION_CIRCLE_PAD_X_RESPONSE,
+    PROGRAM_OPTION_CIRCLE_PAD_Y_RESPONSE,
+    PROGRAM_OPTION_CSTICK_X_RESPONSE,
+    PROGRAM_OPTION_CSTICK_Y_RESPONSE,
+    PROGRAM_OPTION_MIRROR,
+    PROGRAM_OPTION_MOTION_HINTS,
     //--
     PROGRAM_OPTION_COUNT
 } program_option_t;
@@ -79,6 +106,104 @@ static bool opt_handler_int(const char* value_, void* option_, bool* optionSet_)
     return true;
 }
 
+//---------------------------------------------------------------------------
+// Intervals are whole, non-negative numbers of milliseconds
+static bool opt_handler_interval(const char* value_, void* option_, bool* optionSet_)
+{
+    int*  intOption = option_;
+    char* end;
+    long  interval = strtol(value_, &end, 10);
+
+    if ((end == value_) || *end || (interval < 0) || (interval > INT_MAX)) {
+        printf("Invalid interval: %s\n", value_);
+        return false;
+    }
+
+    *intOption = (int)interval;
+    if (optionSet_) {
+        *optionSet_ = true;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static bool opt_handler_framing(const char* value_, void* option_, bool* optionSet_)
+{
+    int*           framingOption = option_;
+    framing_type_t framing;
+
+    if (!framing_type_from_name(value_, &framing)) {
+        return false;
+    }
+
+    *framingOption = (int)framing;
+    if (optionSet_) {
+        *optionSet_ = true;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static bool opt_handler_log_level(const char* value_, void* option_, bool* optionSet_)
+{
+    int*           levelOption = option_;
+    logger_level_t level;
+
+    if (!logger_level_from_name(value_, &level)) {
+        return false;
+    }
+
+    *levelOption = (int)level;
+    if (optionSet_) {
+        *optionSet_ = true;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static bool opt_handler_axis_curve(const char* value_, void* option_, bool* optionSet_)
+{
+    axis_curve_params_t* curveOption = option_;
+
+    if (!axis_curve_params_parse(curveOption, value_)) {
+        printf("Invalid axis response curve: %s\n", value_);
+        return false;
+    }
+    if (optionSet_) {
+        *optionSet_ = true;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Each "mirror" option adds a destination, given as host:port
+static bool opt_handler_mirror(const char* value_, void* option_, bool* optionSet_)
+{
+    program_options_t* options = option_;
+    const char*        colon   = strrchr(value_, ':');
+    int                port    = colon ? atoi(colon + 1) : 0;
+    size_t             hostLen = colon ? (size_t)(colon - value_) : 0;
+
+    if ((hostLen == 0) || (hostLen >= sizeof(options->mirrorHost[0])) || (port <= 0) || (port > UINT16_MAX)) {
+        printf("Invalid mirror: %s\n", value_);
+        return false;
+    }
+    if (options->mirrorCount >= PROGRAM_OPTIONS_MIRROR_MAX) {
+        printf("Too many mirrors (max %d)\n", PROGRAM_OPTIONS_MIRROR_MAX);
+        return false;
+    }
+
+    memcpy(options->mirrorHost[options->mirrorCount], value_, hostLen);
+    options->mirrorHost[options->mirrorCount][hostLen] = '\0';
+    options->mirrorPort[options->mirrorCount]          = port;
+    options->mirrorCount++;
+
+    if (optionSet_) {
+        *optionSet_ = true;
+    }
+    return true;
+}
+
 //---------------------------------------------------------------------------
 static bool opt_handler_string(const char* value_, void* option_, bool* optionSet_)
 {
@@ -95,6 +220,12 @@ static bool opt_handler_string(const char* value_, void* option_, bool* optionSe
 void program_options_init(program_options_t* options_)
 {
     memset(options_, 0, sizeof(*options_));
+    options_->reportRefreshMs   = 1000;
+    options_->logLevel          = LoggerLevelInfo;
+    options_->subframeCapture   = true;
+    options_->congestionControl = true;
+
+    for (int i = 0; i < AxisCount; i++) { axis_curve_params_init(&options_->axisCurves[i]); }
 }
 
 //---------------------------------------------------------------------------
@@ -142,6 +273,39 @@ bool program_options_load(program_options_t* options_, const char* filePath_)
         [PROGRAM_OPTION_TOUCH_OFFSET] = { "touch_offset", opt_handler_int, &options_->touchOffset, NULL },
         [PROGRAM_OPTION_USE_STEERING_WHEEL]
         = { "use_steering_controls", opt_handler_bool, &options_->useSteeringControls, NULL },
+        [PROGRAM_OPTION_SHOW_OVERLAY] = { "show_overlay", opt_handler_bool, &options_->showOverlay, NULL },
+        [PROGRAM_OPTION_STATS_INTERVAL]
+        = { "stats_interval_ms", opt_handler_int, &options_->statsIntervalMs, NULL },
+        [PROGRAM_OPTION_IDLE_TIMEOUT] = { "idle_timeout_ms", opt_handler_int, &options_->idleTimeoutMs, NULL },
+        [PROGRAM_OPTION_IDLE_POLL]    = { "idle_poll_ms", opt_handler_int, &options_->idlePollMs, NULL },
+        [PROGRAM_OPTION_IDLE_BACKLIGHT_OFF]
+        = { "idle_backlight_off", opt_handler_bool, &options_->idleBacklightOff, NULL },
+        [PROGRAM_OPTION_REPORT_REFRESH]
+        = { "report_refresh_ms", opt_handler_int, &options_->reportRefreshMs, NULL },
+        [PROGRAM_OPTION_FRAMING]   = { "framing", opt_handler_framing, &options_->framing, NULL },
+        [PROGRAM_OPTION_LOG_LEVEL] = { "log_level", opt_handler_log_level, &options_->logLevel, NULL },
+        [PROGRAM_OPTION_LOG_FILE]  = { "log_file", opt_handler_string, &options_->logFile, NULL },
+        [PROGRAM_OPTION_SUBFRAME_CAPTURE]
+        = { "subframe_capture", opt_handler_bool, &options_->subframeCapture, NULL },
+        [PROGRAM_OPTION_EVENT_WAKEUP]  = { "event_wakeup", opt_handler_bool, &options_->eventWakeup, NULL },
+        [PROGRAM_OPTION_BUTTON_FRAMES] = { "button_frames", opt_handler_bool, &options_->buttonFrames, NULL },
+        [PROGRAM_OPTION_ANALOG_INTERVAL]
+        = { "analog_interval_ms", opt_handler_interval, &options_->analogIntervalMs, NULL },
+        [PROGRAM_OPTION_CONGESTION_CONTROL]
+        = { "congestion_control", opt_handler_bool, &options_->congestionControl, NULL },
+        [PROGRAM_OPTION_KEEP_WARM] = { "keep_warm_ms", opt_handler_int, &options_->keepWarmMs, NULL },
+        [PROGRAM_OPTION_KEEP_WARM_MEASURE]
+        = { "keep_warm_measure", opt_handler_bool, &options_->keepWarmMeasure, NULL },
+        [PROGRAM_OPTION_CIRCLE_PAD_X_RESPONSE]
+        = { "circle_pad_x_response", opt_handler_axis_curve, &options_->axisCurves[AxisCirclePadX], NULL },
+        [PROGRAM_OPTION_CIRCLE_PAD_Y_RESPONSE]
+        = { "circle_pad_y_response", opt_handler_axis_curve, &options_->axisCurves[AxisCirclePadY], NULL },
+        [PROGRAM_OPTION_CSTICK_X_RESPONSE]
+        = { "cstick_x_response", opt_handler_axis_curve, &options_->axisCurves[AxisCStickX], NULL },
+        [PROGRAM_OPTION_CSTICK_Y_RESPONSE]
+        = { "cstick_y_response", opt_handler_axis_curve, &options_->axisCurves[AxisCStickY], NULL },
+        [PROGRAM_OPTION_MIRROR]       = { "mirror", opt_handler_mirror, options_, NULL },
+        [PROGRAM_OPTION_MOTION_HINTS] = { "motion_hints", opt_handler_bool, &options_->motionHints, NULL },
     };
 
     // Open file and read contents into a buffer...
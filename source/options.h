@@ -7,10 +7,16 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "axis_curve.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
+//---------------------------------------------------------------------------
+// Most secondary destinations ("mirror" options) a stream is copied to
+#define PROGRAM_OPTIONS_MIRROR_MAX (2)
+
 //---------------------------------------------------------------------------
 typedef struct {
     char host[64];           //!< Hostname (IP) of the device to connect to
@@ -30,6 +36,29 @@ typedef struct {
     int  touchOffset; //!< Set the offset from the edges of the screen that are ignored for touch events (reduce active
                       //!< area to make it easier to reach corners)
     bool useSteeringControls; //!< Send motion-based steering-wheel controls with the gamepad device
+    bool showOverlay;         //!< Show live connection/performance statistics on the bottom screen
+    int  statsIntervalMs;     //!< Interval between telemetry messages sent to the server (0 == disabled)
+    int  idleTimeoutMs;       //!< Inactivity period before entering idle mode (0 == disabled)
+    int  idlePollMs;          //!< Input poll period while idle (0 == default)
+    bool idleBacklightOff;    //!< Turn the backlights off while idle
+    int  reportRefreshMs;     //!< Longest time a device goes without sending a report (0 == no limit)
+    int  framing;             //!< Framing codec used on each connection (framing_type_t)
+    int  logLevel;            //!< Minimum severity of logged messages (logger_level_t)
+    char logFile[64];         //!< File that log messages are appended to ("" == console only)
+    bool subframeCapture;     //!< Report every key edge recorded by the HID module, not just those seen by polls
+    bool eventWakeup;         //!< Poll when the HID module publishes a new sample, instead of at fixed times per frame
+    bool buttonFrames;        //!< Send button-only changes as compact button messages (requires server support)
+    int  analogIntervalMs;    //!< Shortest time between reports sent only for axis changes (0 == no limit)
+    bool congestionControl;   //!< Degrade motion, touch and analog updates when the link is congested
+    int  keepWarmMs;          //!< Time without traffic before a keepalive is sent (0 == disabled)
+    bool keepWarmMeasure;     //!< Measure first-press round trips with and without keep-warm
+    bool motionHints;         //!< Send axis velocities with stick and motion reports (requires server support)
+
+    axis_curve_params_t axisCurves[AxisCount]; //!< Response curve of each stick axis (indexed by axis_id_t)
+
+    char mirrorHost[PROGRAM_OPTIONS_MIRROR_MAX][64]; //!< Hostname (IP) of each mirror destination
+    int  mirrorPort[PROGRAM_OPTIONS_MIRROR_MAX];     //!< Port of each mirror destination
+    int  mirrorCount;                                //!< Number of mirror destinations
 } program_options_t;
 
 //---------------------------------------------------------------------------
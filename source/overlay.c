@@ -0,0 +1,128 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "overlay.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <3ds.h>
+
+#include "histogram.h"
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+#define OVERLAY_REFRESH_US (500000)
+#define OVERLAY_COLUMNS (40)
+
+//---------------------------------------------------------------------------
+static PrintConsole        bottomConsole;
+static bool                overlayInit;
+static uint64_t            lastRefreshTicks;
+static hid_device_status_t lastStatus[OVERLAY_MAX_DEVICES]; //!< As of the previous redraw, used to compute rates
+static histogram_t         lastWorkTicks;
+
+//---------------------------------------------------------------------------
+static void overlay_print_line(int row_, const char* format_, ...)
+{
+    char line[OVERLAY_COLUMNS + 1];
+
+    va_list args;
+    va_start(args, format_);
+    vsnprintf(line, sizeof(line), format_, args);
+    va_end(args);
+
+    // Position the cursor explicitly and pad to the full width, so the screen
+    // never needs to be cleared (avoids flicker).
+    printf("\x1b[%d;1H%-*s", row_, OVERLAY_COLUMNS - 1, line);
+}
+
+//---------------------------------------------------------------------------
+static void overlay_format_age(char* buffer_, size_t size_, uint64_t ageTicks_)
+{
+    uint32_t seconds = (uint32_t)(time_util_ticks_to_us(ageTicks_) / 1000000ULL);
+    snprintf(buffer_, size_, "%lu:%02lu:%02lu", seconds / 3600UL, (seconds / 60UL) % 60UL, seconds % 60UL);
+}
+
+//---------------------------------------------------------------------------
+void overlay_init(void)
+{
+    PrintConsole* previous = consoleSelect(consoleInit(GFX_BOTTOM, &bottomConsole));
+    consoleClear();
+    consoleSelect(previous);
+
+    memset(lastStatus, 0, sizeof(lastStatus));
+    histogram_init(&lastWorkTicks);
+    lastRefreshTicks = time_util_ticks();
+    overlayInit      = true;
+}
+
+//---------------------------------------------------------------------------
+void overlay_update(hid_device_t* const* devices_, size_t deviceCount_, const loop_stats_t* loopStats_)
+{
+    if (!overlayInit) {
+        return;
+    }
+
+    uint64_t now     = time_util_ticks();
+    uint64_t elapsed = now - lastRefreshTicks;
+    if (elapsed < time_util_us_to_ticks(OVERLAY_REFRESH_US)) {
+        return;
+    }
+    lastRefreshTicks = now;
+
+    PrintConsole* previous = consoleSelect(&bottomConsole);
+
+    // Loop timing, computed over the refresh window only.
+    histogram_t window;
+    histogram_delta(&window, &loopStats_->workTicks, &lastWorkTicks);
+    lastWorkTicks = loopStats_->workTicks;
+
+    int row = 1;
+    overlay_print_line(row++, "netstick");
+    overlay_print_line(row++,
+                       "loop p50 %luus p99 %luus",
+                       (unsigned long)time_util_ticks_to_us(histogram_percentile(&window, 0.50)),
+                       (unsigned long)time_util_ticks_to_us(histogram_percentile(&window, 0.99)));
+    overlay_print_line(
+        row++, "polls %lu missed %lu", (unsigned long)loopStats_->polls, (unsigned long)loopStats_->missedDeadlines);
+
+    if (deviceCount_ > OVERLAY_MAX_DEVICES) {
+        deviceCount_ = OVERLAY_MAX_DEVICES;
+    }
+
+    for (size_t i = 0; i < deviceCount_; i++) {
+        // The connection belongs to the sender thread, so the overlay works
+        // from the state it last published (or, if that was being replaced
+        // throughout the read, the state shown last time)
+        hid_device_status_t status;
+        if (!hid_device_read_status(devices_[i], &status)) {
+            status = lastStatus[i];
+        }
+
+        uint64_t sentDelta    = status.reportsSent - lastStatus[i].reportsSent;
+        uint64_t bytesDelta   = status.bytesSent - lastStatus[i].bytesSent;
+        uint64_t rateMessages = (sentDelta * TIME_UTIL_TICKS_PER_SEC) / elapsed;
+        uint64_t rateBytes    = (bytesDelta * TIME_UTIL_TICKS_PER_SEC) / elapsed;
+        lastStatus[i]         = status;
+
+        char age[16];
+        overlay_format_age(age, sizeof(age), now - status.stateTicks);
+
+        row++;
+        overlay_print_line(row++, "%-8s %-4s %s", devices_[i]->name, status.connected ? "UP" : "DOWN", age);
+        overlay_print_line(row++, " rpt/s %lu  B/s %lu", (unsigned long)rateMessages, (unsigned long)rateBytes);
+        overlay_print_line(row++,
+                           " err %lu  eagain %lu  conn %lu/%lu",
+                           (unsigned long)status.sendErrors,
+                           (unsigned long)status.sendBackpressure,
+                           (unsigned long)status.connects,
+                           (unsigned long)(status.connects + status.connectFailures));
+    }
+
+    consoleSelect(previous);
+}
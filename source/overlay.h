@@ -0,0 +1,44 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hid_device.h"
+#include "stats.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Maximum number of devices that can be shown on the overlay at once
+#define OVERLAY_MAX_DEVICES (4)
+
+//---------------------------------------------------------------------------
+/**
+ * @brief overlay_init Set up the bottom-screen console used to display the
+ * live performance overlay.  The previously-selected console remains selected
+ * for regular output.
+ */
+void overlay_init(void);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief overlay_update Redraw the overlay from the state of the devices'
+ * connections (as published by the sender thread) and the loop statistics.
+ * This is cheap to call every loop iteration, as the overlay is only redrawn
+ * at a low, fixed rate.
+ * @param devices_ array of devices to display
+ * @param deviceCount_ number of devices in the array (excess devices beyond
+ * OVERLAY_MAX_DEVICES are ignored)
+ * @param loopStats_ input loop timing statistics
+ */
+void overlay_update(hid_device_t* const* devices_, size_t deviceCount_, const loop_stats_t* loopStats_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,84 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "perf.h"
+
+#if defined(NETSTICK_PERF)
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "histogram.h"
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+static histogram_t perfHistograms[PerfStageCount];
+
+//---------------------------------------------------------------------------
+static const char* perfStageNames[PerfStageCount] = {
+    [PerfStageHidScan]       = "hid_scan",
+    [PerfStageSteeringWheel] = "steering",
+    [PerfStageReportBuild]   = "report",
+    [PerfStageEncode]        = "encode",
+    [PerfStageSend]          = "send",
+    [PerfStageLoop]          = "loop",
+};
+
+//---------------------------------------------------------------------------
+void perf_init(void)
+{
+    for (int i = 0; i < PerfStageCount; i++) { histogram_init(&perfHistograms[i]); }
+}
+
+//---------------------------------------------------------------------------
+void perf_record(perf_stage_t stage_, uint64_t startTicks_)
+{
+    uint64_t elapsed = time_util_ticks() - startTicks_;
+    if (elapsed > UINT32_MAX) {
+        elapsed = UINT32_MAX;
+    }
+    histogram_record(&perfHistograms[stage_], (uint32_t)elapsed);
+}
+
+//---------------------------------------------------------------------------
+void perf_scope_end(perf_scope_t* scope_)
+{
+    perf_record(scope_->stage, scope_->start);
+}
+
+//---------------------------------------------------------------------------
+void perf_dump(FILE* out_)
+{
+    fprintf(out_, "%-9s %8s %8s %8s %8s %8s\n", "stage(us)", "count", "mean", "p50", "p99", "max");
+    for (int i = 0; i < PerfStageCount; i++) {
+        const histogram_t* hist = &perfHistograms[i];
+        if (hist->total == 0) {
+            continue;
+        }
+        fprintf(out_,
+                "%-9s %8lu %8lu %8lu %8lu %8lu\n",
+                perfStageNames[i],
+                (unsigned long)hist->total,
+                (unsigned long)time_util_ticks_to_us(histogram_mean(hist)),
+                (unsigned long)time_util_ticks_to_us(histogram_percentile(hist, 0.50)),
+                (unsigned long)time_util_ticks_to_us(histogram_percentile(hist, 0.99)),
+                (unsigned long)time_util_ticks_to_us(hist->max));
+    }
+}
+
+//---------------------------------------------------------------------------
+bool perf_dump_to_file(const char* path_)
+{
+    FILE* out = fopen(path_, "w");
+    if (!out) {
+        printf("Error opening %s\n", path_);
+        return false;
+    }
+    perf_dump(out);
+    fclose(out);
+    return true;
+}
+
+#endif
@@ -0,0 +1,104 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "time_util.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Stages of the input loop that are instrumented with scoped timers.
+typedef enum {
+    PerfStageHidScan = 0,   //!< hidScanInput()
+    PerfStageSteeringWheel, //!< hid_steering_wheel_value()
+    PerfStageReportBuild,   //!< Building a HID report from the sampled input
+    PerfStageEncode,        //!< TLVC encoding + framing of an outgoing message
+    PerfStageSend,          //!< send() of an encoded message
+    PerfStageLoop,          //!< A complete iteration of the main loop
+    //--
+    PerfStageCount
+} perf_stage_t;
+
+//---------------------------------------------------------------------------
+// Instrumentation is only compiled in when NETSTICK_PERF is defined (i.e.
+// "make PERF=1"); otherwise all of the macros below expand to nothing.
+#if defined(NETSTICK_PERF)
+
+//---------------------------------------------------------------------------
+// Object used to implement a scoped timer -- not intended to be used directly.
+typedef struct {
+    perf_stage_t stage;
+    uint64_t     start;
+} perf_scope_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief perf_init Reset all of the per-stage latency histograms.
+ */
+void perf_init(void);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief perf_record Record the time elapsed since startTicks_ against a stage
+ * @param stage_ stage to record the sample against
+ * @param startTicks_ tick count (from time_util_ticks()) when the stage began
+ */
+void perf_record(perf_stage_t stage_, uint64_t startTicks_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief perf_scope_end Cleanup handler for PERF_SCOPE(); records the elapsed
+ * time for the scope's stage.
+ * @param scope_ scope object going out of scope
+ */
+void perf_scope_end(perf_scope_t* scope_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief perf_dump Write a summary of all per-stage histograms to a stream
+ * @param out_ stream to write to (i.e. stdout for the console)
+ */
+void perf_dump(FILE* out_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief perf_dump_to_file Write a summary of all per-stage histograms to a
+ * file (i.e. on the SD card).
+ * @param path_ path of the file to create/overwrite
+ * @return true on success, false if the file could not be written
+ */
+bool perf_dump_to_file(const char* path_);
+
+#define PERF_CONCAT_INNER(a_, b_) a_##b_
+#define PERF_CONCAT(a_, b_) PERF_CONCAT_INNER(a_, b_)
+
+//---------------------------------------------------------------------------
+// Time everything from this point until the end of the enclosing scope.
+#define PERF_SCOPE(stage_)                                                                                             \
+    perf_scope_t PERF_CONCAT(perfScope_, __LINE__) __attribute__((cleanup(perf_scope_end)))                            \
+    = { (stage_), time_util_ticks() }
+
+#define PERF_INIT() perf_init()
+#define PERF_DUMP(out_) perf_dump(out_)
+#define PERF_DUMP_TO_FILE(path_) perf_dump_to_file(path_)
+
+#else
+
+#define PERF_SCOPE(stage_) ((void)0)
+#define PERF_INIT() ((void)0)
+#define PERF_DUMP(out_) ((void)0)
+#define PERF_DUMP_TO_FILE(path_) ((void)0)
+
+#endif
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,181 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "pipeline.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <3ds.h>
+
+#include "logger.h"
+#include "telemetry.h"
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+#define PIPELINE_STACK_SIZE (32 * 1024)
+
+// Longest the sender waits for a snapshot before servicing its connections
+// (receiving server messages, telemetry) anyway.
+#define PIPELINE_WAIT_NS (100000000LL)
+
+// The sampler only runs while the app is in the foreground; if it hasn't sent
+// a snapshot for this long, the app is assumed to be suspended.
+#define PIPELINE_FOREGROUND_US (250000ULL)
+
+//---------------------------------------------------------------------------
+static void pipeline_process(pipeline_t* pipeline_, const input_state_t* input_)
+{
+    pipeline_->inputTicks = time_util_ticks();
+    pipeline_->inputIdle  = input_->idle;
+    pipeline_->processed++;
+
+    // Each device keeps its own connections, and retries them on its own
+    for (size_t i = 0; i < pipeline_->deviceCount; i++) {
+        hid_device_t* device = pipeline_->devices[i];
+
+        // Only the gamepad reports on every poll; the other devices report once
+        // per frame, and motion sensors not at all while idle.
+        if ((i != 0) && !input_->allDevices) {
+            continue;
+        }
+        if (device->isMotionSensor && input_->idle) {
+            continue;
+        }
+        handle_hid_events(device, pipeline_->options, input_);
+    }
+}
+
+//---------------------------------------------------------------------------
+static void pipeline_drain(pipeline_t* pipeline_)
+{
+    input_state_t current;
+    input_state_t next;
+
+    if (!input_ring_pop(&pipeline_->ring, &current)) {
+        return;
+    }
+
+    // Collapse runs of queued snapshots with identical buttons to the newest
+    // one, so that the sender catches up.  Every button edge that reached the
+    // ring is still processed; only snapshots overwritten while the ring was
+    // full (see input_ring_push()) are lost, edges and all, with the newest
+    // state winning.
+    while (input_ring_pop(&pipeline_->ring, &next)) {
+        if (next.keys != current.keys) {
+            pipeline_process(pipeline_, &current);
+        } else {
+            next.allDevices = next.allDevices || current.allDevices;
+            pipeline_->collapsed++;
+        }
+        current = next;
+    }
+    pipeline_process(pipeline_, &current);
+}
+
+//---------------------------------------------------------------------------
+static void pipeline_sender_thread(void* arg_)
+{
+    pipeline_t* pipeline = (pipeline_t*)arg_;
+
+    while (!atomic_load(&pipeline->stopping)) {
+        LightEvent_WaitTimeout(&pipeline->ready, PIPELINE_WAIT_NS);
+
+        pipeline_drain(pipeline);
+
+        if (pipeline->options->congestionControl) {
+            congestion_update(&pipeline->congestion, pipeline->devices, pipeline->deviceCount);
+        }
+
+        // Keepalives only while the user is around: in the foreground, and not idle
+        uint64_t quietTicks = time_util_ticks() - pipeline->inputTicks;
+        bool     active     = !pipeline->inputIdle && (quietTicks < time_util_us_to_ticks(PIPELINE_FOREGROUND_US));
+        keep_warm_update(&pipeline->keepWarm, pipeline->devices[0], active);
+
+        if (pipeline->options->statsIntervalMs > 0) {
+            telemetry_update(
+                pipeline->devices, pipeline->deviceCount, &pipeline->loopStats, pipeline->options->statsIntervalMs);
+        }
+
+        // Let the main thread's overlay see the devices' connections
+        for (size_t i = 0; i < pipeline->deviceCount; i++) { hid_device_publish_status(pipeline->devices[i]); }
+    }
+}
+
+//---------------------------------------------------------------------------
+bool pipeline_start(pipeline_t*              pipeline_,
+                    hid_device_t* const*     devices_,
+                    size_t                   deviceCount_,
+                    const program_options_t* options_)
+{
+    input_ring_init(&pipeline_->ring);
+    LightEvent_Init(&pipeline_->ready, RESET_ONESHOT);
+    atomic_init(&pipeline_->stopping, false);
+
+    pipeline_->devices     = devices_;
+    pipeline_->deviceCount = deviceCount_;
+    pipeline_->options     = options_;
+    pipeline_->processed   = 0;
+    pipeline_->collapsed   = 0;
+    pipeline_->inputTicks  = time_util_ticks();
+    pipeline_->inputIdle   = false;
+    loop_stats_snapshot_init(&pipeline_->loopStats);
+    congestion_init(&pipeline_->congestion);
+    keep_warm_init(&pipeline_->keepWarm, (uint32_t)options_->keepWarmMs, options_->keepWarmMeasure);
+
+    // Run below the sampler's priority, so a vblank/poll wakeup always preempts
+    // the sender.  Use the New 3DS's extra core if we have it.
+    s32 priority = 0x30;
+    svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+
+    bool isNew3DS = false;
+    APT_CheckNew3DS(&isNew3DS);
+
+    pipeline_->thread = threadCreate(
+        pipeline_sender_thread, pipeline_, PIPELINE_STACK_SIZE, priority + 1, isNew3DS ? 2 : -2, false);
+    if (!pipeline_->thread) {
+        printf("Error creating sender thread\n");
+        return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void pipeline_submit(pipeline_t* pipeline_, const input_state_t* input_)
+{
+    input_ring_push(&pipeline_->ring, input_);
+    LightEvent_Signal(&pipeline_->ready);
+}
+
+//---------------------------------------------------------------------------
+void pipeline_publish_loop_stats(pipeline_t* pipeline_, const loop_stats_t* loopStats_)
+{
+    loop_stats_publish(&pipeline_->loopStats, loopStats_);
+}
+
+//---------------------------------------------------------------------------
+void pipeline_stop(pipeline_t* pipeline_)
+{
+    if (!pipeline_->thread) {
+        return;
+    }
+
+    atomic_store(&pipeline_->stopping, true);
+    LightEvent_Signal(&pipeline_->ready);
+    threadJoin(pipeline_->thread, UINT64_MAX);
+    threadFree(pipeline_->thread);
+    pipeline_->thread = NULL;
+
+    LOG_INFO("pipeline: %lu snapshots, %lu processed, %lu collapsed, %lu overflowed",
+             (unsigned long)pipeline_->ring.pushed,
+             (unsigned long)pipeline_->processed,
+             (unsigned long)pipeline_->collapsed,
+             (unsigned long)pipeline_->ring.overflows);
+    if (pipeline_->options->congestionControl) {
+        congestion_print(&pipeline_->congestion);
+    }
+    keep_warm_print(&pipeline_->keepWarm);
+}
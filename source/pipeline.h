@@ -0,0 +1,95 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <3ds.h>
+
+#include "congestion.h"
+#include "hid_device.h"
+#include "input_ring.h"
+#include "input_state.h"
+#include "keep_warm.h"
+#include "options.h"
+#include "stats.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Two-stage input pipeline.  The sampler (the main thread) polls the HID
+// service at a steady rate and submits snapshots into a lock-free SPSC ring.
+// The sender thread drains the ring and runs each device's report building,
+// encoding and socket I/O, so that slow sends and reconnects never delay the
+// next hidScanInput().
+typedef struct {
+    input_ring_t ring;     //!< Snapshots from the sampler to the sender
+    LightEvent   ready;    //!< Signalled by the sampler after each submit
+    Thread       thread;   //!< Sender thread
+    atomic_bool  stopping; //!< Set to ask the sender thread to exit
+
+    hid_device_t* const*     devices;     //!< Devices serviced by the sender
+    size_t                   deviceCount; //!< Number of devices
+    const program_options_t* options;     //!< Program options
+    loop_stats_snapshot_t    loopStats;   //!< Sampler timing, published for telemetry
+
+    uint32_t     processed;  //!< Snapshots handed to the devices
+    uint32_t     collapsed;  //!< Snapshots dropped because a newer one with the same buttons was queued
+    congestion_t congestion; //!< Sheds motion, touch and analog fidelity when the link is congested
+    keep_warm_t  keepWarm;   //!< Keeps the gamepad's connection (and the radio) awake while input is quiet
+    uint64_t     inputTicks; //!< Time the last snapshot was received from the sampler
+    bool         inputIdle;  //!< The last snapshot was taken in idle mode
+} pipeline_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief pipeline_start Initialize the pipeline and start its sender thread.
+ * On a New 3DS, the sender runs on the extra application core; otherwise it
+ * shares the main thread's core at a lower priority.
+ * @param pipeline_ pipeline object to start
+ * @param devices_ devices to service from the sender thread.  The first device
+ * (the gamepad) reports on every poll, the others once per frame.
+ * @param deviceCount_ number of devices
+ * @param options_ program options
+ * @return true on success, false if the sender thread couldn't be created
+ */
+bool pipeline_start(pipeline_t*              pipeline_,
+                    hid_device_t* const*     devices_,
+                    size_t                   deviceCount_,
+                    const program_options_t* options_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief pipeline_submit Hand an input snapshot to the sender thread (sampler
+ * only).  Never blocks -- if the sender falls behind, the newest snapshot wins.
+ * @param pipeline_ pipeline to submit to
+ * @param input_ snapshot to submit
+ */
+void pipeline_submit(pipeline_t* pipeline_, const input_state_t* input_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief pipeline_publish_loop_stats Publish a copy of the sampler's loop
+ * statistics, for telemetry sent by the sender thread (sampler only).  Never
+ * blocks.
+ * @param pipeline_ pipeline to publish to
+ * @param loopStats_ sampler timing statistics
+ */
+void pipeline_publish_loop_stats(pipeline_t* pipeline_, const loop_stats_t* loopStats_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief pipeline_stop Stop the sender thread and wait for it to exit.
+ * @param pipeline_ pipeline to stop
+ */
+void pipeline_stop(pipeline_t* pipeline_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
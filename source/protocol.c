@@ -0,0 +1,85 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "protocol.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+#define FNV1A_OFFSET_BASIS ((uint32_t)(2166136261UL))
+#define FNV1A_PRIME ((uint32_t)(16777619UL))
+
+//---------------------------------------------------------------------------
+uint32_t protocol_config_hash(const js_config_t* config_)
+{
+    const uint8_t* raw  = (const uint8_t*)config_;
+    uint32_t       hash = FNV1A_OFFSET_BASIS;
+    for (size_t i = 0; i < sizeof(*config_); i++) {
+        hash ^= raw[i];
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
+}
+
+//---------------------------------------------------------------------------
+void protocol_pack_buttons(const uint8_t* buttons_, size_t buttonCount_, uint8_t* out_)
+{
+    memset(out_, 0, PROTOCOL_BUTTONS_SIZE(buttonCount_));
+    for (size_t i = 0; i < buttonCount_; i++) {
+        if (buttons_[i]) {
+            out_[i / 8] |= (uint8_t)(1u << (i % 8));
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+void protocol_unpack_buttons(const uint8_t* packed_, size_t buttonCount_, uint8_t* buttons_)
+{
+    for (size_t i = 0; i < buttonCount_; i++) { buttons_[i] = (packed_[i / 8] >> (i % 8)) & 1; }
+}
+
+//---------------------------------------------------------------------------
+const uint8_t* protocol_parse_hinted_report(const void*             data_,
+                                            size_t                  dataLen_,
+                                            netstick_report_hint_t* hint_,
+                                            int32_t*                velocities_,
+                                            size_t                  maxVelocities_,
+                                            size_t*                 reportLen_)
+{
+    const uint8_t* raw = (const uint8_t*)data_;
+
+    if (dataLen_ < sizeof(*hint_)) {
+        return NULL;
+    }
+    memcpy(hint_, raw, sizeof(*hint_));
+
+    size_t hintSize = PROTOCOL_HINT_SIZE(hint_->axisCount);
+    if ((hint_->axisCount > maxVelocities_) || (dataLen_ < hintSize)) {
+        return NULL;
+    }
+
+    memcpy(velocities_, raw + sizeof(*hint_), (size_t)hint_->axisCount * sizeof(int32_t));
+    *reportLen_ = dataLen_ - hintSize;
+    return raw + hintSize;
+}
+
+//---------------------------------------------------------------------------
+const char* protocol_tag_name(uint16_t tag_)
+{
+    switch (tag_) {
+        case NetstickTagConfig: return "config";
+        case NetstickTagReport: return "report";
+        case NetstickTagStats: return "stats";
+        case NetstickTagSessionToken: return "session-token";
+        case NetstickTagSessionResume: return "session-resume";
+        case NetstickTagFraming: return "framing";
+        case NetstickTagButtons: return "buttons";
+        case NetstickTagRateControl: return "rate-control";
+        case NetstickTagKeepAlive: return "keep-alive";
+        case NetstickTagHintedReport: return "hinted-report";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,199 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "joystick.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// TLVC tags used for messages exchanged with the server (see PROTOCOL.txt)
+typedef enum {
+    NetstickTagConfig        = 0, //!< Client -> server: js_config_t device configuration
+    NetstickTagReport        = 1, //!< Client -> server: HID report
+    NetstickTagStats         = 2, //!< Client -> server: netstick_stats_t telemetry
+    NetstickTagSessionToken  = 3, //!< Server -> client: netstick_session_token_t
+    NetstickTagSessionResume = 4, //!< Client -> server: netstick_session_resume_t (sent instead of a config)
+    NetstickTagFraming       = 5, //!< Client -> server: netstick_framing_t (SLIP-framed; selects the framing codec)
+    NetstickTagButtons       = 6, //!< Client -> server: button state only, one bit per button
+    NetstickTagRateControl   = 7, //!< Server -> client: netstick_rate_control_t (report pacing for the connection)
+    NetstickTagKeepAlive     = 8, //!< Client <-> server: netstick_keepalive_t (keeps the link awake; may be echoed)
+    NetstickTagHintedReport  = 9, //!< Client -> server: HID report with sample time and axis velocities
+} netstick_tag_t;
+
+//---------------------------------------------------------------------------
+// Payload of the NetstickTagStats message -- client-side performance counters
+// for the connection the message is sent on.  Counters are cumulative since
+// the client started; loop timing values cover the interval since the
+// previous stats message.
+typedef struct __attribute__((packed)) {
+    uint32_t intervalMs;        //!< Time covered by the loop timing values
+    uint32_t reportsGenerated;  //!< Reports sampled by the device's event handler
+    uint32_t reportsSent;       //!< Reports successfully sent
+    uint32_t reportsSuppressed; //!< Reports not sent because they duplicated the previous report
+    uint32_t sendErrors;        //!< Hard socket errors on send
+    uint32_t sendBackpressure;  //!< Sends that failed with EAGAIN
+    uint32_t connects;          //!< Successful connections (reconnects = connects - 1)
+    uint32_t connectFailures;   //!< Failed connection attempts
+    uint32_t loopP50Us;         //!< Median per-poll processing time (us)
+    uint32_t loopP99Us;         //!< 99th percentile per-poll processing time (us)
+    uint32_t loopMaxUs;         //!< Maximum per-poll processing time (us)
+    uint32_t pollRateHz;        //!< Input polls achieved per second
+    uint32_t missedDeadlines;   //!< Polls whose processing overran the poll period
+} netstick_stats_t;
+
+//---------------------------------------------------------------------------
+// Payload of the NetstickTagSessionToken message.  Sent by servers that
+// support session resumption after creating (or re-attaching to) the device
+// for a connection.
+typedef struct __attribute__((packed)) {
+    uint64_t token;      //!< Opaque token identifying the server-side device
+    uint32_t configHash; //!< protocol_config_hash() of the device's configuration
+    uint8_t  resumed;    //!< 1 if a resume request re-attached to an existing device, 0 otherwise
+} netstick_session_token_t;
+
+//---------------------------------------------------------------------------
+// Payload of the NetstickTagSessionResume message.  Sent by the client as
+// the first message on a new connection when it holds a session token, in
+// place of the configuration message.
+typedef struct __attribute__((packed)) {
+    uint64_t token;      //!< Token from the most recent NetstickTagSessionToken message
+    uint32_t configHash; //!< protocol_config_hash() of the device's configuration
+} netstick_session_resume_t;
+
+//---------------------------------------------------------------------------
+// Payload of the NetstickTagFraming message.  Sent SLIP-framed by clients
+// that use another framing codec, as the very first message on a connection.
+// All subsequent data in both directions uses the selected codec.
+typedef struct __attribute__((packed)) {
+    uint8_t framing; //!< framing_type_t of the codec used for the rest of the connection
+} netstick_framing_t;
+
+//---------------------------------------------------------------------------
+// Payload of the NetstickTagButtons message: the state of every button
+// registered in the device's configuration, packed one bit per button (LSB
+// first) in registration order.  Sent in place of a full report when only
+// buttons have changed, so button edges aren't held back by axis traffic.
+#define PROTOCOL_BUTTONS_SIZE(buttonCount_) (((size_t)(buttonCount_) + 7) / 8)
+
+//---------------------------------------------------------------------------
+// Payload of the NetstickTagRateControl message.  Sent by the server at any
+// time to match the traffic on a connection to what its consumer can use; the
+// client applies it to the connection's device immediately.  Button changes
+// are never delayed.
+typedef struct __attribute__((packed)) {
+    uint32_t intervalUs; //!< Shortest time between reports sent for axis changes alone (0 == no limit)
+    uint32_t coalesceUs; //!< Time an axis change is held, so that later changes go out with it (0 == none)
+    uint8_t  flags;      //!< netstick_rate_control_flag_t values
+} netstick_rate_control_t;
+
+//---------------------------------------------------------------------------
+// Value of a netstick_rate_control_t field that restores the client's own setting
+#define NETSTICK_RATE_CONTROL_DEFAULT (0xFFFFFFFFu)
+
+//---------------------------------------------------------------------------
+// Flags in netstick_rate_control_t
+typedef enum {
+    NetstickRateControlMotionOff = (1 << 0), //!< Motion-sensor devices stop sending reports (ignored by others)
+} netstick_rate_control_flag_t;
+
+//---------------------------------------------------------------------------
+// Payload of the NetstickTagKeepAlive message.  Sent by the client while its
+// input is quiet, so the Wi-Fi radio (and access point) don't enter
+// power-save between presses.  Servers ignore it, unless asked to echo it.
+typedef struct __attribute__((packed)) {
+    uint32_t sequence; //!< Sequence number chosen by the client, returned unchanged in an echo
+    uint8_t  flags;    //!< netstick_keepalive_flag_t values
+} netstick_keepalive_t;
+
+//---------------------------------------------------------------------------
+// Flags in netstick_keepalive_t
+typedef enum {
+    NetstickKeepAliveEcho  = (1 << 0), //!< Client -> server: return the message at once, as a reply
+    NetstickKeepAliveReply = (1 << 1), //!< Server -> client: the message is an echo
+} netstick_keepalive_flag_t;
+
+//---------------------------------------------------------------------------
+// Header of the NetstickTagHintedReport message, sent in place of a plain
+// report by clients that provide motion hints.  It is followed by one int32
+// velocity per absolute axis -- axis units per second, in fixed point with
+// NETSTICK_HINT_VELOCITY_SHIFT fraction bits -- and then by the report itself.
+// Receivers can use them to extrapolate each axis from the time it was
+// sampled to the time they use it.
+typedef struct __attribute__((packed)) {
+    uint32_t sampleUs;  //!< Client clock when the report's input was sampled (us; wraps)
+    uint8_t  axisCount; //!< Number of velocities that follow (the device's absolute axes)
+} netstick_report_hint_t;
+
+#define NETSTICK_HINT_VELOCITY_SHIFT (8)
+
+// Size of a NetstickTagHintedReport payload, excluding the report
+#define PROTOCOL_HINT_SIZE(axisCount_) (sizeof(netstick_report_hint_t) + ((size_t)(axisCount_) * sizeof(int32_t)))
+
+//---------------------------------------------------------------------------
+/**
+ * @brief protocol_config_hash Compute the hash used to verify that a resumed
+ * session refers to a device with an identical configuration (32-bit FNV-1a
+ * over the serialized configuration).
+ * @param config_ configuration to hash
+ * @return hash of the configuration
+ */
+uint32_t protocol_config_hash(const js_config_t* config_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief protocol_pack_buttons Pack a report's button section (one byte per
+ * button) into a NetstickTagButtons payload
+ * @param buttons_ button section of a report
+ * @param buttonCount_ number of buttons
+ * @param out_ [out] payload buffer, PROTOCOL_BUTTONS_SIZE(buttonCount_) bytes
+ */
+void protocol_pack_buttons(const uint8_t* buttons_, size_t buttonCount_, uint8_t* out_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief protocol_unpack_buttons Expand a NetstickTagButtons payload into a
+ * report's button section (one byte per button)
+ * @param packed_ payload, PROTOCOL_BUTTONS_SIZE(buttonCount_) bytes
+ * @param buttonCount_ number of buttons
+ * @param buttons_ [out] button section of a report
+ */
+void protocol_unpack_buttons(const uint8_t* packed_, size_t buttonCount_, uint8_t* buttons_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief protocol_parse_hinted_report Split a NetstickTagHintedReport
+ * payload into its header, velocities and report
+ * @param data_ payload
+ * @param dataLen_ size of the payload (in bytes)
+ * @param hint_ [out] header
+ * @param velocities_ [out] velocity of each absolute axis (hint_->axisCount entries)
+ * @param maxVelocities_ capacity of velocities_; the message is rejected if it has more
+ * @param reportLen_ [out] size of the report (in bytes)
+ * @return pointer to the report within data_, or NULL if the payload is malformed
+ */
+const uint8_t* protocol_parse_hinted_report(const void*             data_,
+                                            size_t                  dataLen_,
+                                            netstick_report_hint_t* hint_,
+                                            int32_t*                velocities_,
+                                            size_t                  maxVelocities_,
+                                            size_t*                 reportLen_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief protocol_tag_name Return a short, printable name for a message tag
+ * @param tag_ message tag (netstick_tag_t)
+ * @return name of the tag, or "unknown" for unrecognized tags
+ */
+const char* protocol_tag_name(uint16_t tag_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
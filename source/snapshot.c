@@ -0,0 +1,53 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "snapshot.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+void snapshot_init(snapshot_latch_t* latch_, void* copies_, const void* data_, size_t size_)
+{
+    atomic_init(&latch_->sequence, 0);
+    memcpy(copies_, data_, size_);
+    memcpy((uint8_t*)copies_ + size_, data_, size_);
+}
+
+//---------------------------------------------------------------------------
+void snapshot_publish(snapshot_latch_t* latch_, void* copies_, const void* data_, size_t size_)
+{
+    uint_fast32_t sequence = atomic_load_explicit(&latch_->sequence, memory_order_relaxed);
+
+    // Steer readers to copy 1 while copy 0 is written, then back to copy 0.
+    // Each bump is a release, so the copy readers are steered to is complete;
+    // the fence after it keeps the copy's writes from moving ahead of the bump,
+    // so a reader that saw any of them sees the bump when it re-checks.
+    atomic_store_explicit(&latch_->sequence, sequence + 1, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    memcpy(copies_, data_, size_);
+
+    atomic_store_explicit(&latch_->sequence, sequence + 2, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    memcpy((uint8_t*)copies_ + size_, data_, size_);
+}
+
+//---------------------------------------------------------------------------
+bool snapshot_read(const snapshot_latch_t* latch_, const void* copies_, void* data_, size_t size_)
+{
+    for (int attempt = 0; attempt < SNAPSHOT_READ_ATTEMPTS; attempt++) {
+        uint_fast32_t sequence = atomic_load_explicit(&latch_->sequence, memory_order_acquire);
+        memcpy(data_, (const uint8_t*)copies_ + ((sequence & 1) * size_), size_);
+
+        // The copy is only good if the writer didn't move on to (and start
+        // rewriting) the same copy in the meantime
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&latch_->sequence, memory_order_relaxed) == sequence) {
+            return true;
+        }
+    }
+    return false;
+}
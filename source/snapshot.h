@@ -0,0 +1,67 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Latched seqlock, for handing a copy of one thread's statistics to another.
+// The writer keeps two copies of the data and updates them one at a time,
+// bumping the sequence before each, so that readers always copy the one not
+// being written (copies[sequence & 1]).  A reader never waits for a write in
+// progress -- which matters on the Old 3DS, where the sampler and the sender
+// share a core, and a reader spinning on a preempted writer would never see
+// it finish -- and the writer never waits for readers.
+typedef struct {
+    atomic_uint_fast32_t sequence; //!< Latch sequence -- readers use copies[sequence & 1]
+} snapshot_latch_t;
+
+//---------------------------------------------------------------------------
+// Attempts made by snapshot_read() before giving up on data that the writer
+// kept updating
+#define SNAPSHOT_READ_ATTEMPTS (4)
+
+//---------------------------------------------------------------------------
+/**
+ * @brief snapshot_init Initialize a latch, and both of its copies
+ * @param latch_ latch to initialize
+ * @param copies_ the latch's two copies (an array of two objects of size_ bytes)
+ * @param data_ initial value of the copies
+ * @param size_ size of the data in bytes
+ */
+void snapshot_init(snapshot_latch_t* latch_, void* copies_, const void* data_, size_t size_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief snapshot_publish Publish new data (writer only).  Never blocks.
+ * @param latch_ latch guarding the copies
+ * @param copies_ the latch's two copies
+ * @param data_ data to publish
+ * @param size_ size of the data in bytes
+ */
+void snapshot_publish(snapshot_latch_t* latch_, void* copies_, const void* data_, size_t size_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief snapshot_read Take a consistent copy of the data last published.
+ * Never waits for the writer.
+ * @param latch_ latch guarding the copies
+ * @param copies_ the latch's two copies
+ * @param data_ [out] copy of the data
+ * @param size_ size of the data in bytes
+ * @return true on success, false if the writer published twice during each
+ * of SNAPSHOT_READ_ATTEMPTS attempts (data_ is then undefined)
+ */
+bool snapshot_read(const snapshot_latch_t* latch_, const void* copies_, void* data_, size_t size_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,63 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "stats.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "histogram.h"
+#include "snapshot.h"
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+void net_stats_init(net_stats_t* stats_)
+{
+    memset(stats_, 0, sizeof(*stats_));
+    histogram_init(&stats_->edgeLatencyUs);
+}
+
+//---------------------------------------------------------------------------
+void loop_stats_init(loop_stats_t* stats_)
+{
+    memset(stats_, 0, sizeof(*stats_));
+    histogram_init(&stats_->workTicks);
+}
+
+//---------------------------------------------------------------------------
+void loop_stats_record_poll(loop_stats_t* stats_, uint64_t startTicks_, uint64_t budgetTicks_)
+{
+    uint64_t elapsed = time_util_ticks() - startTicks_;
+
+    stats_->polls++;
+    if (elapsed > budgetTicks_) {
+        stats_->missedDeadlines++;
+    }
+
+    if (elapsed > UINT32_MAX) {
+        elapsed = UINT32_MAX;
+    }
+    histogram_record(&stats_->workTicks, (uint32_t)elapsed);
+}
+
+//---------------------------------------------------------------------------
+void loop_stats_snapshot_init(loop_stats_snapshot_t* snapshot_)
+{
+    loop_stats_t empty;
+    loop_stats_init(&empty);
+    snapshot_init(&snapshot_->latch, snapshot_->copies, &empty, sizeof(empty));
+}
+
+//---------------------------------------------------------------------------
+void loop_stats_publish(loop_stats_snapshot_t* snapshot_, const loop_stats_t* stats_)
+{
+    snapshot_publish(&snapshot_->latch, snapshot_->copies, stats_, sizeof(*stats_));
+}
+
+//---------------------------------------------------------------------------
+bool loop_stats_read(const loop_stats_snapshot_t* snapshot_, loop_stats_t* stats_)
+{
+    return snapshot_read(&snapshot_->latch, snapshot_->copies, stats_, sizeof(*stats_));
+}
@@ -0,0 +1,107 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "histogram.h"
+#include "snapshot.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Counters maintained by the send path for a single connection
+typedef struct {
+    uint32_t reportsGenerated;  //!< Reports sampled by the device's event handler
+    uint32_t reportsSent;       //!< Reports successfully handed to the socket
+    uint32_t reportsSuppressed; //!< Reports not sent because nothing changed
+    uint32_t messagesSent;      //!< Messages successfully handed to the socket
+    uint64_t bytesSent;         //!< Encoded bytes successfully handed to the socket
+    uint32_t sendErrors;        //!< Sends that failed with a hard socket error
+    uint32_t sendBackpressure;  //!< Writes that found the socket buffer full (EAGAIN, or a short write)
+    uint32_t framesDropped;     //!< Frames dropped because the socket buffer was full
+    uint32_t connects;          //!< Successful connections to the server
+    uint32_t connectFailures;   //!< Failed connection attempts
+    uint32_t buttonEdges;       //!< Button changes sent on the priority lane (as button messages or full reports)
+    uint32_t buttonFramesSent;  //!< Button-only messages sent
+    uint32_t reportsDeferred;   //!< Axis changes held back by analog pacing
+
+    histogram_t edgeLatencyUs; //!< Time from the sample of each button change to its send (us)
+} net_stats_t;
+
+//---------------------------------------------------------------------------
+// Timing statistics for the input-polling loop
+typedef struct {
+    histogram_t workTicks;       //!< Time spent sampling + processing input on each poll
+    uint32_t    polls;           //!< Number of polls performed
+    uint32_t    missedDeadlines; //!< Number of polls whose processing overran the poll period
+} loop_stats_t;
+
+//---------------------------------------------------------------------------
+// Loop statistics published by the thread that owns them, for another thread
+// to read (see snapshot.h)
+typedef struct {
+    snapshot_latch_t latch;
+    loop_stats_t     copies[2];
+} loop_stats_snapshot_t;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief net_stats_init Reset all of the counters in a net_stats_t object
+ * @param stats_ object to initialize
+ */
+void net_stats_init(net_stats_t* stats_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief loop_stats_init Reset all of the counters/histograms in a
+ * loop_stats_t object
+ * @param stats_ object to initialize
+ */
+void loop_stats_init(loop_stats_t* stats_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief loop_stats_record_poll Record the processing time of a single poll
+ * of the input loop.
+ * @param stats_ object to update
+ * @param startTicks_ tick count (from time_util_ticks()) when the poll began
+ * @param budgetTicks_ time available to the poll before the next one is due
+ */
+void loop_stats_record_poll(loop_stats_t* stats_, uint64_t startTicks_, uint64_t budgetTicks_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief loop_stats_snapshot_init Initialize a snapshot with empty statistics
+ * @param snapshot_ object to initialize
+ */
+void loop_stats_snapshot_init(loop_stats_snapshot_t* snapshot_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief loop_stats_publish Publish a copy of the loop statistics (owning
+ * thread only).  Never blocks.
+ * @param snapshot_ snapshot to publish into
+ * @param stats_ current statistics
+ */
+void loop_stats_publish(loop_stats_snapshot_t* snapshot_, const loop_stats_t* stats_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief loop_stats_read Read the loop statistics last published, from any
+ * thread.  Never waits for the owning thread.
+ * @param snapshot_ snapshot to read
+ * @param stats_ [out] copy of the statistics
+ * @return true on success, false if the statistics were republished during
+ * each attempt
+ */
+bool loop_stats_read(const loop_stats_snapshot_t* snapshot_, loop_stats_t* stats_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,93 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "telemetry.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "histogram.h"
+#include "net_util.h"
+#include "protocol.h"
+#include "time_util.h"
+
+//---------------------------------------------------------------------------
+static uint64_t    lastTelemetryTicks;
+static histogram_t lastWorkTicks;
+static uint32_t    lastPolls;
+
+//---------------------------------------------------------------------------
+void telemetry_init(void)
+{
+    lastTelemetryTicks = time_util_ticks();
+    histogram_init(&lastWorkTicks);
+    lastPolls = 0;
+}
+
+//---------------------------------------------------------------------------
+void telemetry_update(hid_device_t* const*         devices_,
+                      size_t                       deviceCount_,
+                      const loop_stats_snapshot_t* loopStats_,
+                      uint32_t                     intervalMs_)
+{
+    uint64_t now     = time_util_ticks();
+    uint64_t elapsed = now - lastTelemetryTicks;
+    if (elapsed < time_util_us_to_ticks((uint64_t)intervalMs_ * 1000ULL)) {
+        return;
+    }
+
+    // The loop statistics belong to the sampler; if it republished them
+    // throughout the read, try again on the next update
+    loop_stats_t loopStats;
+    if (!loop_stats_read(loopStats_, &loopStats)) {
+        return;
+    }
+    lastTelemetryTicks = now;
+
+    // Loop timing is computed over the window since the last stats message
+    histogram_t window;
+    histogram_delta(&window, &loopStats.workTicks, &lastWorkTicks);
+    lastWorkTicks = loopStats.workTicks;
+
+    uint64_t elapsedUs = time_util_ticks_to_us(elapsed);
+    uint32_t polls     = loopStats.polls - lastPolls;
+    lastPolls          = loopStats.polls;
+
+    netstick_stats_t msg = {};
+    msg.intervalMs       = (uint32_t)(elapsedUs / 1000ULL);
+    msg.loopP50Us        = (uint32_t)time_util_ticks_to_us(histogram_percentile(&window, 0.50));
+    msg.loopP99Us        = (uint32_t)time_util_ticks_to_us(histogram_percentile(&window, 0.99));
+    msg.loopMaxUs        = (window.total != 0) ? (uint32_t)time_util_ticks_to_us(window.max) : 0;
+    msg.pollRateHz       = (elapsedUs != 0) ? (uint32_t)(((uint64_t)polls * 1000000ULL) / elapsedUs) : 0;
+    msg.missedDeadlines  = loopStats.missedDeadlines;
+
+    for (size_t i = 0; i < deviceCount_; i++) {
+        hid_device_t* device = devices_[i];
+        if (!device->isInit || (device->sockFd == -1)) {
+            continue;
+        }
+
+        const net_stats_t* stats = &device->stats;
+        msg.reportsGenerated     = stats->reportsGenerated;
+        msg.reportsSent          = stats->reportsSent;
+        msg.reportsSuppressed    = stats->reportsSuppressed;
+        msg.sendErrors           = stats->sendErrors;
+        msg.sendBackpressure     = stats->sendBackpressure;
+        msg.connects             = stats->connects;
+        msg.connectFailures      = stats->connectFailures;
+
+        // Stats dropped for a full socket buffer are simply sent again next period
+        if (net_util_encode_and_transmit(device->sockFd,
+                                         device->framing,
+                                         &device->stats,
+                                         &device->txBacklog,
+                                         NetstickTagStats,
+                                         &msg,
+                                         sizeof(msg))
+            == NetUtilSendError) {
+            hid_device_disconnect(device);
+        }
+    }
+}
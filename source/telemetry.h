@@ -0,0 +1,41 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hid_device.h"
+#include "stats.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+/**
+ * @brief telemetry_init Reset the telemetry interval timer and loop-timing
+ * window.  Must be called before telemetry_update().
+ */
+void telemetry_init(void);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief telemetry_update Send a NetstickTagStats message to the server on
+ * each connected device's socket once every intervalMs_ milliseconds.  Calls
+ * made before the interval elapses return immediately.
+ * @param devices_ array of devices to report on
+ * @param deviceCount_ number of devices in the array
+ * @param loopStats_ input loop timing statistics, as published by the sampler
+ * @param intervalMs_ interval between stats messages in milliseconds
+ */
+void telemetry_update(hid_device_t* const*         devices_,
+                      size_t                       deviceCount_,
+                      const loop_stats_snapshot_t* loopStats_,
+                      uint32_t                     intervalMs_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
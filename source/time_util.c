@@ -0,0 +1,38 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#include "time_util.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_3DS)
+#include <3ds.h>
+#else
+#include <time.h>
+#endif
+
+//---------------------------------------------------------------------------
+uint64_t time_util_ticks(void)
+{
+#if defined(_3DS)
+    return svcGetSystemTick();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+//---------------------------------------------------------------------------
+uint64_t time_util_ticks_to_us(uint64_t ticks_)
+{
+    return (ticks_ * 1000ULL) / (TIME_UTIL_TICKS_PER_SEC / 1000ULL);
+}
+
+//---------------------------------------------------------------------------
+uint64_t time_util_us_to_ticks(uint64_t us_)
+{
+    return (us_ * (TIME_UTIL_TICKS_PER_SEC / 1000ULL)) / 1000ULL;
+}
@@ -0,0 +1,50 @@
+// Netstick-3ds - Copyright (c) 2021 Funkenstein Software Consulting.  See LICENSE.txt
+// for more details.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// Rate of the tick counter returned by time_util_ticks().  On the 3DS this
+// is the ARM11 system tick; on other platforms ticks are nanoseconds from a
+// monotonic clock.
+#if defined(_3DS)
+#define TIME_UTIL_TICKS_PER_SEC ((uint64_t)(268111856ULL))
+#else
+#define TIME_UTIL_TICKS_PER_SEC ((uint64_t)(1000000000ULL))
+#endif
+
+//---------------------------------------------------------------------------
+/**
+ * @brief time_util_ticks Return the current value of a free-running,
+ * monotonic tick counter.  Cheap enough to call from the input hot-path.
+ * @return current tick count
+ */
+uint64_t time_util_ticks(void);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief time_util_ticks_to_us Convert a tick count/delta to microseconds.
+ * @param ticks_ tick count to convert
+ * @return equivalent number of microseconds
+ */
+uint64_t time_util_ticks_to_us(uint64_t ticks_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief time_util_us_to_ticks Convert a duration in microseconds to ticks.
+ * @param us_ number of microseconds to convert
+ * @return equivalent number of ticks
+ */
+uint64_t time_util_us_to_ticks(uint64_t us_);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
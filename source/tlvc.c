@@ -8,6 +8,56 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+// Size of a message with no payload
+#define TLVC_OVERHEAD (sizeof(tlvc_header_t) + sizeof(tlvc_footer_t))
+
+// Loads summed into the 16-bit lanes of the wide checksum before they are
+// folded -- each load adds at most 2 * 0xFF to a lane, so 128 can't overflow.
+#define TLVC_LANE_LOADS (128)
+#define TLVC_LANE_MASK (0x00FF00FF00FF00FFULL)
+
+//---------------------------------------------------------------------------
+// Sum of all bytes in a buffer (mod 2^16).  Eight bytes are loaded at a time
+// (with memcpy, so the buffer needn't be aligned), and added pairwise into
+// four 16-bit lanes.  Byte order doesn't matter, as every byte is summed.
+static uint16_t tlvc_checksum(const uint8_t* data_, size_t dataLen_)
+{
+    uint32_t sum = 0;
+
+    while (dataLen_ >= sizeof(uint64_t)) {
+        size_t loads = dataLen_ / sizeof(uint64_t);
+        if (loads > TLVC_LANE_LOADS) {
+            loads = TLVC_LANE_LOADS;
+        }
+
+        uint64_t lanes = 0;
+        for (size_t i = 0; i < loads; i++) {
+            uint64_t word;
+            memcpy(&word, data_, sizeof(word));
+            lanes += (word & TLVC_LANE_MASK) + ((word >> 8) & TLVC_LANE_MASK);
+            data_ += sizeof(word);
+        }
+        dataLen_ -= loads * sizeof(uint64_t);
+
+        sum += (uint32_t)((lanes & 0xFFFF) + ((lanes >> 16) & 0xFFFF) + ((lanes >> 32) & 0xFFFF) + (lanes >> 48));
+    }
+
+    for (size_t i = 0; i < dataLen_; i++) { sum += data_[i]; }
+    return (uint16_t)sum;
+}
+
+//---------------------------------------------------------------------------
+// Validate the message at the start of data_ (any alignment), whose header
+// has already been read, and which must hold the whole message described by
+// it.  Returns false if the checksum doesn't match.
+static bool tlvc_validate(const uint8_t* data_, const tlvc_header_t* header_, tlvc_footer_t* footer_)
+{
+    memcpy(footer_, data_ + sizeof(*header_) + header_->length, sizeof(*footer_));
+    return footer_->checksum == tlvc_checksum(data_, sizeof(*header_) + header_->length);
+}
 
 //---------------------------------------------------------------------------
 void tlvc_encode_data(tlvc_data_t* tlvc_, uint16_t tag_, size_t dataLen_, void* data_)
@@ -19,11 +69,8 @@ void tlvc_encode_data(tlvc_data_t* tlvc_, uint16_t tag_, size_t dataLen_, void*
     tlvc_->dataLen = dataLen_;
 
     // Compute checksum and add it to the footer
-    uint16_t checksum = 0;
-    uint8_t* raw      = (uint8_t*)(&tlvc_->header);
-    for (size_t i = 0; i < sizeof(tlvc_header_t); i++) { checksum += raw[i]; }
-    raw = (uint8_t*)(data_);
-    for (size_t i = 0; i < dataLen_; i++) { checksum += raw[i]; }
+    uint16_t checksum = tlvc_checksum((const uint8_t*)&tlvc_->header, sizeof(tlvc_header_t));
+    checksum += tlvc_checksum((const uint8_t*)data_, dataLen_);
 
     tlvc_->footer.checksum = checksum;
 }
@@ -31,32 +78,71 @@ void tlvc_encode_data(tlvc_data_t* tlvc_, uint16_t tag_, size_t dataLen_, void*
 //---------------------------------------------------------------------------
 bool tlvc_decode_data(tlvc_data_t* tlvc_, void* data_, size_t dataLen_)
 {
-    tlvc_header_t* header = (tlvc_header_t*)data_;
+    const uint8_t* raw = (const uint8_t*)data_;
+    tlvc_header_t  header;
+    tlvc_footer_t  footer;
 
     // Can't decode a tlvc structure if the raw data size is < header + footer.
-    if (dataLen_ < (sizeof(tlvc_footer_t) + sizeof(tlvc_header_t))) {
+    if (dataLen_ < TLVC_OVERHEAD) {
         return false;
     }
 
     // Verify payload is the same size as specified in the header
-    if (header->length != (dataLen_ - sizeof(tlvc_footer_t) - sizeof(tlvc_header_t))) {
+    memcpy(&header, raw, sizeof(header));
+    if (header.length != (dataLen_ - TLVC_OVERHEAD)) {
         return false;
     }
 
     // Compute + verify the message/header checksum
-    uint8_t* rawData  = data_;
-    uint16_t checksum = 0;
-    for (size_t i = 0; i < dataLen_ - 2; i++) { checksum += rawData[i]; }
-
-    tlvc_footer_t* footer = (tlvc_footer_t*)(data_ + sizeof(tlvc_header_t) + header->length);
-    if (footer->checksum != checksum) {
+    if (!tlvc_validate(raw, &header, &footer)) {
         return false;
     }
 
-    tlvc_->header  = *header;
-    tlvc_->footer  = *footer;
-    tlvc_->data    = ((uint8_t*)data_) + sizeof(tlvc_header_t);
-    tlvc_->dataLen = header->length;
+    tlvc_->header  = header;
+    tlvc_->footer  = footer;
+    tlvc_->data    = (uint8_t*)data_ + sizeof(tlvc_header_t);
+    tlvc_->dataLen = header.length;
 
     return true;
 }
+
+//---------------------------------------------------------------------------
+size_t tlvc_decode_batch(const void*         buffer_,
+                         const tlvc_frame_t* frames_,
+                         size_t              frameCount_,
+                         tlvc_view_t*        views_,
+                         uint32_t*           errors_)
+{
+    const uint8_t* raw    = (const uint8_t*)buffer_;
+    size_t         count  = 0;
+    uint32_t       errors = 0;
+
+    for (size_t i = 0; i < frameCount_; i++) {
+        const uint8_t* frame = raw + frames_[i].offset;
+        tlvc_header_t  header;
+        tlvc_footer_t  footer;
+
+        if (frames_[i].length < TLVC_OVERHEAD) {
+            errors++;
+            continue;
+        }
+
+        // The length field must describe this frame exactly -- a corrupt one
+        // costs only its own frame, as the next frame's boundaries don't
+        // depend on it
+        memcpy(&header, frame, sizeof(header));
+        if ((((size_t)header.length + TLVC_OVERHEAD) != frames_[i].length)
+            || !tlvc_validate(frame, &header, &footer)) {
+            errors++;
+            continue;
+        }
+
+        views_[count].data   = frame + sizeof(tlvc_header_t);
+        views_[count].tag    = header.tag;
+        views_[count].length = header.length;
+        count++;
+    }
+
+    *errors_ = errors;
+    return count;
+}
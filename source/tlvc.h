@@ -34,6 +34,25 @@ typedef struct {
     size_t        dataLen;
 } tlvc_data_t;
 
+//---------------------------------------------------------------------------
+// Boundaries of a decoded frame within a receiver's buffer, as passed to
+// tlvc_decode_batch()
+typedef struct {
+    size_t offset; //!< Start of the frame in the buffer
+    size_t length; //!< Size of the frame in bytes
+} tlvc_frame_t;
+
+//---------------------------------------------------------------------------
+// Lightweight view of a validated message, as returned by tlvc_decode_batch().
+// Nothing is copied: the payload pointer refers into the receiver's buffer,
+// and is only valid for as long as the buffer is.  The payload may be
+// unaligned, so multi-byte fields must be read with memcpy().
+typedef struct {
+    const uint8_t* data;   //!< Payload
+    uint16_t       tag;    //!< Message tag
+    uint16_t       length; //!< Payload length in bytes
+} tlvc_view_t;
+
 //---------------------------------------------------------------------------
 /**
  * @brief tlvc_encode_data construct a tlvc object for a payload of data.
@@ -56,6 +75,29 @@ void tlvc_encode_data(tlvc_data_t* tlvc_, uint16_t tag_, size_t dataLen_, void*
  */
 bool tlvc_decode_data(tlvc_data_t* tlvc_, void* data_, size_t dataLen_);
 
+//---------------------------------------------------------------------------
+/**
+ * @brief tlvc_decode_batch validate a batch of tlvc messages held in one
+ * buffer -- e.g. frames decoded from a read and appended one after another by
+ * a receiver -- in a single pass, producing a view of each valid message
+ * without copying it.  Each message is checked against the boundaries of its
+ * frame, as found by the framing codec, never against its neighbours': one
+ * whose length field doesn't match its frame, or whose checksum doesn't
+ * match, is counted as an error and skipped without affecting the others.
+ * @param buffer_ buffer holding the frames (no alignment requirement)
+ * @param frames_ boundaries of each frame in the buffer
+ * @param frameCount_ number of frames
+ * @param views_ [out] views of the valid messages, in frame order (room for
+ * frameCount_ views)
+ * @param errors_ [out] number of frames skipped as invalid
+ * @return number of views written
+ */
+size_t tlvc_decode_batch(const void*         buffer_,
+                         const tlvc_frame_t* frames_,
+                         size_t              frameCount_,
+                         tlvc_view_t*        views_,
+                         uint32_t*           errors_);
+
 #if defined(__cplusplus)
 } // extern "C"
 #endif